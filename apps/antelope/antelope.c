@@ -41,6 +41,7 @@
 #include <stdio.h>
 
 #include "antelope.h"
+#include "planner.h"
 
 static db_output_function_t output = printf;
 
@@ -153,8 +154,44 @@ db_print_tuple(db_handle_t *handle)
   return DB_OK;
 }
 
+db_result_t
+db_print_plan(db_handle_t *handle)
+{
+  db_plan_t *plan;
+  index_t *index;
+
+  if(!db_explaining(handle)) {
+    return DB_ARGUMENT_ERROR;
+  }
+
+  plan = &handle->plan;
+  if(plan->attr == NULL) {
+    output("[plan = scan, relation = %s, cardinality = %lu, cost = %lu]\n",
+           handle->rel->name, (unsigned long)plan->cardinality,
+           plan->cost);
+  } else {
+    index = plan->attr->index;
+    output("[plan = index, relation = %s, attribute = %s, index = %s, "
+           "range = (%ld, %ld), cardinality = %lu, estimated rows = %lu, "
+           "cost = %lu, scan cost = %lu]\n",
+           handle->rel->name, plan->attr->name,
+           planner_index_name(index->type), plan->min, plan->max,
+           (unsigned long)plan->cardinality,
+           (unsigned long)plan->estimated_rows,
+           plan->cost, plan->scan_cost);
+  }
+
+  return DB_OK;
+}
+
 int
 db_processing(db_handle_t *handle)
 {
   return handle->flags & DB_HANDLE_FLAG_PROCESSING;
 }
+
+int
+db_explaining(db_handle_t *handle)
+{
+  return handle->flags & DB_HANDLE_FLAG_EXPLAIN;
+}
@@ -112,7 +112,9 @@ aql_execute(db_handle_t *handle, aql_adt_t *adt)
     result = index_create(AQL_GET_INDEX_TYPE(adt), rel, relattr);
     break;
   case AQL_TYPE_CREATE_RELATION:
-    if(relation_create(adt->relations[0], DB_STORAGE) != NULL) {
+    if(relation_create(adt->relations[0], DB_STORAGE,
+                       (AQL_GET_FLAGS(adt) & AQL_FLAG_COLUMNAR) ?
+                       RELATION_FLAG_COLUMNAR : 0) != NULL) {
       result = DB_OK;
     }
     break;
@@ -152,6 +154,13 @@ aql_execute(db_handle_t *handle, aql_adt_t *adt)
       break;
     }
     result = relation_select(handle, rel, adt);
+    if(!DB_ERROR(result) && (AQL_GET_FLAGS(adt) & AQL_FLAG_EXPLAIN)) {
+      /* Keep the plan and the relations, which are referenced by the
+         plan until the handle is freed, but do not process the
+         selection. */
+      handle->flags &= ~DB_HANDLE_FLAG_PROCESSING;
+      handle->flags |= DB_HANDLE_FLAG_EXPLAIN;
+    }
     break;
   case AQL_TYPE_INSERT:
     result = relation_insert(rel, adt->values);
@@ -179,7 +188,8 @@ aql_execute(db_handle_t *handle, aql_adt_t *adt)
   }
 
   if(rel != NULL) {
-    if(handle == NULL || !(handle->flags & DB_HANDLE_FLAG_PROCESSING)) {
+    if(handle == NULL ||
+       !(handle->flags & (DB_HANDLE_FLAG_PROCESSING | DB_HANDLE_FLAG_EXPLAIN))) {
       relation_release(rel);
     }
   }
@@ -104,14 +104,16 @@ static const struct keyword keywords[] = {
   {"PROJECT", PROJECT},
   {"MAXHEAP", MAXHEAP},
   {"MEMHASH", MEMHASH},
+  {"EXPLAIN", EXPLAIN},
 
   {"RELATION", RELATION},
+  {"COLUMNAR", COLUMNAR},
 
   {"ATTRIBUTE", ATTRIBUTE}
 };
 
 /* Provides a pointer to the first keyword of a specific length. */
-static const int8_t skip_hint[] = {0, 13, 21, 27, 33, 36, 44, 47, 48};
+static const int8_t skip_hint[] = {0, 13, 21, 27, 33, 36, 44, 48, 50};
 
 static char separators[] = "#.;,() \t\n";
 
@@ -682,6 +682,16 @@ PARSER(create_relation)
   AQL_SET_TYPE(adt, AQL_TYPE_CREATE_RELATION);
   AQL_ADD_RELATION(adt, VALUE);
 
+  /* The storage type of the relation is optional. */
+  NEXT;
+  if(TOKEN != TYPE) {
+    REWIND;
+    RETURN(OK);
+  }
+
+  CONSUME(COLUMNAR);
+  AQL_SET_FLAG(adt, AQL_FLAG_COLUMNAR);
+
   RETURN(OK);
 }
 
@@ -837,6 +847,14 @@ aql_parse(aql_adt_t *external_adt, char *input_string)
     case SELECT:
       result = parse_select(&lex);
       break;
+    case EXPLAIN:
+      if(AQL_ERROR(lexer_next(&lex)) || *lex.token != SELECT) {
+	result = SYNTAX_ERROR;
+	break;
+      }
+      result = parse_select(&lex);
+      AQL_SET_FLAG(adt, AQL_FLAG_EXPLAIN);
+      break;
     case NONE:
     case COMMENT:
       result = OK;
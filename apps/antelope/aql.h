@@ -104,6 +104,8 @@ enum token {
   MEMHASH = 46,
   RELATION = 47,
   ATTRIBUTE = 48,
+  EXPLAIN = 49,
+  COLUMNAR = 50,
 
   INTEGER_VALUE = 251,
   FLOAT_VALUE = 252,
@@ -179,6 +181,8 @@ typedef struct aql_adt aql_adt_t;
 #define AQL_FLAG_AGGREGATE		1
 #define AQL_FLAG_ASSIGN			2
 #define AQL_FLAG_INVERSE_LOGIC		4
+#define AQL_FLAG_EXPLAIN		8
+#define AQL_FLAG_COLUMNAR		16
 
 #define AQL_CLEAR(adt)			aql_clear(adt)
 #define AQL_SET_TYPE(adt, type)	(((adt))->optype = (type))
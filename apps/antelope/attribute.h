@@ -57,9 +57,26 @@ typedef enum {
 #define ATTRIBUTE_FLAG_PRIMARY_KEY	0x4
 #define ATTRIBUTE_FLAG_UNIQUE		0x8
 
+/*
+ * Value statistics that the query planner uses for estimating the
+ * selectivity of conditions. The statistics are valid only if they 
+ * cover all the tuples in the relation.
+ */
+struct attribute_stats {
+  long min;
+  long max;
+  uint32_t tuples;
+  /* A bitmap in which each value sets one hashed bit, used for 
+     estimating the number of distinct values. */
+  uint32_t distinct_map;
+};
+
 struct attribute {
   struct attribute *next;
   void *index;
+#if DB_FEATURE_STATISTICS
+  struct attribute_stats stats;
+#endif /* DB_FEATURE_STATISTICS */
   long aggregation_value;
   uint8_t aggregator;
   uint8_t domain;
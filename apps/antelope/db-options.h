@@ -69,6 +69,26 @@
 #define DB_FEATURE_INTEGRITY		0
 #endif /* DB_FEATURE_INTEGRITY */
 
+/* Maintain value statistics for the query planner. */
+#ifndef DB_FEATURE_STATISTICS
+#define DB_FEATURE_STATISTICS		1
+#endif /* DB_FEATURE_STATISTICS */
+
+/* Support persistent hash table indexes. */
+#ifndef DB_FEATURE_MEMHASH
+#define DB_FEATURE_MEMHASH		0
+#endif /* DB_FEATURE_MEMHASH */
+
+/* Support batched tuple insertions with group commit. */
+#ifndef DB_FEATURE_BATCH
+#define DB_FEATURE_BATCH		0
+#endif /* DB_FEATURE_BATCH */
+
+/* Support relations that store each attribute in a separate file. */
+#ifndef DB_FEATURE_COLUMNAR
+#define DB_FEATURE_COLUMNAR		0
+#endif /* DB_FEATURE_COLUMNAR */
+
 /*----------------------------------------------------------------------------*/
 
 /* Configuration parameters that may be trimmed to save space. */
@@ -104,6 +124,22 @@
 #endif /* DB_MAX_ELEMENT_SIZE */
 
 
+/* The maximum number of tuples buffered in a batch before it
+   is committed to the relation. */
+#ifndef DB_BATCH_SIZE
+#define DB_BATCH_SIZE			8
+#endif /* DB_BATCH_SIZE */
+
+/* The maximum time that a batch may stay uncommitted. */
+#ifndef DB_BATCH_COMMIT_INTERVAL
+#define DB_BATCH_COMMIT_INTERVAL	(10 * CLOCK_SECOND)
+#endif /* DB_BATCH_COMMIT_INTERVAL */
+
+/* The maximum number of columnar relations loaded in memory. */
+#ifndef DB_COLUMNAR_RELATION_LIMIT
+#define DB_COLUMNAR_RELATION_LIMIT	2
+#endif /* DB_COLUMNAR_RELATION_LIMIT */
+
 /* The maximum size of the LVM bytecode compiled from a
    single database query. */
 #ifndef DB_VM_BYTECODE_SIZE
@@ -191,11 +227,44 @@
 #define DB_MEMHASH_INDEX_LIMIT  	1
 #endif /* DB_MEMHASH_INDEX_LIMIT */
 
-/* The default hash table index size. */
+/* The initial number of buckets in a hash table index. */
 #ifndef DB_MEMHASH_TABLE_SIZE
 #define DB_MEMHASH_TABLE_SIZE		61
 #endif /* DB_MEMHASH_TABLE_SIZE */
 
+/* The maximum number of buckets that a hash table index can grow to. */
+#ifndef DB_MEMHASH_TABLE_LIMIT
+#define DB_MEMHASH_TABLE_LIMIT		(4 * DB_MEMHASH_TABLE_SIZE)
+#endif /* DB_MEMHASH_TABLE_LIMIT */
+
+/* The maximum number of items stored in all hash table indexes. */
+#ifndef DB_MEMHASH_ITEM_LIMIT
+#define DB_MEMHASH_ITEM_LIMIT		256
+#endif /* DB_MEMHASH_ITEM_LIMIT */
+
+/* The average number of items per bucket at which a hash table 
+   index grows by one bucket. */
+#ifndef DB_MEMHASH_MAX_LOAD
+#define DB_MEMHASH_MAX_LOAD		2
+#endif /* DB_MEMHASH_MAX_LOAD */
+
+/* The file size to reserve for the insertion log of a hash table index. */
+#ifndef DB_MEMHASH_LOG_SIZE
+#define DB_MEMHASH_LOG_SIZE		(8 * 1024UL)
+#endif /* DB_MEMHASH_LOG_SIZE */
+
+/* The number of values in each encoded block of a column. The tuples
+   of a columnar relation are kept in row format until a block is full.
+   The value must be less than 256. */
+#ifndef DB_COLUMN_BLOCK_SIZE
+#define DB_COLUMN_BLOCK_SIZE		32
+#endif /* DB_COLUMN_BLOCK_SIZE */
+
+/* The file size to reserve for each column when using Coffee. */
+#ifndef DB_COLUMN_RESERVE_SIZE
+#define DB_COLUMN_RESERVE_SIZE		(32 * 1024UL)
+#endif /* DB_COLUMN_RESERVE_SIZE */
+
 /* The maximum number of Maxheap indexes. */
 #ifndef DB_HEAP_INDEX_LIMIT
 #define DB_HEAP_INDEX_LIMIT		1
@@ -88,7 +88,8 @@ get_value(tuple_id_t *index, relation_t *rel, attribute_t *attr)
   unsigned char row[rel->row_length];
   static attribute_value_t value;
 
-  if(DB_ERROR(storage_get_row(rel, index, row))) {
+  if(DB_ERROR(storage_get_columns(rel, index, row,
+                                  storage_attribute_mask(rel, attr)))) {
     return NULL;
   }
 
@@ -29,17 +29,27 @@
 
 /**
  * \file
- *	A memory-resident hash map used as a DB index.
+ *	A memory-resident hash map used as a DB index. The map grows 
+ *      incrementally by linear hashing: once the average number of 
+ *      items per bucket exceeds DB_MEMHASH_MAX_LOAD, one bucket at a 
+ *      time is split into two, so that no single insertion has to 
+ *      rehash the whole map. All updates are also appended to a log 
+ *      file in storage, from which the map is restored when the index 
+ *      is loaded again.
  * \author
  * 	Nicolas Tsiftes <nvt@sics.se>
  */
 
 #include <string.h>
 
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
 #include "lib/memb.h"
 
 #include "db-options.h"
 #include "index.h"
+#include "result.h"
+#include "storage.h"
 
 #define DEBUG DEBUG_NONE
 #include "net/uip-debug.h"
@@ -65,50 +75,474 @@ index_api_t index_memhash = {
 };
 
 struct hash_item {
+  struct hash_item *next;
+  long key;
   tuple_id_t tuple_id;
-  attribute_value_t value;
 };
 typedef struct hash_item hash_item_t;
 
-typedef hash_item_t hash_map_t[DB_MEMHASH_TABLE_SIZE];
+/* The physical representation of an update in the log file. A 
+   record type of zero marks the end of the log. */
+struct hash_record {
+  int32_t key;
+  tuple_id_t tuple_id;
+  uint8_t type;
+};
 
-MEMB(hash_map_memb, hash_map_t, DB_MEMHASH_INDEX_LIMIT);
+#define RECORD_INSERT	1
+#define RECORD_DELETE	2
+#define RECORD_SNAPSHOT	3
+
+/* The log is compacted by writing a snapshot of the map to a temporary
+   file, which is ended by a RECORD_SNAPSHOT record once it is complete,
+   and then copying the snapshot over the log. */
+#define SNAPSHOT_SUFFIX	".tmp"
+
+struct hash_map {
+  db_storage_id_t log_storage;
+  unsigned long log_offset;
+  unsigned long lookups;
+  unsigned long probes;
+  uint16_t item_count;
+  uint16_t split;
+  uint8_t level;
+  hash_item_t *buckets[DB_MEMHASH_TABLE_LIMIT];
+};
+typedef struct hash_map hash_map_t;
 
-static unsigned
-calculate_hash(attribute_value_t *value)
+MEMB(hash_map_memb, hash_map_t, DB_MEMHASH_INDEX_LIMIT);
+MEMB(hash_item_memb, hash_item_t, DB_MEMHASH_ITEM_LIMIT);
+
+/* The position of the item that get_next() returned last, so that the
+   next call for the same iterator can continue from it. The position
+   is invalidated whenever the map is modified. */
+static struct {
+  index_iterator_t *iterator;
+  hash_map_t *map;
+  hash_item_t *item;
+  tuple_id_t next_item_no;
+  long key;
+} cache;
+
+#define BUCKETS_AT_LEVEL(level)	((unsigned long)DB_MEMHASH_TABLE_SIZE << (level))
+#define BUCKET_COUNT(map)	(BUCKETS_AT_LEVEL((map)->level) + (map)->split)
+
+static unsigned long
+calculate_hash(long key)
 {
   unsigned char *cp, *end;
-  unsigned hash_value;
+  unsigned long hash_value;
 
-  cp = (unsigned char *)value;
-  end = cp + sizeof(*value);
+  cp = (unsigned char *)&key;
+  end = cp + sizeof(key);
   hash_value = 0;
 
   while(cp < end) {
     hash_value = hash_value * 33 + *cp++;
   }
 
-  return hash_value % DB_MEMHASH_TABLE_SIZE;
+  return hash_value;
+}
+
+static unsigned
+get_bucket(hash_map_t *map, long key)
+{
+  unsigned long hash_value;
+  unsigned long bucket;
+
+  /* Buckets below the split pointer have already been split, so they
+     are addressed using the hash function of the next level. */
+  hash_value = calculate_hash(key);
+  bucket = hash_value % BUCKETS_AT_LEVEL(map->level);
+  if(bucket < map->split) {
+    bucket = hash_value % BUCKETS_AT_LEVEL(map->level + 1);
+  }
+
+  return (unsigned)bucket;
+}
+
+static void
+invalidate_cache(hash_map_t *map)
+{
+  if(cache.map == map) {
+    cache.iterator = NULL;
+  }
+}
+
+static void
+split_bucket(hash_map_t *map)
+{
+  hash_item_t *item;
+  hash_item_t *next;
+  hash_item_t *remaining;
+  unsigned new_bucket;
+
+  if(BUCKET_COUNT(map) >= DB_MEMHASH_TABLE_LIMIT) {
+    return;
+  }
+
+  new_bucket = (unsigned)BUCKET_COUNT(map);
+  item = map->buckets[map->split];
+  remaining = NULL;
+  map->buckets[new_bucket] = NULL;
+
+  for(; item != NULL; item = next) {
+    next = item->next;
+    if(calculate_hash(item->key) % BUCKETS_AT_LEVEL(map->level + 1) ==
+       new_bucket) {
+      item->next = map->buckets[new_bucket];
+      map->buckets[new_bucket] = item;
+    } else {
+      item->next = remaining;
+      remaining = item;
+    }
+  }
+  map->buckets[map->split] = remaining;
+
+  if(++map->split == BUCKETS_AT_LEVEL(map->level)) {
+    map->level++;
+    map->split = 0;
+  }
+
+  PRINTF("DB: Split a hash bucket; the map has %lu buckets\n",
+         BUCKET_COUNT(map));
+}
+
+static db_result_t
+insert_item(hash_map_t *map, long key, tuple_id_t tuple_id)
+{
+  hash_item_t *item;
+  unsigned bucket;
+
+  item = memb_alloc(&hash_item_memb);
+  if(item == NULL) {
+    PRINTF("DB: No more hash items available\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  item->key = key;
+  item->tuple_id = tuple_id;
+
+  invalidate_cache(map);
+  bucket = get_bucket(map, key);
+  item->next = map->buckets[bucket];
+  map->buckets[bucket] = item;
+
+  if(++map->item_count > BUCKET_COUNT(map) * DB_MEMHASH_MAX_LOAD) {
+    split_bucket(map);
+  }
+
+  return DB_OK;
+}
+
+static void
+delete_items(hash_map_t *map, long key, tuple_id_t tuple_id)
+{
+  hash_item_t **itemp;
+  hash_item_t *item;
+
+  invalidate_cache(map);
+
+  /* Delete all items with the key, or only the item that refers to 
+     the tuple if a valid tuple ID is given. */
+  itemp = &map->buckets[get_bucket(map, key)];
+  while(*itemp != NULL) {
+    item = *itemp;
+    if(item->key == key &&
+       (tuple_id == INVALID_TUPLE || item->tuple_id == tuple_id)) {
+      *itemp = item->next;
+      memb_free(&hash_item_memb, item);
+      map->item_count--;
+    } else {
+      itemp = &item->next;
+    }
+  }
+}
+
+static void
+free_items(hash_map_t *map)
+{
+  unsigned i;
+  hash_item_t *item;
+  hash_item_t *next;
+
+  for(i = 0; i < BUCKET_COUNT(map); i++) {
+    for(item = map->buckets[i]; item != NULL; item = next) {
+      next = item->next;
+      memb_free(&hash_item_memb, item);
+    }
+    map->buckets[i] = NULL;
+  }
+  map->item_count = 0;
+}
+
+static hash_map_t *
+allocate_map(void)
+{
+  hash_map_t *map;
+
+  map = memb_alloc(&hash_map_memb);
+  if(map == NULL) {
+    return NULL;
+  }
+
+  memset(map, 0, sizeof(*map));
+  map->log_storage = -1;
+
+  return map;
+}
+
+static db_storage_id_t
+open_log(const char *filename)
+{
+  db_storage_id_t fd;
+
+  /* The log is only appended to, and the append mode prevents file
+     systems other than Coffee from truncating it when it is opened. */
+  fd = cfs_open(filename, CFS_READ | CFS_WRITE | CFS_APPEND);
+#if DB_FEATURE_COFFEE
+  if(fd >= 0) {
+    cfs_coffee_set_io_semantics(fd, CFS_COFFEE_IO_FLASH_AWARE);
+  }
+#endif
+  return fd;
+}
+
+static db_result_t
+put_record(db_storage_id_t fd, unsigned long offset,
+           long key, tuple_id_t tuple_id, uint8_t type)
+{
+  struct hash_record record;
+
+  /* Do not write uninitialized padding bytes to storage. */
+  memset(&record, 0, sizeof(record));
+  record.key = key;
+  record.tuple_id = tuple_id;
+  record.type = type;
+
+  return storage_write(fd, &record, offset, sizeof(record));
+}
+
+static db_result_t
+write_record(hash_map_t *map, long key, tuple_id_t tuple_id, uint8_t type)
+{
+  if(DB_ERROR(put_record(map->log_storage, map->log_offset,
+                         key, tuple_id, type))) {
+    return DB_STORAGE_ERROR;
+  }
+  map->log_offset += sizeof(struct hash_record);
+
+  return DB_OK;
+}
+
+static void
+get_snapshot_file(index_t *index, char *filename)
+{
+  strcpy(filename, index->descriptor_file);
+  strcat(filename, SNAPSHOT_SUFFIX);
+}
+
+/*
+ * Copy the first length bytes of a complete snapshot over the log, and
+ * remove the snapshot. The log file keeps its name, so that the index
+ * descriptor of the relation remains valid.
+ */
+static db_result_t
+install_snapshot(index_t *index, char *snapshot, unsigned long length)
+{
+  struct hash_record record;
+  db_storage_id_t from;
+  db_storage_id_t to;
+  unsigned long offset;
+  db_result_t result;
+
+  cfs_remove(index->descriptor_file);
+#if DB_FEATURE_COFFEE
+  cfs_coffee_reserve(index->descriptor_file, DB_MEMHASH_LOG_SIZE);
+#endif
+
+  from = cfs_open(snapshot, CFS_READ);
+  to = open_log(index->descriptor_file);
+  result = from < 0 || to < 0 ? DB_STORAGE_ERROR : DB_OK;
+
+  for(offset = 0; result == DB_OK && offset < length;
+      offset += sizeof(record)) {
+    result = storage_read(from, &record, offset, sizeof(record));
+    if(result == DB_OK) {
+      result = storage_write(to, &record, offset, sizeof(record));
+    }
+  }
+
+  if(from >= 0) {
+    storage_close(from);
+  }
+  if(to >= 0) {
+    storage_close(to);
+  }
+
+  if(DB_ERROR(result)) {
+    /* The snapshot is kept, so that load() will install it. */
+    return DB_STORAGE_ERROR;
+  }
+
+  cfs_remove(snapshot);
+
+  return DB_OK;
+}
+
+/*
+ * Finish a compaction that was interrupted by a restart. A complete
+ * snapshot is installed again, whereas an incomplete snapshot is
+ * removed, because the log is not modified until the snapshot is
+ * complete.
+ */
+static db_result_t
+recover_snapshot(index_t *index)
+{
+  char snapshot[sizeof(index->descriptor_file) + sizeof(SNAPSHOT_SUFFIX)];
+  struct hash_record record;
+  db_storage_id_t fd;
+  unsigned long length;
+
+  get_snapshot_file(index, snapshot);
+
+  fd = cfs_open(snapshot, CFS_READ);
+  if(fd < 0) {
+    return DB_OK;
+  }
+
+  memset(&record, 0, sizeof(record));
+  for(length = 0;; length += sizeof(record)) {
+    if(DB_ERROR(storage_read(fd, &record, length, sizeof(record))) ||
+       record.type != RECORD_INSERT) {
+      break;
+    }
+  }
+  storage_close(fd);
+
+  if(record.type != RECORD_SNAPSHOT) {
+    cfs_remove(snapshot);
+    return DB_OK;
+  }
+
+  PRINTF("DB: Installing the hash index snapshot %s\n", snapshot);
+
+  return install_snapshot(index, snapshot, length);
+}
+
+/*
+ * Replace the log with a snapshot of the items in the map. 
+ */
+static db_result_t
+compact_log(index_t *index)
+{
+  char snapshot[sizeof(index->descriptor_file) + sizeof(SNAPSHOT_SUFFIX)];
+  hash_map_t *map;
+  hash_item_t *item;
+  db_storage_id_t fd;
+  unsigned long offset;
+  unsigned i;
+
+  map = index->opaque_data;
+
+  PRINTF("DB: Compacting the hash index log %s\n", index->descriptor_file);
+
+  get_snapshot_file(index, snapshot);
+  cfs_remove(snapshot);
+#if DB_FEATURE_COFFEE
+  cfs_coffee_reserve(snapshot, DB_MEMHASH_LOG_SIZE);
+#endif
+
+  fd = open_log(snapshot);
+  if(fd < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  offset = 0;
+  for(i = 0; i < BUCKET_COUNT(map); i++) {
+    for(item = map->buckets[i]; item != NULL; item = item->next) {
+      if(DB_ERROR(put_record(fd, offset, item->key, item->tuple_id,
+                             RECORD_INSERT))) {
+        goto error;
+      }
+      offset += sizeof(struct hash_record);
+    }
+  }
+
+  if(DB_ERROR(put_record(fd, offset, 0, INVALID_TUPLE, RECORD_SNAPSHOT))) {
+    goto error;
+  }
+  storage_close(fd);
+
+  /* The log remains intact until the snapshot is complete. */
+  storage_close(map->log_storage);
+  map->log_storage = -1;
+  if(DB_ERROR(install_snapshot(index, snapshot, offset))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  map->log_storage = open_log(index->descriptor_file);
+  if(map->log_storage < 0) {
+    return DB_STORAGE_ERROR;
+  }
+  map->log_offset = offset;
+
+  return DB_OK;
+
+error:
+  storage_close(fd);
+  cfs_remove(snapshot);
+  return DB_STORAGE_ERROR;
+}
+
+/*
+ * Append an update, which has already been applied to the map, to the
+ * log. If the log is full, it is compacted instead, which makes the
+ * snapshot include the update.
+ */
+static db_result_t
+log_update(index_t *index, long key, tuple_id_t tuple_id, uint8_t type)
+{
+  hash_map_t *map;
+
+  map = index->opaque_data;
+
+  if(map->log_offset + sizeof(struct hash_record) > DB_MEMHASH_LOG_SIZE) {
+    return compact_log(index);
+  }
+
+  return write_record(map, key, tuple_id, type);
 }
 
 static db_result_t
 create(index_t *index)
 {
-  int i;
-  hash_map_t *hash_map;
+  char *filename;
+  hash_map_t *map;
 
   PRINTF("Creating a memory-resident hash map index\n");
 
-  hash_map = memb_alloc(&hash_map_memb);
-  if(hash_map == NULL) {
+  filename = storage_generate_file("hash", DB_MEMHASH_LOG_SIZE);
+  if(filename == NULL) {
+    PRINTF("DB: Failed to generate a hash index file\n");
+    return DB_INDEX_ERROR;
+  }
+  memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+
+  map = allocate_map();
+  if(map == NULL) {
+    cfs_remove(index->descriptor_file);
     return DB_ALLOCATION_ERROR;
   }
 
-  for(i = 0; i < DB_MEMHASH_TABLE_SIZE; i++) {
-    hash_map[i]->tuple_id = INVALID_TUPLE;
+  map->log_storage = open_log(index->descriptor_file);
+  if(map->log_storage < 0) {
+    memb_free(&hash_map_memb, map);
+    cfs_remove(index->descriptor_file);
+    return DB_STORAGE_ERROR;
   }
 
-  index->opaque_data = hash_map;
+  index->opaque_data = map;
 
   return DB_OK;
 }
@@ -116,7 +550,14 @@ create(index_t *index)
 static db_result_t
 destroy(index_t *index)
 {
-  memb_free(&hash_map_memb, index->opaque_data);
+  char snapshot[sizeof(index->descriptor_file) + sizeof(SNAPSHOT_SUFFIX)];
+
+  if(index->opaque_data != NULL) {
+    release(index);
+  }
+  cfs_remove(index->descriptor_file);
+  get_snapshot_file(index, snapshot);
+  cfs_remove(snapshot);
 
   return DB_OK;
 }
@@ -124,28 +565,88 @@ destroy(index_t *index)
 static db_result_t
 load(index_t *index)
 {
-  return create(index);
+  hash_map_t *map;
+  struct hash_record record;
+
+  if(DB_ERROR(recover_snapshot(index))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  map = allocate_map();
+  if(map == NULL) {
+    return DB_ALLOCATION_ERROR;
+  }
+  index->opaque_data = map;
+
+  map->log_storage = open_log(index->descriptor_file);
+  if(map->log_storage < 0) {
+    release(index);
+    return DB_STORAGE_ERROR;
+  }
+
+  /* Replay the log in order to restore the map. */
+  for(;;) {
+    if(DB_ERROR(storage_read(map->log_storage, &record,
+                             map->log_offset, sizeof(record)))) {
+      release(index);
+      return DB_STORAGE_ERROR;
+    }
+
+    if(record.type == RECORD_INSERT) {
+      if(DB_ERROR(insert_item(map, record.key, record.tuple_id))) {
+        release(index);
+        return DB_ALLOCATION_ERROR;
+      }
+    } else if(record.type == RECORD_DELETE) {
+      delete_items(map, record.key, INVALID_TUPLE);
+    } else {
+      break;
+    }
+    map->log_offset += sizeof(record);
+  }
+
+  PRINTF("DB: Loaded %u items into the hash index from %s\n",
+         map->item_count, index->descriptor_file);
+
+  return DB_OK;
 }
 
 static db_result_t
 release(index_t *index)
 {
-  return destroy(index);
+  hash_map_t *map;
+
+  map = index->opaque_data;
+  if(map->log_storage >= 0) {
+    storage_close(map->log_storage);
+  }
+  invalidate_cache(map);
+  free_items(map);
+  memb_free(&hash_map_memb, map);
+  index->opaque_data = NULL;
+
+  return DB_OK;
 }
 
 static db_result_t
 insert(index_t *index, attribute_value_t *value, tuple_id_t tuple_id)
 {
-  hash_map_t *hash_map;
-  uint16_t hash_value;
+  hash_map_t *map;
+  long key;
+
+  map = index->opaque_data;
+  key = db_value_to_long(value);
 
-  hash_map = index->opaque_data;
+  if(DB_ERROR(insert_item(map, key, tuple_id))) {
+    return DB_INDEX_ERROR;
+  }
 
-  hash_value = calculate_hash(value);
-  hash_map[hash_value]->tuple_id = tuple_id;
-  hash_map[hash_value]->value = *value;
+  if(DB_ERROR(log_update(index, key, tuple_id, RECORD_INSERT))) {
+    delete_items(map, key, tuple_id);
+    return DB_INDEX_ERROR;
+  }
 
-  PRINTF("DB: Inserted value %ld into the hash table\n", VALUE_LONG(value));
+  PRINTF("DB: Inserted value %ld into the hash table\n", key);
 
   return DB_OK;
 }
@@ -153,42 +654,111 @@ insert(index_t *index, attribute_value_t *value, tuple_id_t tuple_id)
 static db_result_t
 delete(index_t *index, attribute_value_t *value)
 {
-  hash_map_t *hash_map;
-  uint16_t hash_value;
+  hash_map_t *map;
+  long key;
+
+  map = index->opaque_data;
+  key = db_value_to_long(value);
 
-  hash_map = index->opaque_data;
+  delete_items(map, key, INVALID_TUPLE);
 
-  hash_value = calculate_hash(value);
-  if(memcmp(&hash_map[hash_value]->value, value, sizeof(*value)) != 0) {
+  if(DB_ERROR(log_update(index, key, INVALID_TUPLE, RECORD_DELETE))) {
     return DB_INDEX_ERROR;
   }
 
-  hash_map[hash_value]->tuple_id = INVALID_TUPLE;
   return DB_OK;
 }
 
 static tuple_id_t
 get_next(index_iterator_t *iterator)
 {
-  hash_map_t *hash_map;
-  uint16_t hash_value;
+  hash_map_t *map;
+  hash_item_t *item;
+  long key;
+  long max;
+  tuple_id_t skip;
+
+  map = iterator->index->opaque_data;
+
+  max = db_value_to_long(&iterator->max_value);
+
+  if(cache.iterator == iterator && cache.map == map &&
+     cache.next_item_no == iterator->next_item_no &&
+     iterator->next_item_no > 0) {
+    /* Continue after the item that was returned in the previous call. */
+    key = cache.key;
+    item = cache.item->next;
+    skip = 0;
+  } else {
+    /* Skip the items that have been returned in previous calls. */
+    key = db_value_to_long(&iterator->min_value);
+    map->lookups++;
+    item = map->buckets[get_bucket(map, key)];
+    skip = iterator->next_item_no;
+  }
 
-  if(iterator->next_item_no == 1) {
-    /* The memhash supports only unique values at the moment. */
-    return INVALID_TUPLE;
+  /* Ranges are emulated by looking up each key in the range
+     separately. */
+  for(;;) {
+    for(; item != NULL; item = item->next) {
+      map->probes++;
+      if(item->key == key) {
+        if(skip == 0) {
+          iterator->next_item_no++;
+          cache.iterator = iterator;
+          cache.map = map;
+          cache.item = item;
+          cache.next_item_no = iterator->next_item_no;
+          cache.key = key;
+          PRINTF("DB: Found value %ld in the hash table\n", key);
+          return item->tuple_id;
+        }
+        skip--;
+      }
+    }
+
+    if(key >= max) {
+      break;
+    }
+    key++;
+    map->lookups++;
+    item = map->buckets[get_bucket(map, key)];
   }
 
-  hash_map = iterator->index->opaque_data;
+  return INVALID_TUPLE;
+}
+
+db_result_t
+index_memhash_get_stats(index_t *index, index_memhash_stats_t *stats)
+{
+  hash_map_t *map;
+  hash_item_t *item;
+  unsigned i;
+  unsigned length;
 
-  hash_value = calculate_hash(&iterator->min_value);
-  if(memcmp(&hash_map[hash_value]->value, &iterator->min_value, sizeof(iterator->min_value)) != 0) {
-    return INVALID_TUPLE;
+  if(index->type != INDEX_MEMHASH || index->opaque_data == NULL) {
+    return DB_ARGUMENT_ERROR;
   }
 
-  iterator->next_item_no++;
-
-  PRINTF("DB: Found value %ld in the hash table\n", 
-	VALUE_LONG(&iterator->min_value));
+  map = index->opaque_data;
+
+  stats->items = map->item_count;
+  stats->buckets = BUCKET_COUNT(map);
+  stats->load_factor = (unsigned)(100UL * map->item_count / stats->buckets);
+  stats->lookups = map->lookups;
+  stats->probes = map->probes;
+
+  stats->max_probe_length = 0;
+  for(i = 0; i < stats->buckets; i++) {
+    for(length = 0, item = map->buckets[i];
+        item != NULL;
+        item = item->next) {
+      length++;
+    }
+    if(length > stats->max_probe_length) {
+      stats->max_probe_length = length;
+    }
+  }
 
-  return hash_map[hash_value]->tuple_id;
+  return DB_OK;
 }
@@ -98,6 +98,21 @@ extern index_api_t index_inline;
 extern index_api_t index_maxheap;
 extern index_api_t index_memhash;
 
+/* Statistics about the state of a hash table index. */
+struct index_memhash_stats {
+  unsigned items;
+  unsigned buckets;
+  /* The average number of items per bucket, multiplied by 100. */
+  unsigned load_factor;
+  /* The length of the longest bucket chain. */
+  unsigned max_probe_length;
+  /* The number of bucket lookups and chained items that have been
+     visited during the lookups. */
+  unsigned long lookups;
+  unsigned long probes;
+};
+typedef struct index_memhash_stats index_memhash_stats_t;
+
 void index_init(void);
 db_result_t index_create(index_type_t, relation_t *, attribute_t *);
 db_result_t index_destroy(index_t *);
@@ -109,5 +124,6 @@ db_result_t index_get_iterator(index_iterator_t *, index_t *,
                                attribute_value_t *, attribute_value_t *);
 tuple_id_t index_get_next(index_iterator_t *);
 int index_exists(attribute_t *);
+db_result_t index_memhash_get_stats(index_t *, index_memhash_stats_t *);
 
 #endif /* !INDEX_H */
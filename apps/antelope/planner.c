@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2012, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/**
+ * \file
+ *	A cost-based query planner, which chooses between a full scan of 
+ *      a relation and the use of one of its indexes. The number of 
+ *      tuples matching the range that the LVM has derived for an 
+ *      attribute is estimated from the value statistics of the 
+ *      attribute, which are maintained as tuples are inserted.
+ */
+
+#include <limits.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/uip-debug.h"
+
+#include "db-options.h"
+#include "index.h"
+#include "planner.h"
+
+/*
+ * The costs are expressed in the number of tuple reads that an access
+ * method is expected to cause. Hash table lookups are done in RAM and
+ * are thus free, whereas a MaxHeap lookup reads a bucket from storage.
+ */
+#define INDEX_MAXHEAP_KEY_COST	4
+#define INDEX_MEMHASH_KEY_COST	0
+
+#define DISTINCT_MAP_BITS	32
+
+#if DB_FEATURE_STATISTICS
+/* Linear counting: the expected number of distinct values, indexed by
+   the number of zero bits in the distinct map. */
+static const uint8_t distinct_estimates[DISTINCT_MAP_BITS + 1] = {
+  255, 111, 89, 76, 67, 59, 54, 49, 44, 41, 37, 34, 31, 29, 26, 24, 22,
+  20, 18, 17, 15, 13, 12, 11, 9, 8, 7, 5, 4, 3, 2, 1, 0
+};
+#endif /* DB_FEATURE_STATISTICS */
+
+static unsigned
+log2_ceil(unsigned long value)
+{
+  unsigned bits;
+
+  for(bits = 0; value > (1UL << bits) && bits < 31; bits++);
+
+  return bits;
+}
+
+void
+planner_init_stats(attribute_t *attr)
+{
+#if DB_FEATURE_STATISTICS
+  attr->stats.min = LONG_MAX;
+  attr->stats.max = LONG_MIN;
+  attr->stats.tuples = 0;
+  attr->stats.distinct_map = 0;
+#endif /* DB_FEATURE_STATISTICS */
+}
+
+void
+planner_update_stats(attribute_t *attr, attribute_value_t *value,
+                     tuple_id_t tuple_id)
+{
+#if DB_FEATURE_STATISTICS
+  long long_value;
+  uint32_t hash;
+
+  /* Statistics that have missed a tuple cannot be made valid again. */
+  if(attr->stats.tuples != tuple_id ||
+     (value->domain != DOMAIN_INT && value->domain != DOMAIN_LONG)) {
+    return;
+  }
+
+  long_value = db_value_to_long(value);
+  if(long_value < attr->stats.min) {
+    attr->stats.min = long_value;
+  }
+  if(long_value > attr->stats.max) {
+    attr->stats.max = long_value;
+  }
+
+  hash = (uint32_t)long_value * 2654435761UL;
+  attr->stats.distinct_map |= (uint32_t)1 << (hash >> 27);
+  attr->stats.tuples++;
+#endif /* DB_FEATURE_STATISTICS */
+}
+
+int
+planner_has_stats(relation_t *rel, attribute_t *attr)
+{
+#if DB_FEATURE_STATISTICS
+  tuple_id_t cardinality;
+
+  cardinality = relation_cardinality(rel);
+  return cardinality != INVALID_TUPLE && cardinality > 0 &&
+         attr->stats.tuples == cardinality;
+#else
+  return 0;
+#endif /* DB_FEATURE_STATISTICS */
+}
+
+unsigned long
+planner_distinct_values(relation_t *rel, attribute_t *attr)
+{
+#if DB_FEATURE_STATISTICS
+  unsigned zeros;
+  uint32_t map;
+  unsigned long estimate;
+  unsigned long span;
+
+  if(!planner_has_stats(rel, attr)) {
+    return 0;
+  }
+
+  for(zeros = 0, map = attr->stats.distinct_map; map != ~(uint32_t)0;
+      map |= map + 1) {
+    zeros++;
+  }
+
+  span = (unsigned long)attr->stats.max - attr->stats.min + 1;
+  if(span == 0) {
+    /* The values span the complete domain of a long. */
+    span = ULONG_MAX;
+  }
+
+  if(zeros == 0) {
+    /* The distinct map is saturated, so we can only tell that there are
+       many distinct values. */
+    estimate = span;
+  } else {
+    estimate = distinct_estimates[zeros];
+    if(estimate == 0) {
+      estimate = 1;
+    }
+  }
+
+  if(estimate > span) {
+    estimate = span;
+  }
+  if(estimate > attr->stats.tuples) {
+    estimate = attr->stats.tuples;
+  }
+
+  return estimate;
+#else
+  return 0;
+#endif /* DB_FEATURE_STATISTICS */
+}
+
+tuple_id_t
+planner_estimate_rows(relation_t *rel, attribute_t *attr, long min, long max)
+{
+  tuple_id_t cardinality;
+  unsigned long width;
+#if DB_FEATURE_STATISTICS
+  unsigned long span;
+  unsigned long fraction;
+#endif
+
+  cardinality = relation_cardinality(rel);
+  if(cardinality == INVALID_TUPLE || cardinality == 0 || min > max) {
+    return 0;
+  }
+
+  width = (unsigned long)max - min + 1;
+
+#if DB_FEATURE_STATISTICS
+  if(planner_has_stats(rel, attr)) {
+    if(max < attr->stats.min || min > attr->stats.max) {
+      return 0;
+    }
+
+    if(min == max) {
+      /* An equality condition matches the average number of tuples
+         per distinct value. */
+      return cardinality / planner_distinct_values(rel, attr);
+    }
+
+    /* Assume that the values are uniformly distributed between the 
+       minimum and the maximum value. */
+    if(min < attr->stats.min) {
+      min = attr->stats.min;
+    }
+    if(max > attr->stats.max) {
+      max = attr->stats.max;
+    }
+    width = (unsigned long)max - min + 1;
+    span = (unsigned long)attr->stats.max - attr->stats.min + 1;
+
+    while(span > 0xffff || span == 0) {
+      span = (span >> 1) | 0x8000;
+      width >>= 1;
+    }
+    if(width > span) {
+      width = span;
+    }
+
+    /* Compute the fraction of matching tuples in units of 1/256, 
+       rounding upward in order to avoid estimates of zero. */
+    fraction = (width * 256 + span - 1) / span;
+    return (cardinality / 256) * fraction +
+           ((cardinality % 256) * fraction + 255) / 256;
+  }
+#endif /* DB_FEATURE_STATISTICS */
+
+  /* Without statistics, we assume that each value in the range 
+     matches one tuple. */
+  if(width == 0 || width > cardinality) {
+    return cardinality;
+  }
+  return width;
+}
+
+static unsigned long
+index_cost(index_t *index, tuple_id_t cardinality,
+           long min, long max, tuple_id_t rows)
+{
+  unsigned long keys;
+
+  if(index->api->flags & INDEX_API_RANGE_QUERIES) {
+    /* Range indexes locate both ends of the range by binary search. */
+    return 2 * log2_ceil(cardinality) + rows;
+  }
+
+  /* Other indexes must look up each key in the range separately. The
+     index module refuses to do so for wide ranges. */
+  keys = (unsigned long)max - min + 1;
+  if(keys == 0 || keys - 1 > cardinality / DB_INDEX_COST) {
+    return ULONG_MAX;
+  }
+
+  switch(index->type) {
+  case INDEX_MAXHEAP:
+    return keys * INDEX_MAXHEAP_KEY_COST + rows;
+  case INDEX_MEMHASH:
+    return keys * INDEX_MEMHASH_KEY_COST + rows;
+  default:
+    return keys + rows;
+  }
+}
+
+void
+planner_choose(db_handle_t *handle, lvm_instance_t *lvm_instance)
+{
+  db_plan_t *plan;
+  attribute_t *attr;
+  index_t *index;
+  operand_value_t min;
+  operand_value_t max;
+  attribute_value_t av_min;
+  attribute_value_t av_max;
+  tuple_id_t rows;
+  unsigned long cost;
+
+  plan = &handle->plan;
+  plan->attr = NULL;
+  plan->cardinality = relation_cardinality(handle->rel);
+  if(plan->cardinality == INVALID_TUPLE) {
+    plan->cardinality = 0;
+  }
+  plan->estimated_rows = plan->cardinality;
+  plan->scan_cost = plan->cost = plan->cardinality;
+  if(lvm_instance == NULL) {
+    /* There is no condition to narrow down the search. */
+    return;
+  }
+
+  /* Estimate the cost of using each index for which the LVM has 
+     derived a range of acceptable values, and select the cheapest
+     access method. */
+  for(attr = list_head(handle->rel->attributes);
+      attr != NULL;
+      attr = attr->next) {
+    index = attr->index;
+    if(index == NULL || !index_exists(attr) ||
+       LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name, &min, &max))) {
+      continue;
+    }
+
+    rows = planner_estimate_rows(handle->rel, attr, min.l, max.l);
+    cost = index_cost(index, plan->cardinality, min.l, max.l, rows);
+
+    PRINTF("DB: Index %s on %s: range (%ld,%ld), %lu rows, cost %lu\n",
+           planner_index_name(index->type), attr->name,
+           min.l, max.l, (unsigned long)rows, cost);
+
+    if(cost < plan->cost ||
+       (plan->attr == NULL && cost == plan->cost && cost != ULONG_MAX)) {
+      plan->attr = attr;
+      plan->min = min.l;
+      plan->max = max.l;
+      plan->estimated_rows = rows;
+      plan->cost = cost;
+    }
+  }
+
+  if(plan->attr == NULL) {
+    PRINTF("DB: Planned a full scan over %lu tuples\n",
+           (unsigned long)plan->cardinality);
+    return;
+  }
+
+  av_min.domain = av_max.domain = DOMAIN_LONG;
+  VALUE_LONG(&av_min) = plan->min;
+  VALUE_LONG(&av_max) = plan->max;
+
+  if(index_get_iterator(&handle->index_iterator, plan->attr->index,
+                        &av_min, &av_max) == DB_OK) {
+    handle->flags |= DB_HANDLE_FLAG_SEARCH_INDEX;
+  } else {
+    /* Fall back to a full scan. */
+    plan->attr = NULL;
+    plan->estimated_rows = plan->cardinality;
+    plan->cost = plan->scan_cost;
+  }
+}
+
+const char *
+planner_index_name(index_type_t type)
+{
+  switch(type) {
+  case INDEX_INLINE:
+    return "inline";
+  case INDEX_MAXHEAP:
+    return "maxheap";
+  case INDEX_MEMHASH:
+    return "memhash";
+  default:
+    return "none";
+  }
+}
@@ -40,6 +40,7 @@
 #include "lib/crc16.h"
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "sys/ctimer.h"
 
 #define DEBUG DEBUG_NONE
 #include "net/uip-debug.h"
@@ -47,6 +48,7 @@
 #include "db-options.h"
 #include "index.h"
 #include "lvm.h"
+#include "planner.h"
 #include "relation.h"
 #include "result.h"
 #include "storage.h"
@@ -68,6 +70,9 @@ struct source_dest_map {
 
 static struct source_dest_map attr_map[AQL_ATTRIBUTE_LIMIT];
 
+/* The attributes that must be read from the source relation. */
+static storage_mask_t source_mask;
+
 #if DB_FEATURE_JOIN
 /*
  * The source_map structure is used for mapping attributes to
@@ -92,6 +97,22 @@ LIST(relations);
 MEMB(relations_memb, relation_t, DB_RELATION_POOL_SIZE);
 MEMB(attributes_memb, attribute_t, DB_ATTRIBUTE_POOL_SIZE);
 
+#if DB_FEATURE_BATCH
+/*
+ * Batched insertions are buffered for one relation at a time. The rows 
+ * are also appended to a log in storage, from which they can be 
+ * recovered if the system restarts before the batch has been committed.
+ */
+static relation_t *batch_rel;
+static tuple_id_t batch_base;
+static unsigned batch_count;
+static db_storage_id_t batch_log = -1;
+static struct ctimer batch_timer;
+static unsigned char batch_rows[DB_BATCH_SIZE * DB_MAX_ATTRIBUTES_PER_RELATION *
+                                DB_MAX_ELEMENT_SIZE];
+static db_result_t batch_recover(relation_t *);
+#endif /* DB_FEATURE_BATCH */
+
 static relation_t *relation_find(char *);
 static attribute_t *attribute_find(relation_t *, char *);
 static int get_attribute_value_offset(relation_t *, attribute_t *);
@@ -231,6 +252,10 @@ relation_load(char *name)
   rel = relation_find(name);
   if(rel != NULL) {
     rel->references++;
+#if DB_FEATURE_BATCH
+    /* Make pending insertions visible to the new user. */
+    relation_batch_commit(rel);
+#endif /* DB_FEATURE_BATCH */
     goto end;
   }
 
@@ -255,6 +280,20 @@ end:
     return NULL;
   }
 
+#if DB_FEATURE_BATCH
+  if(rel->dir == DB_STORAGE && rel->references == 1) {
+    /* The shared batch buffer is used for the recovery. */
+    if(batch_rel != NULL) {
+      relation_batch_commit(batch_rel);
+    }
+    if(DB_ERROR(batch_recover(rel))) {
+      PRINTF("DB: Failed to recover the batch log of %s\n", rel->name);
+      relation_release(rel);
+      return NULL;
+    }
+  }
+#endif /* DB_FEATURE_BATCH */
+
   return rel;
 }
 
@@ -266,6 +305,9 @@ relation_release(relation_t *rel)
   }
 
   if(rel->references == 0) {
+#if DB_FEATURE_BATCH
+    relation_batch_commit(rel);
+#endif /* DB_FEATURE_BATCH */
     storage_unload(rel);
   }
 
@@ -273,11 +315,22 @@ relation_release(relation_t *rel)
 }
 
 relation_t *
-relation_create(char *name, db_direction_t dir)
+relation_create(char *name, db_direction_t dir, uint8_t flags)
 {
   relation_t old_rel;
   relation_t *rel;
 
+#if DB_FEATURE_COLUMNAR
+  if((flags & RELATION_FLAG_COLUMNAR) && dir != DB_STORAGE) {
+    return NULL;
+  }
+#else
+  if(flags & RELATION_FLAG_COLUMNAR) {
+    PRINTF("DB: Columnar relations are not supported\n");
+    return NULL;
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   if(*name != '\0') {
     relation_clear(&old_rel);
 
@@ -298,6 +351,7 @@ relation_create(char *name, db_direction_t dir)
     strncpy(rel->name, name, sizeof(rel->name) - 1);
     rel->name[sizeof(rel->name) - 1] = '\0';
     rel->dir = dir;
+    rel->flags = flags;
 
     if(dir == DB_STORAGE) {
       storage_drop_relation(rel, 1);
@@ -360,6 +414,7 @@ relation_attribute_add(relation_t *rel, db_direction_t dir, char *name,
   attribute->aggregator = 0;
   attribute->index = NULL;
   attribute->flags = 0 /*ATTRIBUTE_FLAG_UNIQUE*/;
+  planner_init_stats(attribute);
 
   rel->row_length += element_size;
 
@@ -472,11 +527,10 @@ relation_remove(char *name, int remove_tuples)
   return result;
 }
 
-db_result_t
-relation_insert(relation_t *rel, attribute_value_t *values)
+static db_result_t
+encode_row(relation_t *rel, attribute_value_t *values, unsigned char *record)
 {
   attribute_t *attr;
-  unsigned char record[rel->row_length];
   unsigned char *ptr;
   attribute_value_t *value;
   db_result_t result;
@@ -533,20 +587,269 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 #endif /* DEBUG */
 
     ptr += attr->element_size;
-    if(attr->index != NULL) {
-      if(DB_ERROR(index_insert(attr->index, value, rel->next_row))) {
+  }
+
+  PRINTF(")\n");
+
+  return DB_OK;
+}
+
+db_result_t
+relation_insert(relation_t *rel, attribute_value_t *values)
+{
+  attribute_t *attr;
+  unsigned char record[rel->row_length];
+  attribute_value_t *value;
+  tuple_id_t tuple_id;
+  db_result_t result;
+
+  result = encode_row(rel, values, record);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  tuple_id = relation_cardinality(rel);
+  if(tuple_id == INVALID_TUPLE) {
+    return DB_STORAGE_ERROR;
+  }
+
+  for(attr = list_head(rel->attributes), value = values;
+      attr != NULL;
+      attr = attr->next, value++) {
+    if(attr->index != NULL && !(attr->flags & ATTRIBUTE_FLAG_INVALID)) {
+      if(DB_ERROR(index_insert(attr->index, value, tuple_id))) {
         return DB_INDEX_ERROR;
       }
     }
+    planner_update_stats(attr, value, tuple_id);
   }
 
-  PRINTF(")\n");
-
-  rel->cardinality++;
-  rel->next_row++;
+  rel->cardinality = tuple_id + 1;
+  rel->next_row = rel->cardinality;
   return storage_put_row(rel, record);
 }
 
+#if DB_FEATURE_BATCH
+static int
+index_has_tuple(index_t *index, attribute_value_t *value, tuple_id_t tuple_id)
+{
+  index_iterator_t iterator;
+  tuple_id_t found_id;
+
+  if(DB_ERROR(index_get_iterator(&iterator, index, value, value))) {
+    return 0;
+  }
+
+  while((found_id = index_get_next(&iterator)) != INVALID_TUPLE) {
+    if(found_id == tuple_id) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Apply a batch of rows, the first of which has the tuple ID base_row,
+ * to the tuple file and to the indexes of the relation. The rows that
+ * are already present in the tuple file are skipped, and their index
+ * entries are inserted only if they are missing. Hence, the operation
+ * can be repeated any number of times with the same outcome, which
+ * makes it usable both for normal commits and for crash recovery.
+ */
+static db_result_t
+apply_batch(relation_t *rel, tuple_id_t base_row,
+            unsigned char *rows, unsigned count)
+{
+  tuple_id_t stored_rows;
+  tuple_id_t tuple_id;
+  unsigned applied;
+  unsigned i;
+  attribute_t *attr;
+  attribute_value_t value;
+  int offset;
+
+  if(DB_ERROR(storage_get_row_amount(rel, &stored_rows))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(stored_rows < base_row) {
+    PRINTF("DB: The batch log of %s is inconsistent with the tuple file\n",
+           rel->name);
+    return DB_INCONSISTENCY_ERROR;
+  }
+
+  applied = stored_rows - base_row;
+  if(applied > count) {
+    applied = count;
+  }
+
+  if(applied < count &&
+     DB_ERROR(storage_put_rows(rel, rows + applied * rel->row_length,
+                               count - applied))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  /* Group the index updates per attribute, so that each index
+     processes all the keys of the batch in sequence. */
+  for(attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+    offset = get_attribute_value_offset(rel, attr);
+    if(offset < 0) {
+      return DB_IMPLEMENTATION_ERROR;
+    }
+
+    for(i = 0; i < count; i++) {
+      if(DB_ERROR(db_phy_to_value(&value, attr,
+                                  rows + i * rel->row_length + offset))) {
+        return DB_IMPLEMENTATION_ERROR;
+      }
+
+      tuple_id = base_row + i;
+      planner_update_stats(attr, &value, tuple_id);
+
+      if(attr->index == NULL || (attr->flags & ATTRIBUTE_FLAG_INVALID)) {
+        continue;
+      }
+
+      if(i < applied && index_has_tuple(attr->index, &value, tuple_id)) {
+        continue;
+      }
+
+      if(DB_ERROR(index_insert(attr->index, &value, tuple_id))) {
+        return DB_INDEX_ERROR;
+      }
+    }
+  }
+
+  rel->cardinality = base_row + count;
+  rel->next_row = rel->cardinality;
+
+  return DB_OK;
+}
+
+static void
+batch_timeout(void *ptr)
+{
+  if(batch_rel != NULL) {
+    PRINTF("DB: Committing the batch of %s after a timeout\n",
+           batch_rel->name);
+    relation_batch_commit(batch_rel);
+  }
+}
+
+static db_result_t
+batch_recover(relation_t *rel)
+{
+  tuple_id_t base_row;
+  unsigned count;
+  db_result_t result;
+
+  if(DB_ERROR(storage_log_get_rows(rel, &base_row, batch_rows,
+                                   DB_BATCH_SIZE, &count))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(count == 0) {
+    /* Nothing to recover, but an incomplete log may remain. */
+    return storage_log_drop(rel);
+  }
+
+  PRINTF("DB: Recovering %u rows from the batch log of %s\n",
+         count, rel->name);
+
+  result = apply_batch(rel, base_row, batch_rows, count);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  return storage_log_drop(rel);
+}
+
+db_result_t
+relation_batch_insert(relation_t *rel, attribute_value_t *values)
+{
+  unsigned char *record;
+  db_result_t result;
+  tuple_id_t cardinality;
+
+  if(rel->dir != DB_STORAGE) {
+    /* Memory-resident relations have nothing to gain from batching. */
+    return relation_insert(rel, values);
+  }
+
+  if(batch_rel != rel) {
+    if(batch_rel != NULL && DB_ERROR(relation_batch_commit(batch_rel))) {
+      return DB_STORAGE_ERROR;
+    }
+
+    /* A log that remains from a failed commit must be replayed before
+       a new log replaces it. */
+    result = batch_recover(rel);
+    if(DB_ERROR(result)) {
+      return result;
+    }
+
+    cardinality = relation_cardinality(rel);
+    if(cardinality == INVALID_TUPLE) {
+      return DB_STORAGE_ERROR;
+    }
+
+    batch_log = storage_log_open(rel, cardinality);
+    if(batch_log < 0) {
+      return DB_STORAGE_ERROR;
+    }
+
+    batch_rel = rel;
+    batch_base = cardinality;
+    batch_count = 0;
+    ctimer_set(&batch_timer, DB_BATCH_COMMIT_INTERVAL, batch_timeout, NULL);
+  }
+
+  record = batch_rows + batch_count * rel->row_length;
+  result = encode_row(rel, values, record);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  if(DB_ERROR(storage_log_put_row(batch_log, rel, record))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(++batch_count == DB_BATCH_SIZE) {
+    return relation_batch_commit(rel);
+  }
+
+  return DB_OK;
+}
+
+db_result_t
+relation_batch_commit(relation_t *rel)
+{
+  db_result_t result;
+
+  if(rel != batch_rel) {
+    return DB_OK;
+  }
+
+  PRINTF("DB: Committing %u rows to relation %s\n", batch_count, rel->name);
+
+  ctimer_stop(&batch_timer);
+  storage_close(batch_log);
+  batch_log = -1;
+  batch_rel = NULL;
+
+  result = apply_batch(rel, batch_base, batch_rows, batch_count);
+  if(DB_ERROR(result)) {
+    /* The log is kept, so that the commit will be retried before the
+       next batch of the relation is started, or when the relation is
+       loaded the next time. */
+    return result;
+  }
+
+  return storage_log_drop(rel);
+}
+#endif /* DB_FEATURE_BATCH */
+
 static void
 aggregate(attribute_t *attr, attribute_value_t *value)
 {
@@ -627,55 +930,12 @@ generate_attribute_map(struct source_dest_map *attr_map, unsigned attribute_coun
   return DB_OK;
 }
 
-static void
-select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
-{
-  index_t *index;
-  attribute_t *attr;
-  operand_value_t min;
-  operand_value_t max;
-  attribute_value_t av_min;
-  attribute_value_t av_max;
-  long range;
-  unsigned long min_range;
-
-  index = NULL;
-  min_range = ULONG_MAX;
-
-  /* Find all indexed and derived attributes, and select the index of 
-     the attribute with the smallest range. */
-  for(attr = list_head(handle->rel->attributes);
-      attr != NULL;
-      attr = attr->next) {
-    if(attr->index != NULL &&
-       !LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name, &min, &max))) {
-      range = (unsigned long)max.l - (unsigned long)min.l;
-      PRINTF("DB: The search range for attribute \"%s\" comprises %ld values\n",
-             attr->name, range + 1);
-
-      if(range <= min_range) {
-        index = attr->index;
-        av_min.domain = av_max.domain = DOMAIN_INT;
-        VALUE_LONG(&av_min) = min.l;
-        VALUE_LONG(&av_max) = max.l;
-      }
-    }
-  }
-
-  if(index != NULL) {
-    /* We found a suitable index; get an iterator for it. */
-    if(index_get_iterator(&handle->index_iterator, index, 
-                          &av_min, &av_max) == DB_OK) {
-      handle->flags |= DB_HANDLE_FLAG_SEARCH_INDEX;
-    }
-  }
-}
-
 static db_result_t
 generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
 {
   relation_t *result_rel;
   unsigned attribute_count;
+  unsigned i;
   attribute_t *attr;
 
   result_rel = handle->result_rel;
@@ -696,11 +956,18 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
     return DB_IMPLEMENTATION_ERROR;
   }
 
-  if(adt->lvm_instance != NULL) {
-    /* Try to establish acceptable ranges for the attribute values. */
-    if(!LVM_ERROR(lvm_derive(adt->lvm_instance))) {
-      select_index(handle, adt->lvm_instance);
-    }
+  /* The result relation includes the attributes used in the
+     condition, so the other attributes need not be read. */
+  for(source_mask = 0, i = 0; i < attribute_count; i++) {
+    source_mask |= storage_attribute_mask(rel, attr_map[i].from_attr);
+  }
+
+  /* Try to establish acceptable ranges for the attribute values, and
+     let the planner decide whether to use any of the indexes. */
+  if(adt->lvm_instance != NULL && !LVM_ERROR(lvm_derive(adt->lvm_instance))) {
+    planner_choose(handle, adt->lvm_instance);
+  } else {
+    planner_choose(handle, NULL);
   }
 
   handle->flags |= DB_HANDLE_FLAG_PROCESSING;
@@ -771,7 +1038,8 @@ relation_process_select(void *handle_ptr)
 
   /* Put the tuples fulfilling the given condition into a new relation.
      The tuples may be projected. */
-  result = storage_get_row(handle->rel, &handle->tuple_id, row);
+  result = storage_get_columns(handle->rel, &handle->tuple_id, row,
+                               source_mask);
   handle->tuple_id++;
   if(DB_ERROR(result)) {
     PRINTF("DB: Failed to get a row in relation %s!\n", handle->rel->name);
@@ -895,7 +1163,10 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
     dir = DB_MEMORY;
   }
   relation_remove(name, 1);
-  relation_create(name, dir);
+  /* A stored result, which replaces the source relation after a
+     REMOVE, keeps the storage layout of the source relation. */
+  relation_create(name, dir,
+                  dir == DB_STORAGE ? rel->flags & RELATION_FLAG_COLUMNAR : 0);
   handle->result_rel = relation_load(name);
 
   if(handle->result_rel == NULL) {
@@ -1137,7 +1408,7 @@ relation_join(void *query_result, void *adt_ptr)
     dir = DB_MEMORY;
   }
   relation_remove(name, 1);
-  relation_create(name, dir);
+  relation_create(name, dir, 0);
   join_rel = relation_load(name);
   handle->result_rel = join_rel;
 
@@ -56,6 +56,9 @@ typedef enum db_direction {
 
 #define RELATION_HAS_TUPLES(rel) ((rel)->tuple_storage >= 0)
 
+/* Store each attribute of the relation in a separate file. */
+#define RELATION_FLAG_COLUMNAR	0x01
+
 /*
  * A relation consists of a name, a set of domains, a set of indexes,
  * and a set of keys. Each relation must have a primary key.
@@ -70,6 +73,7 @@ struct relation {
   tuple_id_t next_row;
   db_storage_id_t tuple_storage;
   db_direction_t dir;
+  uint8_t flags;
   uint8_t references;
   char name[RELATION_NAME_LENGTH + 1];
   char tuple_filename[RELATION_NAME_LENGTH + 1];
@@ -84,7 +88,7 @@ db_result_t relation_process_select(void *);
 db_result_t relation_process_join(void *);
 relation_t *relation_load(char *);
 db_result_t relation_release(relation_t *);
-relation_t *relation_create(char *, db_direction_t);
+relation_t *relation_create(char *, db_direction_t, uint8_t);
 db_result_t relation_rename(char *, char *);
 attribute_t *relation_attribute_add(relation_t *, db_direction_t, char *,
 				    domain_t, size_t);
@@ -95,6 +99,8 @@ db_result_t relation_attribute_remove(relation_t *, char *);
 db_result_t relation_set_primary_key(relation_t *, char *);
 db_result_t relation_remove(char *, int);
 db_result_t relation_insert(relation_t *, attribute_value_t *);
+db_result_t relation_batch_insert(relation_t *, attribute_value_t *);
+db_result_t relation_batch_commit(relation_t *);
 db_result_t relation_select(void *, relation_t *, void *);
 db_result_t relation_join(void *, void *);
 tuple_id_t relation_cardinality(relation_t *);
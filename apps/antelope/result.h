@@ -49,9 +49,24 @@ typedef unsigned char *tuple_t;
 #define DB_HANDLE_FLAG_INDEX_STEP	0x01
 #define DB_HANDLE_FLAG_SEARCH_INDEX	0x02
 #define DB_HANDLE_FLAG_PROCESSING	0x04
+#define DB_HANDLE_FLAG_EXPLAIN		0x08
+
+/* The access plan chosen by the query planner for a selection. */
+struct db_plan {
+  /* The attribute whose index is used, or NULL for a full scan. */
+  attribute_t *attr;
+  long min;
+  long max;
+  tuple_id_t cardinality;
+  tuple_id_t estimated_rows;
+  unsigned long cost;
+  unsigned long scan_cost;
+};
+typedef struct db_plan db_plan_t;
 
 struct db_handle {
   index_iterator_t index_iterator;
+  db_plan_t plan;
   tuple_id_t tuple_id;
   tuple_id_t current_row;
   relation_t *rel;
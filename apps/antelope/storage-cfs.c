@@ -40,6 +40,8 @@
 
 #include "cfs/cfs.h"
 #include "cfs/cfs-coffee.h"
+#include "lib/list.h"
+#include "lib/memb.h"
 #include "lib/random.h"
 
 #define DEBUG DEBUG_NONE
@@ -68,6 +70,21 @@ struct index_record {
 
 #define ROW_XOR 0xf6U
 
+/* Encodes the last byte of the tuple file name in the catalog of a 
+   columnar relation. */
+#define COLUMNAR_XOR 0x9cU
+
+#if DB_FEATURE_COLUMNAR
+static void column_filename(char *, relation_t *, unsigned);
+static db_result_t column_load(relation_t *);
+static void column_unload(relation_t *);
+static db_result_t column_add_attribute(relation_t *);
+static db_result_t column_get_row(relation_t *, tuple_id_t, storage_row_t,
+                                  storage_mask_t);
+static db_result_t column_put_rows(relation_t *, storage_row_t, unsigned);
+static db_result_t column_get_row_amount(relation_t *, tuple_id_t *);
+#endif /* DB_FEATURE_COLUMNAR */
+
 static void
 merge_strings(char *dest, char *prefix, char *suffix)
 {
@@ -103,6 +120,11 @@ storage_generate_file(char *prefix, unsigned long size)
 db_result_t
 storage_load(relation_t *rel)
 {
+  if(RELATION_HAS_TUPLES(rel)) {
+    /* The relation is already in use. */
+    return DB_OK;
+  }
+
   PRINTF("DB: Opening the tuple file %s\n", rel->tuple_filename);
   rel->tuple_storage = cfs_open(rel->tuple_filename,
                                 CFS_READ | CFS_WRITE | CFS_APPEND);
@@ -111,12 +133,22 @@ storage_load(relation_t *rel)
     return DB_STORAGE_ERROR;
   }
 
+#if DB_FEATURE_COLUMNAR
+  if(rel->flags & RELATION_FLAG_COLUMNAR) {
+    return column_load(rel);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   return DB_OK;
 }
 
 void
 storage_unload(relation_t *rel)
 {
+#if DB_FEATURE_COLUMNAR
+  column_unload(rel);
+#endif /* DB_FEATURE_COLUMNAR */
+
   if(RELATION_HAS_TUPLES(rel)) {
     PRINTF("DB: Unload tuple file %s\n", rel->tuple_filename);
 
@@ -155,6 +187,17 @@ storage_get_relation(relation_t *rel, char *name)
   }
 
   rel->tuple_filename[sizeof(rel->tuple_filename) - 1] ^= ROW_XOR;
+  if(rel->tuple_filename[sizeof(rel->tuple_filename) - 1] ==
+     (char)COLUMNAR_XOR) {
+#if DB_FEATURE_COLUMNAR
+    rel->flags |= RELATION_FLAG_COLUMNAR;
+    rel->tuple_filename[sizeof(rel->tuple_filename) - 1] = '\0';
+#else
+    cfs_close(fd);
+    PRINTF("DB: Columnar relations are not supported\n");
+    return DB_STORAGE_ERROR;
+#endif /* DB_FEATURE_COLUMNAR */
+  }
 
   /* Read attribute records. */
   result = DB_OK;
@@ -190,6 +233,7 @@ storage_put_relation(relation_t *rel)
   int r;
   char *str;
   unsigned char *last_byte;
+  unsigned char xor;
 
   PRINTF("DB: put_relation(%s)\n", rel->name);
 
@@ -229,11 +273,15 @@ storage_put_relation(relation_t *rel)
    * the correct length when re-opening the file.
    */
   last_byte = (unsigned char *)&rel->tuple_filename[sizeof(rel->tuple_filename) - 1];
-  *last_byte ^= ROW_XOR;
+  xor = ROW_XOR;
+  if(rel->flags & RELATION_FLAG_COLUMNAR) {
+    xor ^= COLUMNAR_XOR;
+  }
+  *last_byte ^= xor;
 
   r = cfs_write(fd, rel->tuple_filename, sizeof(rel->tuple_filename));
 
-  *last_byte ^= ROW_XOR;
+  *last_byte ^= xor;
 
   if(r != sizeof(rel->tuple_filename)) {
     cfs_close(fd);
@@ -273,14 +321,39 @@ storage_put_attribute(relation_t *rel, attribute_t *attr)
   }
 
   cfs_close(fd);
+
+#if DB_FEATURE_COLUMNAR
+  if(rel->flags & RELATION_FLAG_COLUMNAR) {
+    return column_add_attribute(rel);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   return DB_OK;
 }
 
 db_result_t
 storage_drop_relation(relation_t *rel, int remove_tuples)
 {
-  if(remove_tuples && RELATION_HAS_TUPLES(rel)) {
+  int loaded;
+#if DB_FEATURE_COLUMNAR
+  unsigned i;
+  char filename[DB_MAX_FILENAME_LENGTH];
+#endif
+
+  /* Close the files before removing them. */
+  loaded = RELATION_HAS_TUPLES(rel);
+  storage_unload(rel);
+
+  if(remove_tuples && loaded) {
     cfs_remove(rel->tuple_filename);
+#if DB_FEATURE_COLUMNAR
+    if(rel->flags & RELATION_FLAG_COLUMNAR) {
+      for(i = 0; i < DB_MAX_ATTRIBUTES_PER_RELATION; i++) {
+        column_filename(filename, rel, i);
+        cfs_remove(filename);
+      }
+    }
+#endif /* DB_FEATURE_COLUMNAR */
   }
   return cfs_remove(rel->name) < 0 ? DB_STORAGE_ERROR : DB_OK;
 }
@@ -406,6 +479,12 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
   int r;
   tuple_id_t nrows;
 
+#if DB_FEATURE_COLUMNAR
+  if(rel->flags & RELATION_FLAG_COLUMNAR) {
+    return column_get_row(rel, *tuple_id, row, STORAGE_ALL_ATTRIBUTES);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
     return DB_STORAGE_ERROR;
   }
@@ -437,18 +516,766 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
   return DB_OK;
 }
 
+/* Read a row, of which only the specified attributes must be valid. */
+db_result_t
+storage_get_columns(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row,
+                    storage_mask_t mask)
+{
+#if DB_FEATURE_COLUMNAR
+  if(rel->flags & RELATION_FLAG_COLUMNAR) {
+    return column_get_row(rel, *tuple_id, row, mask);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
+  /* The attributes of a row are read at once. */
+  return storage_get_row(rel, tuple_id, row);
+}
+
+storage_mask_t
+storage_attribute_mask(relation_t *rel, attribute_t *attr)
+{
+  attribute_t *ptr;
+  unsigned position;
+
+  for(ptr = list_head(rel->attributes), position = 0;
+      ptr != NULL;
+      ptr = ptr->next, position++) {
+    if(ptr == attr && position < sizeof(storage_mask_t) * 8) {
+      return (storage_mask_t)1 << position;
+    }
+  }
+
+  return STORAGE_ALL_ATTRIBUTES;
+}
+
 db_result_t
 storage_put_row(relation_t *rel, storage_row_t row)
 {
-  cfs_offset_t end;
-  unsigned remaining;
-  int r;
+  return storage_put_rows(rel, row, 1);
+}
+
+static void
+encode_rows(relation_t *rel, storage_row_t rows, unsigned count)
+{
   unsigned char *last_byte;
+
+  /* Ensure that last written byte of each row is separated from 0, to
+     make file lengths correct in Coffee. The encoding is its own
+     inverse, so this function is used for decoding as well. */
+  for(last_byte = rows + rel->row_length - 1;
+      count > 0;
+      count--, last_byte += rel->row_length) {
+    *last_byte ^= ROW_XOR;
+  }
+}
+
+static db_result_t
+write_all(db_storage_id_t fd, unsigned char *ptr, unsigned remaining)
+{
+  int r;
+
+  do {
+    r = cfs_write(fd, ptr, remaining);
+    if(r < 0) {
+      PRINTF("DB: Failed to store %u bytes\n", remaining);
+      return DB_STORAGE_ERROR;
+    }
+    ptr += r;
+    remaining -= r;
+  } while(remaining > 0);
+
+  return DB_OK;
+}
+
+#if DB_FEATURE_COLUMNAR
+/*
+ * A columnar relation stores each attribute in a column file, which is
+ * named after the tuple file and the position of the attribute. The
+ * columns consist of blocks of DB_COLUMN_BLOCK_SIZE values. The values
+ * of an integer block are predicted from the first value of the block
+ * and the average stride between its values, and only the residuals 
+ * are stored, using as few bytes as possible. A block of equal values,
+ * or of values that increase regularly like timestamps, thereby takes
+ * up no more space than its header. Values that cannot be encoded more
+ * compactly are stored as they are.
+ *
+ * The tuples of the block that is being filled are kept in row format
+ * in the tuple file of the relation, which begins with a header that 
+ * specifies the tuple ID of its first row. When the block is full, it 
+ * is appended to each column before the tuple file is emptied. 
+ */
+struct column_block {
+  uint32_t base;
+  int32_t stride;
+  uint8_t count;
+  uint8_t width;
+  uint8_t unused[2];
+};
+
+/* The block width of values stored without encoding. */
+#define COLUMN_RAW	0xff
+
+struct column_tail {
+  tuple_id_t base_row;
+  uint16_t row_length;
+};
+
+struct column {
+  db_storage_id_t fd;
+  /* The most recently read block. A block without values is used as a
+     starting point before the first block. */
+  tuple_id_t block_row;
+  cfs_offset_t block_offset;
+  struct column_block block;
+};
+
+struct column_set {
+  struct column_set *next;
+  relation_t *rel;
+  tuple_id_t base_row;
+  tuple_id_t tail_rows;
+  struct column columns[DB_MAX_ATTRIBUTES_PER_RELATION];
+};
+
+MEMB(column_set_memb, struct column_set, DB_COLUMNAR_RELATION_LIMIT);
+LIST(column_sets);
+
+static uint32_t block_values[DB_COLUMN_BLOCK_SIZE];
+static unsigned char block_buffer[sizeof(struct column_block) +
+                                  DB_COLUMN_BLOCK_SIZE * sizeof(uint32_t)];
+
+static int
+is_integer(attribute_t *attr)
+{
+  return (attr->domain == DOMAIN_INT || attr->domain == DOMAIN_LONG) &&
+         attr->element_size <= sizeof(uint32_t);
+}
+
+static uint32_t
+get_value(unsigned char *ptr, unsigned size)
+{
+  uint32_t value;
+
+  for(value = 0; size > 0; size--) {
+    value = value << 8 | *ptr++;
+  }
+  return value;
+}
+
+static void
+put_value(unsigned char *ptr, unsigned size, uint32_t value)
+{
+  while(size > 0) {
+    ptr[--size] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+static struct column_set *
+column_set_find(relation_t *rel)
+{
+  struct column_set *set;
+
+  for(set = list_head(column_sets); set != NULL; set = set->next) {
+    if(set->rel == rel) {
+      return set;
+    }
+  }
+  return NULL;
+}
+
+static void
+column_filename(char *filename, relation_t *rel, unsigned position)
+{
+  snprintf(filename, DB_MAX_FILENAME_LENGTH, "%s.%u",
+           rel->tuple_filename, position);
+}
+
+static struct column *
+column_open(struct column_set *set, unsigned position)
+{
+  struct column *col;
+  char filename[DB_MAX_FILENAME_LENGTH];
+#if DB_FEATURE_COFFEE
+  int fd;
+#endif
+
+  col = &set->columns[position];
+  if(col->fd >= 0) {
+    return col;
+  }
+
+  column_filename(filename, set->rel, position);
+
+#if DB_FEATURE_COFFEE
+  fd = cfs_open(filename, CFS_READ);
+  if(fd < 0) {
+    cfs_coffee_reserve(filename, DB_COLUMN_RESERVE_SIZE);
+  } else {
+    cfs_close(fd);
+  }
+#endif /* DB_FEATURE_COFFEE */
+
+  col->fd = cfs_open(filename, CFS_READ | CFS_WRITE | CFS_APPEND);
+  if(col->fd < 0) {
+    PRINTF("DB: Failed to open the column file %s\n", filename);
+    return NULL;
+  }
+
+  col->block_row = INVALID_TUPLE;
+  return col;
+}
+
+static unsigned
+column_width(struct column_block *block, attribute_t *attr)
+{
+  return block->width == COLUMN_RAW ? attr->element_size : block->width;
+}
+
+static cfs_offset_t
+column_block_length(struct column_block *block, attribute_t *attr)
+{
+  if(block->count == 0) {
+    return 0;
+  }
+  return sizeof(*block) + block->count * column_width(block, attr);
+}
+
+/* Read data from the current block, decoding the last byte of the 
+   block in the same way as the last byte of a row. */
+static db_result_t
+column_read(struct column *col, attribute_t *attr, unsigned offset,
+            unsigned char *buf, unsigned length)
+{
+  if(length == 0) {
+    return DB_OK;
+  }
+
+  if(cfs_seek(col->fd, col->block_offset + offset, CFS_SEEK_SET) ==
+     (cfs_offset_t)-1 ||
+     cfs_read(col->fd, buf, length) != (int)length) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(offset + length == column_block_length(&col->block, attr)) {
+    buf[length - 1] ^= ROW_XOR;
+  }
+
+  return DB_OK;
+}
+
+/* Make the block holding the specified tuple the current block of
+   the column. If the column does not hold the tuple, the last block
+   becomes the current block, and DB_FINISHED is returned. */
+static db_result_t
+column_seek(struct column *col, attribute_t *attr, tuple_id_t tuple_id)
+{
+  struct column_block block;
+  cfs_offset_t offset;
+
+  if(col->block_row == INVALID_TUPLE || tuple_id < col->block_row) {
+    col->block_row = 0;
+    col->block_offset = 0;
+    col->block.count = 0;
+  }
+
+  while(tuple_id - col->block_row >= col->block.count) {
+    offset = col->block_offset + column_block_length(&col->block, attr);
+    if(cfs_seek(col->fd, offset, CFS_SEEK_SET) == (cfs_offset_t)-1 ||
+       cfs_read(col->fd, &block, sizeof(block)) != sizeof(block)) {
+      return DB_FINISHED;
+    }
+    if(block.count == 0) {
+      PRINTF("DB: Invalid block at offset %lu in a column of %s\n",
+             (unsigned long)offset, attr->name);
+      return DB_STORAGE_ERROR;
+    }
+
+    col->block_row += col->block.count;
+    col->block_offset = offset;
+    memcpy(&col->block, &block, sizeof(block));
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+column_get_rows(struct column *col, attribute_t *attr, tuple_id_t *rows)
+{
+  db_result_t result;
+
+  result = column_seek(col, attr, INVALID_TUPLE - 1);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  *rows = col->block_row + col->block.count;
+  return DB_OK;
+}
+
+static db_result_t
+column_get_value(struct column *col, attribute_t *attr, tuple_id_t tuple_id,
+                 unsigned char *value)
+{
+  db_result_t result;
+  unsigned index;
+  unsigned width;
+  unsigned char residual[sizeof(uint32_t)];
+  uint32_t decoded;
+
+  result = column_seek(col, attr, tuple_id);
+  if(result != DB_OK) {
+    return DB_ERROR(result) ? result : DB_STORAGE_ERROR;
+  }
+
+  index = tuple_id - col->block_row;
+  width = column_width(&col->block, attr);
+
+  if(col->block.width == COLUMN_RAW) {
+    return column_read(col, attr, sizeof(col->block) + index * width,
+                       value, width);
+  }
+
+  decoded = col->block.base + index * (uint32_t)col->block.stride;
+  if(width > 0) {
+    if(DB_ERROR(column_read(col, attr, sizeof(col->block) + index * width,
+                            residual, width))) {
+      return DB_STORAGE_ERROR;
+    }
+    /* Sign-extend the residual. */
+    decoded += (uint32_t)((int32_t)(get_value(residual, width) <<
+                          (32 - 8 * width)) >> (32 - 8 * width));
+  }
+
+  put_value(value, attr->element_size, decoded);
+  return DB_OK;
+}
+
+static db_result_t
+tail_read(struct column_set *set, tuple_id_t tail_row, unsigned offset,
+          unsigned char *buf, unsigned length)
+{
+  relation_t *rel;
+
+  rel = set->rel;
+  if(cfs_seek(rel->tuple_storage, sizeof(struct column_tail) +
+              (cfs_offset_t)tail_row * rel->row_length + offset,
+              CFS_SEEK_SET) == (cfs_offset_t)-1 ||
+     cfs_read(rel->tuple_storage, buf, length) != (int)length) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(offset + length == rel->row_length) {
+    buf[length - 1] ^= ROW_XOR;
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+tail_reset(struct column_set *set)
+{
+  relation_t *rel;
+  struct column_tail tail;
+
+  rel = set->rel;
+  if(RELATION_HAS_TUPLES(rel)) {
+    cfs_close(rel->tuple_storage);
+    rel->tuple_storage = -1;
+  }
+
+  cfs_remove(rel->tuple_filename);
+#if DB_FEATURE_COFFEE
+  cfs_coffee_reserve(rel->tuple_filename, sizeof(tail) +
+                     DB_COLUMN_BLOCK_SIZE * (unsigned long)rel->row_length);
+#endif
+
+  rel->tuple_storage = cfs_open(rel->tuple_filename,
+                                CFS_READ | CFS_WRITE | CFS_APPEND);
+  if(rel->tuple_storage < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  tail.base_row = set->base_row;
+  tail.row_length = rel->row_length;
+  set->tail_rows = 0;
+
+  return write_all(rel->tuple_storage, (unsigned char *)&tail, sizeof(tail));
+}
+
+/* Encode the tail rows of an attribute into a block. */
+static db_result_t
+column_append(struct column_set *set, struct column *col, attribute_t *attr,
+              unsigned offset)
+{
+  struct column_block *block;
+  unsigned count;
+  unsigned i;
+  unsigned length;
+  int32_t residual;
+  uint32_t magnitude;
+  uint32_t max_magnitude;
+  int exact;
+  unsigned char value[DB_MAX_ELEMENT_SIZE];
+  db_result_t result;
+
+  count = set->tail_rows;
+  block = (struct column_block *)block_buffer;
+  memset(block, 0, sizeof(*block));
+  block->count = count;
+  block->width = COLUMN_RAW;
+
+  if(cfs_seek(col->fd, 0, CFS_SEEK_END) == (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(!is_integer(attr)) {
+    /* Copy the values as they are. */
+    if(DB_ERROR(write_all(col->fd, block_buffer, sizeof(*block)))) {
+      return DB_STORAGE_ERROR;
+    }
+    for(i = 0; i < count; i++) {
+      if(DB_ERROR(tail_read(set, i, offset, value, attr->element_size))) {
+        return DB_STORAGE_ERROR;
+      }
+      if(i == count - 1) {
+        value[attr->element_size - 1] ^= ROW_XOR;
+      }
+      if(DB_ERROR(write_all(col->fd, value, attr->element_size))) {
+        return DB_STORAGE_ERROR;
+      }
+    }
+    return DB_OK;
+  }
+
+  for(i = 0; i < count; i++) {
+    if(DB_ERROR(tail_read(set, i, offset, value, attr->element_size))) {
+      return DB_STORAGE_ERROR;
+    }
+    block_values[i] = get_value(value, attr->element_size);
+  }
+
+  block->base = block_values[0];
+  if(count > 1) {
+    block->stride = (int32_t)(block_values[count - 1] - block_values[0]) /
+                    (int32_t)(count - 1);
+  }
+
+  /* Find the number of bytes needed for the largest residual. */
+  for(i = 0, max_magnitude = 0, exact = 1; i < count; i++) {
+    block_values[i] -= block->base + i * (uint32_t)block->stride;
+    residual = (int32_t)block_values[i];
+    magnitude = residual < 0 ? ~(uint32_t)residual : (uint32_t)residual;
+    if(magnitude > max_magnitude) {
+      max_magnitude = magnitude;
+    }
+    if(residual != 0) {
+      exact = 0;
+    }
+  }
+
+  if(exact) {
+    block->width = 0;
+  } else if(max_magnitude < 0x80) {
+    block->width = 1;
+  } else if(max_magnitude < 0x8000) {
+    block->width = 2;
+  } else {
+    block->width = 4;
+  }
+
+  if(block->width >= attr->element_size) {
+    /* The encoding would not save any space. */
+    for(i = 0; i < count; i++) {
+      block_values[i] += block->base + i * (uint32_t)block->stride;
+    }
+    block->base = 0;
+    block->stride = 0;
+    block->width = COLUMN_RAW;
+  }
+
+  for(i = 0; i < count; i++) {
+    put_value(block_buffer + sizeof(*block) + i * column_width(block, attr),
+              column_width(block, attr), block_values[i]);
+  }
+
+  length = column_block_length(block, attr);
+  block_buffer[length - 1] ^= ROW_XOR;
+  result = write_all(col->fd, block_buffer, length);
+
+  PRINTF("DB: Appended a block of %u bytes to the column %s\n",
+         length, attr->name);
+
+  return result;
+}
+
+/* Move the rows in the tail of a relation into its columns. The 
+   operation is repeatable, so it can be used for completing an 
+   operation that was interrupted by a crash. */
+static db_result_t
+column_flush(struct column_set *set)
+{
+  attribute_t *attr;
+  struct column *col;
+  unsigned position;
+  unsigned offset;
+  db_result_t result;
+
+  for(attr = list_head(set->rel->attributes), position = offset = 0;
+      attr != NULL;
+      offset += attr->element_size, attr = attr->next, position++) {
+    col = column_open(set, position);
+    if(col == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+
+    result = column_seek(col, attr, set->base_row);
+    if(result == DB_OK) {
+      /* The block was appended before the tail could be emptied. */
+      continue;
+    } else if(DB_ERROR(result)) {
+      return result;
+    }
+
+    if(col->block_row + col->block.count != set->base_row) {
+      PRINTF("DB: The column %s of %s is inconsistent\n",
+             attr->name, set->rel->name);
+      return DB_INCONSISTENCY_ERROR;
+    }
+
+    if(DB_ERROR(column_append(set, col, attr, offset))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  set->base_row += set->tail_rows;
+  return tail_reset(set);
+}
+
+static db_result_t
+column_load(relation_t *rel)
+{
+  struct column_set *set;
+  struct column_tail tail;
+  attribute_t *attr;
+  struct column *col;
+  cfs_offset_t end;
+  tuple_id_t rows;
+  unsigned i;
+  db_result_t result;
+
+  set = memb_alloc(&column_set_memb);
+  if(set == NULL) {
+    PRINTF("DB: Too many columnar relations are loaded\n");
+    cfs_close(rel->tuple_storage);
+    rel->tuple_storage = -1;
+    return DB_ALLOCATION_ERROR;
+  }
+
+  set->rel = rel;
+  set->base_row = 0;
+  set->tail_rows = 0;
+  for(i = 0; i < DB_MAX_ATTRIBUTES_PER_RELATION; i++) {
+    set->columns[i].fd = -1;
+  }
+  list_add(column_sets, set);
+
+  end = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
+  if(end >= (cfs_offset_t)sizeof(tail) &&
+     cfs_seek(rel->tuple_storage, 0, CFS_SEEK_SET) == 0 &&
+     cfs_read(rel->tuple_storage, &tail, sizeof(tail)) == sizeof(tail)) {
+    set->base_row = tail.base_row;
+    if(tail.row_length == rel->row_length) {
+      set->tail_rows = (end - sizeof(tail)) / rel->row_length;
+      if(set->tail_rows < DB_COLUMN_BLOCK_SIZE) {
+        return DB_OK;
+      }
+      /* The tail was not emptied after it had become full. */
+      result = column_flush(set);
+    } else if(end == sizeof(tail)) {
+      /* Attributes have been added to the relation. */
+      result = tail_reset(set);
+    } else {
+      result = DB_INCONSISTENCY_ERROR;
+    }
+  } else {
+    /* The tail is new, or it was lost while it was being emptied. In 
+       both cases, all the columns must have the same length. */
+    for(attr = list_head(rel->attributes), i = 0;
+        attr != NULL;
+        attr = attr->next, i++) {
+      col = column_open(set, i);
+      if(col == NULL || DB_ERROR(column_get_rows(col, attr, &rows)) ||
+         (i > 0 && rows != set->base_row)) {
+        break;
+      }
+      set->base_row = rows;
+    }
+    result = attr == NULL ? tail_reset(set) : DB_INCONSISTENCY_ERROR;
+  }
+
+  if(DB_ERROR(result)) {
+    PRINTF("DB: Failed to load the columns of %s\n", rel->name);
+    storage_unload(rel);
+  }
+
+  return result;
+}
+
+/*
+ * Attributes are only added to empty relations, but a relation may
+ * already be loaded, e.g., when it holds the result of a query. The
+ * tail must then be reset for the new row length before rows are
+ * stored in it.
+ */
+static db_result_t
+column_add_attribute(relation_t *rel)
+{
+  struct column_set *set;
+
+  set = column_set_find(rel);
+  if(set == NULL) {
+    return DB_OK;
+  }
+  return tail_reset(set);
+}
+
+static void
+column_unload(relation_t *rel)
+{
+  struct column_set *set;
+  unsigned i;
+
+  set = column_set_find(rel);
+  if(set == NULL) {
+    return;
+  }
+
+  for(i = 0; i < DB_MAX_ATTRIBUTES_PER_RELATION; i++) {
+    if(set->columns[i].fd >= 0) {
+      cfs_close(set->columns[i].fd);
+    }
+  }
+
+  list_remove(column_sets, set);
+  memb_free(&column_set_memb, set);
+}
+
+static db_result_t
+column_put_rows(relation_t *rel, storage_row_t rows, unsigned count)
+{
+  struct column_set *set;
+  unsigned n;
+  db_result_t result;
+
+  set = column_set_find(rel);
+  if(set == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+
+  while(count > 0) {
+    n = DB_COLUMN_BLOCK_SIZE - set->tail_rows;
+    if(n > count) {
+      n = count;
+    }
+
+    if(cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END) == (cfs_offset_t)-1) {
+      return DB_STORAGE_ERROR;
+    }
+
+    encode_rows(rel, rows, n);
+    result = write_all(rel->tuple_storage, rows, n * rel->row_length);
+    encode_rows(rel, rows, n);
+    if(DB_ERROR(result)) {
+      return result;
+    }
+
+    set->tail_rows += n;
+    rows += n * rel->row_length;
+    count -= n;
+
+    if(set->tail_rows == DB_COLUMN_BLOCK_SIZE &&
+       DB_ERROR(column_flush(set))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+column_get_row_amount(relation_t *rel, tuple_id_t *amount)
+{
+  struct column_set *set;
+
+  set = column_set_find(rel);
+  if(set == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+
+  *amount = set->base_row + set->tail_rows;
+  return DB_OK;
+}
+
+static db_result_t
+column_get_row(relation_t *rel, tuple_id_t tuple_id, storage_row_t row,
+               storage_mask_t mask)
+{
+  struct column_set *set;
+  attribute_t *attr;
+  struct column *col;
+  unsigned position;
+  unsigned offset;
+
+  set = column_set_find(rel);
+  if(set == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(tuple_id >= set->base_row + set->tail_rows) {
+    return DB_FINISHED;
+  }
+
+  if(tuple_id >= set->base_row) {
+    return tail_read(set, tuple_id - set->base_row, 0, row, rel->row_length);
+  }
+
+  /* Read only the requested attributes. */
+  for(attr = list_head(rel->attributes), position = offset = 0;
+      attr != NULL;
+      offset += attr->element_size, attr = attr->next, position++) {
+    if(!(mask & ((storage_mask_t)1 << position))) {
+      continue;
+    }
+
+    col = column_open(set, position);
+    if(col == NULL ||
+       DB_ERROR(column_get_value(col, attr, tuple_id, row + offset))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  return DB_OK;
+}
+#endif /* DB_FEATURE_COLUMNAR */
+
+db_result_t
+storage_put_rows(relation_t *rel, storage_row_t rows, unsigned count)
+{
+  cfs_offset_t end;
+  db_result_t result;
 #if DB_FEATURE_INTEGRITY
+  int r;
   int missing_bytes;
   char buf[rel->row_length];
 #endif
 
+#if DB_FEATURE_COLUMNAR
+  if(rel->flags & RELATION_FLAG_COLUMNAR) {
+    return column_put_rows(rel, rows, count);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   end = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
   if(end == (cfs_offset_t)-1) {
     return DB_STORAGE_ERROR;
@@ -465,28 +1292,17 @@ storage_put_row(relation_t *rel, storage_row_t row)
   }
 #endif
 
-  /* Ensure that last written byte is separated from 0, to make file
-     lengths correct in Coffee. */
-  last_byte = row + rel->row_length - 1;
-  *last_byte ^= ROW_XOR;
-
-  remaining = rel->row_length;
-  do {
-    r = cfs_write(rel->tuple_storage, row, remaining);
-    if(r < 0) {
-      PRINTF("DB: Failed to store %u bytes\n", remaining);
-      *last_byte ^= ROW_XOR;
-      return DB_STORAGE_ERROR;
-    }
-    row += r;
-    remaining -= r;
-  } while(remaining > 0);
-
-  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+  /* All rows are written in a single operation, so that a batch of
+     rows costs only one append in the file system. */
+  encode_rows(rel, rows, count);
+  result = write_all(rel->tuple_storage, rows, count * rel->row_length);
+  encode_rows(rel, rows, count);
 
-  *last_byte ^= ROW_XOR;
+  if(result == DB_OK) {
+    PRINTF("DB: Stored %u rows of %d bytes\n", count, rel->row_length);
+  }
 
-  return DB_OK;
+  return result;
 }
 
 db_result_t
@@ -494,6 +1310,12 @@ storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
 {
   cfs_offset_t offset;
 
+#if DB_FEATURE_COLUMNAR
+  if(rel->flags & RELATION_FLAG_COLUMNAR) {
+    return column_get_row_amount(rel, amount);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   if(rel->row_length == 0) {
     *amount = 0;
   } else {
@@ -508,6 +1330,137 @@ storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
   return DB_OK;
 }
 
+/*
+ * The batch log of a relation holds tuples that have been inserted,
+ * but not yet committed to the tuple file and the indexes. The log
+ * begins with a header that specifies the tuple ID of the first
+ * logged row, which allows a recovery procedure to determine how
+ * many of the logged rows that reached the tuple file before a crash.
+ */
+struct log_header {
+  tuple_id_t base_row;
+  uint16_t row_length;
+};
+
+db_storage_id_t
+storage_log_open(relation_t *rel, tuple_id_t base_row)
+{
+  char filename[LOG_NAME_LENGTH];
+  int fd;
+  struct log_header header;
+  cfs_offset_t size;
+
+  merge_strings(filename, rel->name, LOG_NAME_SUFFIX);
+
+  /* A log that holds rows must be recovered with storage_log_get_rows()
+     and removed with storage_log_drop() before a new log is opened. */
+  fd = cfs_open(filename, CFS_READ);
+  if(fd >= 0) {
+    size = cfs_seek(fd, 0, CFS_SEEK_END);
+    cfs_close(fd);
+    if(size != 0) {
+      PRINTF("DB: Refusing to overwrite the batch log %s\n", filename);
+      return -1;
+    }
+  }
+
+  cfs_remove(filename);
+
+#if DB_FEATURE_COFFEE
+  cfs_coffee_reserve(filename, sizeof(header) +
+                     DB_BATCH_SIZE * (unsigned long)rel->row_length);
+#endif
+
+  fd = cfs_open(filename, CFS_WRITE | CFS_APPEND);
+  if(fd < 0) {
+    PRINTF("DB: Failed to open the batch log %s\n", filename);
+    return -1;
+  }
+
+  header.base_row = base_row;
+  header.row_length = rel->row_length;
+  if(cfs_write(fd, &header, sizeof(header)) != sizeof(header)) {
+    cfs_close(fd);
+    cfs_remove(filename);
+    return -1;
+  }
+
+  PRINTF("DB: Opened the batch log %s at row %lu\n",
+         filename, (unsigned long)base_row);
+
+  return fd;
+}
+
+db_result_t
+storage_log_put_row(db_storage_id_t fd, relation_t *rel, storage_row_t row)
+{
+  db_result_t result;
+
+  encode_rows(rel, row, 1);
+  result = write_all(fd, row, rel->row_length);
+  encode_rows(rel, row, 1);
+
+  return result;
+}
+
+db_result_t
+storage_log_get_rows(relation_t *rel, tuple_id_t *base_row,
+                     storage_row_t rows, unsigned max_count, unsigned *count)
+{
+  char filename[LOG_NAME_LENGTH];
+  int fd;
+  int r;
+  struct log_header header;
+
+  *count = 0;
+
+  merge_strings(filename, rel->name, LOG_NAME_SUFFIX);
+
+  fd = cfs_open(filename, CFS_READ);
+  if(fd < 0) {
+    return DB_OK;
+  }
+
+  r = cfs_read(fd, &header, sizeof(header));
+  if(r != sizeof(header) || header.row_length != rel->row_length) {
+    /* The log was not completely created, so no rows can have been
+       logged in it. */
+    cfs_close(fd);
+    return DB_OK;
+  }
+
+  *base_row = header.base_row;
+
+  while(*count < max_count) {
+    r = cfs_read(fd, rows, rel->row_length);
+    if(r < rel->row_length) {
+      /* A partially written row is ignored, because its insertion
+         was never acknowledged to the caller. */
+      break;
+    }
+    encode_rows(rel, rows, 1);
+    rows += rel->row_length;
+    (*count)++;
+  }
+
+  cfs_close(fd);
+
+  PRINTF("DB: Found %u logged rows for relation %s\n", *count, rel->name);
+
+  return DB_OK;
+}
+
+db_result_t
+storage_log_drop(relation_t *rel)
+{
+  char filename[LOG_NAME_LENGTH];
+
+  merge_strings(filename, rel->name, LOG_NAME_SUFFIX);
+  cfs_remove(filename);
+
+  return DB_OK;
+}
+
 db_storage_id_t
 storage_open(const char *filename)
 {
@@ -548,6 +1501,14 @@ storage_read(db_storage_id_t fd,
   ptr = buffer;
   while(length > 0) {
     r = cfs_read(fd, ptr, length);
+#if !DB_FEATURE_COFFEE
+    if(r == 0) {
+      /* Other file systems than Coffee do not necessarily extend the
+         file when seeking past its end. */
+      memset(ptr, 0, length);
+      break;
+    }
+#endif /* !DB_FEATURE_COFFEE */
     if(r <= 0) {
       return DB_STORAGE_ERROR;
     }
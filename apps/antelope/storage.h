@@ -48,8 +48,17 @@
 #define INDEX_NAME_LENGTH       (RELATION_NAME_LENGTH + \
                                  sizeof(INDEX_NAME_SUFFIX) - 1)
 
+#define LOG_NAME_SUFFIX         ".log"
+#define LOG_NAME_LENGTH         (RELATION_NAME_LENGTH + \
+                                 sizeof(LOG_NAME_SUFFIX))
+
 typedef unsigned char * storage_row_t;
 
+/* A set of attributes to read from a relation, in which each bit 
+   corresponds to the position of an attribute in the relation. */
+typedef uint32_t storage_mask_t;
+#define STORAGE_ALL_ATTRIBUTES	((storage_mask_t)-1)
+
 char *storage_generate_file(char *, unsigned long);
 
 db_result_t storage_load(relation_t *);
@@ -65,9 +74,19 @@ db_result_t storage_get_index(index_t *, relation_t *, attribute_t *);
 db_result_t storage_put_index(index_t *);
 
 db_result_t storage_get_row(relation_t *, tuple_id_t *, storage_row_t);
+db_result_t storage_get_columns(relation_t *, tuple_id_t *, storage_row_t,
+                                storage_mask_t);
+storage_mask_t storage_attribute_mask(relation_t *, attribute_t *);
 db_result_t storage_put_row(relation_t *, storage_row_t);
+db_result_t storage_put_rows(relation_t *, storage_row_t, unsigned);
 db_result_t storage_get_row_amount(relation_t *, tuple_id_t *);
 
+db_storage_id_t storage_log_open(relation_t *, tuple_id_t);
+db_result_t storage_log_put_row(db_storage_id_t, relation_t *, storage_row_t);
+db_result_t storage_log_get_rows(relation_t *, tuple_id_t *, storage_row_t,
+                                 unsigned, unsigned *);
+db_result_t storage_log_drop(relation_t *);
+
 db_storage_id_t storage_open(const char *);
 void storage_close(db_storage_id_t);
 db_result_t storage_read(db_storage_id_t, void *, unsigned long, unsigned);
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for streaming blockwise transfers
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "cfs/cfs.h"
+
+#include "er-coap-13-block.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+MEMB(transfers_memb, coap_block_transfer_t, COAP_MAX_BLOCK_TRANSFERS);
+LIST(transfers_list); /* ordered from least to most recently used */
+
+/* The Block2 transfer of the request that is being handled. */
+static coap_block_transfer_t *current = NULL;
+
+/*----------------------------------------------------------------------------*/
+static void
+remove_transfer(coap_block_transfer_t *t)
+{
+  PRINTF("Block: removing transfer for /%.*s at %lu\n", t->url_len, t->url, (unsigned long)t->offset);
+
+  if (t->fd >= 0)
+  {
+    cfs_close(t->fd);
+  }
+  if (t==current)
+  {
+    current = NULL;
+  }
+  list_remove(transfers_list, t);
+  memb_free(&transfers_memb, t);
+}
+/*----------------------------------------------------------------------------*/
+/* Finds the transfer of the requesting endpoint for the URI path, or starts a new one. */
+static coap_block_transfer_t *
+get_transfer(coap_packet_t *request, int upload)
+{
+  coap_block_transfer_t *t = NULL;
+  coap_block_transfer_t *next = NULL;
+
+  if (request->uri_path_len > COAP_BLOCK_URL_LEN)
+  {
+    return NULL;
+  }
+
+  for (t = (coap_block_transfer_t *)list_head(transfers_list); t; t = next)
+  {
+    next = t->next;
+
+    if (stimer_expired(&t->lifetime))
+    {
+      remove_transfer(t);
+    }
+    else if (t->port==UIP_UDP_BUF->srcport && (t->fd >= 0)==upload && t->url_len==request->uri_path_len
+             && memcmp(t->url, request->uri_path, t->url_len)==0 && uip_ipaddr_cmp(&t->addr, &UIP_IP_BUF->srcipaddr))
+    {
+      list_remove(transfers_list, t);
+      list_add(transfers_list, t);
+      stimer_set(&t->lifetime, COAP_BLOCK_TRANSFER_LIFETIME);
+      return t;
+    }
+  }
+
+  if ((t = memb_alloc(&transfers_memb))==NULL)
+  {
+    /* Replace the least recently used transfer. */
+    remove_transfer((coap_block_transfer_t *)list_head(transfers_list));
+    t = memb_alloc(&transfers_memb);
+  }
+
+  uip_ipaddr_copy(&t->addr, &UIP_IP_BUF->srcipaddr);
+  t->port = UIP_UDP_BUF->srcport;
+  t->url_len = request->uri_path_len;
+  memcpy(t->url, request->uri_path, t->url_len);
+  t->offset = 0;
+  t->fd = -1;
+  t->cursor.resumed = 0;
+  memset(t->cursor.state, 0, sizeof(t->cursor.state));
+  stimer_set(&t->lifetime, COAP_BLOCK_TRANSFER_LIFETIME);
+
+  PRINTF("Block: new transfer for /%.*s\n", t->url_len, t->url);
+  list_add(transfers_list, t);
+
+  return t;
+}
+/*----------------------------------------------------------------------------*/
+coap_block_cursor_t *
+coap_block2_get_cursor(void *request, int32_t offset)
+{
+  coap_block_transfer_t *t = get_transfer((coap_packet_t *) request, 0);
+
+  current = t;
+  if (t==NULL)
+  {
+    return NULL;
+  }
+
+  if (offset==0 || offset!=t->offset)
+  {
+    PRINTF("Block: cursor for /%.*s restarts at %ld\n", t->url_len, t->url, (long)offset);
+    t->cursor.resumed = 0;
+    memset(t->cursor.state, 0, sizeof(t->cursor.state));
+  }
+  else
+  {
+    t->cursor.resumed = 1;
+  }
+  t->offset = offset;
+
+  return &t->cursor;
+}
+/*----------------------------------------------------------------------------*/
+void
+coap_block2_update(int32_t new_offset)
+{
+  if (current)
+  {
+    if (new_offset < 0 || (uint32_t)new_offset==current->offset)
+    {
+      /* Completed, or the handler did not produce more data. */
+      remove_transfer(current);
+    }
+    else
+    {
+      current->offset = new_offset;
+    }
+    current = NULL;
+  }
+}
+/*----------------------------------------------------------------------------*/
+int
+coap_block1_to_file(void *request, void *response, const char *filename)
+{
+  coap_packet_t *const coap_req = (coap_packet_t *) request;
+  coap_block_transfer_t *t = NULL;
+  const uint8_t *payload = NULL;
+  int len = coap_get_payload(request, &payload);
+  uint32_t num = 0;
+  uint8_t more = 0;
+  uint16_t size = 0;
+  int blockwise = coap_get_header_block1(request, &num, &more, &size, NULL);
+  uint32_t offset = num * size;
+
+  if ((t = get_transfer(coap_req, 1))==NULL)
+  {
+    /* Draft 13 has no 4.14 Request-URI Too Long, so the URI counts
+       towards the request entity. */
+    coap_set_status_code(response, REQUEST_ENTITY_TOO_LARGE_4_13);
+    coap_set_payload(response, "UriTooLong", 10);
+    return -1;
+  }
+
+  if (offset==0)
+  {
+    /* (Re)start the upload. */
+    if (t->fd >= 0)
+    {
+      cfs_close(t->fd);
+    }
+    cfs_remove(filename);
+    t->fd = cfs_open(filename, CFS_WRITE);
+    t->offset = 0;
+
+    if (t->fd < 0)
+    {
+      remove_transfer(t);
+      coap_set_status_code(response, INTERNAL_SERVER_ERROR_5_00);
+      coap_set_payload(response, "CannotOpenFile", 14);
+      return -1;
+    }
+  }
+  else if (t->fd < 0 || offset > t->offset)
+  {
+    PRINTF("Block1: missing data before %lu for /%.*s\n", (unsigned long)offset, t->url_len, t->url);
+    remove_transfer(t);
+    coap_set_status_code(response, REQUEST_ENTITY_INCOMPLETE_4_08);
+    coap_set_payload(response, "MissingBlocks", 13);
+    return -1;
+  }
+
+  /* Retransmitted blocks overwrite the same data again. */
+  if (cfs_seek(t->fd, offset, CFS_SEEK_SET)!=offset || cfs_write(t->fd, payload, len)!=len)
+  {
+    remove_transfer(t);
+    cfs_remove(filename);
+    coap_set_status_code(response, REQUEST_ENTITY_TOO_LARGE_4_13);
+    coap_set_payload(response, "CannotWriteFile", 15);
+    return -1;
+  }
+  if (offset+len > t->offset)
+  {
+    t->offset = offset+len;
+  }
+
+  PRINTF("Block1: stored #%lu%s (%u bytes) for /%.*s\n", (unsigned long)num, more ? "+" : "", len, t->url_len, t->url);
+
+  if (blockwise && more)
+  {
+    coap_set_status_code(response, CONTINUE_2_31);
+    coap_set_header_block1(response, num, 1, size);
+    return 0;
+  }
+
+  remove_transfer(t);
+  coap_set_status_code(response, CHANGED_2_04);
+  if (blockwise)
+  {
+    coap_set_header_block1(response, num, 0, size);
+  }
+  return 1;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for streaming blockwise transfers
+ */
+
+#ifndef COAP_BLOCK_H_
+#define COAP_BLOCK_H_
+
+#include "er-coap-13.h"
+
+/*
+ * The number of concurrent blockwise transfers that keep state between blocks. The least recently used transfer is
+ * replaced when all are in use.
+ */
+#ifndef COAP_MAX_BLOCK_TRANSFERS
+#define COAP_MAX_BLOCK_TRANSFERS 2
+#endif /* COAP_MAX_BLOCK_TRANSFERS */
+
+/* The size of the handler state that is kept between the blocks of a Block2 transfer. */
+#ifndef COAP_BLOCK_CURSOR_SIZE
+#define COAP_BLOCK_CURSOR_SIZE 16
+#endif /* COAP_BLOCK_CURSOR_SIZE */
+
+/* The longest URI path of a transfer with state. */
+#ifndef COAP_BLOCK_URL_LEN
+#define COAP_BLOCK_URL_LEN 24
+#endif /* COAP_BLOCK_URL_LEN */
+
+/* Seconds after the last block until the state of an unfinished transfer is dropped. */
+#ifndef COAP_BLOCK_TRANSFER_LIFETIME
+#define COAP_BLOCK_TRANSFER_LIFETIME 60
+#endif /* COAP_BLOCK_TRANSFER_LIFETIME */
+
+typedef struct coap_block_cursor {
+  uint8_t resumed; /* 1 if the state continues the previous block, 0 if it was cleared for this offset */
+  uint8_t state[COAP_BLOCK_CURSOR_SIZE];
+} coap_block_cursor_t;
+
+typedef struct coap_block_transfer {
+  struct coap_block_transfer *next; /* for LIST */
+
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint8_t url_len;
+  char url[COAP_BLOCK_URL_LEN];
+  uint32_t offset; /* where the next block starts */
+  int fd; /* CFS file of Block1 uploads, -1 for Block2 */
+  struct stimer lifetime;
+  coap_block_cursor_t cursor;
+} coap_block_transfer_t;
+
+/*
+ * Returns the state a resource handler uses to continue a Block2 transfer where its previous block ended. The state
+ * is cleared (resumed==0) for new transfers and for blocks that do not start where the previous one ended.
+ * Returns NULL if the transfer cannot keep state; the handler must then generate the block from scratch.
+ */
+coap_block_cursor_t *coap_block2_get_cursor(void *request, int32_t offset);
+
+/* Called by the engine with the offset returned by the handler to advance or finish the current Block2 transfer. */
+void coap_block2_update(int32_t new_offset);
+
+/*
+ * Reassembles a Block1 upload into a CFS file and sets the status and Block1 option of the response.
+ * Returns 1 when the upload is complete, 0 if more blocks are expected, and -1 on errors.
+ */
+int coap_block1_to_file(void *request, void *response, const char *filename);
+
+#endif /* COAP_BLOCK_H_ */
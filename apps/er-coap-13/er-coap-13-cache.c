@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for duplicate detection and response caching
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include "er-coap-13-cache.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+static coap_cache_stats_t stats;
+
+/*----------------------------------------------------------------------------*/
+/*- Duplicate detection ------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+#if COAP_DEDUP_ENTRIES
+typedef struct coap_dedup_entry {
+  struct timer lifetime;
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint16_t mid;
+  uint8_t used;
+  uint16_t length; /* 0 to drop duplicates silently, or COAP_DEDUP_NO_RESPONSE to process them */
+  uint8_t data[COAP_DEDUP_RESPONSE_SIZE];
+} coap_dedup_entry_t;
+
+#define COAP_DEDUP_NO_RESPONSE 0xFFFF
+
+static coap_dedup_entry_t dedup_entries[COAP_DEDUP_ENTRIES];
+
+/*----------------------------------------------------------------------------*/
+static coap_dedup_entry_t *
+dedup_find(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
+{
+  coap_dedup_entry_t *e;
+
+  for (e = dedup_entries; e < dedup_entries + COAP_DEDUP_ENTRIES; ++e)
+  {
+    if (e->used && e->mid==mid && e->port==port && uip_ipaddr_cmp(&e->addr, addr))
+    {
+      if (timer_expired(&e->lifetime))
+      {
+        e->used = 0;
+        return NULL;
+      }
+      return e;
+    }
+  }
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+int
+coap_dedup_replay(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
+{
+  coap_dedup_entry_t *e = dedup_find(addr, port, mid);
+
+  if (e==NULL || e->length==COAP_DEDUP_NO_RESPONSE)
+  {
+    ++stats.dedup_misses;
+    return 0;
+  }
+
+  PRINTF("Dedup: duplicate MID %u, replaying %u bytes\n", mid, e->length);
+  ++stats.dedup_hits;
+
+  if (e->length)
+  {
+    coap_send_message(addr, port, e->data, e->length);
+  }
+  return 1;
+}
+/*----------------------------------------------------------------------------*/
+void
+coap_dedup_store(uip_ipaddr_t *addr, uint16_t port, uint16_t mid, const uint8_t *data, uint16_t length)
+{
+  coap_dedup_entry_t *e = dedup_find(addr, port, mid);
+  coap_dedup_entry_t *oldest = NULL;
+
+  if (e==NULL)
+  {
+    /* Use a free or expired entry, or replace the one that expires first. */
+    for (e = dedup_entries; e < dedup_entries + COAP_DEDUP_ENTRIES; ++e)
+    {
+      if (!e->used || timer_expired(&e->lifetime))
+      {
+        break;
+      }
+      if (oldest==NULL || timer_remaining(&e->lifetime) < timer_remaining(&oldest->lifetime))
+      {
+        oldest = e;
+      }
+    }
+    if (e==dedup_entries + COAP_DEDUP_ENTRIES)
+    {
+      e = oldest;
+    }
+  }
+
+  e->used = 1;
+  uip_ipaddr_copy(&e->addr, addr);
+  e->port = port;
+  e->mid = mid;
+  timer_set(&e->lifetime, COAP_EXCHANGE_LIFETIME * CLOCK_SECOND);
+
+  if (length > sizeof(e->data))
+  {
+    e->length = COAP_DEDUP_NO_RESPONSE;
+  }
+  else
+  {
+    memcpy(e->data, data, length);
+    e->length = length;
+  }
+}
+#endif /* COAP_DEDUP_ENTRIES */
+/*----------------------------------------------------------------------------*/
+/*- Response cache -----------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+#if COAP_RESPONSE_CACHE_ENTRIES
+typedef struct coap_cache_entry {
+  struct timer max_age;
+  uint8_t used;
+  uint8_t path_len;
+  uint8_t key_len;
+  char key[COAP_RESPONSE_CACHE_KEY_LEN]; /* path, '?', and query */
+  uint16_t accept;
+  uint32_t block2_num;
+  uint16_t block2_size;
+  uint16_t length;
+  uint8_t data[COAP_MAX_PACKET_SIZE+1]; /* +1 for the '\0' that coap_parse_message() appends to the payload */
+} coap_cache_entry_t;
+
+static coap_cache_entry_t cache_entries[COAP_RESPONSE_CACHE_ENTRIES];
+
+/*----------------------------------------------------------------------------*/
+/* Builds the cache key of a request. Returns 0 if the request is not cacheable. */
+static int
+cache_key(coap_packet_t *request, coap_cache_entry_t *key)
+{
+  if (IS_OPTION(request, COAP_OPTION_OBSERVE) || request->uri_path_len >= COAP_RESPONSE_CACHE_KEY_LEN
+      || request->uri_path_len + 1 + request->uri_query_len > COAP_RESPONSE_CACHE_KEY_LEN)
+  {
+    return 0;
+  }
+
+  memcpy(key->key, request->uri_path, request->uri_path_len);
+  key->path_len = key->key_len = request->uri_path_len;
+  if (request->uri_query_len)
+  {
+    key->key[key->key_len++] = '?';
+    memcpy(key->key + key->key_len, request->uri_query, request->uri_query_len);
+    key->key_len += request->uri_query_len;
+  }
+  key->accept = request->accept_num ? request->accept[0] : 0xFFFF;
+  key->block2_num = IS_OPTION(request, COAP_OPTION_BLOCK2) ? request->block2_num : 0;
+  key->block2_size = IS_OPTION(request, COAP_OPTION_BLOCK2) ? request->block2_size : 0;
+  return 1;
+}
+/*----------------------------------------------------------------------------*/
+static coap_cache_entry_t *
+cache_find(coap_cache_entry_t *key)
+{
+  coap_cache_entry_t *e;
+
+  for (e = cache_entries; e < cache_entries + COAP_RESPONSE_CACHE_ENTRIES; ++e)
+  {
+    if (e->used && e->key_len==key->key_len && memcmp(e->key, key->key, key->key_len)==0
+        && e->accept==key->accept && e->block2_num==key->block2_num && e->block2_size==key->block2_size)
+    {
+      return e;
+    }
+  }
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+int
+coap_cache_get_response(coap_packet_t *request, coap_packet_t *response)
+{
+  static coap_cache_entry_t key;
+  coap_cache_entry_t *e;
+  coap_message_type_t type;
+  uint16_t mid;
+  uint8_t token_len;
+  uint8_t token[COAP_TOKEN_LEN];
+  unsigned long remaining;
+
+  if (request->code!=COAP_GET)
+  {
+    /* Modifications invalidate the cached representations of the resource. */
+    for (e = cache_entries; e < cache_entries + COAP_RESPONSE_CACHE_ENTRIES; ++e)
+    {
+      if (e->used && e->path_len==request->uri_path_len && memcmp(e->key, request->uri_path, e->path_len)==0)
+      {
+        e->used = 0;
+      }
+    }
+    return 0;
+  }
+
+  if (!cache_key(request, &key))
+  {
+    return 0;
+  }
+
+  e = cache_find(&key);
+  if (e==NULL || timer_expired(&e->max_age))
+  {
+    ++stats.cache_misses;
+    return 0;
+  }
+
+  remaining = timer_remaining(&e->max_age) / CLOCK_SECOND;
+  if (remaining==0)
+  {
+    ++stats.cache_misses;
+    return 0;
+  }
+
+  PRINTF("Cache: hit for /%.*s, %lu s left\n", e->key_len, e->key, remaining);
+  ++stats.cache_hits;
+
+  /* Keep the message layer fields prepared for this request. */
+  type = response->type;
+  mid = response->mid;
+  token_len = response->token_len;
+  memcpy(token, response->token, token_len);
+
+  coap_parse_message(response, e->data, e->length);
+
+  response->type = type;
+  response->mid = mid;
+  coap_set_header_token(response, token, token_len);
+  coap_set_header_max_age(response, remaining);
+
+  return 1;
+}
+/*----------------------------------------------------------------------------*/
+void
+coap_cache_put_response(coap_packet_t *request, coap_packet_t *response, uint16_t length)
+{
+  static coap_cache_entry_t key;
+  coap_cache_entry_t *e;
+  coap_cache_entry_t *oldest = NULL;
+
+  if (request->code!=COAP_GET || response->code!=CONTENT_2_05 || !IS_OPTION(response, COAP_OPTION_MAX_AGE)
+      || response->max_age==0 || length > COAP_MAX_PACKET_SIZE || !cache_key(request, &key))
+  {
+    return;
+  }
+
+  if ((e = cache_find(&key))==NULL)
+  {
+    /* Use a free or stale entry, or replace the one that expires first. */
+    for (e = cache_entries; e < cache_entries + COAP_RESPONSE_CACHE_ENTRIES; ++e)
+    {
+      if (!e->used || timer_expired(&e->max_age))
+      {
+        break;
+      }
+      if (oldest==NULL || timer_remaining(&e->max_age) < timer_remaining(&oldest->max_age))
+      {
+        oldest = e;
+      }
+    }
+    if (e==cache_entries + COAP_RESPONSE_CACHE_ENTRIES)
+    {
+      e = oldest;
+    }
+  }
+
+  memcpy(e->key, key.key, key.key_len);
+  e->key_len = key.key_len;
+  e->path_len = key.path_len;
+  e->accept = key.accept;
+  e->block2_num = key.block2_num;
+  e->block2_size = key.block2_size;
+  memcpy(e->data, response->buffer, length);
+  e->length = length;
+  timer_set(&e->max_age, (clock_time_t)response->max_age * CLOCK_SECOND);
+  e->used = 1;
+
+  PRINTF("Cache: stored /%.*s for %lu s\n", e->key_len, e->key, (unsigned long)response->max_age);
+}
+#endif /* COAP_RESPONSE_CACHE_ENTRIES */
+/*----------------------------------------------------------------------------*/
+const coap_cache_stats_t *
+coap_get_cache_stats(void)
+{
+  return &stats;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for duplicate detection and response caching
+ */
+
+#ifndef COAP_CACHE_H_
+#define COAP_CACHE_H_
+
+#include "er-coap-13.h"
+
+/*
+ * The number of recent requests remembered per endpoint and MID. Duplicates of these requests are
+ * answered with the stored response instead of invoking the resource handler again. 0 disables it.
+ */
+#ifndef COAP_DEDUP_ENTRIES
+#define COAP_DEDUP_ENTRIES 0
+#endif /* COAP_DEDUP_ENTRIES */
+
+/*
+ * The largest response that is stored for duplicates. Duplicates of requests with larger responses are processed again.
+ */
+#ifndef COAP_DEDUP_RESPONSE_SIZE
+#define COAP_DEDUP_RESPONSE_SIZE COAP_MAX_PACKET_SIZE
+#endif /* COAP_DEDUP_RESPONSE_SIZE */
+
+/*
+ * How long a request is remembered in seconds (EXCHANGE_LIFETIME).
+ */
+#ifndef COAP_EXCHANGE_LIFETIME
+#define COAP_EXCHANGE_LIFETIME 247
+#endif /* COAP_EXCHANGE_LIFETIME */
+
+/*
+ * The number of GET responses kept for the time given by their Max-Age option. Only responses of resources
+ * that set Max-Age explicitly are cached. 0 disables it.
+ */
+#ifndef COAP_RESPONSE_CACHE_ENTRIES
+#define COAP_RESPONSE_CACHE_ENTRIES 0
+#endif /* COAP_RESPONSE_CACHE_ENTRIES */
+
+/*
+ * The longest URI path and query that can be cached.
+ */
+#ifndef COAP_RESPONSE_CACHE_KEY_LEN
+#define COAP_RESPONSE_CACHE_KEY_LEN 32
+#endif /* COAP_RESPONSE_CACHE_KEY_LEN */
+
+typedef struct coap_cache_stats {
+  uint32_t dedup_hits; /* duplicates answered from the store */
+  uint32_t dedup_misses; /* requests processed */
+  uint32_t cache_hits; /* GETs answered from the response cache */
+  uint32_t cache_misses; /* GETs that had to invoke the resource handler */
+} coap_cache_stats_t;
+
+#if COAP_DEDUP_ENTRIES
+int coap_dedup_replay(uip_ipaddr_t *addr, uint16_t port, uint16_t mid);
+void coap_dedup_store(uip_ipaddr_t *addr, uint16_t port, uint16_t mid, const uint8_t *data, uint16_t length);
+#else
+#define coap_dedup_replay(addr, port, mid) 0
+#define coap_dedup_store(addr, port, mid, data, length)
+#endif /* COAP_DEDUP_ENTRIES */
+
+#if COAP_RESPONSE_CACHE_ENTRIES
+int coap_cache_get_response(coap_packet_t *request, coap_packet_t *response);
+void coap_cache_put_response(coap_packet_t *request, coap_packet_t *response, uint16_t length);
+#else
+#define coap_cache_get_response(request, response) 0
+#define coap_cache_put_response(request, response, length)
+#endif /* COAP_RESPONSE_CACHE_ENTRIES */
+
+const coap_cache_stats_t *coap_get_cache_stats(void);
+
+#endif /* COAP_CACHE_H_ */
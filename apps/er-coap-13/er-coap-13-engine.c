@@ -43,6 +43,7 @@
 #include "contiki-net.h"
 
 #include "er-coap-13-engine.h"
+#include "er-coap-13-cache.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -71,9 +72,66 @@ PROCESS(coap_receiver, "CoAP Receiver");
 /*- Variables ----------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
 static service_callback_t service_cbk = NULL;
+static coap_response_handler_t response_hdlr = NULL;
 /*----------------------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
+/*
+ * Looks up the resource of a request from its Uri-Path options, which are joined into url, without parsing the
+ * message. Returns 0 only if no resource matches; requests with options that the parser rejects, over-long paths,
+ * and malformed options are left to the parser.
+ */
+static
+int
+coap_find_resource(coap_option_iterator_t *it, char *url, uint16_t url_size)
+{
+  uint16_t url_len = 0;
+  unsigned int number = 0;
+  int first = 1;
+
+  while ((number = coap_option_next(it)))
+  {
+    switch (number)
+    {
+      case COAP_OPTION_URI_PATH:
+        if (url_len + !first + it->length > url_size)
+        {
+          return 1;
+        }
+        if (!first)
+        {
+          url[url_len++] = '/';
+        }
+        first = 0;
+        memcpy(url+url_len, it->value, it->length);
+        url_len += it->length;
+        break;
+      case COAP_OPTION_IF_MATCH:
+      case COAP_OPTION_URI_HOST:
+      case COAP_OPTION_IF_NONE_MATCH:
+      case COAP_OPTION_URI_PORT:
+      case COAP_OPTION_URI_QUERY:
+      case COAP_OPTION_BLOCK2:
+      case COAP_OPTION_BLOCK1:
+        break;
+      default:
+        /* Proxy-Uri and unknown critical options are errors that take precedence. */
+        if (number & 1)
+        {
+          return 1;
+        }
+    }
+  }
+
+  /* The iterator stops early at a malformed option. */
+  if (it->next < it->end && it->next[0]!=0xFF)
+  {
+    return 1;
+  }
+
+  return rest_find_resource(url, url_len)!=NULL;
+}
+/*----------------------------------------------------------------------------*/
 static
 int
 coap_receive(void)
@@ -85,8 +143,16 @@ coap_receive(void)
   /* Static declaration reduces stack peaks and program code size. */
   static coap_packet_t message[1]; /* This way the packet can be treated as pointer as usual. */
   static coap_packet_t response[1];
+  static coap_option_iterator_t options[1];
   static coap_transaction_t *transaction = NULL;
 
+  /* Handlers may send, which overwrites uip_buf, so the source is kept for the reply. */
+  static uip_ipaddr_t src_addr;
+  uint16_t src_port;
+  coap_message_type_t type;
+  uint8_t code;
+  uint16_t mid;
+
   if (uip_newdata()) {
 
     PRINTF("receiving UDP datagram from: ");
@@ -95,45 +161,79 @@ coap_receive(void)
     PRINTBITS(uip_appdata, uip_datalen());
     PRINTF("\n");
 
-    coap_error_code = coap_parse_message(message, uip_appdata, uip_datalen());
-
-    if (coap_error_code==NO_ERROR)
+    /* Messages are dispatched on the fixed header and only parsed when the packet is needed. */
+    if (uip_datalen() < COAP_HEADER_LEN)
     {
+      PRINTF("  Shorter than the header\n");
+      return coap_error_code;
+    }
+
+    type = COAP_MESSAGE_TYPE(uip_appdata);
+    code = COAP_MESSAGE_CODE(uip_appdata);
+    mid = COAP_MESSAGE_MID(uip_appdata);
+    uip_ipaddr_copy(&src_addr, &UIP_IP_BUF->srcipaddr);
+    src_port = UIP_UDP_BUF->srcport;
 
-      /*TODO duplicates suppression, if required by application */
+    PRINTF("  Header: t %u, c %u, mid %u\n", type, code, mid);
 
-      PRINTF("  Parsed: v %u, t %u, tkl %u, c %u, mid %u\n", message->version, message->type, message->token_len, message->code, message->mid);
-      PRINTF("  URL: %.*s\n", message->uri_path_len, message->uri_path);
-      PRINTF("  Payload: %.*s\n", message->payload_len, message->payload);
+    transaction = NULL;
+
+    if (!coap_option_iterator_init(options, uip_appdata, uip_datalen()))
+    {
+      coap_error_code = BAD_REQUEST_4_00;
+      coap_error_message = "Invalid header";
+    }
+    /* Handle requests. */
+    else if (code >= COAP_GET && code <= COAP_DELETE)
+    {
+      /* Answer duplicate requests with the stored response without parsing them again. */
+      if (coap_dedup_replay(&src_addr, src_port, mid))
+      {
+        return coap_error_code;
+      }
 
-      /* Handle requests. */
-      if (message->code >= COAP_GET && message->code <= COAP_DELETE)
+      /* Use transaction buffer for response to confirmable request. */
+      if ( (transaction = coap_new_transaction(mid, &src_addr, src_port)) )
       {
-        /* Use transaction buffer for response to confirmable request. */
-        if ( (transaction = coap_new_transaction(message->mid, &UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport)) )
+        uint32_t block_num = 0;
+        uint16_t block_size = REST_MAX_CHUNK_SIZE;
+        uint32_t block_offset = 0;
+        int32_t new_offset = 0;
+
+        /* prepare response */
+        if (type==COAP_TYPE_CON)
+        {
+          /* Reliable CON requests are answered with an ACK. */
+          coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, mid);
+        }
+        else
         {
-          uint32_t block_num = 0;
-          uint16_t block_size = REST_MAX_CHUNK_SIZE;
-          uint32_t block_offset = 0;
-          int32_t new_offset = 0;
+          /* Unreliable NON requests are answered with a NON as well. */
+          coap_init_message(response, COAP_TYPE_NON, CONTENT_2_05, coap_get_mid());
+        }
 
-          /* prepare response */
-          if (message->type==COAP_TYPE_CON)
-          {
-            /* Reliable CON requests are answered with an ACK. */
-            coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, message->mid);
-          }
-          else
-          {
-            /* Unreliable NON requests are answered with a NON as well. */
-            coap_init_message(response, COAP_TYPE_NON, CONTENT_2_05, coap_get_mid());
-          }
+        /* mirror token */
+        if (options->token_len)
+        {
+            coap_set_header_token(response, options->token, options->token_len);
+        }
+
+        /* Answer requests for unknown resources before parsing; the unused transaction buffer holds the URL. */
+        if (service_cbk==rest_invoke_restful_service && !coap_find_resource(options, (char *) transaction->packet, COAP_MAX_PACKET_SIZE))
+        {
+          PRINTF("  Not found: no resource for the Uri-Path\n");
 
-          /* mirror token */
-          if (message->token_len)
+          coap_set_status_code(response, NOT_FOUND_4_04);
+          if ((transaction->packet_len = coap_serialize_message(response, transaction->packet))==0)
           {
-              coap_set_header_token(response, message->token, message->token_len);
+            coap_error_code = PACKET_SERIALIZATION_ERROR;
           }
+        }
+        else if ((coap_error_code = coap_parse_message(message, uip_appdata, uip_datalen()))==NO_ERROR)
+        {
+          PRINTF("  Parsed: v %u, t %u, tkl %u, c %u, mid %u\n", message->version, message->type, message->token_len, message->code, message->mid);
+          PRINTF("  URL: %.*s\n", message->uri_path_len, message->uri_path);
+          PRINTF("  Payload: %.*s\n", message->payload_len, message->payload);
 
           /* get offset for blockwise transfers */
           if (coap_get_header_block2(message, &block_num, NULL, &block_size, &block_offset))
@@ -143,8 +243,16 @@ coap_receive(void)
               new_offset = block_offset;
           }
 
+          /* Use a cached response that is still fresh. */
+          if (coap_cache_get_response(message, response))
+          {
+            if ((transaction->packet_len = coap_serialize_message(response, transaction->packet))==0)
+            {
+              coap_error_code = PACKET_SERIALIZATION_ERROR;
+            }
+          }
           /* Invoke resource handler. */
-          if (service_cbk)
+          else if (service_cbk)
           {
             /* Call REST framework and check if found and allowed. */
             if (service_cbk(message, response, transaction->packet+COAP_MAX_HEADER_SIZE, block_size, &new_offset))
@@ -196,6 +304,9 @@ coap_receive(void)
               } /* no errors/hooks */
             } /* successful service callback */
 
+            /* Advance or finish the state of streaming Block2 transfers. */
+            coap_block2_update(new_offset);
+
             /* Serialize response. */
             if (coap_error_code==NO_ERROR)
             {
@@ -203,6 +314,10 @@ coap_receive(void)
               {
                 coap_error_code = PACKET_SERIALIZATION_ERROR;
               }
+              else
+              {
+                coap_cache_put_response(message, response, transaction->packet_len);
+              }
             }
 
           }
@@ -212,50 +327,88 @@ coap_receive(void)
             coap_error_message = "NoServiceCallbck"; // no a to fit 16 bytes
           } /* if (service callback) */
 
-        } else {
-            coap_error_code = SERVICE_UNAVAILABLE_5_03;
-            coap_error_message = "NoFreeTraBuffer";
-        } /* if (transaction buffer) */
+        } /* if (found and parsed correctly) */
+
+      } else {
+          coap_error_code = SERVICE_UNAVAILABLE_5_03;
+          coap_error_message = "NoFreeTraBuffer";
+      } /* if (transaction buffer) */
+    }
+    else
+    {
+      /* Responses */
+
+      if (type==COAP_TYPE_ACK)
+      {
+        PRINTF("Received ACK\n");
       }
-      else
+      else if (type==COAP_TYPE_RST)
       {
-        /* Responses */
+        PRINTF("Received RST\n");
+        /* Cancel possible subscriptions. */
+        coap_remove_observer_by_mid(&src_addr, src_port, mid);
+      }
 
-        if (message->type==COAP_TYPE_ACK)
-        {
-          PRINTF("Received ACK\n");
-        }
-        else if (message->type==COAP_TYPE_RST)
-        {
-          PRINTF("Received RST\n");
-          /* Cancel possible subscriptions. */
-          coap_remove_observer_by_mid(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport, message->mid);
-        }
+      if ( (transaction = coap_get_transaction_by_mid(mid)) )
+      {
+        restful_response_handler callback = transaction->callback;
+        void *callback_data = transaction->callback_data;
 
-        if ( (transaction = coap_get_transaction_by_mid(message->mid)) )
+        /* Only parse the response if someone registered for it; otherwise, the transaction is just ACKed. */
+        if (callback==NULL || (coap_error_code = coap_parse_message(message, uip_appdata, uip_datalen()))==NO_ERROR)
         {
           /* Free transaction memory before callback, as it may create a new transaction. */
-          restful_response_handler callback = transaction->callback;
-          void *callback_data = transaction->callback_data;
           coap_clear_transaction(transaction);
 
-          /* Check if someone registered for the response */
           if (callback) {
             callback(callback_data, message);
           }
-        } /* if (ACKed transaction) */
-        transaction = NULL;
-
-      } /* Request or Response */
+        }
+      } /* if (ACKed transaction) */
+      else if (response_hdlr && code!=0 && type!=COAP_TYPE_ACK
+               && (coap_error_code = coap_parse_message(message, uip_appdata, uip_datalen()))==NO_ERROR)
+      {
+        /* Separate responses and notifications belong to no transaction; the client must claim them by token. */
+        if (response_hdlr(&src_addr, src_port, message))
+        {
+          if (type==COAP_TYPE_CON)
+          {
+            coap_init_message(message, COAP_TYPE_ACK, 0, mid);
+            coap_send_message(&src_addr, src_port, uip_appdata, coap_serialize_message(message, uip_appdata));
+          }
+        }
+        else
+        {
+          /* Reject unknown responses so that the server removes a stale observer. */
+          coap_init_message(message, COAP_TYPE_RST, 0, mid);
+          coap_send_message(&src_addr, src_port, uip_appdata, coap_serialize_message(message, uip_appdata));
+        }
+      }
+      transaction = NULL;
 
-    } /* if (parsed correctly) */
+    } /* Request or Response */
 
     if (coap_error_code==NO_ERROR)
     {
-      if (transaction) coap_send_transaction(transaction);
+      if (transaction)
+      {
+        coap_dedup_store(&src_addr, src_port, mid, transaction->packet, transaction->packet_len);
+        coap_send_transaction(transaction);
+      }
     }
     else if (coap_error_code==MANUAL_RESPONSE)
     {
+#if COAP_DEDUP_ENTRIES
+      if (transaction)
+      {
+        /* Duplicates of separate CON requests get the empty ACK again, NON duplicates are dropped. */
+        static coap_packet_t ack[1];
+
+        coap_init_message(ack, COAP_TYPE_ACK, 0, mid);
+        coap_dedup_store(&src_addr, src_port, mid, transaction->packet,
+                         type==COAP_TYPE_CON ? coap_serialize_message(ack, transaction->packet) : 0);
+      }
+#endif /* COAP_DEDUP_ENTRIES */
       PRINTF("Clearing transaction for manual response");
       coap_clear_transaction(transaction);
     }
@@ -270,9 +423,9 @@ coap_receive(void)
         coap_error_code = INTERNAL_SERVER_ERROR_5_00;
       }
       /* Reuse input buffer for error message. */
-      coap_init_message(message, COAP_TYPE_ACK, coap_error_code, message->mid);
+      coap_init_message(message, COAP_TYPE_ACK, coap_error_code, mid);
       coap_set_payload(message, coap_error_message, strlen(coap_error_message));
-      coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport, uip_appdata, coap_serialize_message(message, uip_appdata));
+      coap_send_message(&src_addr, src_port, uip_appdata, coap_serialize_message(message, uip_appdata));
     }
   } /* if (new data) */
 
@@ -291,6 +444,12 @@ coap_set_service_callback(service_callback_t callback)
   service_cbk = callback;
 }
 /*----------------------------------------------------------------------------*/
+void
+coap_set_response_handler(coap_response_handler_t handler)
+{
+  response_hdlr = handler;
+}
+/*----------------------------------------------------------------------------*/
 rest_resource_flags_t
 coap_get_rest_method(void *packet)
 {
@@ -47,6 +47,7 @@
 #include "er-coap-13-transactions.h"
 #include "er-coap-13-observing.h"
 #include "er-coap-13-separate.h"
+#include "er-coap-13-block.h"
 
 #include "pt.h"
 
@@ -75,6 +76,16 @@ struct request_state_t {
 
 typedef void (*blocking_response_handler) (void* response);
 
+/*
+ * Handler for separate responses and notifications, which do not belong to an open transaction.
+ * Returns non-zero if it claimed the response by its token; CON responses are then acknowledged,
+ * otherwise they are rejected with a RST. The response points into uip_buf, which a send overwrites,
+ * so a handler that sends a request in turn must copy what it needs first or defer the send.
+ */
+typedef int (*coap_response_handler_t) (uip_ipaddr_t *addr, uint16_t port, coap_packet_t *response);
+
+void coap_set_response_handler(coap_response_handler_t handler);
+
 PT_THREAD(coap_blocking_request(struct request_state_t *state, process_event_t ev,
                                 uip_ipaddr_t *remote_ipaddr, uint16_t remote_port,
                                 coap_packet_t *request,
@@ -56,6 +56,21 @@
 MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 LIST(observers_list);
 
+/* A notification is serialized once without token; the per-observer header and token are patched in when sending. */
+static uint8_t notification_template[COAP_MAX_PACKET_SIZE];
+static uint16_t notification_template_len;
+static uint8_t notification_buffer[COAP_MAX_PACKET_SIZE];
+
+static coap_observing_stats_t stats;
+static clock_time_t stats_second;
+static uint16_t stats_count;
+
+/*-----------------------------------------------------------------------------------*/
+list_t
+coap_get_observers(void)
+{
+  return observers_list;
+}
 /*-----------------------------------------------------------------------------------*/
 coap_observer_t *
 coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token, size_t token_len, const char *url)
@@ -75,6 +90,8 @@ coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token, size_
     o->last_mid = 0;
 
     stimer_set(&o->refresh_timer, COAP_OBSERVING_REFRESH_INTERVAL);
+    o->last_notify = clock_time() - COAP_OBSERVING_MIN_INTERVAL;
+    o->non_count = 0;
 
     PRINTF("Adding observer for /%s [0x%02X%02X]\n", o->url, o->token[0], o->token[1]);
     list_add(observers_list, o);
@@ -166,54 +183,121 @@ coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
   return removed;
 }
 /*-----------------------------------------------------------------------------------*/
+static uint16_t
+build_notification(uint8_t *packet, coap_observer_t *obs, coap_message_type_t type, uint16_t mid)
+{
+  packet[0] = (notification_template[0] & COAP_HEADER_VERSION_MASK)
+              | (COAP_HEADER_TYPE_MASK & type<<COAP_HEADER_TYPE_POSITION)
+              | (COAP_HEADER_TOKEN_LEN_MASK & obs->token_len<<COAP_HEADER_TOKEN_LEN_POSITION);
+  packet[1] = notification_template[1];
+  packet[2] = 0xFF & mid>>8;
+  packet[3] = 0xFF & mid;
+  memcpy(packet+COAP_HEADER_LEN, obs->token, obs->token_len);
+  memcpy(packet+COAP_HEADER_LEN+obs->token_len, notification_template+COAP_HEADER_LEN, notification_template_len-COAP_HEADER_LEN);
+
+  return notification_template_len + obs->token_len;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+count_notification(uint8_t type)
+{
+  ++stats.notifications;
+  if (type==COAP_TYPE_CON) ++stats.con_notifications;
+
+  ++stats_count;
+  if (clock_time() - stats_second >= CLOCK_SECOND)
+  {
+    stats.per_second = (uint32_t)stats_count * CLOCK_SECOND / (clock_time() - stats_second);
+    stats_second = clock_time();
+    stats_count = 0;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
 void
 coap_notify_observers(resource_t *resource, int32_t obs_counter, void *notification)
 {
   coap_packet_t *const coap_res = (coap_packet_t *) notification;
   coap_observer_t* obs = NULL;
   uint8_t preferred_type = coap_res->type;
+  uint8_t type;
+  uint16_t mid;
 
   PRINTF("Observing: Notification from %s\n", resource->url);
 
+  notification_template_len = 0;
+
   /* Iterate over observers. */
   for (obs = (coap_observer_t*)list_head(observers_list); obs; obs = obs->next)
   {
     if (obs->url==resource->url) /* using RESOURCE url pointer as handle */
     {
-      coap_transaction_t *transaction = NULL;
+#if COAP_OBSERVING_MIN_INTERVAL
+      if (clock_time() - obs->last_notify < COAP_OBSERVING_MIN_INTERVAL)
+      {
+        PRINTF("           Rate limited\n");
+        ++stats.rate_limited;
+        continue;
+      }
+#endif
 
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers. */
+      /* Serialize the representation once for all observers. */
+      if (notification_template_len==0)
+      {
+        if (obs_counter>=0) coap_set_header_observe(coap_res, obs_counter);
+        coap_res->token_len = 0;
+        coap_res->mid = 0;
+        if ((notification_template_len = coap_serialize_message(coap_res, notification_template))==0)
+        {
+          return;
+        }
+        ++stats.serializations;
+      }
 
-      if ( (transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port)) )
+      PRINTF("           Observer ");
+      PRINT6ADDR(&obs->addr);
+      PRINTF(":%u\n", obs->port);
+
+      /* Use CON to check whether client is still there/interested after COAP_OBSERVING_REFRESH_INTERVAL. */
+      if (stimer_expired(&obs->refresh_timer) || (COAP_OBSERVING_CON_EVERY && obs->non_count+1>=COAP_OBSERVING_CON_EVERY))
+      {
+        PRINTF("           Refreshing with CON\n");
+        type = COAP_TYPE_CON;
+      }
+      else
       {
-        PRINTF("           Observer ");
-        PRINT6ADDR(&obs->addr);
-        PRINTF(":%u\n", obs->port);
+        type = preferred_type;
+      }
 
-        /* Update last MID for RST matching. */
-        obs->last_mid = transaction->mid;
+      mid = coap_get_mid();
 
-        /* Prepare response */
-        coap_res->mid = transaction->mid;
-        if (obs_counter>=0) coap_set_header_observe(coap_res, obs_counter);
-        coap_set_header_token(coap_res, obs->token, obs->token_len);
+      if (type==COAP_TYPE_CON)
+      {
+        coap_transaction_t *transaction = NULL;
 
-        /* Use CON to check whether client is still there/interested after COAP_OBSERVING_REFRESH_INTERVAL. */
-        if (stimer_expired(&obs->refresh_timer))
+        if ( (transaction = coap_new_transaction(mid, &obs->addr, obs->port)) )
         {
-          PRINTF("           Refreshing with CON\n");
-          coap_res->type = COAP_TYPE_CON;
-          stimer_restart(&obs->refresh_timer);
+          transaction->packet_len = build_notification(transaction->packet, obs, type, mid);
+          coap_send_transaction(transaction);
         }
         else
         {
-          coap_res->type = preferred_type;
+          ++stats.dropped;
+          continue;
         }
-
-        transaction->packet_len = coap_serialize_message(coap_res, transaction->packet);
-
-        coap_send_transaction(transaction);
+        stimer_restart(&obs->refresh_timer);
+        obs->non_count = 0;
+      }
+      else
+      {
+        /* NON notifications are not retransmitted and need no transaction. */
+        coap_send_message(&obs->addr, obs->port, notification_buffer, build_notification(notification_buffer, obs, type, mid));
+        ++obs->non_count;
       }
+
+      /* Update last MID for RST matching. */
+      obs->last_mid = mid;
+      obs->last_notify = clock_time();
+      count_notification(type);
     }
   }
 }
@@ -253,3 +337,9 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
     } /* if (observe) */
   }
 }
+/*-----------------------------------------------------------------------------------*/
+const coap_observing_stats_t *
+coap_get_observing_stats(void)
+{
+  return &stats;
+}
@@ -47,7 +47,19 @@
 #endif /* COAP_MAX_OBSERVERS */
 
 /* Interval in seconds in which NON notifies are changed to CON notifies to check client. */
+#ifndef COAP_OBSERVING_REFRESH_INTERVAL
 #define COAP_OBSERVING_REFRESH_INTERVAL  60
+#endif /* COAP_OBSERVING_REFRESH_INTERVAL */
+
+/* Additionally send every n-th NON notification as CON (0 to only refresh by time). */
+#ifndef COAP_OBSERVING_CON_EVERY
+#define COAP_OBSERVING_CON_EVERY  0
+#endif /* COAP_OBSERVING_CON_EVERY */
+
+/* Minimum time in clock ticks between notifications to the same observer; faster notifications are skipped (0 for no limit). */
+#ifndef COAP_OBSERVING_MIN_INTERVAL
+#define COAP_OBSERVING_MIN_INTERVAL  0
+#endif /* COAP_OBSERVING_MIN_INTERVAL */
 
 #if COAP_MAX_OPEN_TRANSACTIONS<COAP_MAX_OBSERVERS
 #warning "COAP_MAX_OPEN_TRANSACTIONS smaller than COAP_MAX_OBSERVERS: cannot handle CON notifications"
@@ -63,8 +75,19 @@ typedef struct coap_observer {
   uint8_t token[COAP_TOKEN_LEN];
   uint16_t last_mid;
   struct stimer refresh_timer;
+  clock_time_t last_notify;
+  uint8_t non_count; /* NON notifications since the last CON */
 } coap_observer_t;
 
+typedef struct coap_observing_stats {
+  uint32_t notifications; /* notifications sent */
+  uint32_t con_notifications; /* of which were CON */
+  uint32_t serializations; /* representations serialized for the notifications */
+  uint32_t rate_limited; /* notifications skipped due to COAP_OBSERVING_MIN_INTERVAL */
+  uint32_t dropped; /* CON notifications without a free transaction */
+  uint16_t per_second; /* notifications per second, measured over the last full second */
+} coap_observing_stats_t;
+
 list_t coap_get_observers(void);
 
 coap_observer_t *coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token, size_t token_len, const char *url);
@@ -79,4 +102,6 @@ void coap_notify_observers(resource_t *resource, int32_t obs_counter, void *noti
 
 void coap_observe_handler(resource_t *resource, void *request, void *response);
 
+const coap_observing_stats_t *coap_get_observing_stats(void);
+
 #endif /* COAP_OBSERVING_H_ */
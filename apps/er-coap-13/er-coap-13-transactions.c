@@ -36,6 +36,7 @@
  *      Matthias Kovatsch <kovatsch@inf.ethz.ch>
  */
 
+#include <string.h>
 #include "contiki.h"
 #include "contiki-net.h"
 
@@ -62,12 +63,136 @@
 #endif
 
 
+#if COAP_MAX_OPEN_TRANSACTIONS > 254
+#error "COAP_MAX_OPEN_TRANSACTIONS must not exceed 254"
+#endif
+
+/* Returns true if deadline a is before deadline b, also across clock wrap-arounds. */
+#define DEADLINE_BEFORE(a, b) ((clock_time_t)((a) - (b)) > ((clock_time_t)~0 >> 1))
+
+#define NOT_SCHEDULED COAP_MAX_OPEN_TRANSACTIONS
+
+typedef struct { uint8_t data[COAP_MAX_PACKET_SIZE+1]; } coap_buffer_t;
+#if COAP_SMALL_TRANSACTION_BUFFERS
+typedef struct { uint8_t data[COAP_SMALL_TRANSACTION_BUFFER_SIZE]; } coap_small_buffer_t;
+#endif
+
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
-LIST(transactions_list);
+MEMB(buffers_memb, coap_buffer_t, COAP_MAX_TRANSACTION_BUFFERS);
+#if COAP_SMALL_TRANSACTION_BUFFERS
+MEMB(small_buffers_memb, coap_small_buffer_t, COAP_SMALL_TRANSACTION_BUFFERS);
+#endif
+
+/* Transactions by MID. */
+static coap_transaction_t *transactions_table[COAP_TRANSACTION_HASH_SIZE];
+
+/* Binary min-heap of the confirmable transactions ordered by their next retransmission. */
+static coap_transaction_t *schedule[COAP_MAX_OPEN_TRANSACTIONS];
+static uint8_t schedule_len = 0;
 
+/* Single timer for all retransmissions, owned by the transaction handler process. */
+static struct etimer retrans_timer;
+
+static coap_transaction_stats_t stats;
 
 static struct process *transaction_handler_process = NULL;
 
+/*-----------------------------------------------------------------------------------*/
+static coap_transaction_t **
+get_bucket(uint16_t mid)
+{
+  return &transactions_table[mid & (COAP_TRANSACTION_HASH_SIZE - 1)];
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+schedule_set(uint8_t index, coap_transaction_t *t)
+{
+  schedule[index] = t;
+  t->schedule_index = index;
+}
+
+static void
+schedule_sift_up(uint8_t index)
+{
+  coap_transaction_t *t = schedule[index];
+  uint8_t parent;
+
+  while (index > 0)
+  {
+    parent = (index - 1) / 2;
+    if (!DEADLINE_BEFORE(t->retrans_time, schedule[parent]->retrans_time))
+    {
+      break;
+    }
+    schedule_set(index, schedule[parent]);
+    index = parent;
+  }
+  schedule_set(index, t);
+}
+
+static void
+schedule_sift_down(uint8_t index)
+{
+  coap_transaction_t *t = schedule[index];
+  uint8_t child;
+
+  while ((child = 2 * index + 1) < schedule_len)
+  {
+    if (child + 1 < schedule_len && DEADLINE_BEFORE(schedule[child + 1]->retrans_time, schedule[child]->retrans_time))
+    {
+      ++child;
+    }
+    if (!DEADLINE_BEFORE(schedule[child]->retrans_time, t->retrans_time))
+    {
+      break;
+    }
+    schedule_set(index, schedule[child]);
+    index = child;
+  }
+  schedule_set(index, t);
+}
+
+static void
+schedule_remove(coap_transaction_t *t)
+{
+  uint8_t index = t->schedule_index;
+
+  if (index == NOT_SCHEDULED)
+  {
+    return;
+  }
+
+  t->schedule_index = NOT_SCHEDULED;
+  if (index != --schedule_len)
+  {
+    schedule_set(index, schedule[schedule_len]);
+    schedule_sift_down(index);
+    schedule_sift_up(schedule[index]->schedule_index);
+  }
+}
+
+/* Sets the retransmission timer to the earliest deadline. */
+static void
+schedule_timer(void)
+{
+  clock_time_t now = clock_time();
+
+  PROCESS_CONTEXT_BEGIN(transaction_handler_process);
+  if (schedule_len == 0)
+  {
+    etimer_stop(&retrans_timer);
+  }
+  else if (DEADLINE_BEFORE(now, schedule[0]->retrans_time))
+  {
+    etimer_set(&retrans_timer, schedule[0]->retrans_time - now);
+  }
+  else
+  {
+    etimer_set(&retrans_timer, 0);
+  }
+  PROCESS_CONTEXT_END(transaction_handler_process);
+}
+/*-----------------------------------------------------------------------------------*/
 void
 coap_register_as_transaction_handler()
 {
@@ -81,19 +206,54 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
 
   if (t)
   {
+    if ((t->packet = memb_alloc(&buffers_memb)) == NULL)
+    {
+      PRINTF("No transaction buffer for %u\n", mid);
+      ++stats.buffers_exhausted;
+      memb_free(&transactions_memb, t);
+      return NULL;
+    }
+
     t->mid = mid;
     t->retrans_counter = 0;
+    t->schedule_index = NOT_SCHEDULED;
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
     t->port = port;
 
-    list_add(transactions_list, t); /* List itself makes sure same element is not added twice. */
+    t->next = *get_bucket(mid);
+    *get_bucket(mid) = t;
+
+    ++stats.transactions;
+  }
+  else
+  {
+    PRINTF("No transaction for %u\n", mid);
+    ++stats.pool_exhausted;
   }
 
   return t;
 }
 
+#if COAP_SMALL_TRANSACTION_BUFFERS
+/* Moves a message that waits for its ACK to a small buffer if possible. */
+static void
+shrink_buffer(coap_transaction_t *t)
+{
+  uint8_t *small;
+
+  if (memb_inmemb(&buffers_memb, t->packet) && t->packet_len <= COAP_SMALL_TRANSACTION_BUFFER_SIZE
+      && (small = memb_alloc(&small_buffers_memb)) != NULL)
+  {
+    memcpy(small, t->packet, t->packet_len);
+    memb_free(&buffers_memb, t->packet);
+    t->packet = small;
+    ++stats.small_buffers_used;
+  }
+}
+#endif
+
 void
 coap_send_transaction(coap_transaction_t *t)
 {
@@ -110,23 +270,25 @@ coap_send_transaction(coap_transaction_t *t)
 
       if (t->retrans_counter==0)
       {
-        t->retrans_timer.timer.interval = COAP_RESPONSE_TIMEOUT_TICKS + (random_rand() % (clock_time_t) COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
-        PRINTF("Initial interval %f\n", (float)t->retrans_timer.timer.interval/CLOCK_SECOND);
+        t->retrans_interval = COAP_RESPONSE_TIMEOUT_TICKS + (random_rand() % (clock_time_t) COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+        PRINTF("Initial interval %f\n", (float)t->retrans_interval/CLOCK_SECOND);
+
+#if COAP_SMALL_TRANSACTION_BUFFERS
+        shrink_buffer(t);
+#endif
       }
       else
       {
-        t->retrans_timer.timer.interval <<= 1; /* double */
-        PRINTF("Doubled (%u) interval %f\n", t->retrans_counter, (float)t->retrans_timer.timer.interval/CLOCK_SECOND);
+        t->retrans_interval <<= 1; /* double */
+        PRINTF("Doubled (%u) interval %f\n", t->retrans_counter, (float)t->retrans_interval/CLOCK_SECOND);
       }
 
-      /*FIXME
-       * Hack: Setting timer for responsible process.
-       * Maybe there is a better way, but avoid posting everything to the process.
-       */
-      struct process *process_actual = PROCESS_CURRENT();
-      process_current = transaction_handler_process;
-      etimer_restart(&t->retrans_timer); /* interval updated above */
-      process_current = process_actual;
+      /* (Re-)insert into the retransmission schedule. */
+      schedule_remove(t);
+      t->retrans_time = clock_time() + t->retrans_interval;
+      schedule_set(schedule_len++, t);
+      schedule_sift_up(t->schedule_index);
+      schedule_timer();
 
       t = NULL;
     }
@@ -137,6 +299,8 @@ coap_send_transaction(coap_transaction_t *t)
       restful_response_handler callback = t->callback;
       void *callback_data = t->callback_data;
 
+      ++stats.timeouts;
+
       /* handle observers */
       coap_remove_observer_by_client(&t->addr, t->port);
 
@@ -156,12 +320,37 @@ coap_send_transaction(coap_transaction_t *t)
 void
 coap_clear_transaction(coap_transaction_t *t)
 {
+  coap_transaction_t **p;
+
   if (t)
   {
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
-    etimer_stop(&t->retrans_timer);
-    list_remove(transactions_list, t);
+    if (t->schedule_index != NOT_SCHEDULED)
+    {
+      schedule_remove(t);
+      schedule_timer();
+    }
+
+    for (p = get_bucket(t->mid); *p; p = &(*p)->next)
+    {
+      if (*p == t)
+      {
+        *p = t->next;
+        break;
+      }
+    }
+
+#if COAP_SMALL_TRANSACTION_BUFFERS
+    if (memb_inmemb(&small_buffers_memb, t->packet))
+    {
+      memb_free(&small_buffers_memb, t->packet);
+    }
+    else
+#endif
+    {
+      memb_free(&buffers_memb, t->packet);
+    }
     memb_free(&transactions_memb, t);
   }
 }
@@ -171,7 +360,7 @@ coap_get_transaction_by_mid(uint16_t mid)
 {
   coap_transaction_t *t = NULL;
 
-  for (t = (coap_transaction_t*)list_head(transactions_list); t; t = t->next)
+  for (t = *get_bucket(mid); t; t = t->next)
   {
     if (t->mid==mid)
     {
@@ -187,13 +376,26 @@ coap_check_transactions()
 {
   coap_transaction_t *t = NULL;
 
-  for (t = (coap_transaction_t*)list_head(transactions_list); t; t = t->next)
+  if (!etimer_expired(&retrans_timer))
   {
-    if (etimer_expired(&t->retrans_timer))
-    {
-      ++(t->retrans_counter);
-      PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
-      coap_send_transaction(t);
-    }
+    return;
   }
+
+  /* Retransmit all transactions that are due; sending reschedules or clears them. */
+  while (schedule_len > 0 && !DEADLINE_BEFORE(clock_time(), schedule[0]->retrans_time))
+  {
+    t = schedule[0];
+    ++(t->retrans_counter);
+    ++stats.retransmissions;
+    PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
+    coap_send_transaction(t);
+  }
+
+  schedule_timer();
+}
+
+const coap_transaction_stats_t *
+coap_get_transaction_stats(void)
+{
+  return &stats;
 }
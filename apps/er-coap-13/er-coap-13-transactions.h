@@ -48,13 +48,41 @@
 #define COAP_MAX_OPEN_TRANSACTIONS 4 
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/*
+ * The number of full-size message buffers. A transaction needs one while its message is being built.
+ */
+#ifndef COAP_MAX_TRANSACTION_BUFFERS
+#define COAP_MAX_TRANSACTION_BUFFERS COAP_MAX_OPEN_TRANSACTIONS
+#endif /* COAP_MAX_TRANSACTION_BUFFERS */
+
+/*
+ * The number and size of small message buffers. Confirmable messages that fit are moved to a small buffer
+ * while they wait for their ACK, which frees the full-size buffer for the next transaction.
+ */
+#ifndef COAP_SMALL_TRANSACTION_BUFFERS
+#define COAP_SMALL_TRANSACTION_BUFFERS 0
+#endif /* COAP_SMALL_TRANSACTION_BUFFERS */
+
+#ifndef COAP_SMALL_TRANSACTION_BUFFER_SIZE
+#define COAP_SMALL_TRANSACTION_BUFFER_SIZE 64
+#endif /* COAP_SMALL_TRANSACTION_BUFFER_SIZE */
+
+/*
+ * The number of buckets for looking up transactions by MID. Must be a power of two.
+ */
+#ifndef COAP_TRANSACTION_HASH_SIZE
+#define COAP_TRANSACTION_HASH_SIZE 8
+#endif /* COAP_TRANSACTION_HASH_SIZE */
+
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
-  struct coap_transaction *next; /* for LIST */
+  struct coap_transaction *next; /* for the MID hash table */
 
   uint16_t mid;
-  struct etimer retrans_timer;
+  clock_time_t retrans_time; /* when the next retransmission is due */
+  clock_time_t retrans_interval;
   uint8_t retrans_counter;
+  uint8_t schedule_index; /* position in the retransmission schedule, or COAP_MAX_OPEN_TRANSACTIONS */
 
   uip_ipaddr_t addr;
   uint16_t port;
@@ -63,9 +91,19 @@ typedef struct coap_transaction {
   void *callback_data;
 
   uint16_t packet_len;
-  uint8_t packet[COAP_MAX_PACKET_SIZE+1]; /* +1 for the terminating '\0' to simply and savely use snprintf(buf, len+1, "", ...) in the resource handler. */
+  uint8_t *packet; /* COAP_MAX_PACKET_SIZE+1 for the terminating '\0' to simply and savely use snprintf(buf, len+1, "", ...) in the resource handler. */
 } coap_transaction_t;
 
+/* Statistics of the transaction layer. */
+typedef struct coap_transaction_stats {
+  uint32_t transactions;
+  uint32_t retransmissions;
+  uint32_t timeouts;
+  uint32_t pool_exhausted; /* no transaction was available */
+  uint32_t buffers_exhausted; /* no full-size buffer was available */
+  uint32_t small_buffers_used; /* messages moved to a small buffer */
+} coap_transaction_stats_t;
+
 void coap_register_as_transaction_handler();
 
 coap_transaction_t *coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port);
@@ -75,4 +113,6 @@ coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
 
 void coap_check_transactions();
 
+const coap_transaction_stats_t *coap_get_transaction_stats(void);
+
 #endif /* COAP_TRANSACTIONS_H_ */
@@ -643,6 +643,184 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
   return NO_ERROR;
 }
 /*-----------------------------------------------------------------------------------*/
+/*- LAZY OPTION PARSING -------------------------------------------------------------*/
+/*-----------------------------------------------------------------------------------*/
+int
+coap_option_iterator_init(coap_option_iterator_t *it, const uint8_t *data, uint16_t data_len)
+{
+  if (data_len < COAP_HEADER_LEN || ((COAP_HEADER_VERSION_MASK & data[0])>>COAP_HEADER_VERSION_POSITION)!=1)
+  {
+    return 0;
+  }
+
+  it->token_len = (COAP_HEADER_TOKEN_LEN_MASK & data[0])>>COAP_HEADER_TOKEN_LEN_POSITION;
+  if (it->token_len > COAP_TOKEN_LEN || COAP_HEADER_LEN + it->token_len > data_len)
+  {
+    return 0;
+  }
+
+  it->token = data + COAP_HEADER_LEN;
+  it->options = it->token + it->token_len;
+  it->next = it->options;
+  it->end = data + data_len;
+  it->number = 0;
+  it->value = NULL;
+  it->length = 0;
+
+  return 1;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Decodes the option header at current_option. Returns the option value, or NULL at the end of the options. */
+static
+const uint8_t *
+coap_option_decode(const uint8_t *current_option, const uint8_t *end, unsigned int *option_delta, unsigned int *option_length)
+{
+  unsigned int delta = 0;
+  unsigned int length = 0;
+
+  /* End of options or payload marker */
+  if (current_option >= end || current_option[0] >= 0xF0)
+  {
+    return NULL;
+  }
+
+  delta = current_option[0]>>4;
+  length = current_option[0] & 0x0F;
+  ++current_option;
+
+  /* Extended delta and length are rare, so check for them only once in the common case. */
+  if (delta >= 13)
+  {
+    if (delta==13)
+    {
+      if (current_option + 1 > end) return NULL;
+      delta += current_option[0];
+      current_option += 1;
+    }
+    else
+    {
+      if (current_option + 2 > end) return NULL;
+      delta = 269 + (current_option[0]<<8 | current_option[1]);
+      current_option += 2;
+    }
+  }
+  if (length >= 13)
+  {
+    if (length==13)
+    {
+      if (current_option + 1 > end) return NULL;
+      length += current_option[0];
+      current_option += 1;
+    }
+    else if (length==14)
+    {
+      if (current_option + 2 > end) return NULL;
+      length = 269 + (current_option[0]<<8 | current_option[1]);
+      current_option += 2;
+    }
+    else
+    {
+      return NULL;
+    }
+  }
+
+  if (current_option + length > end)
+  {
+    return NULL;
+  }
+
+  *option_delta = delta;
+  *option_length = length;
+  return current_option;
+}
+/*-----------------------------------------------------------------------------------*/
+unsigned int
+coap_option_next(coap_option_iterator_t *it)
+{
+  const uint8_t *value = NULL;
+  unsigned int option_delta = 0;
+  unsigned int option_length = 0;
+
+  if ((value = coap_option_decode(it->next, it->end, &option_delta, &option_length))==NULL)
+  {
+    return 0;
+  }
+
+  it->number += option_delta;
+  it->value = value;
+  it->length = option_length;
+  it->next = value + option_length;
+
+  return it->number;
+}
+/*-----------------------------------------------------------------------------------*/
+int
+coap_option_find(coap_option_iterator_t *it, unsigned int number)
+{
+  const uint8_t *value = NULL;
+  unsigned int option_delta = 0;
+  unsigned int option_length = 0;
+
+  /* Options are ordered by number, so stop without consuming a larger one. */
+  while ((value = coap_option_decode(it->next, it->end, &option_delta, &option_length)) && it->number+option_delta<=number)
+  {
+    it->number += option_delta;
+    it->value = value;
+    it->length = option_length;
+    it->next = value + option_length;
+
+    if (it->number==number)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
+uint32_t
+coap_option_get_int(const coap_option_iterator_t *it)
+{
+  return coap_parse_int_option((uint8_t *) it->value, it->length);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+coap_option_match(coap_option_iterator_t *it, unsigned int number, const char *str, size_t len, char separator)
+{
+  size_t pos = 0;
+  int first = 1;
+
+  /* Compare all following instances of the option, e.g., the segments of the Uri-Path. */
+  while (coap_option_find(it, number))
+  {
+    if (!first)
+    {
+      if (pos>=len || str[pos]!=separator) return 0;
+      ++pos;
+    }
+    first = 0;
+
+    if (it->length > len-pos || memcmp(str+pos, it->value, it->length)!=0) return 0;
+    pos += it->length;
+  }
+
+  return pos==len;
+}
+/*-----------------------------------------------------------------------------------*/
+int
+coap_option_get_payload(coap_option_iterator_t *it, const uint8_t **payload)
+{
+  while (coap_option_next(it)) ;
+
+  if (it->next < it->end && it->next[0]==0xFF)
+  {
+    *payload = it->next + 1;
+    return it->end - *payload;
+  }
+
+  *payload = NULL;
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
 /*- REST FRAMEWORK FUNCTIONS --------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
 int
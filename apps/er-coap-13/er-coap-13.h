@@ -129,6 +129,7 @@ typedef enum {
   VALID_2_03 = 67,                      /* NOT_MODIFIED */
   CHANGED_2_04 = 68,                    /* CHANGED */
   CONTENT_2_05 = 69,                    /* OK */
+  CONTINUE_2_31 = 95,                   /* CONTINUE */
 
   BAD_REQUEST_4_00 = 128,               /* BAD_REQUEST */
   UNAUTHORIZED_4_01 = 129,              /* UNAUTHORIZED */
@@ -137,6 +138,7 @@ typedef enum {
   NOT_FOUND_4_04 = 132,                 /* NOT_FOUND */
   METHOD_NOT_ALLOWED_4_05 = 133,        /* METHOD_NOT_ALLOWED */
   NOT_ACCEPTABLE_4_06 = 134,            /* NOT_ACCEPTABLE */
+  REQUEST_ENTITY_INCOMPLETE_4_08 = 136, /* REQUEST_ENTITY_INCOMPLETE */
   PRECONDITION_FAILED_4_12 = 140,       /* BAD_REQUEST */
   REQUEST_ENTITY_TOO_LARGE_4_13 = 141,  /* REQUEST_ENTITY_TOO_LARGE */
   UNSUPPORTED_MEDIA_TYPE_4_15 = 143,    /* UNSUPPORTED_MEDIA_TYPE */
@@ -318,6 +320,35 @@ size_t coap_serialize_message(void *packet, uint8_t *buffer);
 void coap_send_message(uip_ipaddr_t *addr, uint16_t port, uint8_t *data, uint16_t length);
 coap_status_t coap_parse_message(void *request, uint8_t *data, uint16_t data_len);
 
+/*-----------------------------------------------------------------------------------*/
+
+/*
+ * Lazy option parsing: reads the options of a serialized message on demand without copying them into a
+ * coap_packet_t. Options are visited in the order of their numbers. The message is not modified, but note that
+ * coap_parse_message() merges multi-segment options like Uri-Path in place, so iterate over a message before it is parsed.
+ */
+typedef struct coap_option_iterator {
+  const uint8_t *token;
+  uint8_t token_len;
+  const uint8_t *options; /* first option */
+  const uint8_t *next; /* header of the next option */
+  const uint8_t *end; /* end of the message */
+  unsigned int number; /* number of the current option */
+  const uint8_t *value; /* value of the current option */
+  uint16_t length;
+} coap_option_iterator_t;
+
+#define COAP_MESSAGE_TYPE(data) ((COAP_HEADER_TYPE_MASK & ((const uint8_t *)(data))[0])>>COAP_HEADER_TYPE_POSITION)
+#define COAP_MESSAGE_CODE(data) (((const uint8_t *)(data))[1])
+#define COAP_MESSAGE_MID(data)  (((const uint8_t *)(data))[2]<<8 | ((const uint8_t *)(data))[3])
+
+int coap_option_iterator_init(coap_option_iterator_t *it, const uint8_t *data, uint16_t data_len);
+unsigned int coap_option_next(coap_option_iterator_t *it); /* Returns the number of the next option or 0 at the end. */
+int coap_option_find(coap_option_iterator_t *it, unsigned int number); /* Advances to the next instance of the option. */
+uint32_t coap_option_get_int(const coap_option_iterator_t *it);
+int coap_option_match(coap_option_iterator_t *it, unsigned int number, const char *str, size_t len, char separator); /* Advances past the compared options. */
+int coap_option_get_payload(coap_option_iterator_t *it, const uint8_t **payload);
+
 int coap_get_query_variable(void *packet, const char *name, const char **output);
 int coap_get_post_variable(void *packet, const char *name, const char **output);
 
@@ -58,6 +58,95 @@ PROCESS_NAME(rest_manager_process);
 LIST(restful_services);
 LIST(restful_periodic_services);
 
+/*
+ * Resources are looked up in a hash table keyed by their URL. Resources that
+ * handle sub-resources match by prefix and are kept in a separate chain.
+ */
+static resource_t *resource_table[REST_RESOURCE_HASH_SIZE];
+static resource_t *sub_resources;
+
+/*-----------------------------------------------------------------------------------*/
+static resource_t **
+get_bucket(const char *url, size_t url_len)
+{
+  uint16_t hash = 0;
+
+  while (url_len-- > 0)
+  {
+    hash = (hash << 5) + hash + (uint8_t)*url++;
+  }
+
+  return &resource_table[hash & (REST_RESOURCE_HASH_SIZE - 1)];
+}
+
+static resource_t **
+get_chain(resource_t *resource)
+{
+  if (resource->flags & HAS_SUB_RESOURCES)
+  {
+    return &sub_resources;
+  }
+  return get_bucket(resource->url, strlen(resource->url));
+}
+
+/* Returns 1 if the resource was in the dispatch table. */
+static int
+dispatch_remove(resource_t *resource)
+{
+  resource_t **r;
+  int i;
+
+  for (r = &sub_resources; *r; r = &(*r)->hash_next)
+  {
+    if (*r == resource)
+    {
+      *r = resource->hash_next;
+      return 1;
+    }
+  }
+  for (i = 0; i < REST_RESOURCE_HASH_SIZE; ++i)
+  {
+    for (r = &resource_table[i]; *r; r = &(*r)->hash_next)
+    {
+      if (*r == resource)
+      {
+        *r = resource->hash_next;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void
+dispatch_add(resource_t *resource)
+{
+  resource_t **r;
+
+  dispatch_remove(resource);
+
+  for (r = get_chain(resource); *r; r = &(*r)->hash_next);
+  resource->hash_next = NULL;
+  *r = resource;
+}
+
+/* Returns the resource that was activated first. */
+static resource_t *
+first_activated(resource_t *a, resource_t *b)
+{
+  resource_t *resource;
+
+  for (resource = (resource_t*)list_head(restful_services); resource; resource = resource->next)
+  {
+    if (resource == a || resource == b)
+    {
+      break;
+    }
+  }
+  return resource;
+}
+/*-----------------------------------------------------------------------------------*/
+
 
 void
 rest_init_engine(void)
@@ -88,6 +177,7 @@ rest_activate_resource(resource_t* resource)
   }
 
   list_add(restful_services, resource);
+  dispatch_add(resource);
 }
 
 void
@@ -141,6 +231,40 @@ void
 rest_set_special_flags(resource_t* resource, rest_resource_flags_t flags)
 {
   resource->flags |= flags;
+
+  /* The resource may have to move to the sub-resource chain. */
+  if (dispatch_remove(resource))
+  {
+    dispatch_add(resource);
+  }
+}
+
+resource_t *
+rest_find_resource(const char *url, size_t url_len)
+{
+  resource_t *resource = NULL;
+  resource_t *found = NULL;
+  size_t len;
+
+  for (resource = *get_bucket(url, url_len); resource; resource = resource->hash_next)
+  {
+    if (strncmp(resource->url, url, url_len) == 0 && resource->url[url_len] == '\0')
+    {
+      found = resource;
+      break;
+    }
+  }
+
+  for (resource = sub_resources; resource; resource = resource->hash_next)
+  {
+    len = strlen(resource->url);
+    if (url_len >= len && strncmp(resource->url, url, len) == 0)
+    {
+      found = found ? first_activated(found, resource) : resource;
+    }
+  }
+
+  return found;
 }
 
 int
@@ -149,42 +273,39 @@ rest_invoke_restful_service(void* request, void* response, uint8_t *buffer, uint
   uint8_t found = 0;
   uint8_t allowed = 0;
 
-  PRINTF("rest_invoke_restful_service url /%.*s -->\n", url_len, url);
-
   resource_t* resource = NULL;
   const char *url = NULL;
+  int url_len = REST.get_url(request, &url);
 
-  for (resource = (resource_t*)list_head(restful_services); resource; resource = resource->next)
+  PRINTF("rest_invoke_restful_service url /%.*s -->\n", url_len, url);
+
+  /*if the web service handles that kind of requests and urls matches*/
+  resource = rest_find_resource(url, url_len);
+  if (resource)
   {
-    /*if the web service handles that kind of requests and urls matches*/
-    if ((REST.get_url(request, &url)==strlen(resource->url) || (REST.get_url(request, &url)>strlen(resource->url) && (resource->flags & HAS_SUB_RESOURCES)))
-        && strncmp(resource->url, url, strlen(resource->url)) == 0)
-    {
-      found = 1;
-      rest_resource_flags_t method = REST.get_method_type(request);
+    found = 1;
+    rest_resource_flags_t method = REST.get_method_type(request);
 
-      PRINTF("method %u, resource->flags %u\n", (uint16_t)method, resource->flags);
+    PRINTF("method %u, resource->flags %u\n", (uint16_t)method, resource->flags);
 
-      if (resource->flags & method)
+    if (resource->flags & method)
+    {
+      allowed = 1;
+
+      /*call pre handler if it exists*/
+      if (!resource->pre_handler || resource->pre_handler(resource, request, response))
       {
-        allowed = 1;
+        /* call handler function*/
+        resource->handler(request, response, buffer, buffer_size, offset);
 
-        /*call pre handler if it exists*/
-        if (!resource->pre_handler || resource->pre_handler(resource, request, response))
+        /*call post handler if it exists*/
+        if (resource->post_handler)
         {
-          /* call handler function*/
-          resource->handler(request, response, buffer, buffer_size, offset);
-
-          /*call post handler if it exists*/
-          if (resource->post_handler)
-          {
-            resource->post_handler(resource, request, response);
-          }
+          resource->post_handler(resource, request, response);
         }
-      } else {
-        REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
       }
-      break;
+    } else {
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
     }
   }
 
@@ -52,6 +52,14 @@
 #define REST_MAX_CHUNK_SIZE     128
 #endif
 
+/*
+ * The number of buckets in the table through which requests are dispatched to resources.
+ * Must be a power of two. Gateways exposing hundreds of resources may want to increase it.
+ */
+#ifndef REST_RESOURCE_HASH_SIZE
+#define REST_RESOURCE_HASH_SIZE 16
+#endif
+
 #ifndef MIN
 #define MIN(a, b) ((a) < (b)? (a) : (b))
 #endif /* MIN */
@@ -148,6 +156,7 @@ struct resource_s {
   restful_post_handler post_handler; /* to be called after handler, may perform finalizations (cleanup, etc) */
   void* user_data; /* pointer to user specific data */
   unsigned int benchmark; /* to benchmark resource handler, used for separate response */
+  struct resource_s *hash_next; /* for the dispatch table, points to next resource with the same hash */
 };
 typedef struct resource_s resource_t;
 
@@ -312,6 +321,12 @@ void rest_activate_event_resource(resource_t* resource);
  */
 int rest_invoke_restful_service(void* request, void* response, uint8_t *buffer, uint16_t buffer_size, int32_t *offset);
 
+/*
+ * Returns the activated resource that handles the given URI path, or NULL if there is none.
+ * Sub-resources are matched by prefix; if several resources match, the one activated first wins.
+ */
+resource_t *rest_find_resource(const char *url, size_t url_len);
+
 /*
  * Returns the resource list
  */
@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+#include "jsonstream.h"
+#include <limits.h>
+#include <stddef.h>
+
+/* parser states */
+#define STATE_VALUE        0 /* expecting a value */
+#define STATE_ARRAY_FIRST  1 /* after '[': a value or ']' */
+#define STATE_OBJECT_FIRST 2 /* after '{': a name or '}' */
+#define STATE_NAME         3 /* after ',' in an object */
+#define STATE_COLON        4
+#define STATE_NEXT         5 /* after a value: ',' or the end of the container */
+#define STATE_STRING       6
+#define STATE_NUMBER       7
+#define STATE_LITERAL      8
+#define STATE_DONE         9
+
+/* number substates */
+#define NUMBER_SIGN       0 /* after '-' */
+#define NUMBER_INT        1
+#define NUMBER_FRAC_FIRST 2 /* after '.' */
+#define NUMBER_FRAC       3
+#define NUMBER_EXP_SIGN   4 /* after 'e' */
+#define NUMBER_EXP_FIRST  5 /* after the sign of the exponent */
+#define NUMBER_EXP        6
+
+#define FLAG_NAME         0x01
+#define FLAG_ESCAPE       0x02
+#define FLAG_PARTIAL      0x04
+#define FLAG_NEGATIVE     0x08
+#define FLAG_EXP_NEGATIVE 0x10
+
+static const char *const literals[] = { "true", "false", "null" };
+
+/*--------------------------------------------------------------------*/
+static int
+push(struct jsonstream_state *state, int object)
+{
+  if(state->depth >= JSONSTREAM_MAX_DEPTH) {
+    state->error = JSON_ERROR_TOO_DEEP;
+    return 0;
+  }
+  if(object) {
+    state->stack[state->depth >> 3] |= 1 << (state->depth & 7);
+  } else {
+    state->stack[state->depth >> 3] &= ~(1 << (state->depth & 7));
+  }
+  state->depth++;
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+static int
+in_object(struct jsonstream_state *state)
+{
+  return state->depth > 0 &&
+    (state->stack[(state->depth - 1) >> 3] & (1 << ((state->depth - 1) & 7)));
+}
+/*--------------------------------------------------------------------*/
+static void
+end_value(struct jsonstream_state *state)
+{
+  state->state = state->depth == 0 ? STATE_DONE : STATE_NEXT;
+}
+/*--------------------------------------------------------------------*/
+static void
+end_number(struct jsonstream_state *state, const char *value, int len)
+{
+  if(state->flags & FLAG_EXP_NEGATIVE) {
+    state->exponent -= state->exponent_value;
+  } else {
+    state->exponent += state->exponent_value;
+  }
+  if(state->flags & FLAG_NEGATIVE) {
+    state->mantissa = -state->mantissa;
+  }
+  state->callback(state, JSON_TYPE_NUMBER, value, len);
+  end_value(state);
+}
+/*--------------------------------------------------------------------*/
+void
+jsonstream_init(struct jsonstream_state *state,
+                jsonstream_callback_t callback, void *ptr)
+{
+  state->callback = callback;
+  state->ptr = ptr;
+  state->mantissa = 0;
+  state->exponent = 0;
+  state->depth = 0;
+  state->state = STATE_VALUE;
+  state->flags = 0;
+  state->error = JSON_ERROR_OK;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_feed(struct jsonstream_state *state, const char *data, int len)
+{
+  const char *p = data;
+  const char *end = data + len;
+  const char *start;
+  char c;
+
+  if(state->error != JSON_ERROR_OK) {
+    return state->error;
+  }
+
+  /* A string that started in an earlier chunk continues at the start
+     of this one; a number that did has no value to pass. */
+  start = state->state == STATE_STRING ? data : NULL;
+
+  while(p < end) {
+    c = *p;
+
+    switch(state->state) {
+    case STATE_STRING:
+      while(p < end) {
+        if(state->flags & FLAG_ESCAPE) {
+          state->flags &= ~FLAG_ESCAPE;
+        } else if(*p == '\\') {
+          state->flags |= FLAG_ESCAPE;
+        } else if(*p == '"') {
+          break;
+        }
+        p++;
+      }
+      if(p == end) {
+        if(p > start) {
+          state->flags |= FLAG_PARTIAL;
+          state->callback(state, (state->flags & FLAG_NAME) ?
+                          JSON_TYPE_PAIR_NAME : JSON_TYPE_STRING,
+                          start, p - start);
+        }
+        return JSON_ERROR_OK;
+      }
+      state->flags &= ~FLAG_PARTIAL;
+      if(state->flags & FLAG_NAME) {
+        state->callback(state, JSON_TYPE_PAIR_NAME, start, p - start);
+        state->state = STATE_COLON;
+      } else {
+        state->callback(state, JSON_TYPE_STRING, start, p - start);
+        end_value(state);
+      }
+      p++;
+      continue;
+
+    case STATE_NUMBER:
+      for(; p < end; p++) {
+        c = *p;
+        if(c >= '0' && c <= '9') {
+          switch(state->substate) {
+          case NUMBER_SIGN:
+          case NUMBER_INT:
+            if(state->mantissa <= (LONG_MAX - 9) / 10) {
+              state->mantissa = state->mantissa * 10 + (c - '0');
+            } else {
+              /* keep the magnitude of numbers that do not fit */
+              state->exponent++;
+            }
+            state->substate = NUMBER_INT;
+            break;
+          case NUMBER_FRAC_FIRST:
+          case NUMBER_FRAC:
+            if(state->mantissa <= (LONG_MAX - 9) / 10) {
+              state->mantissa = state->mantissa * 10 + (c - '0');
+              state->exponent--;
+            }
+            state->substate = NUMBER_FRAC;
+            break;
+          default:
+            if(state->exponent_value < 10000) {
+              state->exponent_value = state->exponent_value * 10 + (c - '0');
+            }
+            state->substate = NUMBER_EXP;
+          }
+        } else if(c == '.' && state->substate == NUMBER_INT) {
+          state->substate = NUMBER_FRAC_FIRST;
+        } else if((c == 'e' || c == 'E') &&
+                  (state->substate == NUMBER_INT || state->substate == NUMBER_FRAC)) {
+          state->substate = NUMBER_EXP_SIGN;
+        } else if((c == '-' || c == '+') && state->substate == NUMBER_EXP_SIGN) {
+          if(c == '-') {
+            state->flags |= FLAG_EXP_NEGATIVE;
+          }
+          state->substate = NUMBER_EXP_FIRST;
+        } else {
+          break;
+        }
+      }
+      if(p == end) {
+        return JSON_ERROR_OK;
+      }
+      if(state->substate != NUMBER_INT && state->substate != NUMBER_FRAC &&
+         state->substate != NUMBER_EXP) {
+        state->error = JSON_ERROR_SYNTAX;
+        return state->error;
+      }
+      end_number(state, start, start == NULL ? 0 : p - start);
+      /* the character after the number is handled by the next state */
+      continue;
+
+    case STATE_LITERAL:
+      if(c != literals[(int)state->flags][(int)state->substate]) {
+        state->error = JSON_ERROR_SYNTAX;
+        return state->error;
+      }
+      p++;
+      if(literals[(int)state->flags][(int)++state->substate] == '\0') {
+        state->callback(state, literals[(int)state->flags][0], NULL, 0);
+        state->flags = 0;
+        end_value(state);
+      }
+      continue;
+    }
+
+    /* whitespace between tokens */
+    if(c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      p++;
+      continue;
+    }
+
+    switch(state->state) {
+    case STATE_VALUE:
+    case STATE_ARRAY_FIRST:
+      if(c == '{') {
+        if(!push(state, 1)) {
+          return state->error;
+        }
+        state->callback(state, JSON_TYPE_OBJECT, NULL, 0);
+        state->state = STATE_OBJECT_FIRST;
+      } else if(c == '[') {
+        if(!push(state, 0)) {
+          return state->error;
+        }
+        state->callback(state, JSON_TYPE_ARRAY, NULL, 0);
+        state->state = STATE_ARRAY_FIRST;
+      } else if(c == '"') {
+        state->flags = 0;
+        state->state = STATE_STRING;
+        start = p + 1;
+      } else if(c == '-' || (c >= '0' && c <= '9')) {
+        state->mantissa = 0;
+        state->exponent = 0;
+        state->exponent_value = 0;
+        state->flags = c == '-' ? FLAG_NEGATIVE : 0;
+        state->substate = NUMBER_SIGN;
+        state->state = STATE_NUMBER;
+        start = p;
+        if(c == '-') {
+          p++;
+        }
+        continue;
+      } else if(c == 't' || c == 'f' || c == 'n') {
+        /* the literal index is kept in the flags */
+        state->flags = c == 't' ? 0 : c == 'f' ? 1 : 2;
+        state->substate = 0;
+        state->state = STATE_LITERAL;
+        continue;
+      } else if(c == ']' && state->state == STATE_ARRAY_FIRST) {
+        state->depth--;
+        state->callback(state, ']', NULL, 0);
+        end_value(state);
+      } else {
+        state->error = JSON_ERROR_SYNTAX;
+        return state->error;
+      }
+      break;
+
+    case STATE_OBJECT_FIRST:
+    case STATE_NAME:
+      if(c == '"') {
+        state->flags = FLAG_NAME;
+        state->state = STATE_STRING;
+        start = p + 1;
+      } else if(c == '}' && state->state == STATE_OBJECT_FIRST) {
+        state->depth--;
+        state->callback(state, '}', NULL, 0);
+        end_value(state);
+      } else {
+        state->error = JSON_ERROR_UNEXPECTED_STRING;
+        return state->error;
+      }
+      break;
+
+    case STATE_COLON:
+      if(c != ':') {
+        state->error = JSON_ERROR_SYNTAX;
+        return state->error;
+      }
+      state->state = STATE_VALUE;
+      break;
+
+    case STATE_NEXT:
+      if(c == ',') {
+        state->state = in_object(state) ? STATE_NAME : STATE_VALUE;
+      } else if(c == '}' && in_object(state)) {
+        state->depth--;
+        state->callback(state, '}', NULL, 0);
+        end_value(state);
+      } else if(c == ']' && !in_object(state)) {
+        state->depth--;
+        state->callback(state, ']', NULL, 0);
+        end_value(state);
+      } else {
+        state->error = c == ']' ? JSON_ERROR_UNEXPECTED_END_OF_ARRAY :
+          JSON_ERROR_SYNTAX;
+        return state->error;
+      }
+      break;
+
+    default:
+      /* only whitespace may follow the value */
+      state->error = JSON_ERROR_SYNTAX;
+      return state->error;
+    }
+    p++;
+  }
+  return JSON_ERROR_OK;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_finish(struct jsonstream_state *state)
+{
+  if(state->error == JSON_ERROR_OK && state->state == STATE_NUMBER) {
+    /* a number at the top level ends with the input */
+    if(state->substate == NUMBER_INT || state->substate == NUMBER_FRAC ||
+       state->substate == NUMBER_EXP) {
+      end_number(state, NULL, 0);
+    }
+  }
+  if(state->error == JSON_ERROR_OK && state->state != STATE_DONE) {
+    state->error = JSON_ERROR_INCOMPLETE;
+  }
+  return state->error;
+}
+/*--------------------------------------------------------------------*/
+long
+jsonstream_get_value_as_long(struct jsonstream_state *state)
+{
+  long value = state->mantissa;
+  int exponent = state->exponent;
+
+  for(; exponent > 0 && value != 0; exponent--) {
+    if(value > LONG_MAX / 10 || value < LONG_MIN / 10) {
+      return value > 0 ? LONG_MAX : LONG_MIN;
+    }
+    value *= 10;
+  }
+  for(; exponent < 0 && value != 0; exponent++) {
+    value /= 10;
+  }
+  return value;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_value_as_int(struct jsonstream_state *state)
+{
+  return (int)jsonstream_get_value_as_long(state);
+}
+/*--------------------------------------------------------------------*/
+long
+jsonstream_get_mantissa(struct jsonstream_state *state)
+{
+  return state->mantissa;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_exponent(struct jsonstream_state *state)
+{
+  return state->exponent;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_is_partial(struct jsonstream_state *state)
+{
+  return (state->flags & FLAG_PARTIAL) != 0;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_depth(struct jsonstream_state *state)
+{
+  return state->depth;
+}
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         A streaming JSON parser that accepts its input in chunks
+ *         and calls back for each element
+ */
+
+#ifndef __JSONSTREAM_H__
+#define __JSONSTREAM_H__
+
+#include "contiki-conf.h"
+#include "json.h"
+
+#ifdef JSONSTREAM_CONF_MAX_DEPTH
+#define JSONSTREAM_MAX_DEPTH JSONSTREAM_CONF_MAX_DEPTH
+#else
+#define JSONSTREAM_MAX_DEPTH 16
+#endif
+
+struct jsonstream_state;
+
+/**
+ * \brief      Callback for each JSON element
+ * \param state The parser state
+ * \param type  JSON_TYPE_OBJECT, '}', JSON_TYPE_ARRAY, ']',
+ *              JSON_TYPE_PAIR_NAME, JSON_TYPE_STRING, JSON_TYPE_NUMBER,
+ *              JSON_TYPE_TRUE, JSON_TYPE_FALSE, or JSON_TYPE_NULL
+ * \param value Points into the input chunk for names, strings, and numbers
+ * \param len   The length of the value
+ *
+ *             Names and strings are passed without the quotes and
+ *             with their escape sequences. A name or string that
+ *             continues in the next chunk is passed in parts, and
+ *             jsonstream_is_partial() is true for all but the last
+ *             part. A number that spans chunks is passed with a
+ *             NULL value; its value is always available through
+ *             jsonstream_get_value_as_long() and friends.
+ */
+typedef void (* jsonstream_callback_t)(struct jsonstream_state *state,
+                                       int type, const char *value, int len);
+
+struct jsonstream_state {
+  jsonstream_callback_t callback;
+  void *ptr;
+  /* numbers are mantissa * 10^exponent */
+  long mantissa;
+  int exponent;
+  int exponent_value;
+  int depth;
+  char state;
+  char substate;
+  char flags;
+  char error;
+  unsigned char stack[(JSONSTREAM_MAX_DEPTH + 7) / 8];
+};
+
+/**
+ * \brief      Initialize a streaming JSON parser state.
+ * \param state A pointer to a JSON parser state
+ * \param callback The function to call for each JSON element
+ * \param ptr  A pointer for the application, kept in state->ptr
+ */
+void jsonstream_init(struct jsonstream_state *state,
+                     jsonstream_callback_t callback, void *ptr);
+
+/**
+ * \brief      Parse the next chunk of the input.
+ * \param state A pointer to a JSON parser state
+ * \param data The chunk
+ * \param len  The length of the chunk
+ * \return     JSON_ERROR_OK or the error found so far
+ *
+ *             The chunk is not needed after the function returns.
+ */
+int jsonstream_feed(struct jsonstream_state *state, const char *data, int len);
+
+/**
+ * \brief      Signal the end of the input.
+ * \param state A pointer to a JSON parser state
+ * \return     JSON_ERROR_OK if the input was one complete JSON value
+ */
+int jsonstream_finish(struct jsonstream_state *state);
+
+/* get the current number parsed as an int, fractions are truncated */
+int jsonstream_get_value_as_int(struct jsonstream_state *state);
+
+/* get the current number parsed as a long, fractions are truncated */
+long jsonstream_get_value_as_long(struct jsonstream_state *state);
+
+/* get the current number as mantissa * 10^exponent, e.g., 21.5 as 215 and -1 */
+long jsonstream_get_mantissa(struct jsonstream_state *state);
+int jsonstream_get_exponent(struct jsonstream_state *state);
+
+/* true if the current name or string continues in the next chunk */
+int jsonstream_is_partial(struct jsonstream_state *state);
+
+/* get the number of enclosing objects and arrays */
+int jsonstream_get_depth(struct jsonstream_state *state);
+
+#endif /* __JSONSTREAM_H__ */
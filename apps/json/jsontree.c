@@ -50,54 +50,109 @@
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static void
+write_text(const struct jsontree_context *js_ctx, const char *text, int len)
+{
+  /* The output buffer is not part of the tree walk and is updated
+     also through a const context */
+  struct jsontree_context *ctx = (struct jsontree_context *)js_ctx;
+  int n;
+
+  if(ctx->buf == NULL) {
+    while(len-- > 0) {
+      ctx->putchar(*text++);
+    }
+    return;
+  }
+
+  /* Skip what was output by an earlier call of jsontree_print_buffer() */
+  if(ctx->skip >= len) {
+    ctx->skip -= len;
+    return;
+  }
+  text += ctx->skip;
+  len -= ctx->skip;
+  ctx->skip = 0;
+
+  n = ctx->buf_size - ctx->buf_pos;
+  if(n > len) {
+    n = len;
+  }
+  ctx->step_pos += n;
+  len -= n;
+  /* Most writes are a few bytes, which are faster to copy here */
+  while(n-- > 0) {
+    ctx->buf[ctx->buf_pos++] = *text++;
+  }
+
+  if(len > 0) {
+    /* Keep the rest of the step for the next buffer, so that a
+       callback is not asked again for a value that may have changed */
+    n = JSONTREE_PENDING_SIZE - ctx->pending_len;
+    if(n < len) {
+      ctx->buf_state |= JSONTREE_BUF_FULL;
+    } else {
+      n = len;
+    }
+    memcpy(&ctx->pending[ctx->pending_len], text, n);
+    ctx->pending_len += n;
+    ctx->step_pos += n;
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_atom(const struct jsontree_context *js_ctx, const char *text)
 {
   if(text == NULL) {
-    js_ctx->putchar('0');
+    write_text(js_ctx, "0", 1);
   } else {
-    while(*text != '\0') {
-      js_ctx->putchar(*text++);
-    }
+    write_text(js_ctx, text, strlen(text));
   }
 }
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_string(const struct jsontree_context *js_ctx, const char *text)
 {
-  js_ctx->putchar('"');
+  const char *end;
+
+  write_text(js_ctx, "\"", 1);
   if(text != NULL) {
-    while(*text != '\0') {
-      if(*text == '"') {
-        js_ctx->putchar('\\');
+    /* Write the text in runs between the quotes to escape */
+    for(;;) {
+      for(end = text; *end != '\0' && *end != '"'; end++);
+      write_text(js_ctx, text, end - text);
+      if(*end == '\0') {
+        break;
       }
-      js_ctx->putchar(*text++);
+      write_text(js_ctx, "\\\"", 2);
+      text = end + 1;
     }
   }
-  js_ctx->putchar('"');
+  write_text(js_ctx, "\"", 1);
 }
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_int(const struct jsontree_context *js_ctx, int value)
 {
-  char buf[10];
+  char buf[11];
   int l;
 
+  l = sizeof(buf);
   if(value < 0) {
-    js_ctx->putchar('-');
-    value = -value;
+    do {
+      buf[--l] = '0' - (value % 10);
+      value /= 10;
+    } while(value < 0);
+    buf[--l] = '-';
+  } else {
+    do {
+      buf[--l] = '0' + (value % 10);
+      value /= 10;
+    } while(value > 0);
   }
 
-  l = sizeof(buf) - 1;
-  do {
-    buf[l--] = '0' + (value % 10);
-    value /= 10;
-  } while(value > 0 && l >= 0);
-
-  while(++l < sizeof(buf)) {
-    js_ctx->putchar(buf[l]);
-  }
+  write_text(js_ctx, &buf[l], sizeof(buf) - l);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -115,6 +170,11 @@ jsontree_reset(struct jsontree_context *js_ctx)
 {
   js_ctx->depth = 0;
   js_ctx->index[0] = 0;
+  js_ctx->buf = NULL;
+  js_ctx->buf_state = 0;
+  js_ctx->step_pos = 0;
+  js_ctx->pending_len = 0;
+  js_ctx->pending_pos = 0;
 }
 /*---------------------------------------------------------------------------*/
 const char *
@@ -144,24 +204,21 @@ jsontree_print_next(struct jsontree_context *js_ctx)
 
     index = js_ctx->index[js_ctx->depth];
     if(index == 0) {
-      js_ctx->putchar(v->type);
-      js_ctx->putchar('\n');
+      write_text(js_ctx, v->type == JSON_TYPE_OBJECT ? "{\n" : "[\n", 2);
     }
     if(index >= o->count) {
-      js_ctx->putchar('\n');
-      js_ctx->putchar(v->type + 2);
+      write_text(js_ctx, v->type == JSON_TYPE_OBJECT ? "\n}" : "\n]", 2);
       /* Default operation: back up one level! */
       break;
     }
 
     if(index > 0) {
-      js_ctx->putchar(',');
-      js_ctx->putchar('\n');
+      write_text(js_ctx, ",\n", 2);
     }
     if(v->type == JSON_TYPE_OBJECT) {
       jsontree_write_string(js_ctx,
                             ((struct jsontree_object *)o)->pairs[index].name);
-      js_ctx->putchar(':');
+      write_text(js_ctx, ":", 1);
       ov = ((struct jsontree_object *)o)->pairs[index].value;
     } else {
       ov = o->values[index];
@@ -212,6 +269,66 @@ jsontree_print_next(struct jsontree_context *js_ctx)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+int
+jsontree_print_buffer(struct jsontree_context *js_ctx, char *buf, int size)
+{
+  uint8_t depth;
+  uint16_t index;
+  uint16_t parent_index;
+  int callback_state;
+  int more;
+  int n;
+
+  js_ctx->buf = buf;
+  js_ctx->buf_size = size;
+
+  /* Output the rest of the step that did not fit in the last buffer */
+  n = js_ctx->pending_len - js_ctx->pending_pos;
+  if(n > size) {
+    n = size;
+  }
+  memcpy(buf, &js_ctx->pending[js_ctx->pending_pos], n);
+  js_ctx->buf_pos = n;
+  js_ctx->pending_pos += n;
+  if(js_ctx->pending_pos == js_ctx->pending_len) {
+    js_ctx->pending_pos = js_ctx->pending_len = 0;
+  }
+
+  while(js_ctx->buf_pos < js_ctx->buf_size &&
+        !(js_ctx->buf_state & JSONTREE_BUF_DONE)) {
+    /* Remember where the step starts in case it does not fit */
+    depth = js_ctx->depth;
+    index = js_ctx->index[depth];
+    parent_index = depth > 0 ? js_ctx->index[depth - 1] : 0;
+    callback_state = js_ctx->callback_state;
+
+    js_ctx->skip = js_ctx->step_pos;
+    more = jsontree_print_next(js_ctx);
+
+    if(js_ctx->buf_state & JSONTREE_BUF_FULL) {
+      /* The step is larger than the buffer and the pending bytes
+         together: output it again in the next call, after the
+         pending bytes, and skip what has been output */
+      PRINTF("jsontree: step resumes at %u\n", js_ctx->step_pos);
+      js_ctx->buf_state &= ~JSONTREE_BUF_FULL;
+      js_ctx->depth = depth;
+      js_ctx->index[depth] = index;
+      if(depth > 0) {
+        js_ctx->index[depth - 1] = parent_index;
+      }
+      js_ctx->callback_state = callback_state;
+      break;
+    }
+    js_ctx->step_pos = 0;
+    if(!more || js_ctx->path > js_ctx->depth) {
+      js_ctx->buf_state |= JSONTREE_BUF_DONE;
+    }
+  }
+
+  js_ctx->buf = NULL;
+  return js_ctx->buf_pos;
+}
+/*---------------------------------------------------------------------------*/
 static struct jsontree_value *
 find_next(struct jsontree_context *js_ctx)
 {
@@ -49,6 +49,13 @@
 #define JSONTREE_MAX_DEPTH 10
 #endif /* JSONTREE_CONF_MAX_DEPTH */
 
+/* Room for the part of a step that does not fit in the output buffer */
+#ifdef JSONTREE_CONF_PENDING_SIZE
+#define JSONTREE_PENDING_SIZE JSONTREE_CONF_PENDING_SIZE
+#else
+#define JSONTREE_PENDING_SIZE 32
+#endif /* JSONTREE_CONF_PENDING_SIZE */
+
 struct jsontree_context {
   struct jsontree_value *values[JSONTREE_MAX_DEPTH];
   uint16_t index[JSONTREE_MAX_DEPTH];
@@ -56,8 +63,21 @@ struct jsontree_context {
   uint8_t depth;
   uint8_t path;
   int callback_state;
+  /* output buffer of jsontree_print_buffer() */
+  char *buf;
+  uint16_t buf_size;
+  uint16_t buf_pos;
+  uint16_t step_pos;
+  uint16_t skip;
+  uint8_t buf_state;
+  uint8_t pending_len;
+  uint8_t pending_pos;
+  char pending[JSONTREE_PENDING_SIZE];
 };
 
+#define JSONTREE_BUF_FULL 0x01
+#define JSONTREE_BUF_DONE 0x02
+
 struct jsontree_value {
   uint8_t type;
   /* followed by a value */
@@ -129,6 +149,20 @@ void jsontree_write_atom(const struct jsontree_context *js_ctx,
 void jsontree_write_string(const struct jsontree_context *js_ctx,
                            const char *text);
 int jsontree_print_next(struct jsontree_context *js_ctx);
+
+/*
+ * Print the JSON into a buffer instead of through putchar, e.g., one
+ * TCP segment or CoAP block at a time. Returns the number of bytes
+ * written, which is less than size only when the output is complete.
+ * The tree is not walked again for the next buffer. The part of a
+ * value that does not fit is kept in the context, up to
+ * JSONTREE_PENDING_SIZE bytes, and output first in the next call.
+ * Only a longer value is output again, skipping the bytes already
+ * written, so its callback must then write the same text for the
+ * same callback_state.
+ */
+int jsontree_print_buffer(struct jsontree_context *js_ctx,
+                          char *buf, int size);
 struct jsontree_value *jsontree_find_next(struct jsontree_context *js_ctx,
                                           int type);
 
@@ -300,10 +300,10 @@ generate_file_stats(void *arg)
   if (tmp[0]=='.') { 
 #if WEBSERVER_CONF_LOADTIME
     s->pagetime = clock_time() - s->pagetime;
-    numprinted=httpd_snprintf((char *)uip_appdata, uip_mss(), httpd_cgi_filestat1, httpd_fs_open(s->filename, 0), 
+    numprinted=httpd_snprintf((char *)uip_appdata, uip_mss(), httpd_cgi_filestat1, httpd_fs_open(s->request[0].filename, 0), 
             (unsigned int)s->pagetime/CLOCK_SECOND,(100*((unsigned int)s->pagetime%CLOCK_SECOND))/CLOCK_SECOND);
 #else
-    numprinted=httpd_snprintf((char *)uip_appdata, uip_mss(), httpd_cgi_filestat1, httpd_fs_open(s->filename, 0));
+    numprinted=httpd_snprintf((char *)uip_appdata, uip_mss(), httpd_cgi_filestat1, httpd_fs_open(s->request[0].filename, 0));
 #endif
 
   /* Count for all files */
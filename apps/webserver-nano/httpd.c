@@ -60,6 +60,11 @@
 
 #define STATE_WAITING 0
 #define STATE_OUTPUT  1
+#define STATE_IDLE    2 /* Between the requests of a persistent connection */
+#define STATE_CLOSED  3
+
+/* The request being read */
+#define REQUEST(s) (&(s)->request[(s)->requests])
 /* Allocate memory for the tcp connections */
 MEMB(conns, struct httpd_state, WEBSERVER_CONF_CONNS);
 
@@ -73,6 +78,8 @@ MEMB(conns, struct httpd_state, WEBSERVER_CONF_CONNS);
 #define ISO_slash   0x2f
 #define ISO_colon   0x3a
 #define ISO_qmark   0x3f
+#define ISO_c       0x63
+#define ISO_k       0x6b
 
 
 /*---------------------------------------------------------------------------*/
@@ -241,30 +248,26 @@ PT_THREAD(handle_script(struct httpd_state *s))
 }
 #endif /* WEBSERVER_CONF_INCLUDE || WEBSERVER_CONF_CGI */
 /*---------------------------------------------------------------------------*/
-const char httpd_http[]     HTTPD_STRING_ATTR = "HTTP/1.0 ";
-const char httpd_server[]   HTTPD_STRING_ATTR = "\r\nServer: Contiki/2.0 http://www.sics.se/contiki/\r\nConnection: close\r\n";
+const char httpd_http[]     HTTPD_STRING_ATTR = "HTTP/1.1 ";
+const char httpd_server[]   HTTPD_STRING_ATTR = "\r\nServer: Contiki/2.0 http://www.sics.se/contiki/\r\nConnection: ";
+const char httpd_close[]    HTTPD_STRING_ATTR = "close\r\n";
+const char httpd_keepalive[] HTTPD_STRING_ATTR = "keep-alive\r\n";
+const char httpd_404notf [] HTTPD_STRING_ATTR = "404 Not found";
+const char httpd_200ok   [] HTTPD_STRING_ATTR = "200 OK";
 static unsigned short
-generate_status(void *sstr)
+generate_status(void *state)
 {
-  uint8_t slen=httpd_strlen((char *)sstr);
+  struct httpd_state *s = (struct httpd_state *)state;
+  const char *sstr = s->request[0].flags & HTTPD_FLAG_NOT_FOUND ? httpd_404notf : httpd_200ok;
+  const char *cstr = s->request[0].flags & HTTPD_FLAG_KEEP_ALIVE ? httpd_keepalive : httpd_close;
+  uint8_t slen=httpd_strlen(sstr);
   httpd_memcpy(uip_appdata, httpd_http, sizeof(httpd_http)-1);
   httpd_memcpy(uip_appdata+sizeof(httpd_http)-1, (char *)sstr, slen);
   slen+=sizeof(httpd_http)-1;
   httpd_memcpy(uip_appdata+slen, httpd_server, sizeof(httpd_server)-1);
-  return slen+sizeof(httpd_server)-1;
-}
-/*---------------------------------------------------------------------------*/
-const char httpd_content[]  HTTPD_STRING_ATTR = "Content-type: ";
-const char httpd_crlf[]     HTTPD_STRING_ATTR = "\r\n\r\n";
-static unsigned short
-generate_header(void *hstr)
-{
-  uint8_t slen=httpd_strlen((char *)hstr);
-  httpd_memcpy(uip_appdata,httpd_content,sizeof(httpd_content)-1); 
-  httpd_memcpy(uip_appdata+sizeof(httpd_content)-1, (char *)hstr, slen);
-  slen+=sizeof(httpd_content)-1;
-  httpd_memcpy(uip_appdata+slen,httpd_crlf,sizeof(httpd_crlf)-1);
-  return slen+4;
+  slen+=sizeof(httpd_server)-1;
+  httpd_memcpy(uip_appdata+slen, (char *)cstr, httpd_strlen(cstr));
+  return slen+httpd_strlen(cstr);
 }
 /*---------------------------------------------------------------------------*/
 const char httpd_mime_htm[] HTTPD_STRING_ATTR = "text/html";
@@ -291,53 +294,80 @@ const char httpd_mime_bin[] HTTPD_STRING_ATTR = "application/octet-stream";
 const char httpd_shtml   [] HTTPD_STRING_ATTR = ".shtml";
 #endif
 
-static
-PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
+static const char *
+get_mime_type(struct httpd_state *s)
 {
   char *ptr;
-  PSOCK_BEGIN(&s->sout);
 
-  PSOCK_GENERATOR_SEND(&s->sout, generate_status, (char *)statushdr);
-
-  ptr = strrchr(s->filename, ISO_period);
-  if (httpd_strncmp("4", statushdr, 1)==0) {  //404
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_htm  );
+  ptr = strrchr(s->request[0].filename, ISO_period);
+  if (s->request[0].flags & HTTPD_FLAG_NOT_FOUND) {
+    return httpd_mime_htm;
   } else if(ptr == NULL) {
 #if WEBSERVER_CONF_BIN
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_bin );
+    return httpd_mime_bin;
 #else
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_htm  );
+    return httpd_mime_htm;
 #endif 
-  } else {
-    ptr++;
+  }
+  ptr++;
 #if WEBSERVER_CONF_INCLUDE || WEBSERVER_CONF_CGI
-    if(httpd_strncmp(ptr, &httpd_mime_htm[5],3)== 0 ||httpd_strncmp(ptr, &httpd_shtml[1], 4) == 0) {
+  if(httpd_strncmp(ptr, &httpd_mime_htm[5],3)== 0 ||httpd_strncmp(ptr, &httpd_shtml[1], 4) == 0) {
 #else
-    if(httpd_strncmp(ptr, &httpd_mime_htm[5],3)== 0) {
+  if(httpd_strncmp(ptr, &httpd_mime_htm[5],3)== 0) {
 #endif
-	PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_htm );
+    return httpd_mime_htm;
 #if WEBSEVER_CONF_CSS
-    } else if(httpd_strcmp(ptr, &httpd_mime_css[5]) == 0) {
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_css );
+  } else if(httpd_strcmp(ptr, &httpd_mime_css[5]) == 0) {
+    return httpd_mime_css;
 #endif
 #if WEBSERVER_CONF_PNG
-    } else if(httpd_strcmp(ptr, &httpd_mime_png[6]) == 0) {
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_png );
+  } else if(httpd_strcmp(ptr, &httpd_mime_png[6]) == 0) {
+    return httpd_mime_png;
 #endif
 #if WEBSERVER_CONF_GIF
-    } else if(httpd_strcmp(ptr, &httpd_mime_gif[6])== 0) {
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_gif );
+  } else if(httpd_strcmp(ptr, &httpd_mime_gif[6])== 0) {
+    return httpd_mime_gif;
 #endif
 #if WEBSERVER_CONF_JPG
-    } else if(httpd_strcmp(ptr, httpd_mime_jpg) == 0) {
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_jpg );
+  } else if(httpd_strcmp(ptr, httpd_mime_jpg) == 0) {
+    return httpd_mime_jpg;
 #endif
 #if WEBSERVER_CONF_TXT
-    } else {
-      PSOCK_GENERATOR_SEND(&s->sout, generate_header, &httpd_mime_txt);
+  } else {
+    return httpd_mime_txt;
 #endif
-    }
   }
+  return httpd_mime_htm;
+}
+/*---------------------------------------------------------------------------*/
+const char httpd_content[]  HTTPD_STRING_ATTR = "Content-type: ";
+const char httpd_length[]   HTTPD_STRING_ATTR = "\r\nContent-Length: %u";
+const char httpd_crlf[]     HTTPD_STRING_ATTR = "\r\n\r\n";
+static unsigned short
+generate_header(void *state)
+{
+  struct httpd_state *s = (struct httpd_state *)state;
+  const char *hstr = get_mime_type(s);
+  uint8_t slen=httpd_strlen(hstr);
+  httpd_memcpy(uip_appdata,httpd_content,sizeof(httpd_content)-1); 
+  httpd_memcpy(uip_appdata+sizeof(httpd_content)-1, (char *)hstr, slen);
+  slen+=sizeof(httpd_content)-1;
+  /* A persistent connection needs the length of the response */
+  if(s->request[0].flags & HTTPD_FLAG_KEEP_ALIVE) {
+    slen+=httpd_snprintf((char *)uip_appdata+slen, uip_mss()-slen, httpd_length, s->file.len);
+  }
+  httpd_memcpy(uip_appdata+slen,httpd_crlf,sizeof(httpd_crlf)-1);
+  return slen+4;
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(send_headers(struct httpd_state *s))
+{
+  PSOCK_BEGIN(&s->sout);
+
+  PSOCK_GENERATOR_SEND(&s->sout, generate_status, s);
+  PSOCK_GENERATOR_SEND(&s->sout, generate_header, s);
+
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
@@ -346,44 +376,59 @@ const char httpd_indexfn [] HTTPD_STRING_ATTR = "/index.html";
 const char httpd_indexsfn [] HTTPD_STRING_ATTR = "/index.shtml";
 #endif
 const char httpd_404fn   [] HTTPD_STRING_ATTR = "/404.html";
-const char httpd_404notf [] HTTPD_STRING_ATTR = "404 Not found";
-const char httpd_200ok   [] HTTPD_STRING_ATTR = "200 OK";
 static
 PT_THREAD(handle_output(struct httpd_state *s))
 {
-  char *ptr;
-  
   PT_BEGIN(&s->outputpt);
 #if DEBUGLOGIC
-   httpd_strcpy(s->filename,httpd_indexfn);
+   httpd_strcpy(s->request[0].filename,httpd_indexfn);
+   httpd_fs_open(s->request[0].filename, &s->file);
+   s->request[0].flags = HTTPD_FLAG_SCRIPT;
 #endif
-  if(!httpd_fs_open(s->filename, &s->file)) {
+  PT_WAIT_THREAD(&s->outputpt, send_headers(s));
 #if WEBSERVER_CONF_INCLUDE || WEBSERVER_CONF_CGI
-    /* If index.html not found try index.shtml */
-    if (httpd_strcmp(s->filename,httpd_indexfn)==0) httpd_strcpy(s->filename,httpd_indexsfn);
-	if (httpd_fs_open(s->filename, &s->file)) goto sendfile;
+  if(s->request[0].flags & HTTPD_FLAG_SCRIPT) {
+    PT_INIT(&s->scriptpt);
+    PT_WAIT_THREAD(&s->outputpt, handle_script(s));
+  } else
 #endif
-    httpd_strcpy(s->filename, httpd_404fn);
-    httpd_fs_open(s->filename, &s->file);
-    PT_WAIT_THREAD(&s->outputpt, send_headers(s, httpd_404notf));
+  {
     PT_WAIT_THREAD(&s->outputpt, send_file(s));
-  } else {
-sendfile:
-    PT_WAIT_THREAD(&s->outputpt, send_headers(s, httpd_200ok));
+  }
+  if(!(s->request[0].flags & HTTPD_FLAG_KEEP_ALIVE)) {
+    PSOCK_CLOSE(&s->sout);
+  }
+  PT_END(&s->outputpt);
+}
+/*---------------------------------------------------------------------------*/
+/* Opens the file of the request being read, or the 404 page */
+static void
+open_file(struct httpd_state *s)
+{
+  struct httpd_request *r = REQUEST(s);
 #if WEBSERVER_CONF_INCLUDE || WEBSERVER_CONF_CGI
-    ptr = strchr(s->filename, ISO_period);
-    if((ptr != NULL && httpd_strncmp(ptr, httpd_shtml, 6) == 0) || httpd_strcmp(s->filename,httpd_indexfn)==0) {
-      PT_INIT(&s->scriptpt);
-      PT_WAIT_THREAD(&s->outputpt, handle_script(s));
-    } else {
-#else
-    if (1)
+  char *ptr;
 #endif
-      PT_WAIT_THREAD(&s->outputpt, send_file(s));
-    }
+
+  if(!httpd_fs_open(r->filename, &r->file)) {
+#if WEBSERVER_CONF_INCLUDE || WEBSERVER_CONF_CGI
+    /* If index.html not found try index.shtml */
+    if (httpd_strcmp(r->filename,httpd_indexfn)==0) httpd_strcpy(r->filename,httpd_indexsfn);
+    if (httpd_fs_open(r->filename, &r->file)) goto found;
+#endif
+    httpd_strcpy(r->filename, httpd_404fn);
+    r->file.len = 0;
+    httpd_fs_open(r->filename, &r->file);
+    r->flags |= HTTPD_FLAG_NOT_FOUND;
+    return;
   }
-  PSOCK_CLOSE(&s->sout);
-  PT_END(&s->outputpt);
+#if WEBSERVER_CONF_INCLUDE || WEBSERVER_CONF_CGI
+found:
+  ptr = strchr(r->filename, ISO_period);
+  if((ptr != NULL && httpd_strncmp(ptr, httpd_shtml, 6) == 0) || httpd_strcmp(r->filename,httpd_indexfn)==0) {
+    r->flags |= HTTPD_FLAG_SCRIPT;
+  }
+#endif
 }
 /*---------------------------------------------------------------------------*/
 #if WEBSERVER_CONF_PASSQUERY
@@ -392,63 +437,109 @@ char httpd_query[WEBSERVER_CONF_PASSQUERY];
 
 const char httpd_get[] HTTPD_STRING_ATTR = "GET ";
 const char httpd_ref[] HTTPD_STRING_ATTR = "Referer:";
+const char httpd_11[]  HTTPD_STRING_ATTR = "HTTP/1.1";
+const char httpd_conn[] HTTPD_STRING_ATTR = "Connection: ";
 static
 PT_THREAD(handle_input(struct httpd_state *s))
 {
 
   PSOCK_BEGIN(&s->sin); 
 
-  PSOCK_READTO(&s->sin, ISO_space);
+  while(1) {
+    PSOCK_READTO(&s->sin, ISO_space);
 
-  if(httpd_strncmp(s->inputbuf, httpd_get, 4) != 0) {
-    PSOCK_CLOSE_EXIT(&s->sin);
-  }
-  PSOCK_READTO(&s->sin, ISO_space);
+    if(httpd_strncmp(s->inputbuf, httpd_get, 4) != 0) {
+      PSOCK_CLOSE_EXIT(&s->sin);
+    }
+    if(s->requests == WEBSERVER_CONF_PIPELINE + 1) {
+      /* No room for another request. Close after the ones that have been read, and the client sends the rest again */
+      s->request[WEBSERVER_CONF_PIPELINE].flags &= ~HTTPD_FLAG_KEEP_ALIVE;
+      PSOCK_WAIT_UNTIL(&s->sin, 0);
+    }
+    if(s->state == STATE_IDLE) {
+      s->state = STATE_WAITING;
+    }
+    REQUEST(s)->flags = HTTPD_FLAG_READING;
+    PSOCK_READTO(&s->sin, ISO_space);
 
-  if(s->inputbuf[0] != ISO_slash) {
-    PSOCK_CLOSE_EXIT(&s->sin);
-  }
+    if(s->inputbuf[0] != ISO_slash) {
+      PSOCK_CLOSE_EXIT(&s->sin);
+    }
 
-  if(s->inputbuf[1] == ISO_space) {
-    httpd_strcpy(s->filename, httpd_indexfn);
-  } else {
-    uint8_t i;
-    for (i=0;i<sizeof(s->filename)+1;i++) {
-      if (i >= (PSOCK_DATALEN(&s->sin)-1)) break;
-      if (s->inputbuf[i]==ISO_space) break;	
- #if WEBSERVER_CONF_PASSQUERY
-     /* Query string is left in the httpd_query buffer until zeroed by the application! */
-      if (s->inputbuf[i]==ISO_qmark) {
-         strncpy(httpd_query,&s->inputbuf[i+1],sizeof(httpd_query)); 
-         break;
-      }
+    if(s->inputbuf[1] == ISO_space) {
+      httpd_strcpy(REQUEST(s)->filename, httpd_indexfn);
+    } else {
+      uint8_t i;
+      for (i=0;i<sizeof(REQUEST(s)->filename)-1;i++) {
+        if (i >= (PSOCK_DATALEN(&s->sin)-1)) break;
+        if (s->inputbuf[i]==ISO_space) break;	
+#if WEBSERVER_CONF_PASSQUERY
+       /* Query string is left in the httpd_query buffer until zeroed by the application! */
+        if (s->inputbuf[i]==ISO_qmark) {
+           strncpy(httpd_query,&s->inputbuf[i+1],sizeof(httpd_query)); 
+           break;
+        }
 #endif
-      s->filename[i]=s->inputbuf[i];
+        REQUEST(s)->filename[i]=s->inputbuf[i];
+      }
+      REQUEST(s)->filename[i]=0;
     }
-    s->filename[i]=0;
-  }
 
 #if WEBSERVER_CONF_LOG
-  webserver_log_file(&uip_conn->ripaddr, s->filename);
+    webserver_log_file(&uip_conn->ripaddr, REQUEST(s)->filename);
 //  webserver_log(httpd_query);
 #endif
-#if WEBSERVER_CONF_LOADTIME
-    s->pagetime = clock_time();
-#endif
-  s->state = STATE_OUTPUT;
-  while(1) {
-    PSOCK_READTO(&s->sin, ISO_nl);
+    open_file(s);
+
+    /* The response waits for the end of the headers, which may ask to keep the connection */
+    while(1) {
+      PSOCK_READTO(&s->sin, ISO_nl);
+      if(REQUEST(s)->flags & HTTPD_FLAG_CONTINUED) {
+        /* Ignore the rest of a line that did not fit in inputbuf */
+      } else if(s->inputbuf[0] == ISO_nl || (s->inputbuf[0] == ISO_cr && s->inputbuf[1] == ISO_nl)) {
+        break;
+      } else if(httpd_strncmp(s->inputbuf, httpd_11, 8) == 0) {
+        REQUEST(s)->flags |= HTTPD_FLAG_HTTP11;
+      } else if(httpd_strncmp(s->inputbuf, httpd_conn, 12) == 0) {
+        if((s->inputbuf[12] | 0x20) == ISO_c) {
+          REQUEST(s)->flags |= HTTPD_FLAG_CLOSE;
+        } else if((s->inputbuf[12] | 0x20) == ISO_k) {
+          REQUEST(s)->flags |= HTTPD_FLAG_KEEP_ALIVE;
+        }
 #if WEBSERVER_CONF_LOG && WEBSERVER_CONF_REFERER
-    if(httpd_strncmp(s->inputbuf, httpd_ref, 8) == 0) {
-      s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
-      petsciiconv_topetscii(s->inputbuf, PSOCK_DATALEN(&s->sin) - 2);
-      webserver_log(s->inputbuf);
-    }
+      } else if(httpd_strncmp(s->inputbuf, httpd_ref, 8) == 0) {
+        s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
+        petsciiconv_topetscii(s->inputbuf, PSOCK_DATALEN(&s->sin) - 2);
+        webserver_log(s->inputbuf);
 #endif
+      }
+      if(s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] == ISO_nl) {
+        REQUEST(s)->flags &= ~HTTPD_FLAG_CONTINUED;
+      } else {
+        REQUEST(s)->flags |= HTTPD_FLAG_CONTINUED;
+      }
+    }
+    REQUEST(s)->flags &= ~HTTPD_FLAG_READING;
+
+    /* HTTP/1.1 connections persist unless the client asks to close, HTTP/1.0 ones only if it asks to keep
+     * them. Scripts have no length, so the end of the connection ends them.
+     */
+    if((REQUEST(s)->flags & HTTPD_FLAG_HTTP11) && !(REQUEST(s)->flags & HTTPD_FLAG_CLOSE)) {
+      REQUEST(s)->flags |= HTTPD_FLAG_KEEP_ALIVE;
+    }
+    if(!WEBSERVER_CONF_KEEPALIVE || (REQUEST(s)->flags & (HTTPD_FLAG_CLOSE | HTTPD_FLAG_SCRIPT))) {
+      REQUEST(s)->flags &= ~HTTPD_FLAG_KEEP_ALIVE;
+    }
+    ++s->requests;
+    if(!(s->request[s->requests - 1].flags & HTTPD_FLAG_KEEP_ALIVE)) {
+      /* The connection closes after this response */
+      PSOCK_WAIT_UNTIL(&s->sin, 0);
+    }
   }
   PSOCK_END(&s->sin);
 }
 /*---------------------------------------------------------------------------*/
+/* Answers the requests that have been read, in order */
 static void
 handle_connection(struct httpd_state *s)
 {
@@ -456,9 +547,52 @@ handle_connection(struct httpd_state *s)
   handle_output(s);
 #endif
   handle_input(s);
-  if(s->state == STATE_OUTPUT) {
-    handle_output(s);
+  while(s->state != STATE_CLOSED) {
+    if(s->state != STATE_OUTPUT) {
+      if(s->requests == 0) {
+        return;
+      }
+      s->file = s->request[0].file;
+#if WEBSERVER_CONF_LOADTIME
+      s->pagetime = clock_time();
+#endif
+      PT_INIT(&s->outputpt);
+      s->state = STATE_OUTPUT;
+    }
+    if(handle_output(s) != PT_ENDED) {
+      return;
+    }
+    if(!(s->request[0].flags & HTTPD_FLAG_KEEP_ALIVE)) {
+      s->state = STATE_CLOSED;
+      return;
+    }
+    --s->requests;
+    memmove(&s->request[0], &s->request[1], sizeof(s->request) - sizeof(s->request[0]));
+    s->request[WEBSERVER_CONF_PIPELINE].flags = 0;
+    s->state = REQUEST(s)->flags & HTTPD_FLAG_READING ? STATE_WAITING : STATE_IDLE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Takes the slot of the connection that has been idle the longest when all are in use.
+ * Its connection is closed when polled.
+ */
+static struct httpd_state *
+reuse_idle(void)
+{
+  struct httpd_state *s, *idle = NULL;
+  uint8_t i;
+
+  for(i = 0; i < WEBSERVER_CONF_CONNS; i++) {
+    s = &((struct httpd_state *)conns.mem)[i];
+    if(conns.count[i] > 0 && s->state == STATE_IDLE && (idle == NULL || s->timer > idle->timer)) {
+      idle = s;
+    }
+  }
+  if(idle != NULL) {
+    tcp_markconn(idle->conn, NULL);
+    tcpip_poll_tcp(idle->conn);
   }
+  return idle;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -476,16 +610,22 @@ httpd_appcall(void *state)
     }
   } else if(uip_connected()) {
     s = (struct httpd_state *)memb_alloc(&conns);
+    if(s == NULL) {
+      s = reuse_idle();
+    }
     if(s == NULL) {
       uip_abort();
       return;
     }
 #endif
     tcp_markconn(uip_conn, s);
+    s->conn = uip_conn;
     PSOCK_INIT(&s->sin, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
     PSOCK_INIT(&s->sout, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
     PT_INIT(&s->outputpt);
     s->state = STATE_WAITING;
+    s->requests = 0;
+    s->request[0].flags = 0;
     s->timer = 0;
 #if WEBSERVER_CONF_AJAX
     s->ajax_timeout = WEBSERVER_CONF_TIMEOUT;
@@ -494,18 +634,28 @@ httpd_appcall(void *state)
   } else if(s != NULL) {
     if(uip_poll()) {
       ++s->timer;
+      /* Polls come twice a second */
+      if(s->state == STATE_IDLE) {
+        if(s->timer >= WEBSERVER_CONF_KEEPALIVE_TIMEOUT * 2) {
+          uip_close();
+          s->state = STATE_CLOSED;
+        }
 #if WEBSERVER_CONF_AJAX
-      if(s->timer >= s->ajax_timeout) {
+      } else if(s->timer >= s->ajax_timeout) {
 #else
-      if(s->timer >= WEBSERVER_CONF_TIMEOUT) {
+      } else if(s->timer >= WEBSERVER_CONF_TIMEOUT) {
 #endif
         uip_abort();
         memb_free(&conns, s);
+        return;
       }
     } else {
       s->timer = 0;
     }
     handle_connection(s);
+  } else if(uip_poll()) {
+    /* An idle connection whose slot went to a new one */
+    uip_close();
   } else {
     uip_abort();
   }
@@ -48,6 +48,9 @@
  * can exceed any MSS if there are enough files to display (e.g. tic-tac-toe).
  * The advertised MSS is easily seen in wireshark.
  * Some example set a small MSS by default. rpl-border-router for example uses a receive window of 60.
+ *
+ * Files other than scripts are sent with a Content-Length, and their connections are kept open for
+ * further requests, so that a page and its embedded files can share one connection.
  */
  
  /* Titles of web pages served with the !header cgi can be configured to show characteristics of the node.
@@ -221,6 +224,27 @@ extern char httpd_query[WEBSERVER_CONF_PASSQUERY];
 #error Specified WEBSERVER_CONF_NANO configuration not supported.
 #endif /* WEBSERVER_CONF_NANO */
 
+/* Persistent connections, closed after KEEPALIVE_TIMEOUT idle seconds. An idle connection gives up
+ * its slot when a new one needs it.
+ */
+#ifndef WEBSERVER_CONF_KEEPALIVE
+#define WEBSERVER_CONF_KEEPALIVE 1
+#endif
+#ifndef WEBSERVER_CONF_KEEPALIVE_TIMEOUT
+#define WEBSERVER_CONF_KEEPALIVE_TIMEOUT 5
+#endif
+/* The number of requests a client may send ahead of the responses. Each costs a file name per
+ * connection, plus one for a request that comes with the acknowledgment of the last response.
+ * A client that pipelines more gets its connection closed, and sends the rest again.
+ */
+#ifndef WEBSERVER_CONF_PIPELINE
+#if WEBSERVER_CONF_NANO==1
+#define WEBSERVER_CONF_PIPELINE 1
+#else
+#define WEBSERVER_CONF_PIPELINE 2
+#endif
+#endif
+
 /* Address printing used by cgi's and logging, but it can be turned off if desired */
 #if WEBSERVER_CONF_LOG || WEBSERVER_CONF_ADDRESSES || WEBSERVER_CONF_NEIGHBORS || WEBSERVER_CONF_ROUTES
 extern uip_ds6_netif_t uip_ds6_if;
@@ -269,6 +293,20 @@ uint8_t httpd_cgi_sprint_ip6(uip_ip6addr_t addr, char * result);
 #define httpd_fs_getchar(c)  *(c)
 #endif
 
+struct httpd_request {
+  char filename[WEBSERVER_CONF_NAMESIZE];
+  struct httpd_fs_file file;
+  uint8_t flags;
+};
+
+#define HTTPD_FLAG_NOT_FOUND  0x01
+#define HTTPD_FLAG_SCRIPT     0x02
+#define HTTPD_FLAG_HTTP11     0x04
+#define HTTPD_FLAG_CLOSE      0x08 /* The client asked to close */
+#define HTTPD_FLAG_KEEP_ALIVE 0x10
+#define HTTPD_FLAG_READING    0x20
+#define HTTPD_FLAG_CONTINUED  0x40 /* inputbuf holds the rest of a long header line */
+
 struct httpd_state {
   unsigned char timer;
   struct psock sin, sout;
@@ -277,8 +315,11 @@ struct httpd_state {
   struct pt scriptpt;
 #endif
   char inputbuf[WEBSERVER_CONF_BUFSIZE];
-  char filename[WEBSERVER_CONF_NAMESIZE];
   char state;
+  struct uip_conn *conn;
+  /* The requests that have been read, the first being answered, and the one being read */
+  uint8_t requests;
+  struct httpd_request request[WEBSERVER_CONF_PIPELINE + 1];
   struct httpd_fs_file file;  
   int len;
 #if WEBSERVER_CONF_INCLUDE || WEBSERVER_CONF_CGI
@@ -13,8 +13,18 @@ extern const char http_index_htm[11];
 extern const char http_index_html[12];
 extern const char http_404_html[10];
 extern const char http_referer[9];
+extern const char http_accept_encoding[17];
+extern const char http_if_none_match[16];
+extern const char http_if_modified_since[20];
+extern const char http_gzip[5];
+extern const char http_connection[13];
 extern const char http_header_200[85];
 extern const char http_header_404[92];
+extern const char http_status_200[66];
+extern const char http_status_304[76];
+extern const char http_status_404[73];
+extern const char http_connection_close[20];
+extern const char http_connection_keep_alive[25];
 extern const char http_content_type_plain[29];
 extern const char http_content_type_html[28];
 extern const char http_content_type_css [27];
@@ -41,6 +41,7 @@
  *
  */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -51,8 +52,46 @@
 
 #include "lib/petsciiconv.h"
 
+/* The largest script output that fits in the cache, and how long it is
+   served from there. */
+#ifdef WEBSERVER_CONF_CGI_CACHE_SIZE
+#define CACHE_SIZE WEBSERVER_CONF_CGI_CACHE_SIZE
+#else /* WEBSERVER_CONF_CGI_CACHE_SIZE */
+#define CACHE_SIZE 512
+#endif /* WEBSERVER_CONF_CGI_CACHE_SIZE */
+
+#ifdef WEBSERVER_CONF_CGI_CACHE_TTL
+#define CACHE_TTL WEBSERVER_CONF_CGI_CACHE_TTL
+#else /* WEBSERVER_CONF_CGI_CACHE_TTL */
+#define CACHE_TTL CLOCK_SECOND
+#endif /* WEBSERVER_CONF_CGI_CACHE_TTL */
+
 static struct httpd_cgi_call *calls = NULL;
 
+/* The output of a script, which is truncated when len reaches size. */
+struct cgi_output {
+  char *buf;
+  unsigned short size;
+  unsigned short len;
+};
+
+typedef void (* cgi_writer)(struct cgi_output *o);
+
+#if WEBSERVER_CGI_CACHE
+/* The whole output of a script, kept while it is being sent so that
+   retransmissions send the same bytes, and for CACHE_TTL after it was
+   generated so that repeated requests do not walk the tables again. */
+struct httpd_cgi_cache {
+  const char *name;     /* The script, or NULL if the entry is unused. */
+  struct timer timer;
+  unsigned short len;   /* CACHE_SIZE if the output did not fit. */
+  unsigned char users;  /* The connections sending the output. */
+  char data[CACHE_SIZE];
+};
+
+static struct httpd_cgi_cache cache[WEBSERVER_CGI_CACHE];
+#endif /* WEBSERVER_CGI_CACHE */
+
 static const char closed[] =   /*  "CLOSED",*/
 {0x43, 0x4c, 0x4f, 0x53, 0x45, 0x44, 0};
 static const char syn_rcvd[] = /*  "SYN-RCVD",*/
@@ -133,6 +172,120 @@ httpd_cgi(char *name)
   return nullfunction;
 }
 /*---------------------------------------------------------------------------*/
+static void
+cgi_printf(struct cgi_output *o, const char *fmt, ...)
+{
+  va_list ap;
+
+  if(o->len < o->size) {
+    va_start(ap, fmt);
+    o->len += vsnprintf(o->buf + o->len, o->size - o->len, fmt, ap);
+    va_end(ap);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+cgi_open(struct cgi_output *o, char *buf, unsigned short size)
+{
+  o->buf = buf;
+  o->size = size;
+  o->len = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* The number of bytes in the buffer, without the terminating zero of
+   a truncated output. */
+static unsigned short
+cgi_len(struct cgi_output *o)
+{
+  return o->len < o->size ? o->len : o->size - 1;
+}
+/*---------------------------------------------------------------------------*/
+#if WEBSERVER_CGI_CACHE
+/* Points s->cache to the output of the script, which is generated if
+   the cached one is missing or has expired. Returns 0 when the output
+   does not fit, or all entries are being sent, and the script has to
+   generate its output a segment at a time. */
+static int
+cache_open(struct httpd_state *s, const char *name, cgi_writer write)
+{
+  struct httpd_cgi_cache *c, *unused;
+  struct cgi_output o;
+  clock_time_t now;
+
+  now = clock_time();
+  unused = NULL;
+  for(c = cache; c < &cache[WEBSERVER_CGI_CACHE]; ++c) {
+    if(c->name == name && !timer_expired(&c->timer)) {
+      break;
+    }
+    /* Take an empty entry, or else the one generated the longest ago. */
+    if(c->users == 0 &&
+       (unused == NULL || c->name == NULL ||
+	(unused->name != NULL &&
+	 now - c->timer.start > now - unused->timer.start))) {
+      unused = c;
+    }
+  }
+
+  if(c == &cache[WEBSERVER_CGI_CACHE]) {
+    if(unused == NULL) {
+      return 0;
+    }
+    c = unused;
+    cgi_open(&o, c->data, CACHE_SIZE);
+    write(&o);
+    c->name = name;
+    c->len = o.len < CACHE_SIZE ? o.len : CACHE_SIZE;
+    timer_set(&c->timer, CACHE_TTL);
+  }
+
+  if(c->len == CACHE_SIZE) {
+    return 0;
+  }
+  ++c->users;
+  s->cache = c;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the cached output of the script and ends it, if the output is
+   in the cache. Otherwise the script goes on to generate it. */
+#define CACHE_SEND(s, name, write)					\
+  if(cache_open(s, name, write)) {					\
+    PSOCK_SEND(&(s)->sout, (uint8_t *)(s)->cache->data, (s)->cache->len); \
+    httpd_cgi_release(s);						\
+    PSOCK_EXIT(&(s)->sout);						\
+  }
+#else /* WEBSERVER_CGI_CACHE */
+#define CACHE_SEND(s, name, write)
+#endif /* WEBSERVER_CGI_CACHE */
+/*---------------------------------------------------------------------------*/
+void
+httpd_cgi_release(struct httpd_state *s)
+{
+#if WEBSERVER_CGI_CACHE
+  if(s->cache != NULL) {
+    --s->cache->users;
+    s->cache = NULL;
+  }
+#endif /* WEBSERVER_CGI_CACHE */
+}
+/*---------------------------------------------------------------------------*/
+void
+httpd_cgi_invalidate(const char *name)
+{
+#if WEBSERVER_CGI_CACHE
+  struct httpd_cgi_cache *c;
+
+  /* Connections that are sending the output keep it until they are
+     done. */
+  for(c = cache; c < &cache[WEBSERVER_CGI_CACHE]; ++c) {
+    if(c->name != NULL && (name == NULL || strcmp(c->name, name) == 0)) {
+      c->name = NULL;
+    }
+  }
+#endif /* WEBSERVER_CGI_CACHE */
+}
+/*---------------------------------------------------------------------------*/
 static unsigned short
 generate_file_stats(void *arg)
 {
@@ -150,17 +303,13 @@ PT_THREAD(file_stats(struct httpd_state *s, char *ptr))
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
-static unsigned short
-make_tcp_stats(void *arg)
+static void
+write_tcp_conn(struct cgi_output *o, struct uip_conn *conn)
 {
-  struct uip_conn *conn;
-  struct httpd_state *s = (struct httpd_state *)arg;
-  conn = &uip_conns[s->u.count];
-
 #if UIP_CONF_IPV6
   char buf[48];
   httpd_sprint_ip6(conn->ripaddr, buf);
-  return snprintf((char *)uip_appdata, uip_mss(),
+  cgi_printf(o,
          "<tr align=\"center\"><td>%d</td><td>%s:%u</td><td>%s</td><td>%u</td><td>%u</td><td>%c %c</td></tr>\r\n",
          uip_htons(conn->lport),
          buf,
@@ -171,7 +320,7 @@ make_tcp_stats(void *arg)
          (uip_outstanding(conn))? '*':' ',
          (uip_stopped(conn))? '!':' ');
 #else
-  return snprintf((char *)uip_appdata, uip_mss(),
+  cgi_printf(o,
          "<tr align=\"center\"><td>%d</td><td>%u.%u.%u.%u:%u</td><td>%s</td><td>%u</td><td>%u</td><td>%c %c</td></tr>\r\n",
          uip_htons(conn->lport),
          conn->ripaddr.u8[0],
@@ -187,12 +336,39 @@ make_tcp_stats(void *arg)
 #endif /* UIP_CONF_IPV6 */
 }
 /*---------------------------------------------------------------------------*/
+static unsigned short
+make_tcp_stats(void *arg)
+{
+  struct httpd_state *s = (struct httpd_state *)arg;
+  struct cgi_output o;
+
+  cgi_open(&o, (char *)uip_appdata, uip_mss());
+  write_tcp_conn(&o, &uip_conns[s->u.count]);
+  return cgi_len(&o);
+}
+/*---------------------------------------------------------------------------*/
+#if WEBSERVER_CGI_CACHE
+static void
+write_tcp_stats(struct cgi_output *o)
+{
+  int i;
+
+  for(i = 0; i < UIP_CONNS; ++i) {
+    if((uip_conns[i].tcpstateflags & UIP_TS_MASK) != UIP_CLOSED) {
+      write_tcp_conn(o, &uip_conns[i]);
+    }
+  }
+}
+#endif /* WEBSERVER_CGI_CACHE */
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(tcp_stats(struct httpd_state *s, char *ptr))
 {
   
   PSOCK_BEGIN(&s->sout);
 
+  CACHE_SEND(s, tcp_name, write_tcp_stats);
+
   for(s->u.count = 0; s->u.count < UIP_CONNS; ++s->u.count) {
     if((uip_conns[s->u.count].tcpstateflags & UIP_TS_MASK) != UIP_CLOSED) {
       PSOCK_GENERATOR_SEND(&s->sout, make_tcp_stats, s);
@@ -202,25 +378,48 @@ PT_THREAD(tcp_stats(struct httpd_state *s, char *ptr))
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
-static unsigned short
-make_processes(void *p)
+static void
+write_process(struct cgi_output *o, struct process *p)
 {
   char name[40];
  
-  strncpy(name, PROCESS_NAME_STRING((struct process *)p), 40);
+  strncpy(name, PROCESS_NAME_STRING(p), 40);
   petsciiconv_toascii(name, 40);
 
-  return snprintf((char *)uip_appdata, uip_mss(),
-		 "<tr align=\"center\"><td>%p</td><td>%s</td><td>%p</td><td>%s</td></tr>\r\n",
-		 p, name,
-		 *((char **)&(((struct process *)p)->thread)),
-		 states[9 + ((struct process *)p)->state]);
+  cgi_printf(o,
+	     "<tr align=\"center\"><td>%p</td><td>%s</td><td>%p</td><td>%s</td></tr>\r\n",
+	     p, name,
+	     *((char **)&(p->thread)),
+	     states[9 + p->state]);
 }
 /*---------------------------------------------------------------------------*/
+static unsigned short
+make_processes(void *p)
+{
+  struct cgi_output o;
+
+  cgi_open(&o, (char *)uip_appdata, uip_mss());
+  write_process(&o, (struct process *)p);
+  return cgi_len(&o);
+}
+/*---------------------------------------------------------------------------*/
+#if WEBSERVER_CGI_CACHE
+static void
+write_processes(struct cgi_output *o)
+{
+  struct process *p;
+
+  for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+    write_process(o, p);
+  }
+}
+#endif /* WEBSERVER_CGI_CACHE */
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(processes(struct httpd_state *s, char *ptr))
 {
   PSOCK_BEGIN(&s->sout);
+  CACHE_SEND(s, proc_name, write_processes);
   for(s->u.ptr = PROCESS_LIST(); s->u.ptr != NULL; s->u.ptr = ((struct process *)s->u.ptr)->next) {
     PSOCK_GENERATOR_SEND(&s->sout, make_processes, s->u.ptr);
   }
@@ -244,26 +443,46 @@ static const char httpd_cgi_addrh[] HTTPD_STRING_ATTR = "<code>";
 static const char httpd_cgi_addrf[] HTTPD_STRING_ATTR = "</code>[Room for %u more]";
 static const char httpd_cgi_addrb[] HTTPD_STRING_ATTR = "<br>";
 static const char httpd_cgi_addrn[] HTTPD_STRING_ATTR = "(none)<br>";
+static const char   adrs_name[] HTTPD_STRING_ATTR = "addresses";
+static const char   nbrs_name[] HTTPD_STRING_ATTR = "neighbors";
+static const char   rtes_name[] HTTPD_STRING_ATTR = "routes";
 extern uip_ds6_nbr_t uip_ds6_nbr_cache[];
 extern uip_ds6_route_t uip_ds6_routing_table[];
 extern uip_ds6_netif_t uip_ds6_if;
 
-static unsigned short
-make_addresses(void *p)
+static void
+cgi_print_ip6(struct cgi_output *o, uip_ip6addr_t addr)
+{
+  char buf[48];
+
+  httpd_cgi_sprint_ip6(addr, buf);
+  cgi_printf(o, "%s", buf);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_addresses(struct cgi_output *o)
 {
 uint8_t i,j=0;
-uint16_t numprinted;
-  numprinted = httpd_snprintf((char *)uip_appdata, uip_mss(),httpd_cgi_addrh);
+  cgi_printf(o, httpd_cgi_addrh);
   for (i=0; i<UIP_DS6_ADDR_NB;i++) {
     if (uip_ds6_if.addr_list[i].isused) {
       j++;
-      numprinted += httpd_cgi_sprint_ip6(uip_ds6_if.addr_list[i].ipaddr, uip_appdata + numprinted);
-      numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrb); 
+      cgi_print_ip6(o, uip_ds6_if.addr_list[i].ipaddr);
+      cgi_printf(o, httpd_cgi_addrb);
     }
   }
-//if (j==0) numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrn);
-  numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrf, UIP_DS6_ADDR_NB-j); 
-  return numprinted;
+//if (j==0) cgi_printf(o, httpd_cgi_addrn);
+  cgi_printf(o, httpd_cgi_addrf, UIP_DS6_ADDR_NB-j);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+make_addresses(void *p)
+{
+  struct cgi_output o;
+
+  cgi_open(&o, (char *)uip_appdata, uip_mss());
+  write_addresses(&o);
+  return cgi_len(&o);
 }
 /*---------------------------------------------------------------------------*/
 static
@@ -271,27 +490,36 @@ PT_THREAD(addresses(struct httpd_state *s, char *ptr))
 {
   PSOCK_BEGIN(&s->sout);
 
+  CACHE_SEND(s, adrs_name, write_addresses);
   PSOCK_GENERATOR_SEND(&s->sout, make_addresses, s->u.ptr);
 
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/	
-static unsigned short
-make_neighbors(void *p)
+static void
+write_neighbors(struct cgi_output *o)
 {
 uint8_t i,j=0;
-uint16_t numprinted;
-  numprinted = httpd_snprintf((char *)uip_appdata, uip_mss(),httpd_cgi_addrh);
+  cgi_printf(o, httpd_cgi_addrh);
   for (i=0; i<UIP_DS6_NBR_NB;i++) {
     if (uip_ds6_nbr_cache[i].isused) {
       j++;
-      numprinted += httpd_cgi_sprint_ip6(uip_ds6_nbr_cache[i].ipaddr, uip_appdata + numprinted);
-      numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrb); 
+      cgi_print_ip6(o, uip_ds6_nbr_cache[i].ipaddr);
+      cgi_printf(o, httpd_cgi_addrb);
     }
   }
-//if (j==0) numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrn);
-  numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrf,UIP_DS6_NBR_NB-j);
-  return numprinted;
+//if (j==0) cgi_printf(o, httpd_cgi_addrn);
+  cgi_printf(o, httpd_cgi_addrf, UIP_DS6_NBR_NB-j);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+make_neighbors(void *p)
+{
+  struct cgi_output o;
+
+  cgi_open(&o, (char *)uip_appdata, uip_mss());
+  write_neighbors(&o);
+  return cgi_len(&o);
 }
 /*---------------------------------------------------------------------------*/
 static
@@ -299,38 +527,47 @@ PT_THREAD(neighbors(struct httpd_state *s, char *ptr))
 {
   PSOCK_BEGIN(&s->sout);
 
+  CACHE_SEND(s, nbrs_name, write_neighbors);
   PSOCK_GENERATOR_SEND(&s->sout, make_neighbors, s->u.ptr);  
   
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/			
-static unsigned short
-make_routes(void *p)
+static void
+write_routes(struct cgi_output *o)
 {
   static const char httpd_cgi_rtes1[] HTTPD_STRING_ATTR = "(%u (via ";
   static const char httpd_cgi_rtes2[] HTTPD_STRING_ATTR = ") %lus<br>";
   static const char httpd_cgi_rtes3[] HTTPD_STRING_ATTR = ")<br>";
-  uint8_t i,j=0;
-  uint16_t numprinted;
+  uint8_t j=0;
   uip_ds6_route_t *r;
 
-  numprinted = httpd_snprintf((char *)uip_appdata, uip_mss(),httpd_cgi_addrh);
+  cgi_printf(o, httpd_cgi_addrh);
   for(r = uip_ds6_route_list_head();
       r != NULL;
       r = list_item_next(r)) {
     j++;
-    numprinted += httpd_cgi_sprint_ip6(r->ipaddr, uip_appdata + numprinted);
-    numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_rtes1, r->length);
-    numprinted += httpd_cgi_sprint_ip6(r->nexthop, uip_appdata + numprinted);
+    cgi_print_ip6(o, r->ipaddr);
+    cgi_printf(o, httpd_cgi_rtes1, r->length);
+    cgi_print_ip6(o, r->nexthop);
     if(r->state.lifetime < 3600) {
-      numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_rtes2, r->state.lifetime);
+      cgi_printf(o, httpd_cgi_rtes2, r->state.lifetime);
     } else {
-      numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_rtes3);
+      cgi_printf(o, httpd_cgi_rtes3);
     }
   }
-  if (j==0) numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrn);
-  numprinted += httpd_snprintf((char *)uip_appdata+numprinted, uip_mss()-numprinted, httpd_cgi_addrf,UIP_DS6_ROUTE_NB-j);
-  return numprinted;
+  if (j==0) cgi_printf(o, httpd_cgi_addrn);
+  cgi_printf(o, httpd_cgi_addrf,UIP_DS6_ROUTE_NB-j);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+make_routes(void *p)
+{
+  struct cgi_output o;
+
+  cgi_open(&o, (char *)uip_appdata, uip_mss());
+  write_routes(&o);
+  return cgi_len(&o);
 }
 /*---------------------------------------------------------------------------*/
 static
@@ -338,10 +575,24 @@ PT_THREAD(routes(struct httpd_state *s, char *ptr))
 {
   PSOCK_BEGIN(&s->sout);
  
+  CACHE_SEND(s, rtes_name, write_routes);
   PSOCK_GENERATOR_SEND(&s->sout, make_routes, s->u.ptr); 
  
   PSOCK_END(&s->sout);
 }
+#if WEBSERVER_CGI_CACHE
+/*---------------------------------------------------------------------------*/
+/* A route that comes or goes makes the cached route list stale at once.
+   The lifetimes in it are left to CACHE_TTL. */
+static struct uip_ds6_notification route_notification;
+
+static void
+route_changed(int event, uip_ipaddr_t *route, uip_ipaddr_t *nexthop,
+	      int num_routes)
+{
+  httpd_cgi_invalidate(rtes_name);
+}
+#endif /* WEBSERVER_CGI_CACHE */
 #endif /* WEBSERVER_CONF_STATUSPAGE */
 /*---------------------------------------------------------------------------*/
 void
@@ -358,11 +609,6 @@ httpd_cgi_add(struct httpd_cgi_call *c)
   }
 }
 /*---------------------------------------------------------------------------*/
-#if WEBSERVER_CONF_STATUSPAGE && UIP_CONF_IPV6
-static const char   adrs_name[] HTTPD_STRING_ATTR = "addresses";
-static const char   nbrs_name[] HTTPD_STRING_ATTR = "neighbors";
-static const char   rtes_name[] HTTPD_STRING_ATTR = "routes";
-#endif
 HTTPD_CGI_CALL(file, file_name, file_stats);
 HTTPD_CGI_CALL(tcp, tcp_name, tcp_stats);
 HTTPD_CGI_CALL(proc, proc_name, processes);
@@ -382,6 +628,9 @@ httpd_cgi_init(void)
   httpd_cgi_add(&adrs);
   httpd_cgi_add(&nbrs);
   httpd_cgi_add(&rtes);
+#if WEBSERVER_CGI_CACHE
+  uip_ds6_notification_add(&route_notification, route_changed);
+#endif /* WEBSERVER_CGI_CACHE */
 #endif
 }
 /*---------------------------------------------------------------------------*/
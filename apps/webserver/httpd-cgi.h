@@ -53,4 +53,12 @@ void httpd_cgi_add(struct httpd_cgi_call *c);
 static struct httpd_cgi_call name = {NULL, str, function}
 
 void httpd_cgi_init(void);
+
+/* Lets go of the cached script output that the connection is sending,
+   when the connection goes away in the middle of a script. */
+void httpd_cgi_release(struct httpd_state *s);
+
+/* Drops the cached output of the named script, or of all scripts if
+   name is NULL, for when the data that it shows has changed. */
+void httpd_cgi_invalidate(const char *name);
 #endif /* __HTTPD_CGI_H__ */
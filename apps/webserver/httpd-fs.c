@@ -32,6 +32,8 @@
  *
  */
 
+#include <string.h>
+
 #include "contiki-net.h"
 #include "httpd.h"
 #include "httpd-fs.h"
@@ -40,10 +42,15 @@
 #include "httpd-fsdata.c"
 
 #if HTTPD_FS_STATISTICS
+#ifdef HTTPD_FS_HASH_SIZE
+static uint16_t count[HTTPD_FS_HASH_SIZE];
+#else /* HTTPD_FS_HASH_SIZE */
 static uint16_t count[HTTPD_FS_NUMFILES];
+#endif /* HTTPD_FS_HASH_SIZE */
 #endif /* HTTPD_FS_STATISTICS */
 
 /*-----------------------------------------------------------------------------------*/
+#ifndef HTTPD_FS_HASH_SIZE
 static uint8_t
 httpd_fs_strcmp(const char *str1, const char *str2)
 {
@@ -64,9 +71,55 @@ loop:
   ++i;
   goto loop;
 }
+#endif /* HTTPD_FS_HASH_SIZE */
+/*-----------------------------------------------------------------------------------*/
+#ifdef HTTPD_FS_HASH_SIZE
+/* Returns the slot of the file in the hash index, or -1. The name ends
+   at the end of the string or the line, or at a query string. The hash
+   must match the one in tools/makefsdata. */
+static int
+httpd_fs_hash(const char *name)
+{
+  const struct httpd_fsdata_file *f;
+  uint16_t h;
+  uint8_t len;
+
+  h = 0;
+  for(len = 0; name[len] != 0 && name[len] != '\r' && name[len] != '\n' &&
+        name[len] != '?'; ++len) {
+    h = h * 31 + (uint8_t)name[len];
+  }
+
+  for(h &= HTTPD_FS_HASH_SIZE - 1;
+      (f = httpd_fs_index[h].file) != NULL;
+      h = (h + 1) & (HTTPD_FS_HASH_SIZE - 1)) {
+    if(strncmp(name, f->name, len) == 0 && f->name[len] == 0) {
+      return h;
+    }
+  }
+  return -1;
+}
 /*-----------------------------------------------------------------------------------*/
 int
 httpd_fs_open(const char *name, struct httpd_fs_file *file)
+{
+  int h;
+
+  h = httpd_fs_hash(name);
+  if(h < 0) {
+    return 0;
+  }
+  file->data = (char *)httpd_fs_index[h].file->data;
+  file->len = httpd_fs_index[h].file->len;
+  file->meta = httpd_fs_index[h].meta;
+#if HTTPD_FS_STATISTICS
+  ++count[h];
+#endif /* HTTPD_FS_STATISTICS */
+  return 1;
+}
+#else /* HTTPD_FS_HASH_SIZE */
+int
+httpd_fs_open(const char *name, struct httpd_fs_file *file)
 {
 #if HTTPD_FS_STATISTICS
   uint16_t i = 0;
@@ -80,6 +133,7 @@ httpd_fs_open(const char *name, struct httpd_fs_file *file)
     if(httpd_fs_strcmp(name, f->name) == 0) {
       file->data = f->data;
       file->len = f->len;
+      file->meta = NULL;
 #if HTTPD_FS_STATISTICS
       ++count[i];
 #endif /* HTTPD_FS_STATISTICS */
@@ -92,15 +146,13 @@ httpd_fs_open(const char *name, struct httpd_fs_file *file)
   }
   return 0;
 }
+#endif /* HTTPD_FS_HASH_SIZE */
 /*-----------------------------------------------------------------------------------*/
 void
 httpd_fs_init(void)
 {
 #if HTTPD_FS_STATISTICS
-  uint16_t i;
-  for(i = 0; i < HTTPD_FS_NUMFILES; i++) {
-    count[i] = 0;
-  }
+  memset(count, 0, sizeof(count));
 #endif /* HTTPD_FS_STATISTICS */
 }
 /*-----------------------------------------------------------------------------------*/
@@ -108,6 +160,12 @@ httpd_fs_init(void)
 uint16_t
 httpd_fs_count(char *name)
 {
+#ifdef HTTPD_FS_HASH_SIZE
+  int h;
+
+  h = httpd_fs_hash(name);
+  return h < 0 ? 0 : count[h];
+#else /* HTTPD_FS_HASH_SIZE */
   struct httpd_fsdata_file_noconst *f;
   uint16_t i;
 
@@ -122,6 +180,7 @@ httpd_fs_count(char *name)
     ++i;
   }
   return 0;
+#endif /* HTTPD_FS_HASH_SIZE */
 }
 #endif /* HTTPD_FS_STATISTICS */
 /*-----------------------------------------------------------------------------------*/
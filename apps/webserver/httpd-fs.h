@@ -38,9 +38,13 @@
 
 #define HTTPD_FS_STATISTICS 1
 
+struct httpd_fsdata_meta;
+
 struct httpd_fs_file {
   char *data;
   int len;
+  /* The precomputed headers, or NULL if makefsdata did not add any. */
+  const struct httpd_fsdata_meta *meta;
 };
 
 /* file must be allocated by caller and will be filled in
@@ -611,3 +611,221 @@ const struct httpd_fsdata_file file_tcp_shtml[] = {{file_style_css, data_tcp_sht
 #define HTTPD_FS_ROOT file_tcp_shtml
 
 #define HTTPD_FS_NUMFILES 8
+
+static const char header_header_html[] = "Content-type: text/html\r\nContent-Length: 750\r\nVary: Accept-Encoding\r\nETag: \"968ddfc6\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char header_gz_header_html[] = "Content-type: text/html\r\nContent-Encoding: gzip\r\nContent-Length: 406\r\nVary: Accept-Encoding\r\nETag: \"968ddfc6\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char data_gz_header_html[406]  = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 
+  0x75, 0x52, 0x4d, 0x6f, 0xdb, 0x30, 0x0c, 0xbd, 0xf7, 0x57, 
+  0xb0, 0xda, 0x39, 0xe6, 0x86, 0xf6, 0x34, 0xd8, 0x3e, 0x2c, 
+  0xe9, 0xb0, 0x01, 0xfd, 0xc2, 0xe6, 0xa2, 0xd8, 0x51, 0x96, 
+  0xe9, 0x58, 0x88, 0x6c, 0x19, 0x22, 0x5b, 0x2f, 0xff, 0x7e, 
+  0x52, 0x3c, 0xa7, 0x69, 0xd1, 0xde, 0x28, 0xf2, 0x91, 0x7c, 
+  0x7c, 0x7a, 0xf9, 0xf9, 0xe6, 0x6e, 0x5d, 0xfd, 0xb9, 0xbf, 
+  0x82, 0x1f, 0xd5, 0xcd, 0x35, 0xdc, 0x3f, 0x7c, 0xbb, 0xfe, 
+  0xb9, 0x06, 0xb5, 0x42, 0x7c, 0xbc, 0x58, 0x23, 0x6e, 0xaa, 
+  0xcd, 0x5c, 0xb8, 0xcc, 0x3e, 0x7f, 0x81, 0x2a, 0xe8, 0x81, 
+  0xad, 0x58, 0x3f, 0x68, 0x87, 0x78, 0x75, 0xab, 0x40, 0x75, 
+  0x22, 0xe3, 0x57, 0xc4, 0x69, 0x9a, 0xb2, 0xe9, 0x22, 0xf3, 
+  0x61, 0x8b, 0xd5, 0x2f, 0xec, 0xa4, 0x77, 0x97, 0xe8, 0xbc, 
+  0x67, 0xca, 0x1a, 0x69, 0x54, 0x79, 0x96, 0xa7, 0x54, 0x79, 
+  0x06, 0x90, 0x77, 0xa4, 0x9b, 0x14, 0xc4, 0x50, 0xac, 0x38, 
+  0x2a, 0x1f, 0xc9, 0x19, 0xdf, 0x13, 0x88, 0x07, 0xe9, 0x08, 
+  0xd6, 0x7e, 0x10, 0xbb, 0xb3, 0xab, 0x86, 0x7a, 0x0f, 0x4c, 
+  0xe1, 0x99, 0xc2, 0x79, 0x8e, 0x33, 0x74, 0x6e, 0x73, 0x76, 
+  0xd8, 0x41, 0x20, 0x57, 0x28, 0x96, 0xbd, 0x23, 0xee, 0x88, 
+  0x44, 0x81, 0xec, 0x47, 0x2a, 0x94, 0xd0, 0x5f, 0x41, 0xc3, 
+  0xac, 0xa0, 0x0b, 0xd4, 0x16, 0x0a, 0x0f, 0x90, 0x2c, 0x65, 
+  0x4a, 0x80, 0xb4, 0x1f, 0x17, 0x02, 0x79, 0xed, 0x9b, 0x3d, 
+  0xd4, 0x5b, 0xe3, 0x9d, 0x0f, 0x85, 0xfa, 0xd4, 0xb6, 0x2d, 
+  0x91, 0x89, 0x83, 0xe2, 0x88, 0x42, 0xd5, 0x4e, 0x9b, 0x5d, 
+  0x24, 0x9e, 0x80, 0x8d, 0x7d, 0x06, 0xe3, 0x34, 0x73, 0xa1, 
+  0x7a, 0x1a, 0x9e, 0x6a, 0xe7, 0x3f, 0x2a, 0xa9, 0xc3, 0xe0, 
+  0x71, 0x49, 0xd5, 0x3e, 0x34, 0x14, 0x56, 0x07, 0xf2, 0xaa, 
+  0xbc, 0x89, 0x80, 0x1c, 0xc7, 0xd7, 0x90, 0x63, 0x57, 0xca, 
+  0xea, 0x85, 0xb5, 0x2a, 0xbf, 0x87, 0xa8, 0x03, 0x8c, 0x7a, 
+  0x4b, 0x39, 0xea, 0x32, 0xaf, 0x43, 0x79, 0x0a, 0x68, 0x6d, 
+  0xbc, 0x3b, 0xe3, 0x24, 0x6a, 0x84, 0xc6, 0x07, 0xb0, 0x68, 
+  0xb1, 0x2c, 0xd6, 0xf0, 0x7b, 0x78, 0x31, 0xe3, 0x82, 0xbe, 
+  0x25, 0x99, 0x7c, 0xd8, 0x81, 0xf1, 0xc3, 0x40, 0x26, 0xfd, 
+  0xe5, 0xbb, 0x1d, 0x63, 0xf0, 0x86, 0x98, 0x5f, 0xb6, 0xfc, 
+  0xde, 0xb3, 0x50, 0x0f, 0xc7, 0xfc, 0xb1, 0xe9, 0x20, 0xea, 
+  0x7c, 0x15, 0x46, 0x39, 0x4e, 0x82, 0x37, 0x02, 0xc5, 0x8d, 
+  0x42, 0x83, 0x2c, 0xf2, 0x7d, 0x2c, 0x54, 0x2c, 0xbd, 0x31, 
+  0xc5, 0x91, 0xd6, 0x89, 0xdd, 0x38, 0xde, 0x9a, 0x31, 0xa1, 
+  0x99, 0x0d, 0x13, 0x35, 0xfb, 0x6f, 0x9d, 0xc4, 0x2c, 0xc9, 
+  0x39, 0x51, 0xbd, 0x18, 0x68, 0xe1, 0xf8, 0x0f, 0x36, 0xd0, 
+  0x35, 0x15, 0xee, 0x02, 0x00, 0x00, };
+static const struct httpd_fsdata_meta meta_header_html = {header_header_html, header_header_html + 69, "\"968ddfc6\"", "Mon, 19 Oct 2026 12:19:32 GMT", header_gz_header_html, data_gz_header_html, 406};
+
+static const char header_style_css[] = "Content-type: text/css\r\nContent-Length: 2560\r\nVary: Accept-Encoding\r\nETag: \"6f2340d6\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char header_gz_style_css[] = "Content-type: text/css\r\nContent-Encoding: gzip\r\nContent-Length: 608\r\nVary: Accept-Encoding\r\nETag: \"6f2340d6\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char data_gz_style_css[608]  = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 
+  0xbd, 0x56, 0xdb, 0x6e, 0xe3, 0x20, 0x10, 0x7d, 0x5e, 0xbe, 
+  0x02, 0x69, 0xb5, 0x2f, 0x55, 0xed, 0x3a, 0x51, 0xaa, 0x6d, 
+  0xec, 0xaf, 0xc1, 0x80, 0x1d, 0x54, 0x0c, 0x88, 0x90, 0x26, 
+  0xdd, 0x55, 0xfe, 0x7d, 0xb9, 0xd9, 0xb1, 0x1d, 0xd2, 0x24, 
+  0xed, 0xaa, 0x7e, 0x84, 0xf1, 0x9c, 0x0b, 0x33, 0x03, 0x9b, 
+  0x05, 0x04, 0x7f, 0x01, 0x84, 0x86, 0x1e, 0x4c, 0x86, 0x38, 
+  0x6b, 0x45, 0x09, 0x31, 0x15, 0x86, 0xea, 0xca, 0xae, 0x36, 
+  0x52, 0x98, 0x6c, 0xcb, 0xfe, 0xd0, 0x72, 0xb1, 0x52, 0x66, 
+  0x58, 0x69, 0x50, 0xc7, 0xf8, 0x7b, 0x89, 0x34, 0x43, 0xfc, 
+  0x71, 0x43, 0xf9, 0x1b, 0x35, 0x0c, 0xa3, 0x61, 0x7b, 0x4f, 
+  0x59, 0xbb, 0x31, 0x65, 0x2d, 0x39, 0x71, 0x6b, 0x0a, 0x11, 
+  0xc2, 0x44, 0x5b, 0x2e, 0x0a, 0x75, 0xa8, 0x20, 0x38, 0x02, 
+  0x50, 0x4b, 0xf2, 0x6e, 0x51, 0xed, 0x5e, 0x8d, 0xf0, 0x6b, 
+  0xab, 0xe5, 0x4e, 0x90, 0x0c, 0x4b, 0x2e, 0x75, 0x09, 0x7f, 
+  0x36, 0x4d, 0x43, 0x29, 0x76, 0x3f, 0x86, 0x95, 0x9a, 0xdb, 
+  0x98, 0x0a, 0x4c, 0xd8, 0xbc, 0xdc, 0x40, 0xc6, 0xe2, 0xe4, 
+  0x7b, 0x8d, 0x14, 0x74, 0xf2, 0xf6, 0x8c, 0x98, 0x4d, 0x09, 
+  0xd7, 0x2f, 0xbf, 0xdc, 0x7f, 0x1d, 0xd2, 0x2d, 0xb3, 0x42, 
+  0x0b, 0x88, 0x76, 0x46, 0x56, 0x33, 0xf9, 0x9c, 0x36, 0x57, 
+  0xb3, 0xc3, 0xf8, 0x79, 0x94, 0x8e, 0x8a, 0x5d, 0xcd, 0x25, 
+  0x7e, 0xf5, 0x4e, 0xf6, 0xc9, 0x57, 0x56, 0xed, 0x80, 0xbc, 
+  0x78, 0xf6, 0xc0, 0x0d, 0x97, 0xc8, 0x94, 0x01, 0x60, 0xee, 
+  0x0c, 0xf8, 0xe1, 0xfc, 0x90, 0x9a, 0x50, 0xeb, 0xc2, 0x56, 
+  0x72, 0x46, 0xe0, 0x22, 0xa4, 0x48, 0x9b, 0x84, 0xc9, 0x72, 
+  0xc6, 0xbc, 0x27, 0x3e, 0xb1, 0x6a, 0xad, 0x6e, 0x10, 0xe3, 
+  0x65, 0x60, 0x1b, 0x62, 0x4f, 0x3e, 0x2a, 0xf1, 0x69, 0x92, 
+  0x5a, 0x9e, 0x8b, 0xeb, 0x5a, 0x46, 0x52, 0xac, 0x08, 0x48, 
+  0xa4, 0x31, 0x94, 0xa4, 0xb5, 0xec, 0x37, 0xcc, 0xd0, 0xfb, 
+  0xcf, 0xd7, 0xf2, 0xf3, 0xac, 0x05, 0xdd, 0x6f, 0xaf, 0x98, 
+  0xbf, 0x5c, 0x9d, 0x13, 0xfe, 0x88, 0xf1, 0x97, 0xcc, 0xbf, 
+  0xbf, 0x48, 0x95, 0x66, 0xc2, 0xa0, 0x9a, 0xd3, 0xff, 0xa7, 
+  0xa0, 0xa8, 0xae, 0xf5, 0xd6, 0x88, 0xb9, 0x76, 0xdd, 0xfa, 
+  0x29, 0xea, 0x84, 0xbd, 0xe5, 0xba, 0x61, 0xad, 0x27, 0x7e, 
+  0xee, 0x1e, 0x04, 0xc9, 0xce, 0x1a, 0x11, 0x87, 0x81, 0xf9, 
+  0xa0, 0x7a, 0x10, 0x32, 0xa3, 0x32, 0x68, 0x8f, 0x5c, 0x2d, 
+  0xb6, 0xd2, 0x34, 0xa7, 0x07, 0xd4, 0xa9, 0xe8, 0x5b, 0x0a, 
+  0xfe, 0x1a, 0xd0, 0x07, 0x7d, 0x7f, 0xb3, 0x0d, 0x30, 0x14, 
+  0x70, 0xb6, 0x55, 0x08, 0xd3, 0xd2, 0xb2, 0x8a, 0xed, 0x04, 
+  0x54, 0x6e, 0x8f, 0x55, 0xcb, 0xd1, 0xa1, 0x66, 0x0e, 0xa1, 
+  0x5c, 0x4e, 0x98, 0x64, 0x5e, 0x51, 0x5c, 0x9c, 0x4e, 0xdc, 
+  0xc2, 0xa1, 0x3f, 0x3d, 0x24, 0x86, 0x2a, 0x7c, 0x78, 0xba, 
+  0xa9, 0xa5, 0x55, 0x8e, 0x39, 0x13, 0xa1, 0x33, 0x46, 0x89, 
+  0x97, 0xe7, 0xb2, 0xb0, 0xdc, 0x69, 0x46, 0xf5, 0x63, 0x27, 
+  0x85, 0xf4, 0x4a, 0x2a, 0xdf, 0xff, 0x23, 0x7b, 0xfa, 0x4b, 
+  0xe1, 0x94, 0x76, 0x3d, 0xcb, 0xbb, 0xfe, 0x72, 0x5a, 0x4d, 
+  0x39, 0xb2, 0x73, 0x62, 0xce, 0xb7, 0xb8, 0x69, 0x1a, 0x5c, 
+  0x4a, 0x0b, 0x00, 0xeb, 0xda, 0xdc, 0xdb, 0x1c, 0x12, 0x8f, 
+  0x0b, 0x69, 0x56, 0x10, 0xc7, 0x10, 0xec, 0xce, 0x69, 0x14, 
+  0xdb, 0x17, 0xc6, 0x3c, 0x54, 0xe5, 0x77, 0xd4, 0x7e, 0xcf, 
+  0xe8, 0xbe, 0xea, 0xff, 0xad, 0x4c, 0xef, 0xcd, 0xf7, 0x60, 
+  0x25, 0x3a, 0xcd, 0x82, 0xf3, 0x6f, 0x06, 0x0f, 0x8e, 0x3b, 
+  0xdd, 0x1e, 0x35, 0xe6, 0x09, 0xfd, 0x33, 0xb2, 0xbf, 0x43, 
+  0x8c, 0xdb, 0x2d, 0x7d, 0x29, 0xe8, 0x0c, 0x20, 0x5d, 0x9d, 
+  0x96, 0x6e, 0xc7, 0x04, 0xe2, 0xc9, 0xb9, 0x18, 0x1b, 0xe9, 
+  0x54, 0x3f, 0x97, 0x22, 0x82, 0x35, 0x99, 0x61, 0x26, 0x4e, 
+  0xa4, 0x44, 0x39, 0x26, 0x9e, 0x54, 0x23, 0x9b, 0xa6, 0x26, 
+  0xad, 0x26, 0x63, 0xa2, 0xb6, 0x37, 0xa8, 0xec, 0x4e, 0xce, 
+  0xc5, 0x89, 0x1e, 0x1f, 0x47, 0x17, 0xaf, 0xa9, 0xda, 0x4f, 
+  0xa8, 0xc4, 0xc5, 0x06, 0x8e, 0xd0, 0xb5, 0x06, 0xf8, 0x07, 
+  0x12, 0x9f, 0x74, 0x66, 0x00, 0x0a, 0x00, 0x00, };
+static const struct httpd_fsdata_meta meta_style_css = {header_style_css, header_style_css + 69, "\"6f2340d6\"", "Mon, 19 Oct 2026 12:19:32 GMT", header_gz_style_css, data_gz_style_css, 608};
+
+static const char header_tcp_shtml[] = "Content-type: text/html\r\n\r\n";
+static const struct httpd_fsdata_meta meta_tcp_shtml = {header_tcp_shtml, NULL, NULL, NULL, NULL, NULL, 0};
+
+static const char header_404_html[] = "Content-type: text/html\r\nContent-Length: 160\r\nVary: Accept-Encoding\r\nETag: \"bebb2b04\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char header_gz_404_html[] = "Content-type: text/html\r\nContent-Encoding: gzip\r\nContent-Length: 135\r\nVary: Accept-Encoding\r\nETag: \"bebb2b04\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char data_gz_404_html[135]  = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 
+  0x45, 0x8e, 0x41, 0x0a, 0x02, 0x31, 0x0c, 0x45, 0xf7, 0x73, 
+  0x8a, 0xd0, 0xbd, 0x46, 0x99, 0x59, 0x66, 0xb2, 0xf5, 0x1c, 
+  0x9d, 0x69, 0x6a, 0x0a, 0xb5, 0x81, 0x5a, 0x11, 0x6f, 0x6f, 
+  0x8b, 0xa2, 0xcb, 0xc7, 0x7b, 0xf0, 0x3f, 0x69, 0xbb, 0x65, 
+  0x9e, 0x00, 0x68, 0xb3, 0xf0, 0x82, 0xed, 0xba, 0x5b, 0xb6, 
+  0xba, 0xba, 0xa7, 0xa6, 0x26, 0x6e, 0x88, 0xae, 0x76, 0x29, 
+  0x4d, 0xea, 0x07, 0x3a, 0xea, 0x99, 0x97, 0xd3, 0x02, 0x07, 
+  0x88, 0x29, 0x0b, 0x14, 0x6b, 0x10, 0xed, 0x51, 0x02, 0x61, 
+  0x17, 0xbf, 0x66, 0xe6, 0x8b, 0x01, 0x79, 0xd0, 0x2a, 0x71, 
+  0x75, 0xe8, 0x58, 0xa5, 0x0a, 0xa1, 0x67, 0x48, 0xe5, 0xde, 
+  0xc4, 0x87, 0x63, 0xef, 0xe7, 0xef, 0x00, 0xfe, 0x17, 0x08, 
+  0xc7, 0x11, 0x9e, 0xba, 0x1d, 0xcf, 0xde, 0x57, 0x52, 0xaf, 
+  0xa7, 0xa0, 0x00, 0x00, 0x00, };
+static const struct httpd_fsdata_meta meta_404_html = {header_404_html, header_404_html + 69, "\"bebb2b04\"", "Mon, 19 Oct 2026 12:19:32 GMT", header_gz_404_html, data_gz_404_html, 135};
+
+static const char header_index_html[] = "Content-type: text/html\r\nContent-Length: 976\r\nVary: Accept-Encoding\r\nETag: \"d1850e7d\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char header_gz_index_html[] = "Content-type: text/html\r\nContent-Encoding: gzip\r\nContent-Length: 493\r\nVary: Accept-Encoding\r\nETag: \"d1850e7d\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const char data_gz_index_html[493]  = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 
+  0x8d, 0x53, 0xc1, 0x6e, 0xdb, 0x30, 0x0c, 0x3d, 0xaf, 0x5f, 
+  0xc1, 0x6a, 0xe7, 0x9a, 0x1d, 0xda, 0xd3, 0x60, 0xfb, 0xd0, 
+  0xa4, 0xc3, 0x06, 0xb4, 0x5d, 0xb1, 0x79, 0x28, 0x76, 0x94, 
+  0x65, 0x3a, 0x16, 0xa2, 0x48, 0x86, 0xc4, 0xd4, 0xf3, 0xdf, 
+  0x4f, 0xb2, 0xe3, 0x34, 0x2b, 0x5a, 0x60, 0x06, 0x0c, 0x53, 
+  0xe4, 0x23, 0xf9, 0xf8, 0x4c, 0xe5, 0xe7, 0xeb, 0xef, 0xab, 
+  0xea, 0xf7, 0xe3, 0x2d, 0x7c, 0xad, 0xee, 0xef, 0xe0, 0xf1, 
+  0xd7, 0xcd, 0xdd, 0xb7, 0x15, 0x88, 0x0b, 0xc4, 0xa7, 0xab, 
+  0x15, 0xe2, 0xba, 0x5a, 0xcf, 0x81, 0xeb, 0xec, 0xf2, 0x13, 
+  0x54, 0x5e, 0xda, 0xa0, 0x59, 0x3b, 0x2b, 0x0d, 0xe2, 0xed, 
+  0x83, 0x00, 0xd1, 0x31, 0xf7, 0x9f, 0x11, 0x87, 0x61, 0xc8, 
+  0x86, 0xab, 0xcc, 0xf9, 0x0d, 0x56, 0x3f, 0xb0, 0xe3, 0x9d, 
+  0xb9, 0x46, 0xe3, 0x5c, 0xa0, 0xac, 0xe1, 0x46, 0x94, 0x67, 
+  0x79, 0x72, 0x95, 0x67, 0x00, 0x79, 0x47, 0xb2, 0x49, 0x46, 
+  0x34, 0x59, 0xb3, 0xa1, 0xf2, 0x89, 0x8c, 0x72, 0x3b, 0x02, 
+  0x76, 0xc0, 0x1d, 0xc1, 0xca, 0x59, 0xd6, 0x5b, 0x0d, 0x03, 
+  0xd5, 0x10, 0xc8, 0x3f, 0x93, 0x3f, 0xcf, 0x71, 0x46, 0xce, 
+  0x59, 0x46, 0xdb, 0x2d, 0x78, 0x32, 0x85, 0x08, 0x3c, 0x1a, 
+  0x0a, 0x1d, 0x11, 0x0b, 0xe0, 0xb1, 0xa7, 0x42, 0x30, 0xfd, 
+  0x61, 0x54, 0x21, 0x08, 0xe8, 0x3c, 0xb5, 0x85, 0xc0, 0x09, 
+  0x92, 0x25, 0x4f, 0x09, 0x90, 0xda, 0xe3, 0xd2, 0x3f, 0xaf, 
+  0x5d, 0x33, 0x42, 0xbd, 0x51, 0xce, 0x38, 0x5f, 0x88, 0x8f, 
+  0x6d, 0xdb, 0x12, 0xa9, 0x58, 0x28, 0x96, 0x28, 0x44, 0x6d, 
+  0xa4, 0xda, 0x46, 0xde, 0x09, 0xd8, 0xe8, 0x67, 0x50, 0x46, 
+  0x86, 0x50, 0x88, 0x1d, 0xd9, 0x7d, 0x6d, 0xdc, 0x7b, 0x21, 
+  0x31, 0x15, 0xee, 0x17, 0x57, 0xed, 0x7c, 0x43, 0xfe, 0x62, 
+  0x22, 0x2f, 0xca, 0xfb, 0x08, 0xc8, 0xb1, 0xff, 0x17, 0x72, 
+  0xcc, 0x4a, 0x5e, 0xb9, 0xb0, 0x16, 0xe5, 0x17, 0x1f, 0x65, 
+  0x80, 0x5e, 0x6e, 0x28, 0x47, 0x59, 0xe6, 0xb5, 0x2f, 0x4f, 
+  0x01, 0xad, 0x8e, 0x73, 0x67, 0x21, 0x69, 0x1a, 0xa1, 0xf1, 
+  0x00, 0x81, 0x25, 0xeb, 0xc0, 0x5a, 0x85, 0xb7, 0xf0, 0xac, 
+  0xfa, 0x05, 0xfd, 0x40, 0x3c, 0x38, 0xbf, 0x05, 0xe5, 0xac, 
+  0x25, 0x95, 0x7e, 0xe5, 0x9b, 0x19, 0xbd, 0x77, 0x8a, 0x42, 
+  0x78, 0xe9, 0xf2, 0x73, 0x0c, 0x4c, 0x3b, 0x38, 0xfa, 0x8f, 
+  0x49, 0x93, 0xa8, 0xf3, 0x54, 0x18, 0xe5, 0x38, 0x31, 0x5e, 
+  0x09, 0x14, 0x3b, 0x32, 0x59, 0x5e, 0xe4, 0x7b, 0x5f, 0xa8, 
+  0x18, 0x7a, 0xb5, 0x13, 0x47, 0x5a, 0x27, 0xdb, 0x16, 0xe2, 
+  0xac, 0x59, 0x20, 0x54, 0xf3, 0xbe, 0x44, 0xcd, 0x0e, 0x9b, 
+  0x93, 0x98, 0x25, 0x39, 0x4f, 0x16, 0x68, 0xe1, 0xf8, 0x01, 
+  0xa6, 0x27, 0x7d, 0x5f, 0x9a, 0x6b, 0xcb, 0xde, 0x89, 0x43, 
+  0xb0, 0x8a, 0xdd, 0x52, 0x62, 0x52, 0x3e, 0xc0, 0xe8, 0xf6, 
+  0x20, 0x7d, 0xf4, 0x48, 0x56, 0x9d, 0xb6, 0x9b, 0xe9, 0x30, 
+  0xd5, 0x6c, 0xa0, 0x1e, 0x41, 0x26, 0xe8, 0x9c, 0x37, 0x37, 
+  0x02, 0xbf, 0xb7, 0x36, 0xe1, 0xf6, 0x36, 0xce, 0x73, 0xa0, 
+  0x3e, 0x03, 0xfe, 0x9f, 0x3f, 0xb8, 0x9e, 0x7c, 0xfc, 0x9b, 
+  0x76, 0x73, 0x28, 0x3d, 0x29, 0x9f, 0xa6, 0xca, 0x26, 0xe2, 
+  0x69, 0x90, 0x64, 0xc4, 0x77, 0x9a, 0x2b, 0xed, 0x71, 0xbc, 
+  0x60, 0x38, 0xdf, 0xb0, 0xbf, 0xf1, 0xdb, 0xbc, 0x5f, 0xd0, 
+  0x03, 0x00, 0x00, };
+static const struct httpd_fsdata_meta meta_index_html = {header_index_html, header_index_html + 69, "\"d1850e7d\"", "Mon, 19 Oct 2026 12:19:32 GMT", header_gz_index_html, data_gz_index_html, 493};
+
+static const char header_files_shtml[] = "Content-type: text/html\r\n\r\n";
+static const struct httpd_fsdata_meta meta_files_shtml = {header_files_shtml, NULL, NULL, NULL, NULL, NULL, 0};
+
+static const char header_footer_html[] = "Content-type: text/html\r\nContent-Length: 17\r\nETag: \"40cce27e\"\r\nLast-Modified: Mon, 19 Oct 2026 12:19:32 GMT\r\n\r\n";
+static const struct httpd_fsdata_meta meta_footer_html = {header_footer_html, header_footer_html + 45, "\"40cce27e\"", "Mon, 19 Oct 2026 12:19:32 GMT", NULL, NULL, 0};
+
+static const char header_processes_shtml[] = "Content-type: text/html\r\n\r\n";
+static const struct httpd_fsdata_meta meta_processes_shtml = {header_processes_shtml, NULL, NULL, NULL, NULL, NULL, 0};
+
+#define HTTPD_FS_HASH_SIZE 16
+static const struct httpd_fsdata_hash httpd_fs_index[HTTPD_FS_HASH_SIZE] = {
+  {file_404_html, &meta_404_html},
+  {NULL, NULL},
+  {file_tcp_shtml, &meta_tcp_shtml},
+  {NULL, NULL},
+  {NULL, NULL},
+  {NULL, NULL},
+  {file_index_html, &meta_index_html},
+  {file_style_css, &meta_style_css},
+  {file_files_shtml, &meta_files_shtml},
+  {NULL, NULL},
+  {NULL, NULL},
+  {NULL, NULL},
+  {NULL, NULL},
+  {file_header_html, &meta_header_html},
+  {file_processes_shtml, &meta_processes_shtml},
+  {file_footer_html, &meta_footer_html},
+};
@@ -60,4 +60,23 @@ struct httpd_fsdata_file_noconst {
 #endif /* HTTPD_FS_STATISTICS */
 };
 
+/* Precomputed response headers, generated by makefsdata -x. The
+   headers follow the status line, and end with an empty line. */
+struct httpd_fsdata_meta {
+  const char *header;
+  const char *validators; /* The ETag and Last-Modified headers at the
+                             end of header, or NULL for scripts. */
+  const char *etag;
+  const char *modified;
+  const char *gzheader;   /* The headers and data of the gzip */
+  const char *gzdata;     /* compressed file, or NULL. */
+  int gzlen;
+};
+
+/* The hash index of the file names, generated by makefsdata -x. */
+struct httpd_fsdata_hash {
+  const struct httpd_fsdata_file *file;
+  const struct httpd_fsdata_meta *meta;
+};
+
 #endif /* __HTTPD_FSDATA_H__ */
@@ -39,6 +39,7 @@
 
 #include "webserver.h"
 #include "httpd-fs.h"
+#include "httpd-fsdata.h"
 #include "httpd-cgi.h"
 #include "lib/petsciiconv.h"
 #include "http-strings.h"
@@ -51,19 +52,40 @@
 #define CONNS WEBSERVER_CONF_CGI_CONNS
 #endif /* WEBSERVER_CONF_CGI_CONNS */
 
+/* Persistent connections, and how many seconds they may stay idle. */
+#ifndef WEBSERVER_CONF_KEEPALIVE
+#define KEEPALIVE 1
+#else /* WEBSERVER_CONF_KEEPALIVE */
+#define KEEPALIVE WEBSERVER_CONF_KEEPALIVE
+#endif /* WEBSERVER_CONF_KEEPALIVE */
+
+#ifndef WEBSERVER_CONF_KEEPALIVE_TIMEOUT
+#define KEEPALIVE_TIMEOUT 5
+#else /* WEBSERVER_CONF_KEEPALIVE_TIMEOUT */
+#define KEEPALIVE_TIMEOUT WEBSERVER_CONF_KEEPALIVE_TIMEOUT
+#endif /* WEBSERVER_CONF_KEEPALIVE_TIMEOUT */
+
 #define STATE_WAITING 0
 #define STATE_OUTPUT  1
+#define STATE_IDLE    2 /* Between the requests of a persistent connection. */
+#define STATE_CLOSED  3
+
+/* The request being read. */
+#define REQUEST(s) (&(s)->request[(s)->requests])
 
 #define SEND_STRING(s, str) PSOCK_SEND(s, (uint8_t *)str, (unsigned int)strlen(str))
 MEMB(conns, struct httpd_state, CONNS);
 
 #define ISO_nl      0x0a
+#define ISO_cr      0x0d
 #define ISO_space   0x20
 #define ISO_bang    0x21
 #define ISO_percent 0x25
 #define ISO_period  0x2e
 #define ISO_slash   0x2f
 #define ISO_colon   0x3a
+#define ISO_c       0x63
+#define ISO_k       0x6b
 
 /*---------------------------------------------------------------------------*/
 static unsigned short
@@ -105,6 +127,108 @@ PT_THREAD(send_part_of_file(struct httpd_state *s))
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
+/* Copies the part of str that is at offset *pos in the response into
+   the segment after the first len bytes, and returns the new length of
+   the segment. *pos is made relative to the part that follows str. */
+static int
+copy_part(int len, int *pos, const char *str, int size)
+{
+  int n;
+
+  if(*pos >= size) {
+    *pos -= size;
+    return len;
+  }
+  n = size - *pos;
+  if(n > uip_mss() - len) {
+    n = uip_mss() - len;
+  }
+  memcpy((char *)uip_appdata + len, str + *pos, n);
+  *pos = 0;
+  return len + n;
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+static_status(struct httpd_state *s, int *len)
+{
+  if(s->flags & HTTPD_FLAG_NOT_FOUND) {
+    *len = sizeof(http_status_404) - 1;
+    return http_status_404;
+  } else if(s->flags & HTTPD_FLAG_NOT_MODIFIED) {
+    *len = sizeof(http_status_304) - 1;
+    return http_status_304;
+  }
+  *len = sizeof(http_status_200) - 1;
+  return http_status_200;
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+static_connection(struct httpd_state *s, int *len)
+{
+  if(s->flags & HTTPD_FLAG_KEEP_ALIVE) {
+    *len = sizeof(http_connection_keep_alive) - 1;
+    return http_connection_keep_alive;
+  }
+  *len = sizeof(http_connection_close) - 1;
+  return http_connection_close;
+}
+/*---------------------------------------------------------------------------*/
+static int
+static_body_len(struct httpd_state *s)
+{
+  if((s->flags & HTTPD_FLAG_NOT_MODIFIED) || s->file.meta->validators == NULL) {
+    /* Scripts send their body through handle_script(). */
+    return 0;
+  }
+  return s->file.len;
+}
+/*---------------------------------------------------------------------------*/
+static int
+static_len(struct httpd_state *s)
+{
+  int status, connection;
+
+  static_status(s, &status);
+  static_connection(s, &connection);
+  return status + connection + s->u.count + static_body_len(s);
+}
+/*---------------------------------------------------------------------------*/
+/* Fills the segment with the response at offset s->scriptlen: the status
+   line, the Connection header, the s->u.count bytes of precomputed
+   headers at s->scriptptr, and the file. Headers and data share
+   segments, and are copied straight from the file system. */
+static unsigned short
+generate_static(void *state)
+{
+  struct httpd_state *s = (struct httpd_state *)state;
+  const char *str;
+  int pos, len;
+
+  pos = s->scriptlen;
+  str = static_status(s, &len);
+  s->len = copy_part(0, &pos, str, len);
+  str = static_connection(s, &len);
+  s->len = copy_part(s->len, &pos, str, len);
+  s->len = copy_part(s->len, &pos, s->scriptptr, s->u.count);
+  s->len = copy_part(s->len, &pos, s->file.data, static_body_len(s));
+
+  return s->len;
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(send_static(struct httpd_state *s))
+{
+  PSOCK_BEGIN(&s->sout);
+
+  s->scriptlen = 0;
+  do {
+    PSOCK_GENERATOR_SEND(&s->sout, generate_static, s);
+    s->scriptlen += s->len;
+  } while(s->scriptlen < static_len(s));
+
+  PSOCK_END(&s->sout);
+}
+/*---------------------------------------------------------------------------*/
 static void
 next_scriptstate(struct httpd_state *s)
 {
@@ -221,9 +345,26 @@ PT_THREAD(handle_output(struct httpd_state *s))
   
   PT_BEGIN(&s->outputpt);
  
-  if(!httpd_fs_open(s->filename, &s->file)) {
+  if(s->file.meta != NULL) {
+    /* Files with precomputed headers, and the 404 page when it has them. */
+    if(s->flags & HTTPD_FLAG_NOT_MODIFIED) {
+      s->scriptptr = (char *)s->file.meta->validators;
+    } else if((s->flags & HTTPD_FLAG_GZIP) && s->file.meta->gzdata != NULL) {
+      s->scriptptr = (char *)s->file.meta->gzheader;
+      s->file.data = (char *)s->file.meta->gzdata;
+      s->file.len = s->file.meta->gzlen;
+    } else {
+      s->scriptptr = (char *)s->file.meta->header;
+    }
+    s->u.count = strlen(s->scriptptr);
+    PT_WAIT_THREAD(&s->outputpt, send_static(s));
+    if(s->file.meta->validators == NULL) {
+      PT_INIT(&s->scriptpt);
+      PT_WAIT_THREAD(&s->outputpt, handle_script(s));
+    }
+  } else if(s->flags & HTTPD_FLAG_NOT_FOUND) {
+    /* handle_input() has opened the 404 page. */
     strcpy(s->filename, http_404_html);
-    httpd_fs_open(s->filename, &s->file);
     PT_WAIT_THREAD(&s->outputpt,
 		   send_headers(s,
 		   http_header_404));
@@ -242,58 +383,205 @@ PT_THREAD(handle_output(struct httpd_state *s))
 		     send_file(s));
     }
   }
-  PSOCK_CLOSE(&s->sout);
+  if(!(s->flags & HTTPD_FLAG_KEEP_ALIVE)) {
+    PSOCK_CLOSE(&s->sout);
+  }
   PT_END(&s->outputpt);
 }
 /*---------------------------------------------------------------------------*/
+static void
+parse_header(struct httpd_state *s)
+{
+  struct httpd_request *r = REQUEST(s);
+
+  if(strncmp(s->inputbuf, http_11, 8) == 0) {
+    /* The rest of the request line. */
+    r->flags |= HTTPD_FLAG_HTTP11;
+  } else if(strncmp(s->inputbuf, http_referer, 8) == 0) {
+    s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
+    petsciiconv_topetscii(s->inputbuf, PSOCK_DATALEN(&s->sin) - 2);
+    webserver_log(s->inputbuf);
+  } else if(strncmp(s->inputbuf, http_connection, 12) == 0) {
+    if((s->inputbuf[12] | 0x20) == ISO_c) {
+      r->flags |= HTTPD_FLAG_CLOSE;
+    } else if((s->inputbuf[12] | 0x20) == ISO_k) {
+      r->flags |= HTTPD_FLAG_KEEP_ALIVE;
+    }
+  } else if(r->file.meta != NULL && r->file.meta->validators != NULL) {
+    s->inputbuf[PSOCK_DATALEN(&s->sin)] = 0;
+    if(strncmp(s->inputbuf, http_accept_encoding, 16) == 0 &&
+       strstr(s->inputbuf + 16, http_gzip) != NULL) {
+      r->flags |= HTTPD_FLAG_GZIP;
+    } else if(!(r->flags & HTTPD_FLAG_NOT_FOUND) &&
+	      ((strncmp(s->inputbuf, http_if_none_match, 15) == 0 &&
+		strncmp(s->inputbuf + 15, r->file.meta->etag,
+			strlen(r->file.meta->etag)) == 0) ||
+	       (strncmp(s->inputbuf, http_if_modified_since, 19) == 0 &&
+		strncmp(s->inputbuf + 19, r->file.meta->modified,
+			strlen(r->file.meta->modified)) == 0))) {
+      r->flags |= HTTPD_FLAG_NOT_MODIFIED;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Keeps the connection open after the response, if both ends can. HTTP/1.1
+   connections persist unless the client asks to close them, HTTP/1.0
+   ones only if it asks to keep them. Responses without a length, from
+   scripts and files without precomputed headers, end with the
+   connection. */
+static void
+decide_keep_alive(struct httpd_request *r)
+{
+  if((r->flags & HTTPD_FLAG_HTTP11) && !(r->flags & HTTPD_FLAG_CLOSE)) {
+    r->flags |= HTTPD_FLAG_KEEP_ALIVE;
+  }
+  if(!KEEPALIVE || (r->flags & HTTPD_FLAG_CLOSE) ||
+     r->file.meta == NULL || r->file.meta->validators == NULL) {
+    r->flags &= ~HTTPD_FLAG_KEEP_ALIVE;
+  }
+}
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(handle_input(struct httpd_state *s))
 {
   PSOCK_BEGIN(&s->sin);
 
-  PSOCK_READTO(&s->sin, ISO_space);
-  
-  if(strncmp(s->inputbuf, http_get, 4) != 0) {
-    PSOCK_CLOSE_EXIT(&s->sin);
-  }
-  PSOCK_READTO(&s->sin, ISO_space);
+  while(1) {
+    PSOCK_READTO(&s->sin, ISO_space);
 
-  if(s->inputbuf[0] != ISO_slash) {
-    PSOCK_CLOSE_EXIT(&s->sin);
-  }
+    if(strncmp(s->inputbuf, http_get, 4) != 0) {
+      PSOCK_CLOSE_EXIT(&s->sin);
+    }
+    if(s->requests == WEBSERVER_PIPELINE + 1) {
+      /* No room for another request. The connection closes after the
+	 responses to the ones that have been read, and the client sends
+	 the rest again. */
+      s->request[WEBSERVER_PIPELINE].flags &= ~HTTPD_FLAG_KEEP_ALIVE;
+      PSOCK_WAIT_UNTIL(&s->sin, 0);
+    }
+    if(s->state == STATE_IDLE) {
+      s->state = STATE_WAITING;
+    }
+    REQUEST(s)->flags = HTTPD_FLAG_READING;
+    PSOCK_READTO(&s->sin, ISO_space);
 
-  if(s->inputbuf[1] == ISO_space) {
-    strncpy(s->filename, http_index_html, sizeof(s->filename));
-  } else {
-    s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] = 0;
-    strncpy(s->filename, s->inputbuf, sizeof(s->filename));
-  }
+    if(s->inputbuf[0] != ISO_slash) {
+      PSOCK_CLOSE_EXIT(&s->sin);
+    }
 
-  petsciiconv_topetscii(s->filename, sizeof(s->filename));
-  webserver_log_file(&uip_conn->ripaddr, s->filename);
-  petsciiconv_toascii(s->filename, sizeof(s->filename));
-  s->state = STATE_OUTPUT;
+    if(s->inputbuf[1] == ISO_space) {
+      strncpy(s->filename, http_index_html, sizeof(s->filename));
+    } else {
+      s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] = 0;
+      strncpy(s->filename, s->inputbuf, sizeof(s->filename));
+    }
 
-  while(1) {
-    PSOCK_READTO(&s->sin, ISO_nl);
+    petsciiconv_topetscii(s->filename, sizeof(s->filename));
+    webserver_log_file(&uip_conn->ripaddr, s->filename);
+    petsciiconv_toascii(s->filename, sizeof(s->filename));
 
-    if(strncmp(s->inputbuf, http_referer, 8) == 0) {
-      s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
-      petsciiconv_topetscii(s->inputbuf, PSOCK_DATALEN(&s->sin) - 2);
-      webserver_log(s->inputbuf);
+    if(!httpd_fs_open(s->filename, &REQUEST(s)->file)) {
+      REQUEST(s)->flags |= HTTPD_FLAG_NOT_FOUND;
+      REQUEST(s)->file.len = 0;
+      REQUEST(s)->file.meta = NULL;
+      httpd_fs_open(http_404_html, &REQUEST(s)->file);
+    }
+
+    /* The response waits for the end of the headers, as they may ask for
+       a gzip compressed file, make the request conditional, or ask to
+       keep the connection open. */
+    while(1) {
+      PSOCK_READTO(&s->sin, ISO_nl);
+
+      if(REQUEST(s)->flags & HTTPD_FLAG_CONTINUED) {
+	/* Ignore the rest of a line that did not fit in inputbuf. */
+      } else if(s->inputbuf[0] == ISO_nl ||
+		(s->inputbuf[0] == ISO_cr && s->inputbuf[1] == ISO_nl)) {
+	break;
+      } else {
+	parse_header(s);
+      }
+
+      if(s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] == ISO_nl) {
+	REQUEST(s)->flags &= ~HTTPD_FLAG_CONTINUED;
+      } else {
+	REQUEST(s)->flags |= HTTPD_FLAG_CONTINUED;
+      }
+    }
+
+    REQUEST(s)->flags &= ~HTTPD_FLAG_READING;
+    decide_keep_alive(REQUEST(s));
+    ++s->requests;
+    if(!(s->request[s->requests - 1].flags & HTTPD_FLAG_KEEP_ALIVE)) {
+      /* The connection closes after this response. */
+      PSOCK_WAIT_UNTIL(&s->sin, 0);
     }
   }
   
   PSOCK_END(&s->sin);
 }
 /*---------------------------------------------------------------------------*/
+/* Answers the requests that have been read, in order. */
+static void
+handle_requests(struct httpd_state *s)
+{
+  while(s->state != STATE_CLOSED) {
+    if(s->state != STATE_OUTPUT) {
+      if(s->requests == 0) {
+	return;
+      }
+      s->file = s->request[0].file;
+      s->flags = s->request[0].flags;
+      PT_INIT(&s->outputpt);
+      s->state = STATE_OUTPUT;
+    }
+    if(handle_output(s) != PT_ENDED) {
+      return;
+    }
+    if(!(s->flags & HTTPD_FLAG_KEEP_ALIVE)) {
+      s->state = STATE_CLOSED;
+      return;
+    }
+    --s->requests;
+    memmove(&s->request[0], &s->request[1],
+	    sizeof(s->request) - sizeof(s->request[0]));
+    s->request[WEBSERVER_PIPELINE].flags = 0;
+    if(REQUEST(s)->flags & HTTPD_FLAG_READING) {
+      s->state = STATE_WAITING;
+    } else {
+      s->state = STATE_IDLE;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 static void
 handle_connection(struct httpd_state *s)
 {
   handle_input(s);
-  if(s->state == STATE_OUTPUT) {
-    handle_output(s);
+  handle_requests(s);
+}
+/*---------------------------------------------------------------------------*/
+/* Takes the slot of the persistent connection that has been idle the
+   longest when all are in use. Its connection is closed when polled. */
+static struct httpd_state *
+reuse_idle(void)
+{
+  struct httpd_state *s, *idle;
+  int i;
+
+  idle = NULL;
+  for(i = 0; i < CONNS; ++i) {
+    s = &((struct httpd_state *)conns.mem)[i];
+    if(conns.count[i] > 0 && s->state == STATE_IDLE &&
+       (idle == NULL || s->timer > idle->timer)) {
+      idle = s;
+    }
+  }
+  if(idle != NULL) {
+    tcp_markconn(idle->conn, NULL);
+    tcpip_poll_tcp(idle->conn);
   }
+  return idle;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -303,33 +591,52 @@ httpd_appcall(void *state)
 
   if(uip_closed() || uip_aborted() || uip_timedout()) {
     if(s != NULL) {
+      httpd_cgi_release(s);
       memb_free(&conns, s);
     }
   } else if(uip_connected()) {
     s = (struct httpd_state *)memb_alloc(&conns);
     if(s == NULL) {
-      uip_abort();
-      return;
+      s = reuse_idle();
+      if(s == NULL) {
+	uip_abort();
+	return;
+      }
     }
     tcp_markconn(uip_conn, s);
+    s->conn = uip_conn;
+#if WEBSERVER_CGI_CACHE
+    s->cache = NULL;
+#endif /* WEBSERVER_CGI_CACHE */
     PSOCK_INIT(&s->sin, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
     PSOCK_INIT(&s->sout, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
     PT_INIT(&s->outputpt);
     s->state = STATE_WAITING;
+    s->requests = 0;
+    s->request[0].flags = 0;
     /*    timer_set(&s->timer, CLOCK_SECOND * 100);*/
     s->timer = 0;
     handle_connection(s);
   } else if(s != NULL) {
     if(uip_poll()) {
       ++s->timer;
-      if(s->timer >= 20) {
+      /* The connection is polled twice a second. */
+      if(s->state == STATE_IDLE && s->timer >= KEEPALIVE_TIMEOUT * 2) {
+	uip_close();
+	s->state = STATE_CLOSED;
+      } else if(s->state != STATE_IDLE && s->timer >= 20) {
 	uip_abort();
+	httpd_cgi_release(s);
 	memb_free(&conns, s);
+	return;
       }
     } else {
       s->timer = 0;
     }
     handle_connection(s);
+  } else if(uip_poll()) {
+    /* An idle connection whose slot went to a new one. */
+    uip_close();
   } else {
     uip_abort();
   }
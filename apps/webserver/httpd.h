@@ -38,6 +38,31 @@
 #include "contiki-net.h"
 #include "httpd-fs.h"
 
+/* The number of requests that a client may send ahead of the responses.
+   A client that pipelines more gets its connection closed after these,
+   and sends the rest again on a new connection. */
+#ifdef WEBSERVER_CONF_PIPELINE
+#define WEBSERVER_PIPELINE WEBSERVER_CONF_PIPELINE
+#else /* WEBSERVER_CONF_PIPELINE */
+#define WEBSERVER_PIPELINE 2
+#endif /* WEBSERVER_CONF_PIPELINE */
+
+/* The number of script outputs that httpd-cgi.c keeps, so that
+   retransmissions and repeated requests do not run the script again.
+   Zero turns the cache off. */
+#ifdef WEBSERVER_CONF_CGI_CACHE
+#define WEBSERVER_CGI_CACHE WEBSERVER_CONF_CGI_CACHE
+#else /* WEBSERVER_CONF_CGI_CACHE */
+#define WEBSERVER_CGI_CACHE 0
+#endif /* WEBSERVER_CONF_CGI_CACHE */
+
+struct httpd_cgi_cache;
+
+struct httpd_request {
+  struct httpd_fs_file file;
+  unsigned char flags;
+};
+
 struct httpd_state {
   unsigned char timer;
   struct psock sin, sout;
@@ -45,6 +70,7 @@ struct httpd_state {
   char inputbuf[50];
   char filename[20];
   char state;
+  unsigned char flags;
   struct httpd_fs_file file;  
   int len;
   char *scriptptr;
@@ -53,8 +79,28 @@ struct httpd_state {
     unsigned short count;
     void *ptr;
   } u;
+  struct uip_conn *conn;
+#if WEBSERVER_CGI_CACHE
+  /* The cached script output being sent. */
+  struct httpd_cgi_cache *cache;
+#endif /* WEBSERVER_CGI_CACHE */
+  /* The requests that have been read, the first being answered, and
+     the one being read at request[requests]. The extra one is for a
+     request that comes with the acknowledgment of the last response. */
+  unsigned char requests;
+  struct httpd_request request[WEBSERVER_PIPELINE + 1];
 };
 
+#define HTTPD_FLAG_NOT_FOUND    0x01
+#define HTTPD_FLAG_GZIP         0x02 /* The client accepts gzip. */
+#define HTTPD_FLAG_NOT_MODIFIED 0x04
+#define HTTPD_FLAG_CONTINUED    0x08 /* inputbuf holds the rest of a
+                                        long header line. */
+#define HTTPD_FLAG_HTTP11       0x10
+#define HTTPD_FLAG_CLOSE        0x20 /* The client asked to close. */
+#define HTTPD_FLAG_KEEP_ALIVE   0x40
+#define HTTPD_FLAG_READING      0x80
+
 
 void httpd_init(void);
 void httpd_appcall(void *state);
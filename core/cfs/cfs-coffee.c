@@ -58,6 +58,7 @@
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
+#include "sys/clock.h"
 
 /* Micro logs enable modifications on storage types that do not support
    in-place updates. This applies primarily to flash memories. */
@@ -90,6 +91,52 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING	1
 #endif
 
+/*
+ * Reclaim obsolete sectors in a background process, one sector at a
+ * time while the system is idle, so that file reservations seldom have
+ * to wait for a complete garbage collection.
+ */
+#ifndef COFFEE_INCREMENTAL_GC
+#define COFFEE_INCREMENTAL_GC	0
+#endif
+
+/* The background garbage collection starts when fewer sectors than
+   this remain after the next free page. */
+#ifndef COFFEE_GC_THRESHOLD
+#define COFFEE_GC_THRESHOLD	(COFFEE_SECTOR_COUNT / 4 + 1)
+#endif
+
+/* The maximum number of sectors to examine in one time slice. */
+#ifndef COFFEE_GC_SLICE_SECTORS
+#define COFFEE_GC_SLICE_SECTORS	4
+#endif
+
+/* The time to wait before retrying a time slice when the system is busy. */
+#ifndef COFFEE_GC_BUSY_INTERVAL
+#define COFFEE_GC_BUSY_INTERVAL	(CLOCK_SECOND / 8)
+#endif
+
+#if COFFEE_INCREMENTAL_GC
+#include "sys/process.h"
+#include "sys/etimer.h"
+#endif /* COFFEE_INCREMENTAL_GC */
+
+/*
+ * Write buffers coalesce contiguous small writes through a file
+ * descriptor, so that they reach the storage as one append or as
+ * full log records instead of one log record per call. The buffers
+ * are shared by all file descriptors and are flushed when a write
+ * is not contiguous, when a buffer fills up, and when the file is
+ * accessed in any other way.
+ */
+#ifndef COFFEE_WRITE_BUFFERS
+#define COFFEE_WRITE_BUFFERS		0
+#endif
+
+#ifndef COFFEE_WRITE_BUFFER_SIZE
+#define COFFEE_WRITE_BUFFER_SIZE	COFFEE_PAGE_SIZE
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -161,6 +208,12 @@ struct sector_status {
   coffee_page_t free;
 };
 
+/* The state of an iteration over the sectors in get_sector_status(). */
+struct sector_iterator {
+  coffee_page_t skip_pages;
+  char last_pages_are_active;
+};
+
 /* The structure of cached file objects. */
 struct file {
   cfs_offset_t end;
@@ -193,6 +246,17 @@ struct file_header {
   char name[COFFEE_NAME_LENGTH];
 };
 
+#if COFFEE_WRITE_BUFFERS
+/* The structure of write buffers. A buffer is free if fdp is NULL. */
+struct write_buffer {
+  struct file_desc *fdp;
+  cfs_offset_t offset;
+  uint16_t length;
+  uint16_t writes;
+  char data[COFFEE_WRITE_BUFFER_SIZE];
+};
+#endif /* COFFEE_WRITE_BUFFERS */
+
 /* This is needed because of a buggy compiler. */
 struct log_param {
   cfs_offset_t offset;
@@ -217,6 +281,34 @@ static struct file_desc * const coffee_fd_set = protected_mem.coffee_fd_set;
 static coffee_page_t * const next_free = &protected_mem.next_free;
 static char * const gc_wait = &protected_mem.gc_wait;
 
+static struct cfs_coffee_gc_stats gc_stats;
+
+static struct cfs_coffee_write_stats write_stats;
+
+#if COFFEE_WRITE_BUFFERS
+static struct write_buffer write_buffers[COFFEE_WRITE_BUFFERS];
+
+static int flush_buffer(struct write_buffer *wb);
+static int flush_fd(struct file_desc *fdp);
+static struct write_buffer *find_buffer(struct file *file);
+static int flush_file(struct file *file);
+#endif /* COFFEE_WRITE_BUFFERS */
+
+#if COFFEE_INCREMENTAL_GC
+PROCESS(coffee_gc_process, "Coffee GC");
+
+/* Changed whenever pages are allocated or erased, which invalidates an
+   ongoing background iteration over the sectors. */
+static uint8_t gc_generation;
+/* Set when files have been removed since the last background pass. */
+static uint8_t gc_pending;
+
+static void gc_notify(void);
+#define GC_CHANGED()		gc_generation++
+#else
+#define GC_CHANGED()
+#endif /* COFFEE_INCREMENTAL_GC */
+
 /*---------------------------------------------------------------------------*/
 static void
 write_header(struct file_header *hdr, coffee_page_t page)
@@ -243,10 +335,9 @@ absolute_offset(coffee_page_t page, cfs_offset_t offset)
 }
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
-get_sector_status(uint16_t sector, struct sector_status *stats)
+get_sector_status(uint16_t sector, struct sector_status *stats,
+                  struct sector_iterator *iterator)
 {
-  static coffee_page_t skip_pages;
-  static char last_pages_are_active;
   struct file_header hdr;
   coffee_page_t active, obsolete, free;
   coffee_page_t sector_start, sector_end;
@@ -256,13 +347,14 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
   active = obsolete = free = 0;
 
   /*
-   * get_sector_status() is an iterative function using local static 
-   * state. It therefore requires that the caller starts iterating from 
-   * sector 0 in order to reset the internal state.
+   * get_sector_status() is an iterative function using the state in
+   * the iterator. It therefore requires that the caller starts 
+   * iterating from sector 0 in order to reset the state, and that the
+   * pages are not allocated or erased during the iteration.
    */
   if(sector == 0) {
-    skip_pages = 0;
-    last_pages_are_active = 0;
+    iterator->skip_pages = 0;
+    iterator->last_pages_are_active = 0;
   }
 
   sector_start = sector * COFFEE_PAGES_PER_SECTOR;
@@ -273,29 +365,30 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
    * segment that extends into this segment. If the whole segment is 
    * covered, we do not need to continue counting pages in this iteration.
    */
-  if(last_pages_are_active) {
-    if(skip_pages >= COFFEE_PAGES_PER_SECTOR) {
+  if(iterator->last_pages_are_active) {
+    if(iterator->skip_pages >= COFFEE_PAGES_PER_SECTOR) {
       stats->active = COFFEE_PAGES_PER_SECTOR;
-      skip_pages -= COFFEE_PAGES_PER_SECTOR;
+      iterator->skip_pages -= COFFEE_PAGES_PER_SECTOR;
       return 0;
     }
-    active = skip_pages;
+    active = iterator->skip_pages;
   } else {
-    if(skip_pages >= COFFEE_PAGES_PER_SECTOR) {
+    if(iterator->skip_pages >= COFFEE_PAGES_PER_SECTOR) {
       stats->obsolete = COFFEE_PAGES_PER_SECTOR;
-      skip_pages -= COFFEE_PAGES_PER_SECTOR;
-      return skip_pages >= COFFEE_PAGES_PER_SECTOR ? 0 : skip_pages;
+      iterator->skip_pages -= COFFEE_PAGES_PER_SECTOR;
+      return iterator->skip_pages >= COFFEE_PAGES_PER_SECTOR ?
+             0 : iterator->skip_pages;
     }
-    obsolete = skip_pages;
+    obsolete = iterator->skip_pages;
   }
 
   /* Determine the amount of pages of each type that have not been 
      accounted for yet in the current sector. */
-  for(page = sector_start + skip_pages; page < sector_end;) {
+  for(page = sector_start + iterator->skip_pages; page < sector_end;) {
     read_header(&hdr, page);
-    last_pages_are_active = 0;
+    iterator->last_pages_are_active = 0;
     if(HDR_ACTIVE(hdr)) {
-      last_pages_are_active = 1;
+      iterator->last_pages_are_active = 1;
       page += hdr.max_pages;
       active += hdr.max_pages;
     } else if(HDR_ISOLATED(hdr)) {
@@ -318,9 +411,9 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
    * amount is that there is no need to read in the headers of each 
    * of these pages from the storage.
    */
-  skip_pages = active + obsolete + free - COFFEE_PAGES_PER_SECTOR;
-  if(skip_pages > 0) {
-    if(last_pages_are_active) {
+  iterator->skip_pages = active + obsolete + free - COFFEE_PAGES_PER_SECTOR;
+  if(iterator->skip_pages > 0) {
+    if(iterator->last_pages_are_active) {
       active = COFFEE_PAGES_PER_SECTOR - obsolete;
     } else {
       obsolete = COFFEE_PAGES_PER_SECTOR - active;
@@ -338,8 +431,9 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
    * sector, however, the garbage collection can free the next sector 
    * immediately without requiring page isolation. 
    */
-  return (last_pages_are_active || (skip_pages >= COFFEE_PAGES_PER_SECTOR)) ?
-	0 : skip_pages;
+  return (iterator->last_pages_are_active ||
+          (iterator->skip_pages >= COFFEE_PAGES_PER_SECTOR)) ?
+	0 : iterator->skip_pages;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -362,48 +456,76 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
 
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Erase a sector if it is garbage according to the mode. Returns 0 if
+ * the sector was kept, 1 if it was erased, and 2 if it was erased and
+ * pages had to be isolated in the following sector.
+ */
+static int
+collect_sector(uint16_t sector, int mode, struct sector_iterator *iterator)
+{
+  struct sector_status stats;
+  coffee_page_t first_page, isolation_count;
+
+  isolation_count = get_sector_status(sector, &stats, iterator);
+  PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
+      sector, (unsigned)stats.active,
+      (unsigned)stats.obsolete, (unsigned)stats.free);
+
+  if(stats.active > 0) {
+    return 0;
+  }
+
+  if((mode == GC_RELUCTANT && stats.free == 0) ||
+     (mode == GC_GREEDY && stats.obsolete > 0)) {
+    first_page = sector * COFFEE_PAGES_PER_SECTOR;
+    if(first_page < *next_free) {
+      *next_free = first_page;
+    }
+
+    if(isolation_count > 0) {
+      isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+    }
+
+    COFFEE_ERASE(sector);
+    GC_CHANGED();
+    PRINTF("Coffee: Erased sector %d!\n", sector);
+
+    return isolation_count > 0 ? 2 : 1;
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 static void
 collect_garbage(int mode)
 {
   uint16_t sector;
-  struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  struct sector_iterator iterator = { 0, 0 };
+  clock_time_t start;
+  int result;
 
   PRINTF("Coffee: Running the file system garbage collector in %s mode\n",
 	 mode == GC_RELUCTANT ? "reluctant" : "greedy");
+
+  start = clock_time();
+
   /*
    * The garbage collector erases as many sectors as possible. A sector is
    * erasable if there are only free or obsolete pages in it.
    */
   for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
-    isolation_count = get_sector_status(sector, &stats);
-    PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
-        sector, (unsigned)stats.active,
-	(unsigned)stats.obsolete, (unsigned)stats.free);
-
-    if(stats.active > 0) {
-      continue;
-    }
-
-    if((mode == GC_RELUCTANT && stats.free == 0) ||
-       (mode == GC_GREEDY && stats.obsolete > 0)) {
-      first_page = sector * COFFEE_PAGES_PER_SECTOR;
-      if(first_page < *next_free) {
-        *next_free = first_page;
-      }
-
-      if(isolation_count > 0) {
-        isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
-      }
-
-      COFFEE_ERASE(sector);
-      PRINTF("Coffee: Erased sector %d!\n", sector);
-
-      if(mode == GC_RELUCTANT && isolation_count > 0) {
+    result = collect_sector(sector, mode, &iterator);
+    if(result > 0) {
+      gc_stats.sync_sectors++;
+      if(mode == GC_RELUCTANT && result > 1) {
         break;
       }
     }
   }
+
+  gc_stats.sync_collections++;
+  gc_stats.sync_ticks += clock_time() - start;
 }
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
@@ -591,6 +713,9 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   write_header(&hdr, page);
 
   *gc_wait = 0;
+#if COFFEE_INCREMENTAL_GC
+  gc_pending = 1;
+#endif
 
   /* Close all file descriptors that reference the removed file. */
   if(close_fds) {
@@ -599,6 +724,15 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
 	coffee_fd_set[i].flags = COFFEE_FD_FREE;
       }
     }
+#if COFFEE_WRITE_BUFFERS
+    /* The buffered data of the removed file is discarded. */
+    for(i = 0; i < COFFEE_WRITE_BUFFERS; i++) {
+      if(write_buffers[i].fdp != NULL &&
+         write_buffers[i].fdp->flags == COFFEE_FD_FREE) {
+        write_buffers[i].fdp = NULL;
+      }
+    }
+#endif /* COFFEE_WRITE_BUFFERS */
   }
 
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
@@ -615,6 +749,10 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   }
 #endif
 
+#if COFFEE_INCREMENTAL_GC
+  gc_notify();
+#endif
+
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -655,6 +793,7 @@ reserve(const char *name, coffee_page_t pages,
   hdr.max_pages = pages;
   hdr.flags = HDR_FLAG_ALLOCATED | flags;
   write_header(&hdr, page);
+  GC_CHANGED();
 
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
       pages, page, name);
@@ -664,6 +803,10 @@ reserve(const char *name, coffee_page_t pages,
     file->end = 0;
   }
 
+#if COFFEE_INCREMENTAL_GC
+  gc_notify();
+#endif
+
   return file;
 }
 /*---------------------------------------------------------------------------*/
@@ -931,6 +1074,7 @@ write_log_page(struct file *file, struct log_param *lp)
     if(log_record >= log_records) {
       /* The log is full; merge the log. */
       PRINTF("Coffee: Merging the file %s with its log\n", hdr.name);
+      write_stats.merges++;
       return merge_log(file->page, 0);
     }
   } else {
@@ -973,6 +1117,7 @@ write_log_page(struct file *file, struct log_param *lp)
     COFFEE_WRITE(copy_buf, sizeof(copy_buf),
 		 offset + log_record * log_record_size);
     file->record_count = log_record + 1;
+    write_stats.log_records++;
   }
 
   return lp->size;
@@ -997,6 +1142,20 @@ cfs_open(const char *name, int flags)
 {
   int fd;
   struct file_desc *fdp;
+#if COFFEE_WRITE_BUFFERS
+  struct file *file;
+#endif
+
+#if COFFEE_WRITE_BUFFERS
+  /*
+   * Flush before a file descriptor is taken, because merging the log
+   * of the file opens and closes descriptors, and may move the file.
+   */
+  file = find_file(name);
+  if(file != NULL && flush_file(file) < 0) {
+    return -1;
+  }
+#endif
 
   fd = get_available_fd();
   if(fd < 0) {
@@ -1032,6 +1191,13 @@ void
 cfs_close(int fd)
 {
   if(FD_VALID(fd)) {
+#if COFFEE_WRITE_BUFFERS
+    /* cfs_close() cannot return an error, so a failed flush is only
+       counted in the write statistics. */
+    if(flush_fd(&coffee_fd_set[fd]) < 0) {
+      PRINTF("Coffee: Lost the buffered data of fd %d on close\n", fd);
+    }
+#endif
     coffee_fd_set[fd].flags = COFFEE_FD_FREE;
     coffee_fd_set[fd].file->references--;
     coffee_fd_set[fd].file = NULL;
@@ -1042,17 +1208,29 @@ cfs_offset_t
 cfs_seek(int fd, cfs_offset_t offset, int whence)
 {
   struct file_desc *fdp;
-  cfs_offset_t new_offset;
+  cfs_offset_t new_offset, end;
+#if COFFEE_WRITE_BUFFERS
+  struct write_buffer *wb;
+#endif
 
   if(!FD_VALID(fd)) {
     return -1;
   }
   fdp = &coffee_fd_set[fd];
+  end = fdp->file->end;
+
+#if COFFEE_WRITE_BUFFERS
+  /* The buffered data is not yet included in the file end. */
+  wb = find_buffer(fdp->file);
+  if(wb != NULL && wb->offset + wb->length > end) {
+    end = wb->offset + wb->length;
+  }
+#endif
 
   if(whence == CFS_SEEK_SET) {
     new_offset = offset;
   } else if(whence == CFS_SEEK_END) {
-    new_offset = fdp->file->end + offset;
+    new_offset = end + offset;
   } else if(whence == CFS_SEEK_CUR) {
     new_offset = fdp->offset + offset;
   } else {
@@ -1063,7 +1241,20 @@ cfs_seek(int fd, cfs_offset_t offset, int whence)
     return -1;
   }
 
-  if(fdp->file->end < new_offset) {
+#if COFFEE_WRITE_BUFFERS
+  /*
+   * Keep the buffer if the next write may continue the buffered data,
+   * as when a caller seeks to the position it is writing at.
+   */
+  if(wb != NULL &&
+     (new_offset < wb->offset || new_offset > wb->offset + wb->length)) {
+    if(flush_buffer(wb) < 0) {
+      return -1;
+    }
+  }
+#endif
+
+  if(end < new_offset) {
     fdp->file->end = new_offset;
   }
 
@@ -1106,6 +1297,12 @@ cfs_read(int fd, void *buf, unsigned size)
   }
 
   fdp = &coffee_fd_set[fd];
+#if COFFEE_WRITE_BUFFERS
+  if(flush_file(fdp->file) < 0) {
+    return -1;
+  }
+#endif
+  /* A flush that merged the log has moved the file. */
   file = fdp->file;
   if(fdp->offset + size > file->end) {
     size = file->end - fdp->offset;
@@ -1146,10 +1343,9 @@ cfs_read(int fd, void *buf, unsigned size)
   return size;
 }
 /*---------------------------------------------------------------------------*/
-int
-cfs_write(int fd, const void *buf, unsigned size)
+static int
+write_file(struct file_desc *fdp, const void *buf, unsigned size)
 {
-  struct file_desc *fdp;
   struct file *file;
 #if COFFEE_MICRO_LOGS
   int i;
@@ -1158,11 +1354,6 @@ cfs_write(int fd, const void *buf, unsigned size)
   const char dummy[1] = { 0xff };
 #endif
 
-  if(!(FD_VALID(fd) && FD_WRITABLE(fd))) {
-    return -1;
-  }
-
-  fdp = &coffee_fd_set[fd];
   file = fdp->file;
 
   /* Attempt to extend the file if we try to write past the end. */
@@ -1241,6 +1432,203 @@ cfs_write(int fd, const void *buf, unsigned size)
   return size;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_WRITE_BUFFERS
+static int
+flush_buffer(struct write_buffer *wb)
+{
+  struct file_desc *fdp;
+  cfs_offset_t offset;
+  unsigned long log_records;
+  int r;
+#if COFFEE_MICRO_LOGS
+  static unsigned long avoided_records;
+  struct file_header hdr;
+  uint16_t log_record_size, records_per_log;
+#endif
+
+  fdp = wb->fdp;
+  wb->fdp = NULL;
+  if(wb->length == 0) {
+    return 0;
+  }
+
+  write_stats.flushes++;
+  log_records = write_stats.log_records;
+
+  /* The file descriptor offset is already past the buffered data. */
+  offset = fdp->offset;
+  fdp->offset = wb->offset;
+  r = write_file(fdp, wb->data, wb->length);
+  fdp->offset = offset;
+  if(r < 0) {
+    write_stats.failed_flushes++;
+    return -1;
+  }
+
+  /* Without the buffer, each write would have produced a log record. */
+  log_records = write_stats.log_records - log_records;
+  if(log_records > 0 && wb->writes > log_records) {
+    write_stats.log_records_avoided += wb->writes - log_records;
+
+#if COFFEE_MICRO_LOGS
+    /* Estimate the merges avoided from the size of the file's log. */
+    read_header(&hdr, fdp->file->page);
+    adjust_log_config(&hdr, &log_record_size, &records_per_log);
+    avoided_records += wb->writes - log_records;
+    write_stats.merges_avoided += avoided_records / records_per_log;
+    avoided_records %= records_per_log;
+#endif /* COFFEE_MICRO_LOGS */
+  }
+
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+flush_fd(struct file_desc *fdp)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_WRITE_BUFFERS; i++) {
+    if(write_buffers[i].fdp == fdp) {
+      return flush_buffer(&write_buffers[i]);
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct write_buffer *
+find_buffer(struct file *file)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_WRITE_BUFFERS; i++) {
+    if(write_buffers[i].fdp != NULL && write_buffers[i].fdp->file == file) {
+      return &write_buffers[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+flush_file(struct file *file)
+{
+  struct write_buffer *wb;
+
+  wb = find_buffer(file);
+  return wb != NULL ? flush_buffer(wb) : 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns 1 if the data was buffered, 0 if it has to be written
+   directly, and -1 if buffered data could not be flushed. */
+static int
+buffer_write(struct file_desc *fdp, const void *buf, unsigned size)
+{
+  struct file *file;
+  struct write_buffer *wb;
+  int i;
+
+  file = fdp->file;
+
+  /* Only small writes that do not require the file to be extended
+     are buffered. */
+  if(size >= COFFEE_WRITE_BUFFER_SIZE ||
+     fdp->offset + size + sizeof(struct file_header) >
+     file->max_pages * COFFEE_PAGE_SIZE) {
+    return 0;
+  }
+#if COFFEE_APPEND_ONLY
+  if(fdp->offset < file->end) {
+    return 0;
+  }
+#endif /* COFFEE_APPEND_ONLY */
+
+  /*
+   * A file has at most one write buffer, so that the writes through
+   * different file descriptors reach the storage in order.
+   */
+  wb = NULL;
+  for(i = 0; i < COFFEE_WRITE_BUFFERS; i++) {
+    if(write_buffers[i].fdp == NULL) {
+      if(wb == NULL) {
+        wb = &write_buffers[i];
+      }
+    } else if(write_buffers[i].fdp->file == file) {
+      wb = &write_buffers[i];
+      if(wb->fdp != fdp ||
+         wb->offset + wb->length != fdp->offset ||
+         wb->length + size > sizeof(wb->data)) {
+        if(flush_buffer(wb) < 0) {
+          return -1;
+        }
+      }
+      break;
+    }
+  }
+
+  if(wb == NULL) {
+    /* All buffers are used by other files. */
+    return 0;
+  }
+
+  if(wb->fdp == NULL) {
+    wb->fdp = fdp;
+    wb->offset = fdp->offset;
+    wb->length = 0;
+    wb->writes = 0;
+  }
+
+  memcpy(&wb->data[wb->length], buf, size);
+  wb->length += size;
+  wb->writes++;
+  fdp->offset += size;
+  write_stats.buffered_writes++;
+
+  return 1;
+}
+#endif /* COFFEE_WRITE_BUFFERS */
+/*---------------------------------------------------------------------------*/
+int
+cfs_write(int fd, const void *buf, unsigned size)
+{
+  struct file_desc *fdp;
+
+  if(!(FD_VALID(fd) && FD_WRITABLE(fd))) {
+    return -1;
+  }
+
+  fdp = &coffee_fd_set[fd];
+
+#if COFFEE_WRITE_BUFFERS
+  switch(buffer_write(fdp, buf, size)) {
+  case 1:
+    return size;
+  case 0:
+    if(flush_file(fdp->file) == 0) {
+      break;
+    }
+    /* Fall through. */
+  default:
+    return -1;
+  }
+#endif /* COFFEE_WRITE_BUFFERS */
+
+  return write_file(fdp, buf, size);
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_coffee_flush(int fd)
+{
+  if(!FD_VALID(fd)) {
+    return -1;
+  }
+
+#if COFFEE_WRITE_BUFFERS
+  return flush_fd(&coffee_fd_set[fd]);
+#else
+  return 0;
+#endif
+}
+/*---------------------------------------------------------------------------*/
 int
 cfs_opendir(struct cfs_dir *dir, const char *name)
 {
@@ -1249,6 +1637,20 @@ cfs_opendir(struct cfs_dir *dir, const char *name)
    * currently enforce this.
    */
   memset(dir->dummy_space, 0, sizeof(coffee_page_t));
+
+#if COFFEE_WRITE_BUFFERS
+  {
+    int i;
+
+    /* The file sizes are read from the storage. */
+    for(i = 0; i < COFFEE_WRITE_BUFFERS; i++) {
+      if(write_buffers[i].fdp != NULL) {
+        flush_buffer(&write_buffers[i]);
+      }
+    }
+  }
+#endif /* COFFEE_WRITE_BUFFERS */
+
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -1350,6 +1752,13 @@ cfs_coffee_format(void)
 
   /* Formatting invalidates the file information. */
   memset(&protected_mem, 0, sizeof(protected_mem));
+#if COFFEE_WRITE_BUFFERS
+  memset(write_buffers, 0, sizeof(write_buffers));
+#endif
+  GC_CHANGED();
+#if COFFEE_INCREMENTAL_GC
+  gc_pending = 0;
+#endif
 
   PRINTF(" done!\n");
 
@@ -1362,3 +1771,92 @@ cfs_coffee_get_protected_mem(unsigned *size)
   *size = sizeof(protected_mem);
   return &protected_mem;
 }
+/*---------------------------------------------------------------------------*/
+void
+cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats)
+{
+  memcpy(stats, &gc_stats, sizeof(*stats));
+}
+/*---------------------------------------------------------------------------*/
+void
+cfs_coffee_get_write_stats(struct cfs_coffee_write_stats *stats)
+{
+  memcpy(stats, &write_stats, sizeof(*stats));
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_INCREMENTAL_GC
+static void
+gc_notify(void)
+{
+  /* Wake up the garbage collector only when files have been removed and
+     the free space at the end of the storage is running out. */
+  if(!gc_pending ||
+     COFFEE_SECTOR_COUNT - *next_free / COFFEE_PAGES_PER_SECTOR >=
+     COFFEE_GC_THRESHOLD) {
+    return;
+  }
+
+  if(!process_is_running(&coffee_gc_process)) {
+    process_start(&coffee_gc_process, NULL);
+  }
+  process_poll(&coffee_gc_process);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  static struct etimer busy_timer;
+  static struct sector_iterator iterator;
+  static uint16_t sector;
+  static uint8_t generation;
+  clock_time_t start;
+  unsigned count;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    while(gc_pending) {
+      gc_pending = 0;
+      gc_stats.passes++;
+      PRINTF("Coffee: Starting a background garbage collection pass\n");
+
+      generation = gc_generation;
+      for(sector = 0; sector < COFFEE_SECTOR_COUNT;) {
+        /* Give way to other processes that have events to handle. */
+        if(process_nevents() > 0) {
+          etimer_set(&busy_timer, COFFEE_GC_BUSY_INTERVAL);
+          PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&busy_timer));
+          continue;
+        }
+
+        /* The sector iteration has to be restarted if the file system
+           has allocated or erased pages since the last time slice. */
+        if(generation != gc_generation) {
+          generation = gc_generation;
+          sector = 0;
+        }
+
+        /* Examine a bounded number of sectors and erase at most one. */
+        for(count = 0;
+            count < COFFEE_GC_SLICE_SECTORS && sector < COFFEE_SECTOR_COUNT;
+            count++) {
+          start = clock_time();
+          if(collect_sector(sector++, GC_GREEDY, &iterator) > 0) {
+            generation = gc_generation;
+            *gc_wait = 0;
+            gc_stats.reclaimed_sectors++;
+            gc_stats.background_ticks += clock_time() - start;
+            break;
+          }
+        }
+        gc_stats.slices++;
+
+        PROCESS_PAUSE();
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+#endif /* COFFEE_INCREMENTAL_GC */
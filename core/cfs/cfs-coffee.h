@@ -138,6 +138,84 @@ int cfs_coffee_format(void);
  */
 void *cfs_coffee_get_protected_mem(unsigned *size);
 
+/**
+ * Garbage collection statistics. The tick counters are measured
+ * with clock_time().
+ */
+struct cfs_coffee_gc_stats {
+  /** Background passes over the sectors. */
+  unsigned long passes;
+  /** Background time slices. */
+  unsigned long slices;
+  /** Sectors erased by the background garbage collector. */
+  unsigned long reclaimed_sectors;
+  /** Ticks spent erasing sectors in the background, i.e., the stall
+      time avoided in the file operations. */
+  unsigned long background_ticks;
+  /** Synchronous garbage collections done by file operations. */
+  unsigned long sync_collections;
+  /** Sectors erased by the synchronous garbage collections. */
+  unsigned long sync_sectors;
+  /** Ticks spent by file operations in synchronous garbage collection. */
+  unsigned long sync_ticks;
+};
+
+/**
+ * \brief Flush the write buffer of a file descriptor.
+ * \param fd The file descriptor.
+ * \return 0 on success, -1 on failure.
+ *
+ * When Coffee is compiled with COFFEE_WRITE_BUFFERS, contiguous small
+ * writes through a file descriptor are coalesced in RAM before they
+ * are written to the storage. The buffer is flushed automatically
+ * when it fills up, when the file is read, seeked in, or written
+ * through another file descriptor, and when the file descriptor is
+ * closed. This function forces the data out, e.g., before a
+ * checkpoint or a reboot.
+ *
+ * Since cfs_close() cannot report errors, a caller that must know
+ * whether the buffered data reached the storage should call this
+ * function before closing the file descriptor.
+ */
+int cfs_coffee_flush(int fd);
+
+/**
+ * Write statistics.
+ */
+struct cfs_coffee_write_stats {
+  /** Writes that were coalesced in a write buffer. */
+  unsigned long buffered_writes;
+  /** Write buffers that were flushed to the storage. */
+  unsigned long flushes;
+  /** Write buffers whose data could not be written to the storage,
+      and was discarded. */
+  unsigned long failed_flushes;
+  /** Log records written. */
+  unsigned long log_records;
+  /** Log records that the write buffers saved. */
+  unsigned long log_records_avoided;
+  /** Merges of files with their full logs. */
+  unsigned long merges;
+  /** An estimate of the merges that the write buffers saved. */
+  unsigned long merges_avoided;
+};
+
+/**
+ * \brief Get the write statistics.
+ * \param stats A pointer to a structure that receives the statistics.
+ */
+void cfs_coffee_get_write_stats(struct cfs_coffee_write_stats *stats);
+
+/**
+ * \brief Get the garbage collection statistics.
+ * \param stats A pointer to a structure that receives the statistics.
+ *
+ * The background counters are zero unless Coffee has been compiled
+ * with COFFEE_INCREMENTAL_GC, in which case a process reclaims
+ * obsolete sectors in bounded time slices while the system is idle.
+ */
+void cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats);
+
 /** @} */
 /** @} */
 
@@ -172,6 +172,12 @@ CCIF int cfs_open(const char *name, int flags);
  *
  *             This function closes a file that has previously been
  *             opened with cfs_open().
+ *
+ *             A file system that buffers writes stores the buffered
+ *             data when the file is closed. Since this function
+ *             cannot report errors, a caller that needs to know
+ *             whether the data was stored should flush it before
+ *             closing the file, e.g., with cfs_coffee_flush().
  */
 #ifndef cfs_close
 CCIF void cfs_close(int fd);
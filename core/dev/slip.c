@@ -59,6 +59,19 @@ uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
 #define SLIP_STATISTICS(statement) statement
 #endif
 
+#ifdef SLIP_CONF_ARCH_WRITE
+#define SLIP_ARCH_WRITE SLIP_CONF_ARCH_WRITE
+#else /* SLIP_CONF_ARCH_WRITE */
+#define SLIP_ARCH_WRITE 0
+#endif /* SLIP_CONF_ARCH_WRITE */
+
+/* The size of the output buffer handed to slip_arch_write(). */
+#ifdef SLIP_CONF_TX_BUFSIZE
+#define SLIP_TX_BUFSIZE SLIP_CONF_TX_BUFSIZE
+#else /* SLIP_CONF_TX_BUFSIZE */
+#define SLIP_TX_BUFSIZE 64
+#endif /* SLIP_CONF_TX_BUFSIZE */
+
 /* Must be at least one byte larger than UIP_BUFSIZE! */
 #define RX_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN + 16)
 
@@ -93,24 +106,86 @@ slip_set_input_callback(void (*c)(void))
   input_callback = c;
 }
 /*---------------------------------------------------------------------------*/
-/* slip_send: forward (IPv4) packets with {UIP_FW_NETIF(..., slip_send)}
- * was used in slip-bridge.c
+/*
+ * Encode as much of [in, in + *len) as fits into [out, out + size),
+ * without the SLIP_END framing. On return *len is the number of input
+ * bytes consumed; the return value is the number of bytes written.
  */
-//#if WITH_UIP
-uint8_t
-slip_send(void)
+static uint16_t
+encode(const uint8_t *in, uint16_t *len, uint8_t *out, uint16_t size)
 {
-  uint16_t i;
-  uint8_t *ptr;
+  const uint8_t *p, *e;
+  uint8_t *o, *oe;
   uint8_t c;
 
-  slip_arch_writeb(SLIP_END);
+  p = in;
+  e = in + *len;
+  o = out;
+  oe = out + size;
+  while(p < e && o < oe) {
+    c = *p;
+    if(c == SLIP_END || c == SLIP_ESC) {
+      if(oe - o < 2) {
+        break;
+      }
+      *o++ = SLIP_ESC;
+      c = c == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+    }
+    *o++ = c;
+    p++;
+  }
+  *len = p - in;
+  return o - out;
+}
+/*---------------------------------------------------------------------------*/
+#if SLIP_ARCH_WRITE
+/*
+ * Output is encoded into txbuf and handed to slip_arch_write() when
+ * the buffer is full and at the end of each packet.
+ */
+static uint8_t txbuf[SLIP_TX_BUFSIZE];
+static uint16_t txlen;
 
-  ptr = &uip_buf[UIP_LLH_LEN];
-  for(i = 0; i < uip_len; ++i) {
-    if(i == UIP_TCPIP_HLEN) {
-      ptr = (uint8_t *)uip_appdata;
+static void
+tx_flush(void)
+{
+  if(txlen > 0) {
+    slip_arch_write(txbuf, txlen);
+    txlen = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_data(const uint8_t *ptr, uint16_t len)
+{
+  uint16_t n;
+
+  while(len > 0) {
+    n = len;
+    txlen += encode(ptr, &n, &txbuf[txlen], SLIP_TX_BUFSIZE - txlen);
+    ptr += n;
+    len -= n;
+    if(len > 0) {
+      tx_flush();
     }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_end(void)
+{
+  if(txlen == SLIP_TX_BUFSIZE) {
+    tx_flush();
+  }
+  txbuf[txlen++] = SLIP_END;
+}
+#else /* SLIP_ARCH_WRITE */
+static void
+tx_data(const uint8_t *ptr, uint16_t len)
+{
+  uint8_t c;
+
+  while(len-- > 0) {
     c = *ptr++;
     if(c == SLIP_END) {
       slip_arch_writeb(SLIP_ESC);
@@ -121,7 +196,36 @@ slip_send(void)
     }
     slip_arch_writeb(c);
   }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_end(void)
+{
   slip_arch_writeb(SLIP_END);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_flush(void)
+{
+}
+#endif /* SLIP_ARCH_WRITE */
+/*---------------------------------------------------------------------------*/
+/* slip_send: forward (IPv4) packets with {UIP_FW_NETIF(..., slip_send)}
+ * was used in slip-bridge.c
+ */
+//#if WITH_UIP
+uint8_t
+slip_send(void)
+{
+  uint16_t hdrlen;
+
+  hdrlen = uip_len < UIP_TCPIP_HLEN ? uip_len : UIP_TCPIP_HLEN;
+
+  tx_end();
+  tx_data(&uip_buf[UIP_LLH_LEN], hdrlen);
+  tx_data((uint8_t *)uip_appdata, uip_len - hdrlen);
+  tx_end();
+  tx_flush();
 
   return UIP_FW_OK;
 }
@@ -130,26 +234,111 @@ slip_send(void)
 uint8_t
 slip_write(const void *_ptr, int len)
 {
-  const uint8_t *ptr = _ptr;
-  uint16_t i;
-  uint8_t c;
+  tx_end();
+  tx_data(_ptr, len);
+  tx_end();
+  tx_flush();
 
-  slip_arch_writeb(SLIP_END);
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_encode(const void *data, int len, uint8_t *out, int size)
+{
+  uint16_t n, outlen;
 
-  for(i = 0; i < len; ++i) {
-    c = *ptr++;
-    if(c == SLIP_END) {
-      slip_arch_writeb(SLIP_ESC);
-      c = SLIP_ESC_END;
-    } else if(c == SLIP_ESC) {
-      slip_arch_writeb(SLIP_ESC);
-      c = SLIP_ESC_ESC;
-    }
-    slip_arch_writeb(c);
+  if(size < 2) {
+    return 0;
   }
-  slip_arch_writeb(SLIP_END);
+  n = len;
+  out[0] = SLIP_END;
+  outlen = 1 + encode(data, &n, &out[1], size - 2);
+  if(n != len) {
+    return 0;
+  }
+  out[outlen++] = SLIP_END;
+  return outlen;
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_decoder_init(struct slip_decoder *d, uint8_t *buf, uint16_t size)
+{
+  d->buf = buf;
+  d->size = size;
+  d->len = 0;
+  d->state = STATE_OK;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_decode(struct slip_decoder *d, const uint8_t **data, int *len)
+{
+  const uint8_t *p, *e, *run;
+  uint16_t n;
+  uint8_t c;
 
-  return len;
+  p = *data;
+  e = p + *len;
+  while(p < e) {
+    if(d->state == STATE_OK) {
+      /* Copy the bytes up to the next control character in one go. */
+      run = p;
+      while(p < e && *p != SLIP_END && *p != SLIP_ESC) {
+        p++;
+      }
+      n = p - run;
+      if(n > d->size - d->len) {
+        d->state = STATE_RUBBISH;
+        d->len = 0;
+        SLIP_STATISTICS(slip_overflow++);
+        continue;
+      }
+      memcpy(&d->buf[d->len], run, n);
+      d->len += n;
+      if(p == e) {
+        break;
+      }
+      if(*p++ == SLIP_ESC) {
+        d->state = STATE_ESC;
+      } else if(d->len > 0) {
+        n = d->len;
+        d->len = 0;
+        *len -= p - *data;
+        *data = p;
+        return n;
+      }
+    } else if(d->state == STATE_ESC) {
+      c = *p++;
+      if(c == SLIP_ESC_END) {
+        c = SLIP_END;
+      } else if(c == SLIP_ESC_ESC) {
+        c = SLIP_ESC;
+      } else {
+        d->state = STATE_RUBBISH;
+        d->len = 0;
+        SLIP_STATISTICS(slip_rubbish++);
+        continue;
+      }
+      if(d->len == d->size) {
+        d->state = STATE_RUBBISH;
+        d->len = 0;
+        SLIP_STATISTICS(slip_overflow++);
+        continue;
+      }
+      d->buf[d->len++] = c;
+      d->state = STATE_OK;
+    } else {
+      /* Skip to the end of the broken packet. */
+      run = memchr(p, SLIP_END, e - p);
+      if(run == NULL) {
+        break;
+      }
+      p = run + 1;
+      d->state = STATE_OK;
+    }
+  }
+  *data = e;
+  *len = 0;
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -393,3 +582,58 @@ slip_input_byte(unsigned char c)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+int
+slip_input(const uint8_t *buf, int len)
+{
+  const uint8_t *p, *e, *run;
+  uint16_t n, space, first;
+  int wake;
+
+  wake = 0;
+  p = buf;
+  e = buf + len;
+  while(p < e) {
+    if(state == STATE_RUBBISH) {
+      /* Skip to the end of the broken packet. */
+      run = memchr(p, SLIP_END, e - p);
+      if(run == NULL) {
+        break;
+      }
+      p = run;
+    } else if(state == STATE_TWOPACKETS) {
+      break;
+    } else if(state == STATE_OK) {
+      run = p;
+      while(p < e && *p != SLIP_END && *p != SLIP_ESC) {
+        p++;
+      }
+      n = p - run;
+      if(n > 0) {
+        /* Copy the bytes up to the next control character in one go. */
+        space = (begin > end ? begin : begin + RX_BUFSIZE) - end - 1;
+        if(n > space) {		/* rxbuf is full */
+          state = STATE_RUBBISH;
+          SLIP_STATISTICS(slip_overflow++);
+          end = pkt_end;	/* remove rubbish */
+          continue;
+        }
+        first = RX_BUFSIZE - end;
+        if(first > n) {
+          first = n;
+        }
+        memcpy(&rxbuf[end], run, first);
+        memcpy(&rxbuf[0], run + first, n - first);
+        end = end + n < RX_BUFSIZE ? end + n : end + n - RX_BUFSIZE;
+
+        if(rxbuf[begin] == 'C' && memchr(run, 'T', n) != NULL) {
+          process_poll(&slip_process);
+          wake = 1;
+        }
+        continue;
+      }
+    }
+    wake |= slip_input_byte(*p++);
+  }
+  return wake;
+}
+/*---------------------------------------------------------------------------*/
@@ -62,8 +62,77 @@ uint8_t slip_send(void);
  */
 int slip_input_byte(unsigned char c);
 
+/**
+ * Input a block of SLIP bytes.
+ *
+ * This function does the same as calling slip_input_byte() for each
+ * byte in the buffer, but copies the bytes between SLIP control
+ * characters into the receive buffer in one go. It is meant for
+ * UARTs that receive into a DMA buffer and for ports that read the
+ * serial line in blocks. Like slip_input_byte(), it can be called
+ * from an interrupt context, and at most two packets are buffered
+ * until slip_process has run; further packets are dropped.
+ *
+ * \param buf The received bytes
+ * \param len The number of bytes in buf
+ *
+ * \return Non-zero if the CPU should be powered up, zero otherwise.
+ */
+int slip_input(const uint8_t *buf, int len);
+
 uint8_t slip_write(const void *ptr, int len);
 
+/**
+ * A SLIP decoder with a buffer of its own, for code that receives
+ * SLIP outside of slip_process, e.g., a native program that reads a
+ * serial port or a pty.
+ */
+struct slip_decoder {
+  uint8_t *buf;
+  uint16_t size;
+  uint16_t len;
+  uint8_t state;
+};
+
+void slip_decoder_init(struct slip_decoder *d, uint8_t *buf, uint16_t size);
+
+/**
+ * Decode SLIP bytes until a packet is complete.
+ *
+ * The function consumes input up to and including the end of the
+ * next complete packet and returns its length; the packet is in
+ * d->buf until the next call. When all input has been consumed
+ * without completing a packet, the function returns zero and keeps
+ * the partial packet for the next block of input. Packets that do not
+ * fit in the buffer or contain an invalid escape are dropped. A
+ * receive loop looks like:
+ *
+ * \code
+ * while((n = slip_decode(&d, &data, &len)) > 0) {
+ *   handle_packet(d.buf, n);
+ * }
+ * \endcode
+ *
+ * \param d The decoder
+ * \param data Pointer to the input, advanced past the consumed bytes
+ * \param len Pointer to the input length, decreased accordingly
+ *
+ * \return The length of a complete packet, or zero.
+ */
+int slip_decode(struct slip_decoder *d, const uint8_t **data, int *len);
+
+/** The largest size of a SLIP-encoded packet of len bytes. */
+#define SLIP_ENCODED_MAXLEN(len) (2 * (len) + 2)
+
+/**
+ * Encode a packet, including the SLIP_END bytes around it, into a
+ * buffer, e.g., for a DMA transfer.
+ *
+ * \return The length of the encoded packet, or zero if it did not
+ *         fit in size bytes.
+ */
+int slip_encode(const void *data, int len, uint8_t *out, int size);
+
 /* Did we receive any bytes lately? */
 extern uint8_t slip_active;
 
@@ -83,4 +152,13 @@ void slip_set_input_callback(void (*callback)(void));
 void slip_arch_init(unsigned long ubr);
 void slip_arch_writeb(unsigned char c);
 
+/*
+ * Platforms that can write a block of bytes at once, e.g., with DMA,
+ * define SLIP_CONF_ARCH_WRITE to 1 and provide this function as well;
+ * slip_send() and slip_write() then encode into a buffer of
+ * SLIP_CONF_TX_BUFSIZE bytes and write it with one call. The function
+ * must not return before buf can be reused.
+ */
+void slip_arch_write(const uint8_t *buf, int len);
+
 #endif /* __SLIP_H__ */
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Big ring buffer library implementation
+ */
+
+#include <string.h>
+
+#include "lib/bigringbuf.h"
+
+/*
+ * The producer must not make new elements visible before their data
+ * is written, and the consumer must not hand space back before it
+ * has read the data there. RELEASE() orders the accesses before it
+ * before the index update that follows; ACQUIRE() orders the index
+ * read before it before the accesses that follow. A compiler barrier
+ * is enough between an interrupt handler and the code it interrupts,
+ * but threads on different CPUs need fences.
+ */
+#ifdef BIGRINGBUF_CONF_BARRIER
+#define ACQUIRE() BIGRINGBUF_CONF_BARRIER()
+#define RELEASE() BIGRINGBUF_CONF_BARRIER()
+#elif defined(__GNUC__) && \
+  (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#elif defined(__GNUC__)
+#define ACQUIRE() __asm__ __volatile__("" : : : "memory")
+#define RELEASE() __asm__ __volatile__("" : : : "memory")
+#else
+#define ACQUIRE()
+#define RELEASE()
+#endif /* BIGRINGBUF_CONF_BARRIER */
+/*---------------------------------------------------------------------------*/
+void
+bigringbuf_init(struct bigringbuf *r, uint8_t *dataptr,
+                bigringbuf_index_t size)
+{
+  r->data = dataptr;
+  r->mask = size - 1;
+  r->put_ptr = 0;
+  r->get_ptr = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+bigringbuf_put(struct bigringbuf *r, uint8_t c)
+{
+  bigringbuf_index_t put, get;
+
+  put = r->put_ptr;
+  get = r->get_ptr;
+  ACQUIRE();
+  if((bigringbuf_index_t)(put - get) > r->mask) {
+    return 0;
+  }
+  r->data[put & r->mask] = c;
+  RELEASE();
+  r->put_ptr = put + 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+bigringbuf_get(struct bigringbuf *r)
+{
+  bigringbuf_index_t put, get;
+  uint8_t c;
+
+  get = r->get_ptr;
+  put = r->put_ptr;
+  ACQUIRE();
+  if(put == get) {
+    return -1;
+  }
+  c = r->data[get & r->mask];
+  RELEASE();
+  r->get_ptr = get + 1;
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+bigringbuf_index_t
+bigringbuf_put_span(struct bigringbuf *r, uint8_t **ptr)
+{
+  bigringbuf_index_t put, get, space, contiguous;
+
+  put = r->put_ptr;
+  get = r->get_ptr;
+  ACQUIRE();
+  space = r->mask + 1 - (bigringbuf_index_t)(put - get);
+  contiguous = r->mask + 1 - (put & r->mask);
+  *ptr = &r->data[put & r->mask];
+  return space < contiguous ? space : contiguous;
+}
+/*---------------------------------------------------------------------------*/
+void
+bigringbuf_put_commit(struct bigringbuf *r, bigringbuf_index_t len)
+{
+  RELEASE();
+  r->put_ptr = r->put_ptr + len;
+}
+/*---------------------------------------------------------------------------*/
+bigringbuf_index_t
+bigringbuf_get_span(struct bigringbuf *r, uint8_t **ptr)
+{
+  bigringbuf_index_t put, get, elements, contiguous;
+
+  get = r->get_ptr;
+  put = r->put_ptr;
+  ACQUIRE();
+  elements = put - get;
+  contiguous = r->mask + 1 - (get & r->mask);
+  *ptr = &r->data[get & r->mask];
+  return elements < contiguous ? elements : contiguous;
+}
+/*---------------------------------------------------------------------------*/
+void
+bigringbuf_get_commit(struct bigringbuf *r, bigringbuf_index_t len)
+{
+  RELEASE();
+  r->get_ptr = r->get_ptr + len;
+}
+/*---------------------------------------------------------------------------*/
+bigringbuf_index_t
+bigringbuf_write(struct bigringbuf *r, const uint8_t *data,
+                 bigringbuf_index_t len)
+{
+  bigringbuf_index_t n, written;
+  uint8_t *ptr;
+
+  written = 0;
+  while(written < len && (n = bigringbuf_put_span(r, &ptr)) > 0) {
+    if(n > len - written) {
+      n = len - written;
+    }
+    memcpy(ptr, data + written, n);
+    bigringbuf_put_commit(r, n);
+    written += n;
+  }
+  return written;
+}
+/*---------------------------------------------------------------------------*/
+bigringbuf_index_t
+bigringbuf_read(struct bigringbuf *r, uint8_t *data, bigringbuf_index_t len)
+{
+  bigringbuf_index_t n, read;
+  uint8_t *ptr;
+
+  read = 0;
+  while(read < len && (n = bigringbuf_get_span(r, &ptr)) > 0) {
+    if(n > len - read) {
+      n = len - read;
+    }
+    memcpy(data + read, ptr, n);
+    bigringbuf_get_commit(r, n);
+    read += n;
+  }
+  return read;
+}
+/*---------------------------------------------------------------------------*/
+bigringbuf_index_t
+bigringbuf_size(struct bigringbuf *r)
+{
+  return r->mask + 1;
+}
+/*---------------------------------------------------------------------------*/
+bigringbuf_index_t
+bigringbuf_elements(struct bigringbuf *r)
+{
+  return r->put_ptr - r->get_ptr;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,210 @@
+/** \addtogroup lib
+ * @{ */
+
+/**
+ * \defgroup bigringbuf Ring buffer library with bulk access
+ * @{
+ *
+ * The big ring buffer library is a variant of the \ref ringbuf "ring
+ * buffer library" for buffers larger than 128 bytes and for drivers
+ * that move data in blocks, e.g., with DMA or with read() and write()
+ * on the native platform. Apart from byte-wise and copying block
+ * access, it lets a producer write into, and a consumer read from,
+ * the buffer memory directly: the producer reserves a contiguous span
+ * of free space, fills it, and commits it; the consumer gets a
+ * contiguous span of data, processes it, and commits it.
+ *
+ * One producer and one consumer can use a buffer concurrently, for
+ * example an interrupt handler and a process, or two threads on the
+ * native platform, without locking. The data written by the producer
+ * is visible to the consumer before the elements are, and the
+ * consumer is done with the data before the space is handed back to
+ * the producer. This requires that the buffer indices are read and
+ * written atomically, which holds for the default 16-bit indices on
+ * 16-bit and 32-bit CPUs; use the 8-bit ring buffer library on 8-bit
+ * CPUs.
+ */
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Header file for the big ring buffer library
+ */
+
+#ifndef __BIGRINGBUF_H__
+#define __BIGRINGBUF_H__
+
+#include "contiki-conf.h"
+
+/*
+ * The type of the buffer indices. A buffer can hold at most half as
+ * many bytes as the type can count, i.e., 32768 bytes with 16-bit
+ * indices. Set to uint32_t for larger buffers on 32-bit CPUs.
+ */
+#ifdef BIGRINGBUF_CONF_INDEX_TYPE
+typedef BIGRINGBUF_CONF_INDEX_TYPE bigringbuf_index_t;
+#else /* BIGRINGBUF_CONF_INDEX_TYPE */
+typedef uint16_t bigringbuf_index_t;
+#endif /* BIGRINGBUF_CONF_INDEX_TYPE */
+
+/**
+ * \brief      Structure that holds the state of a big ring buffer.
+ *
+ *             This structure holds the state of a ring buffer. The
+ *             actual buffer needs to be defined separately. This
+ *             struct is an opaque structure with no user-visible
+ *             elements.
+ *
+ */
+struct bigringbuf {
+  uint8_t *data;
+  bigringbuf_index_t mask;
+
+  /* Free-running counts of the bytes written and read. put_ptr is
+     only written by the producer and get_ptr only by the consumer. */
+  volatile bigringbuf_index_t put_ptr, get_ptr;
+};
+
+/**
+ * \brief      Initialize a big ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param a    A pointer to an array to hold the data in the buffer
+ * \param size_power_of_two The size of the ring buffer, which must be a power of two
+ *
+ *             This function initiates a ring buffer. The data in the
+ *             buffer is stored in an external array, to which a
+ *             pointer must be supplied. The size of the ring buffer
+ *             must be a power of two and at most half the range of
+ *             bigringbuf_index_t.
+ *
+ */
+void    bigringbuf_init(struct bigringbuf *r, uint8_t *a,
+                        bigringbuf_index_t size_power_of_two);
+
+/**
+ * \brief      Insert a byte into the ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param c    The byte to be written to the buffer
+ * \return     Non-zero if the data could be written, or zero if the buffer was full.
+ */
+int     bigringbuf_put(struct bigringbuf *r, uint8_t c);
+
+/**
+ * \brief      Get a byte from the ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \return     The data from the buffer, or -1 if the buffer was empty
+ */
+int     bigringbuf_get(struct bigringbuf *r);
+
+/**
+ * \brief      Copy bytes into the ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param data The bytes to be written to the buffer
+ * \param len  The number of bytes
+ * \return     The number of bytes written, which is less than len if the buffer became full
+ */
+bigringbuf_index_t bigringbuf_write(struct bigringbuf *r, const uint8_t *data,
+                                    bigringbuf_index_t len);
+
+/**
+ * \brief      Copy bytes out of the ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param data A buffer for the bytes
+ * \param len  The size of the buffer
+ * \return     The number of bytes read, which is less than len if the buffer became empty
+ */
+bigringbuf_index_t bigringbuf_read(struct bigringbuf *r, uint8_t *data,
+                                   bigringbuf_index_t len);
+
+/**
+ * \brief      Reserve contiguous free space in the ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param ptr  Set to point to the free space
+ * \return     The number of contiguous free bytes at *ptr, or zero if the buffer is full
+ *
+ *             This function lets the producer write directly into
+ *             the buffer, e.g., by pointing a DMA transfer or a
+ *             read() call at it. The bytes become visible to the
+ *             consumer when they are committed with
+ *             bigringbuf_put_commit(). The free space may wrap
+ *             around the end of the buffer, in which case a second
+ *             call after the commit returns the rest of it.
+ *
+ */
+bigringbuf_index_t bigringbuf_put_span(struct bigringbuf *r, uint8_t **ptr);
+
+/**
+ * \brief      Commit bytes written into a reserved span
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param len  The number of bytes written, at most the size of the span
+ */
+void    bigringbuf_put_commit(struct bigringbuf *r, bigringbuf_index_t len);
+
+/**
+ * \brief      Get contiguous data from the ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param ptr  Set to point to the data
+ * \return     The number of contiguous bytes at *ptr, or zero if the buffer is empty
+ *
+ *             This function lets the consumer process the data in
+ *             place. The bytes stay in the buffer until they are
+ *             released with bigringbuf_get_commit().
+ *
+ */
+bigringbuf_index_t bigringbuf_get_span(struct bigringbuf *r, uint8_t **ptr);
+
+/**
+ * \brief      Release bytes obtained with bigringbuf_get_span()
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \param len  The number of bytes consumed, at most the size of the span
+ */
+void    bigringbuf_get_commit(struct bigringbuf *r, bigringbuf_index_t len);
+
+/**
+ * \brief      Get the size of a ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \return     The size of the buffer.
+ */
+bigringbuf_index_t bigringbuf_size(struct bigringbuf *r);
+
+/**
+ * \brief      Get the number of elements currently in the ring buffer
+ * \param r    A pointer to a struct bigringbuf to hold the state of the ring buffer
+ * \return     The number of elements in the buffer.
+ */
+bigringbuf_index_t bigringbuf_elements(struct bigringbuf *r);
+
+#endif /* __BIGRINGBUF_H__ */
+
+/** @} */
+/** @} */
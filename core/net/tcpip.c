@@ -80,6 +80,28 @@ process_event_t tcpip_icmp6_event;
 /* Periodic check of active connections. */
 static struct etimer periodic;
 
+/* The interval at which uIP counts down the TCP connections' timers. */
+#define TCP_TIMER_INTERVAL (CLOCK_SECOND / 2)
+
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS && UIP_CONF_IP_FORWARD
+/* The periodic timer only runs for the TCP connections' deadlines, so
+   the forwarding cache is aged by a timer of its own. */
+static struct etimer fw_periodic;
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS && UIP_CONF_IP_FORWARD */
+
+#if UIP_RX_QUEUE
+/* The receive queue: a ring of packet buffers, of which rx_queue_count
+   packets starting at rx_queue_get wait to be processed. */
+struct rx_packet {
+  uint16_t len;
+  uint8_t buf[UIP_BUFSIZE];
+};
+static struct rx_packet rx_queue[UIP_RX_QUEUE];
+static uint8_t rx_queue_get, rx_queue_count;
+
+static void rx_queue_process(void);
+#endif /* UIP_RX_QUEUE */
+
 #if UIP_CONF_IPV6 && UIP_CONF_IPV6_REASSEMBLY
 /* Timer for reassembly. */
 extern struct etimer uip_reass_timer;
@@ -155,6 +177,11 @@ unsigned char tcpip_is_forwarding; /* Forwarding right now? */
 PROCESS(tcpip_process, "TCP/IP stack");
 
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS
+/* The periodic timer is set for the next connection timer to expire
+   instead, see tcp_timers_update(). */
+#define start_periodic_tcp_timer()
+#else /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
 static void
 start_periodic_tcp_timer(void)
 {
@@ -162,6 +189,7 @@ start_periodic_tcp_timer(void)
     etimer_restart(&periodic);
   }
 }
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
 /*---------------------------------------------------------------------------*/
 static void
 check_for_tcp_syn(void)
@@ -178,9 +206,205 @@ check_for_tcp_syn(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_SEND_WINDOW
+static void
+send_window(void)
+{
+  struct uip_conn *conn;
+
+  /* uIP produces one segment at a time, so we keep polling the
+     connection while it can send more from its send window. */
+  conn = uip_conn;
+  while(conn != NULL && uip_tcp_window_pending(conn)) {
+    uip_poll_conn(conn);
+    if(uip_len == 0) {
+      break;
+    }
+    tcpip_ipv6_output();
+  }
+}
+#else /* UIP_TCP && UIP_TCP_SEND_WINDOW */
+#define send_window()
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS
+/* The connections' timers count TCP_TIMER_INTERVAL ticks. Rather than
+   ticking all connections, we age their timers by the ticks that have
+   passed whenever the stack runs, and set the periodic timer for the
+   tick on which the first of them expires. tcp_timers_time is the
+   start of the current tick, and tcp_timers_next is when the periodic
+   timer expires, if tcp_timers_pending is set. */
+static clock_time_t tcp_timers_time;
+static clock_time_t tcp_timers_next;
+static uint8_t tcp_timers_pending;
+
+/* The connections whose timers have expired, to be processed by
+   tcp_timers_run(). */
+static uint8_t tcp_timers_due[(UIP_CONNS + 7) / 8];
+
+/* Connection timers never run for more than this many ticks. */
+#define TCP_TIMERS_MAX_TICKS 256
+
+/* Returns the number of ticks until uip_periodic() times out or
+   retransmits on the connection, or 0 if it would only poll it. */
+static uint16_t
+tcp_timer_ticks(struct uip_conn *conn)
+{
+  if(conn->tcpstateflags == UIP_TIME_WAIT ||
+     conn->tcpstateflags == UIP_FIN_WAIT_2) {
+    return UIP_TIME_WAIT_TIMEOUT - conn->timer;
+  } else if(conn->tcpstateflags != UIP_CLOSED && uip_outstanding(conn)) {
+    return conn->timer + 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_timers_age(void)
+{
+  struct uip_conn *conn;
+  clock_time_t ticks;
+  uint16_t left;
+  uint8_t i;
+
+  ticks = (clock_time() - tcp_timers_time) / TCP_TIMER_INTERVAL;
+  if(ticks == 0) {
+    return;
+  }
+  tcp_timers_time += ticks * TCP_TIMER_INTERVAL;
+
+  /* uip_periodic() is no longer called on every tick to advance the
+     initial sequence number, so advance it by the ticks that have
+     passed. */
+  uip_add_iss(ticks);
+
+  for(i = 0; i < UIP_CONNS; ++i) {
+    conn = &uip_conns[i];
+    left = tcp_timer_ticks(conn);
+    if(left == 0) {
+      continue;
+    }
+    if(left <= ticks) {
+      /* Leave the timer on its last tick, so that uip_periodic()
+         expires it when tcp_timers_run() gets to the connection. */
+      tcp_timers_due[i >> 3] |= 1 << (i & 7);
+      left = left - 1;
+    } else {
+      left = ticks;
+    }
+    if(conn->tcpstateflags == UIP_TIME_WAIT ||
+       conn->tcpstateflags == UIP_FIN_WAIT_2) {
+      conn->timer += left;
+    } else {
+      conn->timer -= left;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_timers_run(void)
+{
+  struct uip_conn *conn;
+  uint8_t i;
+
+  for(i = 0; i < UIP_CONNS; ++i) {
+    if((tcp_timers_due[i >> 3] & (1 << (i & 7))) == 0) {
+      continue;
+    }
+    tcp_timers_due[i >> 3] &= ~(1 << (i & 7));
+    conn = &uip_conns[i];
+    /* The connection may have been acknowledged or closed since its
+       timer expired. */
+    if(tcp_timer_ticks(conn) != 1) {
+      continue;
+    }
+    UIP_STAT(++uip_stat.tcp.timers);
+    uip_periodic_conn(conn);
+#if UIP_CONF_IPV6
+    tcpip_ipv6_output();
+    send_window();
+#else
+    if(uip_len > 0) {
+      tcpip_output();
+    }
+#endif /* UIP_CONF_IPV6 */
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_timers_set(uint16_t ticks)
+{
+  clock_time_t now;
+
+  tcp_timers_pending = 1;
+  tcp_timers_next = tcp_timers_time + ticks * TCP_TIMER_INTERVAL;
+  now = clock_time();
+  if((clock_time_t)(tcp_timers_next - now) <=
+     TCP_TIMERS_MAX_TICKS * TCP_TIMER_INTERVAL) {
+    etimer_set(&periodic, tcp_timers_next - now);
+  } else {
+    etimer_set(&periodic, 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_timers_schedule(void)
+{
+  struct uip_conn *conn;
+  uint16_t ticks, next;
+
+  next = 0;
+  for(conn = &uip_conns[0]; conn < &uip_conns[UIP_CONNS]; ++conn) {
+    ticks = tcp_timer_ticks(conn);
+    if(ticks != 0 && (next == 0 || ticks < next)) {
+      next = ticks;
+    }
+  }
+  tcp_timers_pending = 0;
+  if(next != 0) {
+    tcp_timers_set(next);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_timers_update(struct uip_conn *conn)
+{
+  clock_time_t next;
+  uint16_t ticks;
+
+  next = 0;
+  if(tcp_timers_pending) {
+    next = (clock_time_t)(tcp_timers_next - tcp_timers_time) /
+      TCP_TIMER_INTERVAL;
+    if(next == 0 || next > TCP_TIMERS_MAX_TICKS) {
+      /* The periodic timer is behind, so the connections it was set
+         for have just been processed, and it must be set anew. */
+      tcp_timers_schedule();
+      return;
+    }
+  }
+
+  /* Only the connection's timer can have changed, so it is enough to
+     check if it expires before the periodic timer. */
+  if(conn != NULL) {
+    ticks = tcp_timer_ticks(conn);
+    if(ticks != 0 && (next == 0 || ticks < next)) {
+      tcp_timers_set(ticks);
+    }
+  }
+}
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
+/*---------------------------------------------------------------------------*/
 static void
 packet_input(void)
 {
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS
+  struct uip_conn *conn;
+
+  /* Bring the timers up to date before uIP uses them, e.g., to
+     measure the round-trip time. */
+  tcp_timers_age();
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
 #if UIP_CONF_IP_FORWARD
   if(uip_len > 0) {
     tcpip_is_forwarding = 1;
@@ -194,6 +418,7 @@ packet_input(void)
 #else /* UIP_CONF_TCP_SPLIT */
 #if UIP_CONF_IPV6
         tcpip_ipv6_output();
+        send_window();
 #else
 	PRINTF("tcpip packet_input forward output len %d\n", uip_len);
         tcpip_output();
@@ -213,6 +438,7 @@ packet_input(void)
 #else /* UIP_CONF_TCP_SPLIT */
 #if UIP_CONF_IPV6
       tcpip_ipv6_output();
+      send_window();
 #else
       PRINTF("tcpip packet_input output len %d\n", uip_len);
       tcpip_output();
@@ -221,6 +447,11 @@ packet_input(void)
     }
   }
 #endif /* UIP_CONF_IP_FORWARD */
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS
+  conn = uip_conn;
+  tcp_timers_run();
+  tcp_timers_update(conn);
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
 }
 /*---------------------------------------------------------------------------*/
 #if UIP_TCP
@@ -230,6 +461,10 @@ tcp_connect(uip_ipaddr_t *ripaddr, uint16_t port, void *appstate)
 {
   struct uip_conn *c;
   
+#if UIP_TCP_EVENT_TIMERS
+  /* The new connection's timer starts now. */
+  tcp_timers_age();
+#endif /* UIP_TCP_EVENT_TIMERS */
   c = uip_connect(ripaddr, port);
   if(c == NULL) {
     return NULL;
@@ -411,7 +646,7 @@ eventhandler(process_event_t ev, process_data_t data)
         for(cptr = &uip_udp_conns[0];
             cptr < &uip_udp_conns[UIP_UDP_CONNS]; ++cptr) {
           if(cptr->appstate.p == p) {
-            cptr->lport = 0;
+            uip_udp_remove(cptr);
           }
         }
       }
@@ -426,14 +661,22 @@ eventhandler(process_event_t ev, process_data_t data)
         if(data == &periodic &&
            etimer_expired(&periodic)) {
 #if UIP_TCP
+          UIP_STAT(++uip_stat.tcp.wakeups);
+#if UIP_TCP_EVENT_TIMERS
+          tcp_timers_age();
+          tcp_timers_run();
+          tcp_timers_schedule();
+#else /* UIP_TCP_EVENT_TIMERS */
           for(i = 0; i < UIP_CONNS; ++i) {
             if(uip_conn_active(i)) {
               /* Only restart the timer if there are active
                  connections. */
               etimer_restart(&periodic);
+              UIP_STAT(++uip_stat.tcp.timers);
               uip_periodic(i);
 #if UIP_CONF_IPV6
               tcpip_ipv6_output();
+              send_window();
 #else
               if(uip_len > 0) {
 		PRINTF("tcpip_output from periodic len %d\n", uip_len);
@@ -443,11 +686,19 @@ eventhandler(process_event_t ev, process_data_t data)
 #endif /* UIP_CONF_IPV6 */
             }
           }
+#endif /* UIP_TCP_EVENT_TIMERS */
 #endif /* UIP_TCP */
-#if UIP_CONF_IP_FORWARD
+#if UIP_CONF_IP_FORWARD && !(UIP_TCP && UIP_TCP_EVENT_TIMERS)
           uip_fw_periodic();
-#endif /* UIP_CONF_IP_FORWARD */
+#endif /* UIP_CONF_IP_FORWARD && !(UIP_TCP && UIP_TCP_EVENT_TIMERS) */
         }
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS && UIP_CONF_IP_FORWARD
+        if(data == &fw_periodic &&
+           etimer_expired(&fw_periodic)) {
+          etimer_reset(&fw_periodic);
+          uip_fw_periodic();
+        }
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS && UIP_CONF_IP_FORWARD */
         
 #if UIP_CONF_IPV6
 #if UIP_CONF_IPV6_REASSEMBLY
@@ -488,9 +739,13 @@ eventhandler(process_event_t ev, process_data_t data)
 #if UIP_TCP
     case TCP_POLL:
       if(data != NULL) {
+#if UIP_TCP_EVENT_TIMERS
+        tcp_timers_age();
+#endif /* UIP_TCP_EVENT_TIMERS */
         uip_poll_conn(data);
 #if UIP_CONF_IPV6
         tcpip_ipv6_output();
+        send_window();
 #else /* UIP_CONF_IPV6 */
         if(uip_len > 0) {
 	  PRINTF("tcpip_output from tcp poll len %d\n", uip_len);
@@ -499,6 +754,10 @@ eventhandler(process_event_t ev, process_data_t data)
 #endif /* UIP_CONF_IPV6 */
         /* Start the periodic polling, if it isn't already active. */
         start_periodic_tcp_timer();
+#if UIP_TCP_EVENT_TIMERS
+        tcp_timers_run();
+        tcp_timers_update(data);
+#endif /* UIP_TCP_EVENT_TIMERS */
       }
       break;
 #endif /* UIP_TCP */
@@ -520,6 +779,12 @@ eventhandler(process_event_t ev, process_data_t data)
     case PACKET_INPUT:
       packet_input();
       break;
+
+#if UIP_RX_QUEUE
+    case PROCESS_EVENT_POLL:
+      rx_queue_process();
+      break;
+#endif /* UIP_RX_QUEUE */
   };
 }
 /*---------------------------------------------------------------------------*/
@@ -533,6 +798,79 @@ tcpip_input(void)
 #endif /*UIP_CONF_IPV6*/
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_RX_QUEUE
+void
+tcpip_queue_input(void)
+{
+  struct rx_packet *p;
+  uint16_t len;
+
+  if(rx_queue_count == UIP_RX_QUEUE) {
+    UIP_STAT(++uip_stat.ip.qdrop);
+    UIP_LOG("tcpip_queue_input: receive queue full");
+  } else {
+    p = &rx_queue[(rx_queue_get + rx_queue_count) % UIP_RX_QUEUE];
+    /* Depending on the driver, uip_len may or may not include the
+       link layer header. */
+    len = uip_len + UIP_LLH_LEN;
+    if(len > UIP_BUFSIZE) {
+      len = UIP_BUFSIZE;
+    }
+    memcpy(p->buf, uip_buf, len);
+    p->len = uip_len;
+    if(++rx_queue_count == 1) {
+      process_poll(&tcpip_process);
+    }
+#if UIP_STATISTICS
+    if(rx_queue_count > uip_stat.ip.qmax) {
+      uip_stat.ip.qmax = rx_queue_count;
+    }
+#endif /* UIP_STATISTICS */
+  }
+  uip_len = 0;
+#if UIP_CONF_IPV6
+  uip_ext_len = 0;
+#endif /*UIP_CONF_IPV6*/
+}
+/*---------------------------------------------------------------------------*/
+int
+tcpip_queue_full(void)
+{
+  return rx_queue_count == UIP_RX_QUEUE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rx_queue_process(void)
+{
+  struct rx_packet *p;
+  uint16_t len;
+  int n;
+
+  for(n = 0; n < UIP_RX_QUEUE_BATCH && rx_queue_count > 0; ++n) {
+    p = &rx_queue[rx_queue_get];
+    len = p->len + UIP_LLH_LEN;
+    if(len > UIP_BUFSIZE) {
+      len = UIP_BUFSIZE;
+    }
+    memcpy(uip_buf, p->buf, len);
+    uip_len = p->len;
+    rx_queue_get = (rx_queue_get + 1) % UIP_RX_QUEUE;
+    --rx_queue_count;
+
+    packet_input();
+    uip_len = 0;
+#if UIP_CONF_IPV6
+    uip_ext_len = 0;
+#endif /*UIP_CONF_IPV6*/
+  }
+
+  /* Let other processes run before the rest of the queue. */
+  if(rx_queue_count > 0) {
+    process_poll(&tcpip_process);
+  }
+}
+#endif /* UIP_RX_QUEUE */
+/*---------------------------------------------------------------------------*/
 #if UIP_CONF_IPV6
 void
 tcpip_ipv6_output(void)
@@ -758,7 +1096,14 @@ PROCESS_THREAD(tcpip_process, ev, data)
 #if UIP_CONF_ICMP6
   tcpip_icmp6_event = process_alloc_event();
 #endif /* UIP_CONF_ICMP6 */
-  etimer_set(&periodic, CLOCK_SECOND / 2);
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS
+  tcp_timers_time = clock_time();
+#if UIP_CONF_IP_FORWARD
+  etimer_set(&fw_periodic, TCP_TIMER_INTERVAL);
+#endif /* UIP_CONF_IP_FORWARD */
+#else /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
+  etimer_set(&periodic, TCP_TIMER_INTERVAL);
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
 
   uip_init();
 #ifdef UIP_FALLBACK_INTERFACE
@@ -335,6 +335,37 @@ CCIF extern process_event_t tcpip_event;
  */
 CCIF void tcpip_input(void);
 
+/**
+ * \brief      Queue an incoming packet for the TCP/IP stack
+ *
+ *             This function is called by network device drivers
+ *             instead of tcpip_input() to copy the packet in the
+ *             uip_buf buffer to the receive queue, if there is one
+ *             (UIP_CONF_RX_QUEUE), and return before the packet has
+ *             been processed. The packet is dropped if the queue is
+ *             full. Drivers for which the stack needs more than the
+ *             packet, e.g., the packetbuf attributes, must use
+ *             tcpip_input().
+ */
+#if UIP_RX_QUEUE
+void tcpip_queue_input(void);
+#else /* UIP_RX_QUEUE */
+#define tcpip_queue_input() tcpip_input()
+#endif /* UIP_RX_QUEUE */
+
+/**
+ * \brief      Check if the receive queue is full
+ *
+ *             A driver can read packets for as long as this returns
+ *             0. Without a receive queue, it always returns 1, so the
+ *             driver delivers one packet at a time.
+ */
+#if UIP_RX_QUEUE
+int tcpip_queue_full(void);
+#else /* UIP_RX_QUEUE */
+#define tcpip_queue_full() 1
+#endif /* UIP_RX_QUEUE */
+
 /**
  * \brief Output packet to layer 2
  * The eventual parameter is the MAC address of the destination.
@@ -366,6 +366,15 @@ uip_udpchksum(void)
 #endif /* UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS
+void
+uip_add_iss(uint16_t ticks)
+{
+  uip_add32(iss, ticks);
+  memcpy(iss, uip_acc32, sizeof(iss));
+}
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -389,6 +389,34 @@ void uip_setipid(uint16_t id);
 #define uip_poll_conn(conn) do { uip_conn = conn;       \
     uip_process(UIP_POLL_REQUEST); } while (0)
 
+#if UIP_TCP_EVENT_TIMERS
+/**
+ * Advance the TCP initial sequence number by a number of timer ticks.
+ *
+ * uip_periodic() increases the initial sequence number on every
+ * tick. When the TCP timers only run as they expire, the ticks that
+ * have passed in between are added with this function instead.
+ *
+ * \param ticks The number of ticks that have passed.
+ */
+void uip_add_iss(uint16_t ticks);
+#endif /* UIP_TCP_EVENT_TIMERS */
+
+#if UIP_TCP_SEND_WINDOW
+/**
+ * Check if a connection can send more from its send window.
+ *
+ * This function is true when the application's last data went into
+ * the send window, so that it may send more, or when a segment is to
+ * be retransmitted. The connection is then polled with
+ * uip_poll_conn() until this function is false or no packet is
+ * produced.
+ *
+ * \param conn A pointer to the uip_conn structure for the connection.
+ */
+int uip_tcp_window_pending(struct uip_conn *conn);
+#endif /* UIP_TCP_SEND_WINDOW */
+
 #endif /* UIP_TCP */
 
 #if UIP_UDP
@@ -834,7 +862,11 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH_SIZE
+#define uip_udp_remove(conn) uip_udp_set_lport(conn, 0)
+#else /* UIP_CONN_HASH_SIZE */
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif /* UIP_CONN_HASH_SIZE */
 
 /**
  * Bind a UDP connection to a local port.
@@ -846,7 +878,26 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH_SIZE
+#define uip_udp_bind(conn, port) uip_udp_set_lport(conn, port)
+
+/**
+ * Set the local port of a UDP connection.
+ *
+ * With UIP_CONF_CONN_HASH_SIZE, the local port must be changed with
+ * this function, through uip_udp_bind() and uip_udp_remove(), so that
+ * incoming datagrams find the connection.
+ *
+ * \param conn A pointer to the uip_udp_conn structure for the
+ * connection.
+ *
+ * \param port The local port number, in network byte order, or 0 to
+ * remove the connection.
+ */
+void uip_udp_set_lport(struct uip_udp_conn *conn, uint16_t port);
+#else /* UIP_CONN_HASH_SIZE */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_CONN_HASH_SIZE */
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1319,6 +1370,19 @@ struct uip_conn {
   uint8_t timer;         /**< The retransmission timer. */
   uint8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#if UIP_TCP_SEND_WINDOW
+  uint16_t snd_wnd;      /**< The window advertised by the remote host. */
+  uint16_t sndbuf_start; /**< The start of the outstanding data in
+                            sndbuf. */
+  uint16_t recover;      /**< The amount of outstanding data to be
+                            acknowledged before a loss is recovered. */
+  uint16_t rexmit_pos;   /**< The offset in the outstanding data of the
+                            next segment to retransmit. */
+  uint8_t dupacks;       /**< The number of duplicate ACKs received. */
+  uint8_t window_flags;  /**< Send window state flags. */
+  uint8_t *sndbuf;       /**< The retransmission buffer, holding len
+                            bytes of outstanding data. */
+#endif /* UIP_TCP_SEND_WINDOW */
 
   /** The application state. */
   uip_tcp_appstate_t appstate;
@@ -1419,6 +1483,10 @@ struct uip_stats {
 			     checksum errors. */
     uip_stats_t protoerr; /**< Number of packets dropped because they
 			     were neither ICMP, UDP nor TCP. */
+    uip_stats_t qdrop;    /**< Number of packets dropped because the
+			     receive queue was full. */
+    uip_stats_t qmax;     /**< Largest number of packets in the receive
+			     queue. */
   } ip;                   /**< IP statistics. */
   struct {
     uip_stats_t recv;     /**< Number of received ICMP packets. */
@@ -1444,6 +1512,9 @@ struct uip_stats {
 			     connections were available. */
     uip_stats_t synrst;   /**< Number of SYNs for closed ports,
 			     triggering a RST. */
+    uip_stats_t wakeups;  /**< Number of times the TCP timer ran. */
+    uip_stats_t timers;   /**< Number of connections processed by the
+			     TCP timer. */
   } tcp;                  /**< TCP statistics. */
 #endif
 #if UIP_UDP
@@ -254,6 +254,175 @@ struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 /** @} */
 
+#if UIP_CONN_HASH_SIZE
+/*---------------------------------------------------------------------------*/
+/** @{ \name Connection hash tables                                          */
+/*---------------------------------------------------------------------------*/
+/* Each bucket holds the index of its first entry, and the entries are
+   chained through the next arrays. */
+#define HASH_END      0xff
+#define HASH_UNLINKED 0xfe
+
+#define HASH_MASK (UIP_CONN_HASH_SIZE - 1)
+
+/* Multiplies by 2^16 / phi, so that the middle bits of the result
+   depend on all bits of h. */
+static uint8_t
+hash_mix(uint16_t h)
+{
+  return ((uint16_t)(h * 40503u) >> 8) & HASH_MASK;
+}
+#define port_hash(port) hash_mix(port)
+/*---------------------------------------------------------------------------*/
+/* Unlinks entry i from the bucket that starts at *head. */
+static void
+hash_unlink(uint8_t *head, uint8_t *next, uint8_t i)
+{
+  while(*head != i) {
+    if(*head == HASH_END) {
+      return;
+    }
+    head = &next[*head];
+  }
+  *head = next[i];
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP
+#if UIP_CONNS >= HASH_UNLINKED || UIP_LISTENPORTS >= HASH_UNLINKED
+#error "UIP_CONF_CONN_HASH_SIZE requires fewer than 254 connections"
+#endif
+
+/* Connections are linked into the bucket for their addresses and
+   ports when they are opened, and stay there after they are closed
+   until they are opened again. */
+static uint8_t tcp_hash[UIP_CONN_HASH_SIZE];
+static uint8_t tcp_hash_next[UIP_CONNS];
+
+static uint8_t listen_hash[UIP_CONN_HASH_SIZE];
+static uint8_t listen_hash_next[UIP_LISTENPORTS];
+
+static uint8_t
+tcp_hash_of(uint16_t lport, uint16_t rport, const uip_ipaddr_t *ripaddr)
+{
+  uint16_t a;
+
+  /* The address is rotated by a byte, so that consecutive addresses
+     and ports do not cancel out. */
+  a = ripaddr->u16[6] ^ ripaddr->u16[7];
+  return hash_mix(lport ^ rport ^ (uint16_t)((a << 8) | (a >> 8)));
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_hash_remove(struct uip_conn *conn)
+{
+  uint8_t i = conn - uip_conns;
+
+  if(tcp_hash_next[i] != HASH_UNLINKED) {
+    hash_unlink(&tcp_hash[tcp_hash_of(conn->lport, conn->rport,
+                                      &conn->ripaddr)],
+                tcp_hash_next, i);
+    tcp_hash_next[i] = HASH_UNLINKED;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tcp_hash_add(struct uip_conn *conn)
+{
+  uint8_t i = conn - uip_conns;
+  uint8_t h = tcp_hash_of(conn->lport, conn->rport, &conn->ripaddr);
+
+  tcp_hash_next[i] = tcp_hash[h];
+  tcp_hash[h] = i;
+}
+/*---------------------------------------------------------------------------*/
+/* Finds the open connection for the incoming segment. */
+static struct uip_conn *
+tcp_hash_find(void)
+{
+  struct uip_conn *conn;
+  uint8_t i;
+
+  for(i = tcp_hash[tcp_hash_of(UIP_TCP_BUF->destport, UIP_TCP_BUF->srcport,
+                               &UIP_IP_BUF->srcipaddr)];
+      i != HASH_END; i = tcp_hash_next[i]) {
+    conn = &uip_conns[i];
+    if(conn->tcpstateflags != UIP_CLOSED &&
+       UIP_TCP_BUF->destport == conn->lport &&
+       UIP_TCP_BUF->srcport == conn->rport &&
+       uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &conn->ripaddr)) {
+      return conn;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+listen_hash_find(uint16_t port)
+{
+  uint8_t i;
+
+  for(i = listen_hash[port_hash(port)]; i != HASH_END;
+      i = listen_hash_next[i]) {
+    if(uip_listenports[i] == port) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* UIP_TCP */
+/*---------------------------------------------------------------------------*/
+#if UIP_UDP
+#if UIP_UDP_CONNS >= HASH_UNLINKED
+#error "UIP_CONF_CONN_HASH_SIZE requires fewer than 254 UDP connections"
+#endif
+
+/* UDP connections with a local port are linked into the bucket for
+   that port, in the order of uip_udp_conns, so that the first
+   matching connection is found as without the hash table. */
+static uint8_t udp_hash[UIP_CONN_HASH_SIZE];
+static uint8_t udp_hash_next[UIP_UDP_CONNS];
+
+void
+uip_udp_set_lport(struct uip_udp_conn *conn, uint16_t port)
+{
+  uint8_t i = conn - uip_udp_conns;
+  uint8_t *head;
+
+  if(conn->lport != 0) {
+    hash_unlink(&udp_hash[port_hash(conn->lport)], udp_hash_next, i);
+  }
+  conn->lport = port;
+  if(port != 0) {
+    for(head = &udp_hash[port_hash(port)]; *head < i;
+        head = &udp_hash_next[*head]);
+    udp_hash_next[i] = *head;
+    *head = i;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Finds the first UDP connection for the incoming datagram. */
+static struct uip_udp_conn *
+udp_hash_find(void)
+{
+  struct uip_udp_conn *conn;
+  uint8_t i;
+
+  for(i = udp_hash[port_hash(UIP_UDP_BUF->destport)]; i != HASH_END;
+      i = udp_hash_next[i]) {
+    conn = &uip_udp_conns[i];
+    if(UIP_UDP_BUF->destport == conn->lport &&
+       (conn->rport == 0 || UIP_UDP_BUF->srcport == conn->rport) &&
+       (uip_is_addr_unspecified(&conn->ripaddr) ||
+        uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &conn->ripaddr))) {
+      return conn;
+    }
+  }
+  return NULL;
+}
+#endif /* UIP_UDP */
+/** @} */
+#endif /* UIP_CONN_HASH_SIZE */
+
 /*---------------------------------------------------------------------------*/
 /** @{ \name ICMPv6 variables                                                */
 /*---------------------------------------------------------------------------*/
@@ -296,6 +465,230 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #endif /* UIP_ARCH_ADD32 && UIP_TCP */
 
+#if UIP_TCP && UIP_TCP_SEND_WINDOW
+/*---------------------------------------------------------------------------*/
+/** \name TCP send window
+ * @{
+ */
+#define SNDBUF_SIZE (UIP_TCP_SEND_WINDOW * UIP_TCP_MSS)
+
+#define WINDOW_ACCEPTED 0x01 /* The application's data went into the
+                                window, tell it with UIP_ACKDATA. */
+#define WINDOW_REFUSED  0x02 /* The window was full, have the application
+                                send its data again with UIP_REXMIT. */
+#define WINDOW_REXMIT   0x04 /* Retransmit the outstanding data from
+                                rexmit_pos on. */
+#define WINDOW_CLOSE    0x08 /* The application has closed, send the FIN
+                                when all data has been acknowledged. */
+
+/* The retransmission buffers of the connections. */
+static uint8_t sndbufs[UIP_CONNS][SNDBUF_SIZE];
+
+/* The offset from snd_nxt of the segment being sent. */
+static uint16_t snd_offset;
+/*---------------------------------------------------------------------------*/
+static void
+window_init(struct uip_conn *conn)
+{
+  conn->sndbuf = sndbufs[conn - uip_conns];
+  conn->snd_wnd = 0;
+  conn->sndbuf_start = 0;
+  conn->recover = 0;
+  conn->rexmit_pos = 0;
+  conn->dupacks = 0;
+  conn->window_flags = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+seqno32(const uint8_t *seqno)
+{
+  return ((uint32_t)seqno[0] << 24) | ((uint32_t)seqno[1] << 16) |
+    ((uint32_t)seqno[2] << 8) | seqno[3];
+}
+/*---------------------------------------------------------------------------*/
+/* The amount of data that the application may send right now. */
+static uint16_t
+window_room(struct uip_conn *conn)
+{
+  uint16_t room;
+
+  room = conn->snd_wnd > conn->len ? conn->snd_wnd - conn->len : 0;
+  if(conn->len == 0 && room < conn->mss) {
+    /* As without a send window, one segment is always allowed so that
+       a zero window is probed with retransmissions. */
+    room = conn->mss;
+  }
+  if(room > SNDBUF_SIZE - conn->len) {
+    room = SNDBUF_SIZE - conn->len;
+  }
+  return room;
+}
+/*---------------------------------------------------------------------------*/
+/* The flags to call the application with when the window has changed. */
+static uint8_t
+window_appflags(struct uip_conn *conn)
+{
+  uint8_t flags;
+
+  flags = 0;
+  if(conn->window_flags & WINDOW_ACCEPTED) {
+    conn->window_flags &= ~WINDOW_ACCEPTED;
+    flags |= UIP_ACKDATA;
+  }
+  if((conn->window_flags & WINDOW_REFUSED) &&
+     window_room(conn) >= conn->mss) {
+    conn->window_flags &= ~WINDOW_REFUSED;
+    flags |= UIP_REXMIT;
+  }
+  return flags;
+}
+/*---------------------------------------------------------------------------*/
+/* Copy the application's data in uip_sappdata into the window. */
+static void
+window_accept(struct uip_conn *conn)
+{
+  uint16_t pos, n;
+
+  if(uip_slen > conn->mss) {
+    uip_slen = conn->mss;
+  }
+  if(uip_slen > window_room(conn)) {
+    conn->window_flags |= WINDOW_REFUSED;
+    uip_slen = 0;
+    return;
+  }
+
+  pos = conn->sndbuf_start + conn->len;
+  if(pos >= SNDBUF_SIZE) {
+    pos -= SNDBUF_SIZE;
+  }
+  n = SNDBUF_SIZE - pos;
+  if(n > uip_slen) {
+    n = uip_slen;
+  }
+  memcpy(&conn->sndbuf[pos], uip_sappdata, n);
+  memcpy(&conn->sndbuf[0], (uint8_t *)uip_sappdata + n, uip_slen - n);
+
+  if(conn->len == 0) {
+    conn->timer = conn->rto;
+  }
+  conn->window_flags |= WINDOW_ACCEPTED;
+  if(conn->window_flags & WINDOW_REXMIT) {
+    /* The data is sent when the retransmissions get to it. */
+    conn->len += uip_slen;
+    uip_slen = 0;
+  } else {
+    snd_offset = conn->len;
+    conn->len += uip_slen;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Copy the next segment to retransmit to uip_sappdata and return its
+   length. */
+static uint16_t
+window_rexmit(struct uip_conn *conn)
+{
+  uint16_t pos, len, n;
+
+  len = conn->len - conn->rexmit_pos;
+  if(len > conn->mss) {
+    len = conn->mss;
+  }
+  pos = conn->sndbuf_start + conn->rexmit_pos;
+  if(pos >= SNDBUF_SIZE) {
+    pos -= SNDBUF_SIZE;
+  }
+  n = SNDBUF_SIZE - pos;
+  if(n > len) {
+    n = len;
+  }
+  memcpy(uip_sappdata, &conn->sndbuf[pos], n);
+  memcpy((uint8_t *)uip_sappdata + n, &conn->sndbuf[0], len - n);
+
+  snd_offset = conn->rexmit_pos;
+  conn->rexmit_pos += len;
+  if(conn->rexmit_pos >= conn->len) {
+    conn->window_flags &= ~WINDOW_REXMIT;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* Start over from the first outstanding segment. All of the
+   outstanding data is retransmitted, as uIP and many other small
+   stacks drop the segments that arrive after a lost one. */
+static void
+window_go_back(struct uip_conn *conn)
+{
+  conn->recover = conn->len;
+  conn->rexmit_pos = 0;
+  conn->dupacks = 0;
+  conn->window_flags |= WINDOW_REXMIT;
+}
+/*---------------------------------------------------------------------------*/
+/* Process a cumulative ACK for the data in the window. */
+static void
+window_ack(struct uip_conn *conn)
+{
+  uint32_t acked;
+  uint16_t wnd;
+  signed char m;
+
+  acked = seqno32(UIP_TCP_BUF->ackno) - seqno32(conn->snd_nxt);
+  wnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + UIP_TCP_BUF->wnd[1];
+
+  if(acked > 0 && acked <= conn->len) {
+    /* Do RTT estimation, unless we have done retransmissions. */
+    if(conn->nrtx == 0) {
+      m = conn->rto - conn->timer;
+      m = m - (conn->sa >> 3);
+      conn->sa += m;
+      if(m < 0) {
+        m = -m;
+      }
+      m = m - (conn->sv >> 2);
+      conn->sv += m;
+      conn->rto = (conn->sa >> 3) + conn->sv;
+    }
+    conn->timer = conn->rto;
+    conn->nrtx = 0;
+    conn->dupacks = 0;
+
+    uip_add32(conn->snd_nxt, acked);
+    memcpy(conn->snd_nxt, uip_acc32, 4);
+    conn->sndbuf_start += acked;
+    if(conn->sndbuf_start >= SNDBUF_SIZE) {
+      conn->sndbuf_start -= SNDBUF_SIZE;
+    }
+    conn->len -= acked;
+    conn->recover = conn->recover > acked ? conn->recover - acked : 0;
+    conn->rexmit_pos = conn->rexmit_pos > acked ? conn->rexmit_pos - acked : 0;
+  } else if(acked == 0 && conn->len > 0 && uip_len == 0 &&
+            (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+            wnd == conn->snd_wnd) {
+    /* A duplicate ACK. After three, the first segment is assumed to be
+       lost and the retransmissions start right away. Duplicate ACKs for
+       the segments sent before a loss are ignored until it has been
+       recovered. */
+    if(conn->recover == 0 && ++conn->dupacks == 3) {
+      PRINTF("tcp: fast retransmit\n");
+      UIP_STAT(++uip_stat.tcp.rexmit);
+      window_go_back(conn);
+    }
+  }
+  conn->snd_wnd = wnd;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_tcp_window_pending(struct uip_conn *conn)
+{
+  return (conn->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+    ((conn->window_flags & (WINDOW_ACCEPTED | WINDOW_REXMIT)) ||
+     ((conn->window_flags & WINDOW_REFUSED) &&
+      window_room(conn) >= conn->mss));
+}
+/** @} */
+#endif /* UIP_TCP && UIP_TCP_SEND_WINDOW */
+
 #if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
 static uint16_t
@@ -404,6 +797,15 @@ uip_udpchksum(void)
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP && UIP_TCP_EVENT_TIMERS
+void
+uip_add_iss(uint16_t ticks)
+{
+  uip_add32(iss, ticks);
+  memcpy(iss, uip_acc32, sizeof(iss));
+}
+#endif /* UIP_TCP && UIP_TCP_EVENT_TIMERS */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -428,6 +830,17 @@ uip_init(void)
     uip_udp_conns[c].lport = 0;
   }
 #endif /* UIP_UDP */
+
+#if UIP_CONN_HASH_SIZE
+#if UIP_TCP
+  memset(tcp_hash, HASH_END, sizeof(tcp_hash));
+  memset(tcp_hash_next, HASH_UNLINKED, sizeof(tcp_hash_next));
+  memset(listen_hash, HASH_END, sizeof(listen_hash));
+#endif /* UIP_TCP */
+#if UIP_UDP
+  memset(udp_hash, HASH_END, sizeof(udp_hash));
+#endif /* UIP_UDP */
+#endif /* UIP_CONN_HASH_SIZE */
 }
 /*---------------------------------------------------------------------------*/
 #if UIP_TCP && UIP_ACTIVE_OPEN
@@ -472,6 +885,9 @@ uip_connect(uip_ipaddr_t *ripaddr, uint16_t rport)
   if(conn == 0) {
     return 0;
   }
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_remove(conn);
+#endif /* UIP_CONN_HASH_SIZE */
   
   conn->tcpstateflags = UIP_SYN_SENT;
 
@@ -496,6 +912,12 @@ uip_connect(uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_add(conn);
+#endif /* UIP_CONN_HASH_SIZE */
+#if UIP_TCP_SEND_WINDOW
+  window_init(conn);
+#endif /* UIP_TCP_SEND_WINDOW */
   
   return conn;
 }
@@ -558,7 +980,11 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     return 0;
   }
   
+#if UIP_CONN_HASH_SIZE
+  uip_udp_set_lport(conn, UIP_HTONS(lastport));
+#else /* UIP_CONN_HASH_SIZE */
   conn->lport = UIP_HTONS(lastport);
+#endif /* UIP_CONN_HASH_SIZE */
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(&conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -577,6 +1003,9 @@ uip_unlisten(uint16_t port)
 {
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == port) {
+#if UIP_CONN_HASH_SIZE
+      hash_unlink(&listen_hash[port_hash(port)], listen_hash_next, c);
+#endif /* UIP_CONN_HASH_SIZE */
       uip_listenports[c] = 0;
       return;
     }
@@ -589,6 +1018,10 @@ uip_listen(uint16_t port)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == 0) {
       uip_listenports[c] = port;
+#if UIP_CONN_HASH_SIZE
+      listen_hash_next[c] = listen_hash[port_hash(port)];
+      listen_hash[port_hash(port)] = c;
+#endif /* UIP_CONN_HASH_SIZE */
       return;
     }
   }
@@ -917,11 +1350,32 @@ uip_process(uint8_t flag)
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
+#if UIP_TCP_SEND_WINDOW
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      if(uip_connr->window_flags & WINDOW_REXMIT) {
+        goto tcp_send_window_rexmit;
+      }
+      if(uip_connr->window_flags & WINDOW_CLOSE) {
+        goto drop;
+      }
+      /* The application is polled while there is room in the window. */
+      uip_flags = window_appflags(uip_connr);
+      if(window_room(uip_connr) >= uip_connr->mss) {
+        uip_flags |= UIP_POLL;
+      }
+      if(uip_flags == 0) {
+        goto drop;
+      }
+      uip_slen = 0;
+      UIP_APPCALL();
+      goto appsend;
+#else /* UIP_TCP_SEND_WINDOW */
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
        !uip_outstanding(uip_connr)) {
       uip_flags = UIP_POLL;
       UIP_APPCALL();
       goto appsend;
+#endif /* UIP_TCP_SEND_WINDOW */
 #if UIP_ACTIVE_OPEN
     } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_SYN_SENT) {
       /* In the SYN_SENT state, we retransmit out SYN. */
@@ -1014,6 +1468,15 @@ uip_process(uint8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
                      
             case UIP_ESTABLISHED:
+#if UIP_TCP_SEND_WINDOW
+              /*
+               * With a send window, we retransmit the outstanding data
+               * from the retransmission buffer, one segment each time
+               * the connection is polled.
+               */
+              window_go_back(uip_connr);
+              goto tcp_send_window_rexmit;
+#else /* UIP_TCP_SEND_WINDOW */
               /*
                * In the ESTABLISHED state, we call upon the application
                * to do the actual retransmit after which we jump into
@@ -1023,6 +1486,7 @@ uip_process(uint8_t flag)
               uip_flags = UIP_REXMIT;
               UIP_APPCALL();
               goto apprexmit;
+#endif /* UIP_TCP_SEND_WINDOW */
                      
             case UIP_FIN_WAIT_1:
             case UIP_CLOSING:
@@ -1036,7 +1500,14 @@ uip_process(uint8_t flag)
          * If there was no need for a retransmission, we poll the
          * application for new data.
          */
+#if UIP_TCP_SEND_WINDOW
+        if(uip_connr->window_flags & WINDOW_CLOSE) {
+          goto drop;
+        }
+        uip_flags = UIP_POLL | window_appflags(uip_connr);
+#else /* UIP_TCP_SEND_WINDOW */
         uip_flags = UIP_POLL;
+#endif /* UIP_TCP_SEND_WINDOW */
         UIP_APPCALL();
         goto appsend;
       }
@@ -1473,6 +1944,12 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_CONN_HASH_SIZE
+  uip_udp_conn = udp_hash_find();
+  if(uip_udp_conn != NULL) {
+    goto udp_found;
+  }
+#else /* UIP_CONN_HASH_SIZE */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
@@ -1492,6 +1969,7 @@ uip_process(uint8_t flag)
       goto udp_found;
     }
   }
+#endif /* UIP_CONN_HASH_SIZE */
   PRINTF("udp: no matching connection found\n");
 
 #if UIP_UDP_SEND_UNREACH_NOPORT
@@ -1576,6 +2054,12 @@ uip_process(uint8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_CONN_HASH_SIZE
+  uip_connr = tcp_hash_find();
+  if(uip_connr != NULL) {
+    goto found;
+  }
+#else /* UIP_CONN_HASH_SIZE */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
@@ -1585,6 +2069,7 @@ uip_process(uint8_t flag)
       goto found;
     }
   }
+#endif /* UIP_CONN_HASH_SIZE */
 
   /* If we didn't find and active connection that expected the packet,
      either this packet is an old duplicate, or this is a SYN packet
@@ -1596,11 +2081,17 @@ uip_process(uint8_t flag)
   
   tmp16 = UIP_TCP_BUF->destport;
   /* Next, check listening connections. */
+#if UIP_CONN_HASH_SIZE
+  if(listen_hash_find(tmp16)) {
+    goto found_listen;
+  }
+#else /* UIP_CONN_HASH_SIZE */
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(tmp16 == uip_listenports[c]) {
       goto found_listen;
     }
   }
+#endif /* UIP_CONN_HASH_SIZE */
   
   /* No matching connection found, so we send a RST packet. */
   UIP_STAT(++uip_stat.tcp.synrst);
@@ -1691,6 +2182,9 @@ uip_process(uint8_t flag)
     goto drop;
   }
   uip_conn = uip_connr;
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_remove(uip_connr);
+#endif /* UIP_CONN_HASH_SIZE */
   
   /* Fill in the necessary fields for the new connection. */
   uip_connr->rto = uip_connr->timer = UIP_RTO;
@@ -1700,6 +2194,9 @@ uip_process(uint8_t flag)
   uip_connr->lport = UIP_TCP_BUF->destport;
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
+#if UIP_CONN_HASH_SIZE
+  tcp_hash_add(uip_connr);
+#endif /* UIP_CONN_HASH_SIZE */
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
 
   uip_connr->snd_nxt[0] = iss[0];
@@ -1707,6 +2204,9 @@ uip_process(uint8_t flag)
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
   uip_connr->len = 1;
+#if UIP_TCP_SEND_WINDOW
+  window_init(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW */
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
   uip_connr->rcv_nxt[3] = UIP_TCP_BUF->seqno[3];
@@ -1820,6 +2320,15 @@ uip_process(uint8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_SEND_WINDOW
+  /* With a send window, an ACK may acknowledge any part of the
+     outstanding data, and the application is told about it through
+     window_appflags() instead of the UIP_ACKDATA flag. */
+  if((UIP_TCP_BUF->flags & TCP_ACK) &&
+     (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+    window_ack(uip_connr);
+  } else
+#endif /* UIP_TCP_SEND_WINDOW */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1874,6 +2383,10 @@ uip_process(uint8_t flag)
         uip_connr->tcpstateflags = UIP_ESTABLISHED;
         uip_flags = UIP_CONNECTED;
         uip_connr->len = 0;
+#if UIP_TCP_SEND_WINDOW
+        uip_connr->snd_wnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) +
+          UIP_TCP_BUF->wnd[1];
+#endif /* UIP_TCP_SEND_WINDOW */
         if(uip_len > 0) {
           uip_flags |= UIP_NEWDATA;
           uip_add_rcv_nxt(uip_len);
@@ -1936,6 +2449,10 @@ uip_process(uint8_t flag)
         uip_add_rcv_nxt(1);
         uip_flags = UIP_CONNECTED | UIP_NEWDATA;
         uip_connr->len = 0;
+#if UIP_TCP_SEND_WINDOW
+        uip_connr->snd_wnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) +
+          UIP_TCP_BUF->wnd[1];
+#endif /* UIP_TCP_SEND_WINDOW */
         uip_len = 0;
         uip_slen = 0;
         UIP_APPCALL();
@@ -2045,7 +2562,22 @@ uip_process(uint8_t flag)
          put into the uip_appdata and the length of the data should be
          put into uip_len. If the application don't have any data to
          send, uip_len must be set to 0. */
+#if UIP_TCP_SEND_WINDOW
+      if(uip_connr->window_flags & WINDOW_CLOSE) {
+        /* The application has closed the connection and is not called
+           again. The FIN is sent when all data has been acknowledged. */
+        if(uip_connr->len == 0) {
+          goto tcp_send_window_close;
+        }
+        uip_flags &= UIP_NEWDATA;
+        uip_slen = 0;
+        goto tcp_send_window;
+      }
+      uip_flags |= window_appflags(uip_connr);
+      if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA | UIP_REXMIT)) {
+#else /* UIP_TCP_SEND_WINDOW */
       if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA)) {
+#endif /* UIP_TCP_SEND_WINDOW */
         uip_slen = 0;
         UIP_APPCALL();
 
@@ -2059,6 +2591,14 @@ uip_process(uint8_t flag)
         }
 
         if(uip_flags & UIP_CLOSE) {
+#if UIP_TCP_SEND_WINDOW
+          if(uip_connr->len > 0) {
+            uip_connr->window_flags |= WINDOW_CLOSE;
+            uip_slen = 0;
+            goto tcp_send_window;
+          }
+        tcp_send_window_close:
+#endif /* UIP_TCP_SEND_WINDOW */
           uip_slen = 0;
           uip_connr->len = 1;
           uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
@@ -2067,6 +2607,30 @@ uip_process(uint8_t flag)
           goto tcp_send_nodata;
         }
 
+#if UIP_TCP_SEND_WINDOW
+        /* If uip_slen > 0, the application has data to be sent, which
+           goes into the window if there is room for it. */
+        if(uip_slen > 0) {
+          window_accept(uip_connr);
+        }
+      tcp_send_window:
+        uip_appdata = uip_sappdata;
+
+        if(uip_slen > 0) {
+          uip_len = uip_slen + UIP_TCPIP_HLEN;
+          UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+          goto tcp_send_noopts;
+        }
+        /* A retransmission also acknowledges any new data. */
+        if(uip_connr->window_flags & WINDOW_REXMIT) {
+          goto tcp_send_window_rexmit;
+        }
+        if(uip_flags & UIP_NEWDATA) {
+          uip_len = UIP_TCPIP_HLEN;
+          UIP_TCP_BUF->flags = TCP_ACK;
+          goto tcp_send_noopts;
+        }
+#else /* UIP_TCP_SEND_WINDOW */
         /* If uip_slen > 0, the application has data to be sent. */
         if(uip_slen > 0) {
 
@@ -2120,8 +2684,28 @@ uip_process(uint8_t flag)
           UIP_TCP_BUF->flags = TCP_ACK;
           goto tcp_send_noopts;
         }
+#endif /* UIP_TCP_SEND_WINDOW */
       }
+#if UIP_TCP_SEND_WINDOW
+      if(uip_connr->window_flags & WINDOW_REXMIT) {
+        goto tcp_send_window_rexmit;
+      }
+#endif /* UIP_TCP_SEND_WINDOW */
       goto drop;
+
+#if UIP_TCP_SEND_WINDOW
+    tcp_send_window_rexmit:
+      /* Retransmit the next outstanding segment. */
+      if(uip_connr->rexmit_pos >= uip_connr->len) {
+        uip_connr->window_flags &= ~WINDOW_REXMIT;
+        goto drop;
+      }
+      uip_appdata = uip_sappdata;
+      uip_len = window_rexmit(uip_connr) + UIP_TCPIP_HLEN;
+      UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+      goto tcp_send_noopts;
+#endif /* UIP_TCP_SEND_WINDOW */
+
     case UIP_LAST_ACK:
       /* We can close this connection if the peer has acknowledged our
          FIN. This is indicated by the UIP_ACKDATA flag. */
@@ -2212,10 +2796,20 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->ackno[2] = uip_connr->rcv_nxt[2];
   UIP_TCP_BUF->ackno[3] = uip_connr->rcv_nxt[3];
   
+#if UIP_TCP_SEND_WINDOW
+  /* New data follows the outstanding data in the window. */
+  uip_add32(uip_connr->snd_nxt, snd_offset);
+  snd_offset = 0;
+  UIP_TCP_BUF->seqno[0] = uip_acc32[0];
+  UIP_TCP_BUF->seqno[1] = uip_acc32[1];
+  UIP_TCP_BUF->seqno[2] = uip_acc32[2];
+  UIP_TCP_BUF->seqno[3] = uip_acc32[3];
+#else /* UIP_TCP_SEND_WINDOW */
   UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
   UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_SEND_WINDOW */
 
   UIP_IP_BUF->proto = UIP_PROTO_TCP;
 
@@ -341,6 +341,28 @@
 #define UIP_LISTENPORTS (UIP_CONF_MAX_LISTENPORTS)
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * The number of buckets in the tables that find the connection for an
+ * incoming packet.
+ *
+ * By default, uIP searches all TCP connections, listening ports, and
+ * UDP connections for every packet it receives. With many
+ * connections, hash tables on the TCP connections' addresses and
+ * ports and on the local ports of listening ports and UDP connections
+ * make the search cheaper. The tables use one byte for each bucket
+ * and one byte for each connection and listening port. The number of
+ * buckets must be a power of two.
+ *
+ * Only the IPv6 stack supports the hash tables.
+ *
+ * \hideinitializer
+ */
+#if defined(UIP_CONF_CONN_HASH_SIZE) && UIP_CONF_IPV6
+#define UIP_CONN_HASH_SIZE (UIP_CONF_CONN_HASH_SIZE)
+#else
+#define UIP_CONN_HASH_SIZE 0
+#endif
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -403,6 +425,29 @@
 #define UIP_RECEIVE_WINDOW (UIP_CONF_RECEIVE_WINDOW)
 #endif
 
+/**
+ * The number of TCP segments a connection may have in flight.
+ *
+ * By default, a connection has at most one unacknowledged segment and
+ * the application retransmits it when uip_rexmit() is true. With a
+ * send window, uIP copies the data the application sends into a
+ * retransmission buffer of this many segments for each connection and
+ * retransmits from there itself. The application is told that its data
+ * has been sent, through uip_acked(), as soon as it is in the buffer,
+ * and it may then send the next segment. The remote host's advertised
+ * window limits how much data is in flight.
+ *
+ * Only the IPv6 stack supports the send window, and not together
+ * with UIP_CONF_TCP_SPLIT.
+ *
+ * \hideinitializer
+ */
+#if defined(UIP_CONF_TCP_SEND_WINDOW) && UIP_CONF_IPV6
+#define UIP_TCP_SEND_WINDOW (UIP_CONF_TCP_SEND_WINDOW)
+#else
+#define UIP_TCP_SEND_WINDOW 0
+#endif
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
@@ -414,6 +459,28 @@
 #define UIP_TIME_WAIT_TIMEOUT UIP_CONF_WAIT_TIMEOUT
 #endif
 
+/**
+ * Run the TCP timers only when a connection's timer expires.
+ *
+ * By default, the TCP/IP process wakes up every half second while
+ * there are active connections and calls uip_periodic() for each of
+ * them. With this option set, it keeps track of when the next
+ * retransmission or TIME_WAIT timeout is due, sleeps until then, and
+ * only processes the connections whose timers have expired. The
+ * connections' timers are brought up to date whenever the stack runs.
+ *
+ * Idle connections are then no longer polled every half second, so
+ * applications must not count on periodic polls, e.g., to time out
+ * idle connections, but use their own timers and tcpip_poll_tcp().
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_EVENT_TIMERS
+#define UIP_TCP_EVENT_TIMERS (UIP_CONF_TCP_EVENT_TIMERS)
+#else
+#define UIP_TCP_EVENT_TIMERS 0
+#endif
+
 /** @} */
 /*------------------------------------------------------------------------------*/
 /**
@@ -519,6 +586,38 @@
 #endif /* UIP_CONF_BUFFER_SIZE */
 
 
+/**
+ * The number of incoming packets that can wait for the TCP/IP process.
+ *
+ * Network device drivers that deliver packets with
+ * tcpip_queue_input() normally have each packet processed before
+ * they can read the next one. With a receive queue, the packets are
+ * copied into a pool of this many packet buffers instead, and the
+ * TCP/IP process handles them in batches, so that a burst of packets
+ * need not be dropped by the driver or the operating system. Each
+ * buffer takes UIP_BUFSIZE bytes of RAM.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_RX_QUEUE
+#define UIP_RX_QUEUE (UIP_CONF_RX_QUEUE)
+#else /* UIP_CONF_RX_QUEUE */
+#define UIP_RX_QUEUE 0
+#endif /* UIP_CONF_RX_QUEUE */
+
+/**
+ * The largest number of queued packets that the TCP/IP process
+ * handles before it lets other processes run.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_RX_QUEUE_BATCH
+#define UIP_RX_QUEUE_BATCH (UIP_CONF_RX_QUEUE_BATCH)
+#else /* UIP_CONF_RX_QUEUE_BATCH */
+#define UIP_RX_QUEUE_BATCH UIP_RX_QUEUE
+#endif /* UIP_CONF_RX_QUEUE_BATCH */
+
+
 /**
  * Determines if statistics support should be compiled in.
  *
@@ -59,17 +59,20 @@ tapdev_output(void)
 static void
 pollhandler(void)
 {
-  uip_len = tapdev_poll();
-
-  if(uip_len > 0) {
+  /* Read packets for as long as the TCP/IP stack can queue them. */
+  do {
+    uip_len = tapdev_poll();
+    if(uip_len == 0) {
+      break;
+    }
 #if UIP_CONF_IPV6
     if(BUF->type == uip_htons(UIP_ETHTYPE_IPV6)) {
-      tcpip_input();
+      tcpip_queue_input();
     } else
 #endif /* UIP_CONF_IPV6 */
     if(BUF->type == uip_htons(UIP_ETHTYPE_IP)) {
       uip_len -= sizeof(struct uip_eth_hdr);
-      tcpip_input();
+      tcpip_queue_input();
     } else if(BUF->type == uip_htons(UIP_ETHTYPE_ARP)) {
 #if !UIP_CONF_IPV6 //math
        uip_arp_arpin();
@@ -83,7 +86,7 @@ pollhandler(void)
     } else {
       uip_len = 0;
     }
-  }
+  } while(!tcpip_queue_full());
 }
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(tapdev_process, ev, data)
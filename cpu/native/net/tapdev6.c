@@ -307,8 +307,12 @@ tapdev_init(void)
       perror(buf);
       exit(1);
     }
+    /* The interface is tap0 unless another node already has it. */
+    snprintf(buf, sizeof(buf), "ifconfig %s up", ifr.ifr_name);
   }
-#endif /* Linux */
+#else /* linux */
+  snprintf(buf, sizeof(buf), "ifconfig tap0 up");
+#endif /* linux */
 
 #ifdef __APPLE__
   tapdev_init_darwin_routes();
@@ -325,8 +329,6 @@ tapdev_init(void)
      system(buf);
      PRINTF("%s\n", buf);
   */
-  /* freebsd */
-  snprintf(buf, sizeof(buf), "ifconfig tap0 up");
   system(buf);
   printf("%s\n", buf);
   
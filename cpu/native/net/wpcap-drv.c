@@ -86,12 +86,12 @@ pollhandler(void)
 #if UIP_CONF_IPV6
     if(BUF->type == uip_htons(UIP_ETHTYPE_IPV6)) {
 //     printf("wpcap poll calls tcpip");
-      tcpip_input();
+      tcpip_queue_input();
     } else
 #endif /* UIP_CONF_IPV6 */
     if(BUF->type == uip_htons(UIP_ETHTYPE_IP)) {
       uip_len -= sizeof(struct uip_eth_hdr);
-      tcpip_input();
+      tcpip_queue_input();
 #if !UIP_CONF_IPV6
     } else if(BUF->type == uip_htons(UIP_ETHTYPE_ARP)) {
        uip_arp_arpin();      //math
@@ -122,18 +122,18 @@ pollhandler(void)
         memcpy(&uip_buf[UIP_LLH_LEN], uip_buf+14, uip_len);  //LLH_LEN is zero for native border router to slip radio
 //	CopyMemory(uip_buf, uip_buf+14, uip_len);
 //{int i;printf("\n0000 ");for (i=0;i<uip_len;i++) printf("%02x ",*(char*)(uip_buf+i));printf("\n");}	
-      tcpip_input();
+      tcpip_queue_input();
     } else
 	 goto bail;
 #elif UIP_CONF_IPV6
     if(BUF->type == uip_htons(UIP_ETHTYPE_IPV6)) {
-      tcpip_input();
+      tcpip_queue_input();
     } else
 	 goto bail;
 #endif /* UIP_CONF_IPV6 */
     if(BUF->type == uip_htons(UIP_ETHTYPE_IP)) {
       uip_len -= sizeof(struct uip_eth_hdr);
-      tcpip_input();
+      tcpip_queue_input();
 #if !UIP_CONF_IPV6
     } else if(BUF->type == uip_htons(UIP_ETHTYPE_ARP)) {
        uip_arp_arpin();      //math
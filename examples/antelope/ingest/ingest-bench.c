@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2012, Swedish Institute of Computer Science
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/**
+ * \file
+ *	A benchmark of the tuple ingestion rate in Antelope, comparing
+ *      single insertions with batched insertions.
+ */
+
+#include <stdio.h>
+
+#include "contiki.h"
+
+#include "antelope.h"
+
+/* The number of tuples to insert in each run. */
+#ifndef INGEST_TUPLES
+#define INGEST_TUPLES	5000
+#endif
+
+/* The number of sensors that the samples are distributed over. */
+#ifndef INGEST_SENSORS
+#define INGEST_SENSORS	100
+#endif
+
+PROCESS(ingest_bench, "Antelope ingest benchmark");
+AUTOSTART_PROCESSES(&ingest_bench);
+/*---------------------------------------------------------------------------*/
+static db_result_t
+prepare(char *name)
+{
+  db_result_t result;
+
+  db_query(NULL, "REMOVE RELATION %s;", name);
+
+  result = db_query(NULL, "CREATE RELATION %s;", name);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+  result = db_query(NULL, "CREATE ATTRIBUTE time DOMAIN LONG IN %s;", name);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+  result = db_query(NULL, "CREATE ATTRIBUTE sensor DOMAIN INT IN %s;", name);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+  result = db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN %s;", name);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+  return db_query(NULL, "CREATE INDEX %s.sensor TYPE MAXHEAP;", name);
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(char *name, int batched)
+{
+  relation_t *rel;
+  attribute_value_t values[3];
+  clock_time_t start;
+  clock_time_t elapsed;
+  long i;
+  db_result_t result;
+
+  if(DB_ERROR(prepare(name))) {
+    printf("Failed to prepare the relation %s\n", name);
+    return;
+  }
+
+  rel = relation_load(name);
+  if(rel == NULL) {
+    printf("Failed to load the relation %s\n", name);
+    return;
+  }
+
+  values[0].domain = DOMAIN_LONG;
+  values[1].domain = DOMAIN_INT;
+  values[2].domain = DOMAIN_INT;
+
+  start = clock_time();
+  for(i = 0; i < INGEST_TUPLES; i++) {
+    VALUE_LONG(&values[0]) = i / INGEST_SENSORS;
+    VALUE_INT(&values[1]) = i % INGEST_SENSORS;
+    VALUE_INT(&values[2]) = (i * 7) & 0x3ff;
+
+    if(batched) {
+      result = relation_batch_insert(rel, values);
+    } else {
+      result = relation_insert(rel, values);
+    }
+    if(DB_ERROR(result)) {
+      printf("Insertion %ld failed: %s\n", i, db_get_result_message(result));
+      break;
+    }
+  }
+  if(batched) {
+    relation_batch_commit(rel);
+  }
+  elapsed = clock_time() - start;
+
+  printf("%s: %ld tuples in %lu ms (%lu tuples/s), cardinality %lu\n",
+         batched ? "batched" : "single", i,
+         (unsigned long)elapsed * 1000 / CLOCK_SECOND,
+         elapsed > 0 ? (unsigned long)i * CLOCK_SECOND / elapsed : 0,
+         (unsigned long)relation_cardinality(rel));
+
+  relation_release(rel);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ingest_bench, ev, data)
+{
+  PROCESS_BEGIN();
+
+  db_init();
+
+  /* Let the indexer process start. */
+  PROCESS_PAUSE();
+
+  run("single", 0);
+  run("batched", 1);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
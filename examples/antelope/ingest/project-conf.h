@@ -0,0 +1,21 @@
+#undef QUEUEBUF_CONF_NUM
+#define QUEUEBUF_CONF_NUM	4
+
+#undef NETSTACK_CONF_RDC
+#define NETSTACK_CONF_RDC       nullrdc_driver
+
+#undef DB_FEATURE_BATCH
+#define DB_FEATURE_BATCH	1
+
+#ifdef CONTIKI_TARGET_NATIVE
+/* The native platform uses the POSIX backend of CFS. */
+#undef DB_FEATURE_COFFEE
+#define DB_FEATURE_COFFEE	0
+
+#undef DB_BATCH_SIZE
+#define DB_BATCH_SIZE		64
+#endif /* CONTIKI_TARGET_NATIVE */
+
+/* Both benchmark relations keep a MaxHeap index loaded. */
+#undef DB_HEAP_INDEX_LIMIT
+#define DB_HEAP_INDEX_LIMIT	2
@@ -66,6 +66,11 @@ PROCESS_THREAD(db_shell, ev, data)
       continue;
     }
 
+    if(db_explaining(&handle)) {
+      db_print_plan(&handle);
+      db_free(&handle);
+    }
+
     if(!db_processing(&handle)) {
       printf("OK\n");
       continue;
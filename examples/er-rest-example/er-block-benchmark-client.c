@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Erbium (Er) blockwise transfer benchmark client. Downloads the regenerated and the streamed log from
+ *      er-block-benchmark-server and uploads a file with Block1, and prints the throughput of each transfer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include "er-coap-13-engine.h"
+
+/* The address of the node running er-block-benchmark-server. */
+#ifndef SERVER_NODE
+#define SERVER_NODE(ipaddr)   uip_ip6addr(ipaddr, 0xaaaa, 0, 0, 0, 0x0212, 0x7402, 0x0002, 0x0202) /* cooja2 */
+#endif
+
+#define REMOTE_PORT     UIP_HTONS(COAP_DEFAULT_PORT)
+
+/* The number of bytes to upload. */
+#ifndef BENCHMARK_UPLOAD_SIZE
+#define BENCHMARK_UPLOAD_SIZE 16384UL
+#endif
+
+PROCESS(block_benchmark_client, "Erbium blockwise benchmark client");
+AUTOSTART_PROCESSES(&block_benchmark_client);
+
+static uip_ipaddr_t server_ipaddr;
+static unsigned long received;
+static uint8_t status;
+
+static void
+download_handler(void *response)
+{
+  const uint8_t *chunk;
+
+  received += coap_get_payload(response, &chunk);
+}
+
+static void
+upload_handler(void *response)
+{
+  status = ((coap_packet_t *)response)->code;
+}
+
+static void
+print_throughput(const char *name, unsigned long bytes, clock_time_t time)
+{
+  printf("%-12s %8lu bytes %8lu ms %8lu B/s\n", name, bytes,
+         (unsigned long)(time * 1000 / CLOCK_SECOND),
+         time ? (unsigned long)(bytes * CLOCK_SECOND / time) : 0);
+}
+
+PROCESS_THREAD(block_benchmark_client, ev, data)
+{
+  static coap_packet_t request[1];
+  static uint8_t chunk[REST_MAX_CHUNK_SIZE];
+  static clock_time_t start;
+  static uint32_t num;
+  static uint16_t len;
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  SERVER_NODE(&server_ipaddr);
+
+  coap_receiver_init();
+
+  /* Give the network time to come up. */
+  etimer_set(&et, 5 * CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, "log/regen");
+  received = 0;
+  start = clock_time();
+  COAP_BLOCKING_REQUEST(&server_ipaddr, REMOTE_PORT, request, download_handler);
+  print_throughput("log/regen", received, clock_time() - start);
+
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, "log/stream");
+  received = 0;
+  start = clock_time();
+  COAP_BLOCKING_REQUEST(&server_ipaddr, REMOTE_PORT, request, download_handler);
+  print_throughput("log/stream", received, clock_time() - start);
+
+  start = clock_time();
+  for (num = 0; num * REST_MAX_CHUNK_SIZE < BENCHMARK_UPLOAD_SIZE; ++num)
+  {
+    len = MIN(REST_MAX_CHUNK_SIZE, BENCHMARK_UPLOAD_SIZE - num * REST_MAX_CHUNK_SIZE);
+    memset(chunk, 'a' + num % 26, len);
+
+    coap_init_message(request, COAP_TYPE_CON, COAP_PUT, 0);
+    coap_set_header_uri_path(request, "upload");
+    coap_set_header_block1(request, num, (num + 1) * REST_MAX_CHUNK_SIZE < BENCHMARK_UPLOAD_SIZE, REST_MAX_CHUNK_SIZE);
+    coap_set_payload(request, chunk, len);
+    status = 0;
+    COAP_BLOCKING_REQUEST(&server_ipaddr, REMOTE_PORT, request, upload_handler);
+
+    if (status!=CONTINUE_2_31 && status!=CHANGED_2_04)
+    {
+      printf("upload failed at block %lu with %u.%02u\n", (unsigned long)num, status >> 5, status & 0x1F);
+      break;
+    }
+  }
+  print_throughput("upload", num * REST_MAX_CHUNK_SIZE < BENCHMARK_UPLOAD_SIZE ? num * REST_MAX_CHUNK_SIZE : BENCHMARK_UPLOAD_SIZE,
+                   clock_time() - start);
+
+  PROCESS_END();
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Erbium (Er) blockwise transfer benchmark server. Serves a generated log once through a handler that
+ *      regenerates it from the start for every block, and once through a handler that resumes from the
+ *      Block2 cursor of the transfer. Block1 uploads are reassembled into a CFS file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "cfs/cfs.h"
+
+#include "erbium.h"
+#include "er-coap-13-engine.h"
+
+/* The number of lines in the generated log. */
+#ifndef BENCHMARK_LOG_LINES
+#define BENCHMARK_LOG_LINES 2000
+#endif
+
+#define UPLOAD_FILE "upload.bin"
+
+/* Generator state, kept in the Block2 cursor between blocks. */
+struct log_state {
+  uint32_t line;
+  uint32_t seed;
+  uint32_t line_start; /* offset of the line in the log */
+};
+
+static unsigned long generated;
+
+/*
+ * Writes the log from offset into the buffer. The state must be at a line that starts at or before offset; it is
+ * left at the line where the buffer ends. Returns the number of bytes written.
+ */
+static int
+generate_log(struct log_state *state, int32_t offset, uint8_t *buffer, uint16_t size)
+{
+  char line[32];
+  int line_len = 0;
+  int skip = 0;
+  int len = 0;
+  int written = 0;
+
+  while (state->line < BENCHMARK_LOG_LINES && written < size)
+  {
+    line_len = snprintf(line, sizeof(line), "entry %lu: %lu\n", (unsigned long)state->line, (unsigned long)(state->seed >> 16));
+    generated += line_len;
+
+    if (state->line_start + line_len > offset + written)
+    {
+      skip = offset + written - state->line_start;
+      len = MIN(line_len - skip, size - written);
+      memcpy(buffer + written, line + skip, len);
+      written += len;
+
+      if (skip + len < line_len)
+      {
+        /* The next block continues within this line. */
+        break;
+      }
+    }
+
+    state->line_start += line_len;
+    state->seed = state->seed * 1103515245 + 12345;
+    ++state->line;
+  }
+
+  return written;
+}
+
+static void
+log_response(const char *name, void *response, uint8_t *buffer, int32_t *offset, struct log_state *state, int written)
+{
+  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
+  REST.set_response_payload(response, buffer, written);
+
+  if (state->line >= BENCHMARK_LOG_LINES)
+  {
+    printf("%s: %lu bytes sent, %lu bytes generated\n", name, (unsigned long)(*offset + written), generated);
+    generated = 0;
+    *offset = -1;
+  }
+  else
+  {
+    *offset += written;
+  }
+}
+
+/* Regenerates the log from the start for every block. */
+RESOURCE(log_regen, METHOD_GET, "log/regen", "title=\"Regenerated log\";rt=\"block\"");
+
+void
+log_regen_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  struct log_state state;
+
+  memset(&state, 0, sizeof(state));
+  log_response("regen", response, buffer, offset, &state, generate_log(&state, *offset, buffer, preferred_size));
+}
+
+/* Continues from where the previous block ended. */
+RESOURCE(log_stream, METHOD_GET, "log/stream", "title=\"Streamed log\";rt=\"block\"");
+
+void
+log_stream_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  coap_block_cursor_t *cursor = coap_block2_get_cursor(request, *offset);
+  struct log_state state;
+  int written;
+
+  memset(&state, 0, sizeof(state));
+  if (cursor && cursor->resumed)
+  {
+    memcpy(&state, cursor->state, sizeof(state));
+  }
+
+  written = generate_log(&state, *offset, buffer, preferred_size);
+
+  if (cursor)
+  {
+    memcpy(cursor->state, &state, sizeof(state));
+  }
+  log_response("stream", response, buffer, offset, &state, written);
+}
+
+/* Reassembles Block1 uploads into a file. */
+RESOURCE(upload, METHOD_PUT, "upload", "title=\"Upload\";rt=\"block\"");
+
+void
+upload_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  int fd;
+
+  if (coap_block1_to_file(request, response, UPLOAD_FILE)==1)
+  {
+    fd = cfs_open(UPLOAD_FILE, CFS_READ);
+    printf("upload of %ld bytes done\n", (long)cfs_seek(fd, 0, CFS_SEEK_END));
+    cfs_close(fd);
+  }
+}
+
+PROCESS(block_benchmark_server, "Erbium blockwise benchmark server");
+AUTOSTART_PROCESSES(&block_benchmark_server);
+
+PROCESS_THREAD(block_benchmark_server, ev, data)
+{
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+
+  rest_activate_resource(&resource_log_regen);
+  rest_activate_resource(&resource_log_stream);
+  rest_activate_resource(&resource_upload);
+
+  PROCESS_END();
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Erbium (Er) request dispatch benchmark. Measures the time to find the
+ *      resources for CoAP requests for growing numbers of resources, and
+ *      compares it to a linear search through the resource list.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include "erbium.h"
+#include "er-coap-13.h"
+
+/* The largest number of resources to activate. */
+#ifndef BENCHMARK_RESOURCES
+#define BENCHMARK_RESOURCES 512
+#endif
+
+/* The number of requests to dispatch for each number of resources. */
+#ifndef BENCHMARK_REQUESTS
+#define BENCHMARK_REQUESTS 100000UL
+#endif
+
+static resource_t resources[BENCHMARK_RESOURCES];
+static char urls[BENCHMARK_RESOURCES][20];
+static char request_urls[BENCHMARK_RESOURCES][32];
+static unsigned long handled;
+
+/* Also dispatches sub-resources, e.g., "sensors/ch001/raw". */
+RESOURCE(sensors, METHOD_GET | HAS_SUB_RESOURCES, "sensors", "title=\"Sensors\"");
+
+void
+sensors_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  ++handled;
+}
+
+static void
+channel_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  ++handled;
+}
+
+/* The linear search that dispatched requests before the dispatch table. */
+static resource_t *
+find_linear(const char *url, int url_len)
+{
+  resource_t *resource;
+
+  for (resource = (resource_t *)list_head(rest_get_resources()); resource; resource = resource->next)
+  {
+    if ((url_len == strlen(resource->url) || (url_len > strlen(resource->url) && (resource->flags & HAS_SUB_RESOURCES)))
+        && strncmp(resource->url, url, strlen(resource->url)) == 0)
+    {
+      return resource;
+    }
+  }
+  return NULL;
+}
+
+PROCESS(dispatch_benchmark, "Erbium dispatch benchmark");
+AUTOSTART_PROCESSES(&dispatch_benchmark);
+
+PROCESS_THREAD(dispatch_benchmark, ev, data)
+{
+  static coap_packet_t request[1];
+  static coap_packet_t response[1];
+  static uint8_t buffer[REST_MAX_CHUNK_SIZE];
+  int32_t offset;
+  unsigned count, active, i, errors;
+  unsigned long n;
+  clock_time_t start, table_time, linear_time;
+  const char *url;
+  int url_len;
+
+  PROCESS_BEGIN();
+
+  rest_activate_resource(&resource_sensors);
+
+  for (i = 0; i < BENCHMARK_RESOURCES; ++i)
+  {
+    sprintf(urls[i], "channels/ch%03u", i);
+    resources[i].flags = METHOD_GET;
+    resources[i].url = urls[i];
+    resources[i].handler = channel_handler;
+  }
+
+  printf("resources  table(ms)  linear(ms)  requests\n");
+
+  active = 0;
+  for (count = 8; count <= BENCHMARK_RESOURCES; count *= 4)
+  {
+    while (active < count)
+    {
+      rest_activate_resource(&resources[active++]);
+    }
+
+    /* Request all channels, a sub-resource, and a missing resource. */
+    for (i = 0; i < count; ++i)
+    {
+      strcpy(request_urls[i], urls[i]);
+    }
+    snprintf(request_urls[count - 2], sizeof(request_urls[0]), "sensors/ch%03u/raw", count);
+    snprintf(request_urls[count - 1], sizeof(request_urls[0]), "channels/ch%03u", count);
+
+    errors = 0;
+    for (i = 0; i < count; ++i)
+    {
+      url_len = strlen(request_urls[i]);
+      if (rest_find_resource(request_urls[i], url_len) != find_linear(request_urls[i], url_len))
+      {
+        ++errors;
+      }
+    }
+
+    /* All requests but the one for the missing resource are handled. */
+    handled = 0;
+    for (i = 0; i < count; ++i)
+    {
+      coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+      coap_set_header_uri_path(request, request_urls[i]);
+      coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, 0);
+      offset = 0;
+      rest_invoke_restful_service(request, response, buffer, sizeof(buffer), &offset);
+    }
+    if (handled != count - 1)
+    {
+      ++errors;
+    }
+
+    start = clock_time();
+    for (n = 0; n < BENCHMARK_REQUESTS; ++n)
+    {
+      coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+      coap_set_header_uri_path(request, request_urls[n % count]);
+      url_len = REST.get_url(request, &url);
+      if (rest_find_resource(url, url_len) == NULL)
+      {
+        REST.set_response_status(response, REST.status.NOT_FOUND);
+      }
+    }
+    table_time = clock_time() - start;
+
+    start = clock_time();
+    for (n = 0; n < BENCHMARK_REQUESTS; ++n)
+    {
+      coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+      coap_set_header_uri_path(request, request_urls[n % count]);
+      url_len = REST.get_url(request, &url);
+      if (find_linear(url, url_len) == NULL)
+      {
+        REST.set_response_status(response, REST.status.NOT_FOUND);
+      }
+    }
+    linear_time = clock_time() - start;
+
+    printf("%9u  %9lu  %10lu  %8lu%s\n", count,
+           (unsigned long)(table_time * 1000 / CLOCK_SECOND),
+           (unsigned long)(linear_time * 1000 / CLOCK_SECOND),
+           BENCHMARK_REQUESTS, errors ? "  MISMATCH" : "");
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
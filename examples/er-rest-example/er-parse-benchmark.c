@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Erbium (Er) CoAP parser benchmark. Compares the cost of parsing a typical and an option-heavy request
+ *      into a coap_packet_t with reading the options a handler needs through the lazy option iterator.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include "er-coap-13.h"
+
+/* The number of messages to parse per measurement. */
+#ifndef BENCHMARK_MESSAGES
+#define BENCHMARK_MESSAGES 1000000UL
+#endif
+
+#define TYPICAL_PATH "sensors/light"
+#define HEAVY_PATH   "floor2/room17/sensors/light"
+
+static uint8_t message[COAP_MAX_PACKET_SIZE+1];
+static uint16_t message_len;
+static uint8_t work[COAP_MAX_PACKET_SIZE+1];
+
+static void
+build_typical(void)
+{
+  static coap_packet_t request[1];
+
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0x1234);
+  coap_set_header_token(request, (const uint8_t *) "\x12\x34", 2);
+  coap_set_header_uri_path(request, TYPICAL_PATH);
+  coap_set_header_accept(request, TEXT_PLAIN);
+  message_len = coap_serialize_message(request, message);
+}
+
+static void
+build_heavy(void)
+{
+  static coap_packet_t request[1];
+
+  coap_init_message(request, COAP_TYPE_CON, COAP_PUT, 0x1234);
+  coap_set_header_token(request, (const uint8_t *) "\x01\x02\x03\x04\x05\x06\x07\x08", 8);
+  coap_set_header_uri_path(request, HEAVY_PATH);
+  coap_set_header_content_type(request, TEXT_PLAIN);
+  coap_set_header_uri_query(request, "unit=lux&rate=10");
+  coap_set_header_accept(request, TEXT_PLAIN);
+  coap_set_header_block2(request, 3, 0, 64);
+  coap_set_payload(request, "0123456789abcdef0123456789abcdef", 32);
+  message_len = coap_serialize_message(request, message);
+}
+
+/* Reads the path, Accept, and Block2 as a handler would. Returns a checksum to compare both parsers. */
+static uint32_t
+read_parsed(const char *path)
+{
+  static coap_packet_t request[1];
+  const char *uri_path = NULL;
+  const uint16_t *accept = NULL;
+  uint32_t block_num = 0;
+  uint32_t sum = 0;
+  int len;
+
+  /* coap_parse_message() modifies the message. */
+  memcpy(work, message, message_len);
+  if (coap_parse_message(request, work, message_len)!=NO_ERROR)
+  {
+    return 0;
+  }
+
+  len = coap_get_header_uri_path(request, &uri_path);
+  sum += (len==strlen(path) && memcmp(uri_path, path, len)==0);
+  if (coap_get_header_accept(request, &accept))
+  {
+    sum += accept[0] << 8;
+  }
+  if (coap_get_header_block2(request, &block_num, NULL, NULL, NULL))
+  {
+    sum += block_num << 16;
+  }
+  return sum;
+}
+
+static uint32_t
+read_lazy(const char *path)
+{
+  coap_option_iterator_t it;
+  uint32_t sum = 0;
+
+  /* The iterator does not modify the message, so no copy is needed. */
+  if (!coap_option_iterator_init(&it, message, message_len))
+  {
+    return 0;
+  }
+
+  sum += coap_option_match(&it, COAP_OPTION_URI_PATH, path, strlen(path), '/');
+  if (coap_option_find(&it, COAP_OPTION_ACCEPT))
+  {
+    sum += coap_option_get_int(&it) << 8;
+  }
+  if (coap_option_find(&it, COAP_OPTION_BLOCK2))
+  {
+    sum += (coap_option_get_int(&it) >> 4) << 16;
+  }
+  return sum;
+}
+
+static void
+measure(const char *name, const char *path)
+{
+  clock_time_t start, parsed_time, lazy_time;
+  uint32_t parsed_sum, lazy_sum;
+  unsigned long n;
+
+  parsed_sum = read_parsed(path);
+  lazy_sum = read_lazy(path);
+
+  start = clock_time();
+  for (n = 0; n < BENCHMARK_MESSAGES; ++n)
+  {
+    read_parsed(path);
+  }
+  parsed_time = clock_time() - start;
+
+  start = clock_time();
+  for (n = 0; n < BENCHMARK_MESSAGES; ++n)
+  {
+    read_lazy(path);
+  }
+  lazy_time = clock_time() - start;
+
+  printf("%-8s %5u  %10lu  %8lu%s\n", name, message_len,
+         (unsigned long)(parsed_time * 1000 / CLOCK_SECOND),
+         (unsigned long)(lazy_time * 1000 / CLOCK_SECOND),
+         parsed_sum==lazy_sum && parsed_sum&1 ? "" : "  MISMATCH");
+}
+
+PROCESS(parse_benchmark, "Erbium parse benchmark");
+AUTOSTART_PROCESSES(&parse_benchmark);
+
+PROCESS_THREAD(parse_benchmark, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("state: coap_packet_t %u bytes, coap_option_iterator_t %u bytes\n",
+         (unsigned)sizeof(coap_packet_t), (unsigned)sizeof(coap_option_iterator_t));
+  printf("message  bytes  parsed(ms)  lazy(ms)  (%lu messages)\n", BENCHMARK_MESSAGES);
+
+  build_typical();
+  measure("typical", TYPICAL_PATH);
+
+  build_heavy();
+  measure("heavy", HEAVY_PATH);
+
+  exit(0);
+
+  PROCESS_END();
+}
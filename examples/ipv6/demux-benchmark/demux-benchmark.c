@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Demultiplexing benchmark. Opens as many TCP connections,
+ *         listening ports, and UDP connections as uIP has room for,
+ *         feeds uIP packets for all of them in turn, and reports the
+ *         time it takes.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The number of packets of each kind. */
+#ifndef BENCHMARK_PACKETS
+#define BENCHMARK_PACKETS 1000000UL
+#endif
+
+/* The TCP flags, as in uip6.c. */
+#define TCP_SYN 0x02
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+#define TCP_PEER_PORT    80
+#define LISTEN_PORT_BASE 8000
+#define UDP_PORT_BASE    5000
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_TCP_BUF ((struct uip_tcp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#define UIP_UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+static uip_ipaddr_t host;
+
+static struct uip_conn *tcp_conns[UIP_CONNS];
+static struct uip_udp_conn *udp_conns[UIP_UDP_CONNS];
+static unsigned tcp_count, udp_count;
+
+/* The packets to feed uIP, without the link layer header. */
+static uint8_t tcp_packets[UIP_CONNS][UIP_IPTCPH_LEN];
+static uint8_t syn_packets[UIP_LISTENPORTS][UIP_IPTCPH_LEN];
+static uint8_t udp_packets[UIP_UDP_CONNS][UIP_IPUDPH_LEN + 1];
+
+/* What the sink process has received. */
+static unsigned long newdata;
+static void *newdata_conn;
+
+PROCESS(demux_sink, "Demux sink");
+PROCESS(demux_benchmark, "Demux benchmark");
+AUTOSTART_PROCESSES(&demux_benchmark);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(demux_sink, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+    if(uip_newdata()) {
+      ++newdata;
+      newdata_conn = uip_conn != NULL ? (void *)uip_conn : (void *)uip_udp_conn;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+ip_header(const uip_ipaddr_t *src, uint8_t proto, uint16_t len)
+{
+  memset(UIP_IP_BUF, 0, UIP_IPH_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = len >> 8;
+  UIP_IP_BUF->len[1] = len & 0xff;
+  UIP_IP_BUF->proto = proto;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, src);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &host);
+  uip_len = UIP_IPH_LEN + len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+seqno_add(uint8_t *dst, const uint8_t *seqno, uint16_t n)
+{
+  uint32_t s;
+
+  s = ((uint32_t)seqno[0] << 24) + ((uint32_t)seqno[1] << 16) +
+    ((uint32_t)seqno[2] << 8) + seqno[3] + n;
+  dst[0] = s >> 24;
+  dst[1] = s >> 16;
+  dst[2] = s >> 8;
+  dst[3] = s;
+}
+/*---------------------------------------------------------------------------*/
+/* Builds a segment from the peer of a connection in uip_buf. */
+static void
+tcp_segment(const uip_ipaddr_t *src, uint16_t srcport, uint16_t destport,
+            const uint8_t *seqno, const uint8_t *ackno, uint8_t flags,
+            uint16_t datalen)
+{
+  ip_header(src, UIP_PROTO_TCP, UIP_TCPH_LEN + datalen);
+  memset(UIP_TCP_BUF, 0, UIP_TCPH_LEN);
+  UIP_TCP_BUF->srcport = srcport;
+  UIP_TCP_BUF->destport = destport;
+  memcpy(UIP_TCP_BUF->seqno, seqno, 4);
+  memcpy(UIP_TCP_BUF->ackno, ackno, 4);
+  UIP_TCP_BUF->tcpoffset = 5 << 4;
+  UIP_TCP_BUF->flags = flags;
+  UIP_TCP_BUF->wnd[0] = 4;
+  memset(&uip_buf[UIP_LLH_LEN + UIP_IPTCPH_LEN], 'x', datalen);
+  UIP_TCP_BUF->tcpchksum = 0;
+  UIP_TCP_BUF->tcpchksum = ~(uip_tcpchksum());
+}
+/*---------------------------------------------------------------------------*/
+static void
+conn_segment(struct uip_conn *conn, uint8_t flags, uint16_t datalen)
+{
+  uint8_t ackno[4];
+
+  seqno_add(ackno, conn->snd_nxt, conn->len);
+  tcp_segment(&conn->ripaddr, conn->rport, conn->lport, conn->rcv_nxt, ackno,
+              flags, datalen);
+}
+/*---------------------------------------------------------------------------*/
+static void
+udp_datagram(struct uip_udp_conn *conn)
+{
+  uip_ipaddr_t src;
+
+  uip_ip6addr(&src, 0xfd00, 0, 0, 0, 0, 0, 0, 1);
+  ip_header(&src, UIP_PROTO_UDP, UIP_UDPH_LEN + 1);
+  UIP_UDP_BUF->srcport = UIP_HTONS(UDP_PORT_BASE);
+  UIP_UDP_BUF->destport = conn->lport;
+  UIP_UDP_BUF->udplen = UIP_HTONS(UIP_UDPH_LEN + 1);
+  uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN] = 'x';
+  UIP_UDP_BUF->udpchksum = 0;
+  UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(void)
+{
+  uip_input();
+  /* Nothing is sent, the benchmark has no network. */
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(uint8_t *packet)
+{
+  memcpy(packet, &uip_buf[UIP_LLH_LEN], uip_len);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+run(uint8_t *packets, unsigned count, uint16_t len)
+{
+  clock_time_t start;
+  unsigned long n;
+
+  start = clock_time();
+  for(n = 0; n < BENCHMARK_PACKETS; ++n) {
+    memcpy(&uip_buf[UIP_LLH_LEN], &packets[(n % count) * len], len);
+    uip_len = len;
+    input();
+  }
+  return (clock_time() - start) * 1000 / CLOCK_SECOND;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(demux_benchmark, ev, data)
+{
+  static uip_ipaddr_t peer;
+  static uint8_t zero[4];
+  struct uip_conn *conn;
+  unsigned i, errors;
+  unsigned long ms;
+
+  PROCESS_BEGIN();
+
+  process_start(&demux_sink, NULL);
+  uip_ipaddr_copy(&host, &uip_ds6_get_link_local(-1)->ipaddr);
+  errors = 0;
+
+  /* Open the TCP connections and establish them with a SYNACK from
+     each peer. */
+  for(tcp_count = 0; tcp_count < UIP_CONNS; ++tcp_count) {
+    uip_ip6addr(&peer, 0xfd00, 0, 0, 0, 0, 0, 0, tcp_count + 1);
+    conn = uip_connect(&peer, UIP_HTONS(TCP_PEER_PORT));
+    if(conn == NULL) {
+      break;
+    }
+    conn->appstate.p = &demux_sink;
+    conn->appstate.state = NULL;
+    conn_segment(conn, TCP_SYN | TCP_ACK, 0);
+    input();
+    if(conn->tcpstateflags != UIP_ESTABLISHED) {
+      ++errors;
+    }
+    tcp_conns[tcp_count] = conn;
+  }
+
+  for(i = 0; i < UIP_LISTENPORTS; ++i) {
+    uip_listen(UIP_HTONS(LISTEN_PORT_BASE + i));
+  }
+
+  for(udp_count = 0; udp_count < UIP_UDP_CONNS; ++udp_count) {
+    udp_conns[udp_count] = udp_new(NULL, 0, NULL);
+    if(udp_conns[udp_count] == NULL) {
+      break;
+    }
+    udp_conns[udp_count]->appstate.p = &demux_sink;
+    udp_bind(udp_conns[udp_count], UIP_HTONS(UDP_PORT_BASE + udp_count));
+  }
+
+  /* Check that data reaches the right connection, and keep a pure ACK
+     for each. */
+  for(i = 0; i < tcp_count; ++i) {
+    newdata = 0;
+    conn_segment(tcp_conns[i], TCP_ACK | TCP_PSH, 1);
+    input();
+    if(newdata != 1 || newdata_conn != tcp_conns[i]) {
+      ++errors;
+    }
+    conn_segment(tcp_conns[i], TCP_ACK, 0);
+    save(tcp_packets[i]);
+  }
+  for(i = 0; i < udp_count; ++i) {
+    newdata = 0;
+    udp_datagram(udp_conns[i]);
+    save(udp_packets[i]);
+    input();
+    if(newdata != 1 || newdata_conn != udp_conns[i]) {
+      ++errors;
+    }
+  }
+  /* A SYN for a listening port is dropped, as there are no free
+     connections, and a SYN for a closed port is answered with a
+     RST. */
+  uip_ip6addr(&peer, 0xfd00, 0, 0, 0, 0, 0, 0, 0xffff);
+  for(i = 0; i < UIP_LISTENPORTS; ++i) {
+    tcp_segment(&peer, UIP_HTONS(TCP_PEER_PORT),
+                UIP_HTONS(LISTEN_PORT_BASE + i), zero, zero, TCP_SYN, 0);
+    uip_input();
+    if(uip_len > 0) {
+      ++errors;
+    }
+    tcp_segment(&peer, UIP_HTONS(TCP_PEER_PORT),
+                UIP_HTONS(LISTEN_PORT_BASE + UIP_LISTENPORTS + i),
+                zero, zero, TCP_SYN, 0);
+    save(syn_packets[i]);
+    uip_input();
+    if(uip_len == 0) {
+      ++errors;
+    }
+  }
+  uip_len = 0;
+
+  printf("%u TCP connections, %u listening ports, %u UDP connections, %s\n",
+         tcp_count, UIP_LISTENPORTS, udp_count,
+         UIP_CONN_HASH_SIZE ? "hash tables" : "linear search");
+  printf("packet      time(ms)  packets\n");
+
+  ms = run(&tcp_packets[0][0], tcp_count, UIP_IPTCPH_LEN);
+  printf("tcp ack   %10lu  %7lu\n", ms, BENCHMARK_PACKETS);
+
+  ms = run(&syn_packets[0][0], UIP_LISTENPORTS, UIP_IPTCPH_LEN);
+  printf("tcp rst   %10lu  %7lu\n", ms, BENCHMARK_PACKETS);
+
+  newdata = 0;
+  ms = run(&udp_packets[0][0], udp_count, UIP_IPUDPH_LEN + 1);
+  if(newdata != BENCHMARK_PACKETS) {
+    ++errors;
+  }
+  printf("udp       %10lu  %7lu\n", ms, BENCHMARK_PACKETS);
+
+  if(errors) {
+    printf("%u packets did not reach their connections\n", errors);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,542 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Web server request rate benchmark. Runs apps/webserver and a
+ *         client in the same node, with the packets looped back from the
+ *         output function to the input, and reports how many requests
+ *         per second the server handles for static files, gzip
+ *         compressed files, conditional requests, scripts, the tables
+ *         of connections and processes, and missing files. Then loads a page of four files over a loopback with
+ *         a delay, with a connection per file, over a persistent
+ *         connection, and with pipelined requests, and reports how long
+ *         the page takes.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "httpd.h"
+#include "webserver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The number of requests of each kind. */
+#ifndef BENCHMARK_REQUESTS
+#define BENCHMARK_REQUESTS 20000
+#endif
+
+/* The number of page loads of each kind, and the one-way delay of the
+   loopback for them, in milliseconds. */
+#ifndef BENCHMARK_PAGE_LOADS
+#define BENCHMARK_PAGE_LOADS 10
+#endif
+#ifndef BENCHMARK_DELAY
+#define BENCHMARK_DELAY 5
+#endif
+
+/* The number of packets in flight on the loopback. */
+#define LOOPBACK_PACKETS 16
+
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+struct request {
+  const char *name;
+  const char *text;
+  const char *status;
+};
+
+/* The conditional request gets the ETag that the server sent for the
+   first one. */
+static char etag_request[100];
+
+static const struct request requests[] = {
+  {"static", "GET /style.css HTTP/1.0\r\n\r\n", "200"},
+  {"gzip", "GET /style.css HTTP/1.0\r\nAccept-Encoding: gzip, deflate\r\n\r\n", "200"},
+  {"304", etag_request, "304"},
+  {"script", "GET /files.shtml HTTP/1.0\r\n\r\n", "200"},
+  {"tcp", "GET /tcp.shtml HTTP/1.0\r\n\r\n", "200"},
+  {"procs", "GET /processes.shtml HTTP/1.0\r\n\r\n", "200"},
+  {"404", "GET /missing.html HTTP/1.0\r\n\r\n", "404"},
+};
+
+struct page_load {
+  const char *name;
+  const char *version;
+  /* The number of requests sent ahead of the responses. */
+  uint8_t depth;
+};
+
+/* HTTP/1.0 connections close after each response. Pipelining more
+   requests than the server reads ahead makes it close the connection,
+   and the client sends the rest again on a new one. */
+static const struct page_load page_loads[] = {
+  {"close", "HTTP/1.0", 1},
+  {"keep-alive", "HTTP/1.1", 1},
+  {"pipelined", "HTTP/1.1", WEBSERVER_PIPELINE},
+  {"overflow", "HTTP/1.1", 4},
+};
+
+static const char *page[] = {
+  "/index.html", "/style.css", "/header.html", "/footer.html",
+};
+#define PAGE_FILES (sizeof(page) / sizeof(page[0]))
+
+static uip_ipaddr_t host;
+
+static uint8_t loopback[LOOPBACK_PACKETS][UIP_BUFSIZE];
+static uint16_t loopback_len[LOOPBACK_PACKETS];
+static clock_time_t loopback_due[LOOPBACK_PACKETS];
+static uint8_t loopback_first, loopback_count;
+static unsigned long loopback_drops;
+static clock_time_t loopback_delay;
+static struct etimer loopback_timer;
+
+/* The start of the response, and its length. */
+static char response[200];
+static unsigned long response_len;
+static uint8_t done;
+
+/* How much of the request has been acknowledged, and how much is in
+   flight. */
+static uint16_t sent, sending;
+
+/* The page load: the requests that have been sent and answered, the
+   requests waiting to be sent on the connection, and the response
+   being read. */
+static uint8_t page_sent, page_answered, page_conn_requests;
+static char page_out[256];
+static uint16_t page_out_len;
+static char page_header[300];
+static uint16_t page_header_len;
+static unsigned long page_body;
+static uint8_t page_state;
+static unsigned long page_errors;
+static clock_time_t page_end;
+
+#define PAGE_HEADER   0
+#define PAGE_BODY     1
+#define PAGE_TO_CLOSE 2 /* The response has no Content-Length. */
+
+PROCESS(loopback_process, "Loopback");
+PROCESS(http_server, "HTTP server");
+PROCESS(http_benchmark, "HTTP benchmark");
+AUTOSTART_PROCESSES(&http_benchmark);
+/*---------------------------------------------------------------------------*/
+void
+webserver_log_file(uip_ipaddr_t *requester, char *file)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+webserver_log(char *msg)
+{
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+loopback_output(uip_lladdr_t *lladdr)
+{
+  uint8_t i;
+
+  /* Only TCP is looped back, as the node would take its own neighbor
+     solicitations and RPL messages for those of another node. */
+  if(UIP_IP_BUF->proto != UIP_PROTO_TCP) {
+    return 0;
+  }
+  if(loopback_count == LOOPBACK_PACKETS) {
+    ++loopback_drops;
+    return 0;
+  }
+  i = (loopback_first + loopback_count) % LOOPBACK_PACKETS;
+  memcpy(loopback[i], &uip_buf[UIP_LLH_LEN], uip_len);
+  loopback_len[i] = uip_len;
+  if(loopback_delay > 0) {
+    loopback_due[i] = clock_time() + loopback_delay;
+  }
+  ++loopback_count;
+  process_poll(&loopback_process);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Delivers the packets that have been delayed long enough, and waits
+   for the next one. */
+static void
+loopback_deliver(void)
+{
+  while(loopback_count > 0 &&
+        (loopback_delay == 0 ||
+         (clock_time_t)(clock_time() - loopback_due[loopback_first]) <
+         (clock_time_t)~0 / 2)) {
+    memcpy(&uip_buf[UIP_LLH_LEN], loopback[loopback_first],
+           loopback_len[loopback_first]);
+    uip_len = loopback_len[loopback_first];
+    loopback_first = (loopback_first + 1) % LOOPBACK_PACKETS;
+    --loopback_count;
+    tcpip_input();
+  }
+  if(loopback_count > 0) {
+    etimer_set(&loopback_timer, loopback_due[loopback_first] - clock_time());
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(loopback_process, ev, data)
+{
+  PROCESS_POLLHANDLER(loopback_deliver());
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER ||
+                             ev == PROCESS_EVENT_EXIT);
+    if(ev == PROCESS_EVENT_EXIT) {
+      break;
+    }
+    loopback_deliver();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(http_server, ev, data)
+{
+  PROCESS_BEGIN();
+
+  httpd_init();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+    httpd_appcall(data);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+/* Keeps the node's own address in the neighbor cache, as the neighbor
+   solicitations for it are not looped back. */
+static void
+host_neighbor(void)
+{
+  uip_ds6_nbr_t *nbr;
+
+  nbr = uip_ds6_nbr_lookup(&host);
+  if(nbr == NULL) {
+    nbr = uip_ds6_nbr_add(&host, &uip_lladdr, 0, NBR_REACHABLE);
+  }
+  if(nbr != NULL) {
+    nbr->state = NBR_REACHABLE;
+    stimer_set(&nbr->reachable, uip_ds6_if.reachable_time / 1000);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+client_appcall(const struct request *r)
+{
+  uint16_t n;
+
+  if(uip_acked()) {
+    sent += sending;
+    sending = 0;
+  }
+  if(uip_connected() || uip_acked() || uip_rexmit()) {
+    /* The request may need more than one segment. */
+    sending = strlen(r->text) - sent;
+    if(sending > uip_mss()) {
+      sending = uip_mss();
+    }
+    if(sending > 0) {
+      uip_send(r->text + sent, sending);
+    }
+  }
+  if(uip_newdata()) {
+    if(response_len < sizeof(response) - 1) {
+      n = sizeof(response) - 1 - response_len;
+      if(n > uip_datalen()) {
+        n = uip_datalen();
+      }
+      memcpy(&response[response_len], uip_appdata, n);
+    }
+    response_len += uip_datalen();
+  }
+  if(uip_closed() || uip_aborted() || uip_timedout()) {
+    done = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Copies the ETag of the response into a conditional request. */
+static void
+make_etag_request(void)
+{
+  char *etag, *end;
+
+  response[sizeof(response) - 1] = 0;
+  etag = strstr(response, "ETag: ");
+  end = etag != NULL ? strstr(etag, "\r\n") : NULL;
+  if(end == NULL) {
+    /* The server does not send ETags, so the request gets the file. */
+    strcpy(etag_request, requests[0].text);
+    return;
+  }
+  snprintf(etag_request, sizeof(etag_request),
+           "GET /style.css HTTP/1.0\r\nIf-None-Match: %.*s\r\n\r\n",
+           (int)(end - etag - 6), etag + 6);
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the next part of the requests, unless a part is in flight. */
+static void
+page_send(void)
+{
+  if(sending == 0 && sent == page_out_len) {
+    sent = page_out_len = 0;
+  }
+  if(sending == 0) {
+    sending = page_out_len - sent;
+    if(sending > uip_mss()) {
+      sending = uip_mss();
+    }
+  }
+  if(sending > 0) {
+    uip_send(page_out + sent, sending);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Adds the requests that may be sent ahead of the responses. */
+static void
+page_request(const struct page_load *l)
+{
+  while(page_sent < PAGE_FILES && page_sent - page_answered < l->depth &&
+        (l->version[7] == '1' || page_conn_requests == 0) &&
+        page_out_len + 100 < sizeof(page_out)) {
+    page_out_len += sprintf(page_out + page_out_len,
+                            "GET %s %s\r\nAccept-Encoding: gzip\r\n\r\n",
+                            page[page_sent], l->version);
+    ++page_sent;
+    ++page_conn_requests;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+page_answer(void)
+{
+  if(strncmp(&page_header[9], "200", 3) != 0) {
+    ++page_errors;
+  }
+  page_state = PAGE_HEADER;
+  page_header_len = 0;
+  if(++page_answered == PAGE_FILES) {
+    page_end = clock_time();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Splits the data into responses, by their Content-Length. */
+static void
+page_input(const char *data, uint16_t len)
+{
+  char *p;
+  uint16_t n;
+
+  while(len > 0) {
+    if(page_state == PAGE_TO_CLOSE) {
+      return;
+    } else if(page_state == PAGE_BODY) {
+      n = page_body < len ? page_body : len;
+      data += n;
+      len -= n;
+      page_body -= n;
+      if(page_body == 0) {
+        page_answer();
+      }
+      continue;
+    }
+    if(page_header_len < sizeof(page_header) - 1) {
+      page_header[page_header_len++] = *data;
+      page_header[page_header_len] = 0;
+    }
+    ++data;
+    --len;
+    if(page_header_len >= 4 &&
+       strcmp(&page_header[page_header_len - 4], "\r\n\r\n") == 0) {
+      p = strstr(page_header, "Content-Length: ");
+      if(p == NULL) {
+        page_state = PAGE_TO_CLOSE;
+      } else {
+        page_body = strtoul(p + 16, NULL, 10);
+        page_state = PAGE_BODY;
+        if(page_body == 0) {
+          page_answer();
+        }
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+page_appcall(const struct page_load *l)
+{
+  if(uip_acked()) {
+    sent += sending;
+    sending = 0;
+  }
+  if(uip_newdata()) {
+    page_input(uip_appdata, uip_datalen());
+  }
+  if(uip_closed() || uip_aborted() || uip_timedout()) {
+    if(page_state == PAGE_TO_CLOSE) {
+      page_answer();
+    }
+    done = 1;
+    return;
+  }
+  if(page_answered == PAGE_FILES) {
+    uip_close();
+    return;
+  }
+  page_request(l);
+  if(uip_connected() || uip_acked() || uip_rexmit() || uip_newdata()) {
+    page_send();
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(http_benchmark, ev, data)
+{
+  static const struct request *r;
+  static const struct page_load *l;
+  static struct uip_conn *conn;
+  static clock_time_t start, total;
+  static unsigned long n, errors, connections;
+  static uint8_t answered;
+  unsigned long ms;
+
+  PROCESS_BEGIN();
+
+  process_start(&loopback_process, NULL);
+  process_start(&http_server, NULL);
+  tcpip_set_outputfunc(loopback_output);
+  uip_ipaddr_copy(&host, &uip_ds6_get_link_local(-1)->ipaddr);
+
+  printf("request  status  bytes  time(ms)  requests/s\n");
+
+  for(r = requests; r < requests + sizeof(requests) / sizeof(requests[0]); ++r) {
+    errors = 0;
+    start = clock_time();
+    for(n = 0; n < BENCHMARK_REQUESTS; ++n) {
+      host_neighbor();
+      response_len = 0;
+      memset(response, 0, sizeof(response));
+      done = 0;
+      sent = sending = 0;
+      conn = tcp_connect(&host, UIP_HTONS(80), NULL);
+      if(conn == NULL) {
+        ++errors;
+        break;
+      }
+      while(!done) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+        /* Skip the events of the previous connection. */
+        if(uip_conn == conn) {
+          client_appcall(r);
+        }
+      }
+      /* The status code follows "HTTP/1.0 ". */
+      if(strncmp(&response[9], r->status, 3) != 0) {
+        ++errors;
+      }
+      if(r == requests && n == 0) {
+        make_etag_request();
+      }
+    }
+    ms = (clock_time() - start) * 1000 / CLOCK_SECOND;
+    printf("%-7s  %.3s  %7lu  %8lu  %10lu%s\n", r->name, &response[9],
+           response_len, ms, ms > 0 ? n * 1000 / ms : 0,
+           errors ? "  UNEXPECTED STATUS" : "");
+  }
+
+  loopback_delay = BENCHMARK_DELAY * CLOCK_SECOND / 1000;
+  printf("\npage of %u files, %u ms each way\n", (unsigned)PAGE_FILES,
+         BENCHMARK_DELAY);
+  printf("load        connections  time(ms)\n");
+
+  for(l = page_loads; l < page_loads + sizeof(page_loads) / sizeof(page_loads[0]); ++l) {
+    page_errors = 0;
+    connections = 0;
+    total = 0;
+    for(n = 0; n < BENCHMARK_PAGE_LOADS; ++n) {
+      page_answered = 0;
+      start = clock_time();
+      while(page_answered < PAGE_FILES) {
+        /* A new connection sends the requests that were not answered
+           on the previous one again. */
+        host_neighbor();
+        page_sent = page_answered;
+        page_conn_requests = 0;
+        page_out_len = 0;
+        page_state = PAGE_HEADER;
+        page_header_len = 0;
+        done = 0;
+        sent = sending = 0;
+        answered = page_answered;
+        conn = tcp_connect(&host, UIP_HTONS(80), NULL);
+        if(conn == NULL) {
+          break;
+        }
+        ++connections;
+        while(!done) {
+          PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+          if(uip_conn == conn) {
+            page_appcall(l);
+          }
+        }
+        if(page_answered == answered) {
+          break;
+        }
+      }
+      if(page_answered < PAGE_FILES) {
+        ++page_errors;
+        break;
+      }
+      total += page_end - start;
+    }
+    printf("%-10s  %11.1f  %8lu%s\n", l->name,
+           n > 0 ? (double)connections / n : 0.0,
+           n > 0 ? (unsigned long)(total * 1000 / CLOCK_SECOND / n) : 0,
+           page_errors ? "  ERRORS" : "");
+  }
+
+  if(loopback_drops > 0) {
+    printf("%lu packets were dropped on the loopback\n", loopback_drops);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -56,6 +56,8 @@
 #define PRINTF(...)
 #endif
 
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
 #ifdef JSON_WS_CONF_CALLBACK_PROTO
 #define CALLBACK_PROTO JSON_WS_CONF_CALLBACK_PROTO
 #else
@@ -262,17 +264,6 @@ struct jsontree_callback json_leds_callback =
 
 #endif /* PLATFORM_HAS_LEDS */
 /*---------------------------------------------------------------------------*/
-static struct httpd_ws_state *json_putchar_context;
-static int
-json_putchar(int c)
-{
-  if(json_putchar_context != NULL &&
-     json_putchar_context->outbuf_pos < HTTPD_OUTBUF_SIZE) {
-    json_putchar_context->outbuf[json_putchar_context->outbuf_pos++] = c;
-    return c;
-  }
-  return 0;
-}
 static int putchar_size = 0;
 static int
 json_putchar_count(int c)
@@ -284,11 +275,8 @@ json_putchar_count(int c)
 static
 PT_THREAD(send_values(struct httpd_ws_state *s))
 {
-  json_putchar_context = s;
-
   PSOCK_BEGIN(&s->sout);
 
-  s->json.putchar = json_putchar;
   s->outbuf_pos = 0;
 
   if(s->json.values[0] == NULL) {
@@ -313,15 +301,11 @@ PT_THREAD(send_values(struct httpd_ws_state *s))
     s->outbuf_pos = 15;
 
   } else {
-    /* Get value */
-    while(jsontree_print_next(&s->json) && s->json.path <= s->json.depth) {
-      if(s->outbuf_pos >= UIP_TCP_MSS) {
-        SEND_STRING(&s->sout, s->outbuf, UIP_TCP_MSS);
-        s->outbuf_pos -= UIP_TCP_MSS;
-        if(s->outbuf_pos > 0) {
-          memcpy(s->outbuf, &s->outbuf[UIP_TCP_MSS], s->outbuf_pos);
-        }
-      }
+    /* Get value, one segment at a time */
+    while((s->outbuf_pos =
+           jsontree_print_buffer(&s->json, s->outbuf,
+                                 MIN(UIP_TCP_MSS, sizeof(s->outbuf)))) > 0) {
+      SEND_STRING(&s->sout, s->outbuf, s->outbuf_pos);
     }
   }
 
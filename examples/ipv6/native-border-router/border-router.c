@@ -50,6 +50,9 @@
 #include "cmd.h"
 #include "border-router.h"
 #include "border-router-cmds.h"
+#if WITH_COAP_PROXY
+#include "http-coap-proxy.h"
+#endif /* WITH_COAP_PROXY */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -351,6 +354,10 @@ PROCESS_THREAD(border_router_process, ev, data)
      packet reception rates. */
   NETSTACK_MAC.off(1);
 
+#if WITH_COAP_PROXY
+  process_start(&http_coap_proxy_process, NULL);
+#endif /* WITH_COAP_PROXY */
+
   while(1) {
     etimer_set(&et, CLOCK_SECOND * 2);
     PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
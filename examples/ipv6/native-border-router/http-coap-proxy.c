@@ -0,0 +1,994 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         An HTTP-CoAP proxy for the nodes behind the border router.
+ *
+ *         GET /[aaaa::212:7401:1:101]:5683/sensors/light?unit=lux
+ *         is forwarded as CoAP GET to the node, and the response is
+ *         returned as HTTP response. Identical GET requests share one
+ *         CoAP request, and responses are cached for their Max-Age.
+ *         GET /observe/[...]/path registers as observer; HTTP/1.1
+ *         clients receive each notification as a chunk of a chunked
+ *         response, HTTP/1.0 clients a long-poll response with the
+ *         next notification. GET / returns the proxy statistics.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "contiki-net.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "lib/random.h"
+
+#include "erbium.h"
+#include "er-coap-13-engine.h"
+
+#include "http-coap-proxy.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define STATE_WAITING 0
+#define STATE_OUTPUT  1
+#define STATE_CLOSING 2
+
+#define FLAG_KEEP_ALIVE 0x01
+#define FLAG_HTTP11     0x02
+#define FLAG_OBSERVE    0x04
+#define FLAG_STATS      0x08
+
+#define EXCHANGE_PENDING 0
+#define EXCHANGE_DONE    1
+
+#define ISO_nl      0x0a
+#define ISO_space   0x20
+#define ISO_slash   0x2f
+
+/* A CoAP request and its response, shared by all HTTP requests for the same resource. */
+struct exchange {
+  struct exchange *next;
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint8_t token[2];
+  uint8_t method;
+  uint8_t state;
+  uint8_t in_flight;   /* a transaction waits for the ACK */
+  uint8_t send_next;   /* the next block is requested from the process */
+  uint8_t observe;     /* registers as observer */
+  uint8_t observing;   /* notifications update the response */
+  uint8_t cacheable;
+  uint8_t users;
+  int16_t accept;
+  int16_t content_type;
+  uint16_t version;    /* incremented for each complete response */
+  uint16_t status;     /* HTTP status code */
+  uint32_t block_num;
+  uint32_t max_age;
+  struct timer timer;  /* response timeout while pending, freshness when done */
+  uint8_t path_len;
+  uint8_t url_len;
+  char url[HTTP_COAP_PROXY_URL_SIZE]; /* path '\0' query '\0' */
+  uint16_t length;     /* the request body, then the response payload */
+  uint8_t payload[HTTP_COAP_PROXY_BODY_SIZE];
+};
+
+struct proxy_conn {
+  struct proxy_conn *next;
+  struct uip_conn *conn;
+  struct psock sin, sout;
+  struct timer timer;
+  struct exchange *exchange;
+  uint16_t version;
+  uint16_t status;     /* error found while reading the request */
+  uint16_t content_length;
+  uint16_t body_len;
+  int16_t content_type;
+  int16_t accept;
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint8_t method;
+  uint8_t flags;
+  uint8_t state;
+  uint8_t path_len;
+  uint8_t url_len;
+  char url[HTTP_COAP_PROXY_URL_SIZE];
+  char inputbuf[HTTP_COAP_PROXY_URL_SIZE + 72];
+  uint16_t outlen;
+  char outbuf[HTTP_COAP_PROXY_BODY_SIZE + 192];
+};
+
+MEMB(conns, struct proxy_conn, HTTP_COAP_PROXY_CONNS);
+LIST(conn_list);
+MEMB(exchanges, struct exchange, HTTP_COAP_PROXY_EXCHANGES);
+LIST(exchange_list); /* most recently used first */
+
+static struct http_coap_proxy_stats stats;
+static uint16_t current_token;
+
+static const struct {
+  uint8_t coap;
+  const char *http;
+} content_types[] = {
+  { TEXT_PLAIN, "text/plain" },
+  { APPLICATION_LINK_FORMAT, "application/link-format" },
+  { APPLICATION_XML, "application/xml" },
+  { APPLICATION_OCTET_STREAM, "application/octet-stream" },
+  { APPLICATION_EXI, "application/exi" },
+  { APPLICATION_JSON, "application/json" },
+};
+
+static const struct {
+  uint16_t status;
+  const char *text;
+} status_texts[] = {
+  { 200, "OK" },
+  { 201, "Created" },
+  { 400, "Bad Request" },
+  { 401, "Unauthorized" },
+  { 403, "Forbidden" },
+  { 404, "Not Found" },
+  { 405, "Method Not Allowed" },
+  { 406, "Not Acceptable" },
+  { 412, "Precondition Failed" },
+  { 413, "Request Entity Too Large" },
+  { 414, "Request-URI Too Long" },
+  { 415, "Unsupported Media Type" },
+  { 500, "Internal Server Error" },
+  { 501, "Not Implemented" },
+  { 502, "Bad Gateway" },
+  { 503, "Service Unavailable" },
+  { 504, "Gateway Timeout" },
+};
+/*---------------------------------------------------------------------------*/
+static int
+content_type_from_http(const char *str)
+{
+  int i;
+
+  for(i = 0; i < sizeof(content_types) / sizeof(content_types[0]); ++i) {
+    if(strncasecmp(str, content_types[i].http, strlen(content_types[i].http)) == 0) {
+      return content_types[i].coap;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+content_type_to_http(int content_type)
+{
+  int i;
+
+  for(i = 0; i < sizeof(content_types) / sizeof(content_types[0]); ++i) {
+    if(content_types[i].coap == content_type) {
+      return content_types[i].http;
+    }
+  }
+  return "application/octet-stream";
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+status_text(uint16_t status)
+{
+  int i;
+
+  for(i = 0; i < sizeof(status_texts) / sizeof(status_texts[0]); ++i) {
+    if(status_texts[i].status == status) {
+      return status_texts[i].text;
+    }
+  }
+  return "";
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+status_from_coap(uint8_t code)
+{
+  switch(code) {
+  case CREATED_2_01:                  return 201;
+  case BAD_REQUEST_4_00:
+  case BAD_OPTION_4_02:
+  case REQUEST_ENTITY_INCOMPLETE_4_08: return 400;
+  case UNAUTHORIZED_4_01:             return 401;
+  case FORBIDDEN_4_03:                return 403;
+  case NOT_FOUND_4_04:                return 404;
+  case METHOD_NOT_ALLOWED_4_05:       return 405;
+  case NOT_ACCEPTABLE_4_06:           return 406;
+  case PRECONDITION_FAILED_4_12:      return 412;
+  case REQUEST_ENTITY_TOO_LARGE_4_13: return 413;
+  case UNSUPPORTED_MEDIA_TYPE_4_15:   return 415;
+  case NOT_IMPLEMENTED_5_01:          return 501;
+  case BAD_GATEWAY_5_02:
+  case PROXYING_NOT_SUPPORTED_5_05:   return 502;
+  case SERVICE_UNAVAILABLE_5_03:      return 503;
+  case GATEWAY_TIMEOUT_5_04:          return 504;
+  }
+  /* Other success, client, and server error codes by class */
+  return code < BAD_REQUEST_4_00 ? 200 : code < INTERNAL_SERVER_ERROR_5_00 ? 400 : 500;
+}
+/*---------------------------------------------------------------------------*/
+/*- CoAP exchanges ----------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+exchange_wake(struct exchange *ex)
+{
+  struct proxy_conn *s;
+
+  for(s = list_head(conn_list); s != NULL; s = s->next) {
+    if(s->exchange == ex) {
+      tcpip_poll_tcp(s->conn);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+exchange_fail(struct exchange *ex, uint16_t status)
+{
+  ex->status = status;
+  ex->length = 0;
+  ex->content_type = -1;
+  ex->cacheable = 0;
+  ex->observing = 0;
+  ex->block_num = 0;
+  ex->send_next = 0;
+  ex->state = EXCHANGE_DONE;
+  ++ex->version;
+  exchange_wake(ex);
+}
+/*---------------------------------------------------------------------------*/
+static void exchange_callback(void *data, void *response);
+
+static int
+exchange_send(struct exchange *ex)
+{
+  static coap_packet_t request[1];
+  coap_transaction_t *transaction;
+
+  coap_init_message(request, COAP_TYPE_CON, ex->method, coap_get_mid());
+  coap_set_header_token(request, ex->token, sizeof(ex->token));
+  if(ex->path_len) {
+    coap_set_header_uri_path(request, ex->url);
+  }
+  if(ex->url_len > ex->path_len + 2) {
+    coap_set_header_uri_query(request, ex->url + ex->path_len + 1);
+  }
+  if(ex->accept >= 0) {
+    coap_set_header_accept(request, ex->accept);
+  }
+  if(ex->observe && ex->block_num == 0) {
+    coap_set_header_observe(request, 0);
+  }
+  if(ex->block_num > 0) {
+    coap_set_header_block2(request, ex->block_num, 0, REST_MAX_CHUNK_SIZE);
+  } else if(ex->length) {
+    if(ex->content_type >= 0) {
+      coap_set_header_content_type(request, ex->content_type);
+    }
+    coap_set_payload(request, ex->payload, ex->length);
+  }
+
+  if((transaction = coap_new_transaction(request->mid, &ex->addr, ex->port)) == NULL) {
+    return 0;
+  }
+  transaction->callback = exchange_callback;
+  transaction->callback_data = ex;
+  if((transaction->packet_len = coap_serialize_message(request, transaction->packet)) == 0) {
+    coap_clear_transaction(transaction);
+    return 0;
+  }
+  coap_send_transaction(transaction);
+
+  ex->in_flight = 1;
+  timer_set(&ex->timer, HTTP_COAP_PROXY_TIMEOUT * CLOCK_SECOND);
+  ++stats.coap_requests;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+exchange_response(struct exchange *ex, coap_packet_t *response)
+{
+  uint32_t block_num = 0;
+  uint8_t more = 0;
+
+  if(response == NULL) {
+    PRINTF("proxy: timeout\n");
+    ++stats.timeouts;
+    exchange_fail(ex, 504);
+    return;
+  }
+  if(response->code == 0) {
+    /* Empty ACK, the response follows separately */
+    return;
+  }
+
+  if(coap_get_header_block2(response, &block_num, &more, NULL, NULL) && block_num != ex->block_num) {
+    if(block_num != 0 || !ex->observing) {
+      return;
+    }
+    /* A new notification interrupts the reassembly of the previous one. */
+  }
+  if(block_num == 0) {
+    ex->length = 0;
+    if(ex->observe) {
+      ex->observing = IS_OPTION(response, COAP_OPTION_OBSERVE) && ex->users > 0;
+    }
+  }
+  if(ex->length + response->payload_len > sizeof(ex->payload)) {
+    exchange_fail(ex, 502);
+    return;
+  }
+  memcpy(ex->payload + ex->length, response->payload, response->payload_len);
+  ex->length += response->payload_len;
+
+  if(more) {
+    /* Fetch the next block before publishing the response. The request is
+       sent from the process, as the engine still needs uip_buf to
+       acknowledge this response. */
+    ex->state = EXCHANGE_PENDING;
+    ex->block_num = block_num + 1;
+    ex->send_next = 1;
+    process_poll(&http_coap_proxy_process);
+    return;
+  }
+
+  ex->block_num = 0;
+  ex->status = status_from_coap(response->code);
+  ex->content_type = IS_OPTION(response, COAP_OPTION_CONTENT_TYPE) ? response->content_type : -1;
+  coap_get_header_max_age(response, &ex->max_age);
+  timer_set(&ex->timer, ex->max_age * CLOCK_SECOND);
+  ex->cacheable = ex->method == COAP_GET && response->code == CONTENT_2_05 && ex->max_age > 0;
+  if(response->code != CONTENT_2_05) {
+    ex->observing = 0;
+  }
+  ex->state = EXCHANGE_DONE;
+  ++ex->version;
+  exchange_wake(ex);
+}
+/*---------------------------------------------------------------------------*/
+static void
+exchange_callback(void *data, void *response)
+{
+  struct exchange *ex = (struct exchange *)data;
+
+  ex->in_flight = 0;
+  exchange_response(ex, (coap_packet_t *)response);
+}
+/*---------------------------------------------------------------------------*/
+/* Claims separate responses and notifications by their token. */
+static int
+handle_response(uip_ipaddr_t *addr, uint16_t port, coap_packet_t *response)
+{
+  struct exchange *ex;
+
+  if(response->token_len != sizeof(ex->token)) {
+    return 0;
+  }
+  for(ex = list_head(exchange_list); ex != NULL; ex = ex->next) {
+    if((ex->state == EXCHANGE_PENDING || ex->observing)
+       && memcmp(ex->token, response->token, sizeof(ex->token)) == 0
+       && ex->port == port && uip_ipaddr_cmp(&ex->addr, addr)) {
+      if(ex->state == EXCHANGE_DONE) {
+        ++stats.notifications;
+      }
+      exchange_response(ex, response);
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+exchange_matches(struct exchange *ex, struct proxy_conn *s)
+{
+  return ex->port == s->port && ex->accept == s->accept
+         && ex->url_len == s->url_len && memcmp(ex->url, s->url, s->url_len) == 0
+         && uip_ipaddr_cmp(&ex->addr, &s->addr);
+}
+/*---------------------------------------------------------------------------*/
+static struct exchange *
+exchange_find(struct proxy_conn *s)
+{
+  struct exchange *ex;
+
+  for(ex = list_head(exchange_list); ex != NULL; ex = ex->next) {
+    if(ex->method != COAP_GET || !exchange_matches(ex, s)) {
+      continue;
+    }
+    if(s->flags & FLAG_OBSERVE) {
+      /* Share the registration. */
+      if(ex->observe && (ex->state == EXCHANGE_PENDING || ex->observing)) {
+        return ex;
+      }
+    } else if(ex->state == EXCHANGE_PENDING
+              || (ex->cacheable && !timer_expired(&ex->timer))) {
+      return ex;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Requests that change a resource invalidate its cached responses. */
+static void
+exchange_invalidate(struct proxy_conn *s)
+{
+  struct exchange *ex;
+
+  for(ex = list_head(exchange_list); ex != NULL; ex = ex->next) {
+    if(ex->port == s->port && ex->path_len == s->path_len
+       && memcmp(ex->url, s->url, s->path_len) == 0 && uip_ipaddr_cmp(&ex->addr, &s->addr)) {
+      ex->cacheable = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct exchange *
+exchange_new(struct proxy_conn *s)
+{
+  struct exchange *ex, *victim;
+
+  if((ex = memb_alloc(&exchanges)) == NULL) {
+    /* Reuse the least recently used exchange that is not needed anymore. */
+    victim = NULL;
+    for(ex = list_head(exchange_list); ex != NULL; ex = ex->next) {
+      if(ex->users == 0 && ex->state == EXCHANGE_DONE && !ex->in_flight) {
+        victim = ex;
+      }
+    }
+    if(victim == NULL) {
+      return NULL;
+    }
+    list_remove(exchange_list, victim);
+    ex = victim;
+  }
+
+  uip_ipaddr_copy(&ex->addr, &s->addr);
+  ex->port = s->port;
+  ++current_token;
+  ex->token[0] = current_token >> 8;
+  ex->token[1] = current_token;
+  ex->method = s->method;
+  ex->state = EXCHANGE_PENDING;
+  ex->in_flight = 0;
+  ex->send_next = 0;
+  ex->observe = (s->flags & FLAG_OBSERVE) != 0;
+  ex->observing = 0;
+  ex->cacheable = 0;
+  ex->users = 0;
+  ex->accept = s->accept;
+  ex->content_type = s->content_type;
+  ex->version = 0;
+  ex->status = 0;
+  ex->block_num = 0;
+  ex->path_len = s->path_len;
+  ex->url_len = s->url_len;
+  memcpy(ex->url, s->url, s->url_len);
+  ex->length = s->body_len;
+  memcpy(ex->payload, s->outbuf, s->body_len);
+
+  list_push(exchange_list, ex);
+  return ex;
+}
+/*---------------------------------------------------------------------------*/
+static void
+exchange_attach(struct proxy_conn *s, struct exchange *ex)
+{
+  s->exchange = ex;
+  ++ex->users;
+
+  /* Long-poll requests wait for the next notification, all others take the current response. */
+  s->version = ex->version;
+  if(ex->state == EXCHANGE_DONE && (s->flags & (FLAG_OBSERVE | FLAG_HTTP11)) != FLAG_OBSERVE) {
+    --s->version;
+  }
+
+  list_remove(exchange_list, ex);
+  list_push(exchange_list, ex);
+}
+/*---------------------------------------------------------------------------*/
+static void
+exchange_release(struct proxy_conn *s)
+{
+  if(s->exchange != NULL) {
+    if(--s->exchange->users == 0) {
+      /* The next notification is rejected, which cancels the registration. */
+      s->exchange->observing = 0;
+    }
+    s->exchange = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Requests the next blocks of the responses that exchange_response() received. */
+static void
+send_next_blocks(void)
+{
+  struct exchange *ex;
+
+  for(ex = list_head(exchange_list); ex != NULL; ex = ex->next) {
+    if(ex->send_next) {
+      ex->send_next = 0;
+      if(!exchange_send(ex)) {
+        exchange_fail(ex, 503);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_timeouts(void)
+{
+  struct exchange *ex;
+
+  for(ex = list_head(exchange_list); ex != NULL; ex = ex->next) {
+    /* Waiting for a separate response; the transaction layer handles lost ACKs. */
+    if(ex->state == EXCHANGE_PENDING && !ex->in_flight && !ex->send_next
+       && timer_expired(&ex->timer)) {
+      ++stats.timeouts;
+      exchange_fail(ex, 504);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*- HTTP --------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+/* Parses "/[addr]:port/path?query" and "/observe/[addr]/path". Returns an HTTP status on error. */
+static uint16_t
+parse_target(struct proxy_conn *s, char *target, int len)
+{
+  char *p, *query;
+  int path_len, query_len;
+
+  if(len < 2 || target[len - 1] != ISO_space) {
+    return 414;
+  }
+  target[len - 1] = '\0';
+
+  if(target[0] != ISO_slash) {
+    return 400;
+  }
+  if(target[1] == '\0') {
+    s->flags |= FLAG_STATS;
+    return 0;
+  }
+  if(strncmp(target, "/observe/", 9) == 0) {
+    s->flags |= FLAG_OBSERVE;
+    target += 8;
+  }
+  if(target[1] != '[' || (p = strchr(target, ']')) == NULL
+     || !uiplib_ipaddrconv(target + 1, &s->addr)) {
+    return 400;
+  }
+
+  ++p;
+  s->port = UIP_HTONS(COAP_DEFAULT_PORT);
+  if(*p == ':') {
+    s->port = UIP_HTONS(atoi(p + 1));
+    while(*p != '\0' && *p != ISO_slash) {
+      ++p;
+    }
+  }
+  if(*p == ISO_slash) {
+    ++p;
+  } else if(*p != '\0') {
+    return 400;
+  }
+
+  if((query = strchr(p, '?')) != NULL) {
+    path_len = query - p;
+    ++query;
+    query_len = strlen(query);
+  } else {
+    path_len = strlen(p);
+    query_len = 0;
+  }
+  if(path_len + query_len + 2 > sizeof(s->url)) {
+    return 414;
+  }
+  memcpy(s->url, p, path_len);
+  s->url[path_len] = '\0';
+  memcpy(s->url + path_len + 1, query, query_len);
+  s->url[path_len + 1 + query_len] = '\0';
+  s->path_len = path_len;
+  s->url_len = path_len + query_len + 2;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+parse_header(struct proxy_conn *s, char *line)
+{
+  char *value;
+
+  if((value = strchr(line, ':')) == NULL) {
+    return;
+  }
+  for(++value; *value == ISO_space; ++value);
+
+  if(strncasecmp(line, "Connection:", 11) == 0) {
+    if(strncasecmp(value, "close", 5) == 0) {
+      s->flags &= ~FLAG_KEEP_ALIVE;
+    } else if(strncasecmp(value, "keep-alive", 10) == 0) {
+      s->flags |= FLAG_KEEP_ALIVE;
+    }
+  } else if(strncasecmp(line, "Content-Length:", 15) == 0) {
+    s->content_length = atoi(value);
+  } else if(strncasecmp(line, "Content-Type:", 13) == 0) {
+    s->content_type = content_type_from_http(value);
+  } else if(strncasecmp(line, "Accept:", 7) == 0) {
+    s->accept = content_type_from_http(value);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(handle_input(struct proxy_conn *s))
+{
+  uint16_t len;
+
+  PSOCK_BEGIN(&s->sin);
+
+  PSOCK_READTO(&s->sin, ISO_space);
+
+  if(strncmp(s->inputbuf, "GET ", 4) == 0) {
+    s->method = COAP_GET;
+  } else if(strncmp(s->inputbuf, "POST ", 5) == 0) {
+    s->method = COAP_POST;
+  } else if(strncmp(s->inputbuf, "PUT ", 4) == 0) {
+    s->method = COAP_PUT;
+  } else if(strncmp(s->inputbuf, "DELETE ", 7) == 0) {
+    s->method = COAP_DELETE;
+  } else {
+    s->status = 501;
+    s->state = STATE_OUTPUT;
+    PSOCK_EXIT(&s->sin);
+  }
+
+  PSOCK_READTO(&s->sin, ISO_space);
+
+  if((s->status = parse_target(s, s->inputbuf, PSOCK_DATALEN(&s->sin))) != 0) {
+    s->state = STATE_OUTPUT;
+    PSOCK_EXIT(&s->sin);
+  }
+
+  PSOCK_READTO(&s->sin, ISO_nl);
+
+  if(strncmp(s->inputbuf, "HTTP/1.1", 8) == 0) {
+    s->flags |= FLAG_HTTP11 | FLAG_KEEP_ALIVE;
+  }
+
+  /* Header lines that do not fit into the input buffer are ignored. */
+  while(1) {
+    PSOCK_READTO(&s->sin, ISO_nl);
+    len = PSOCK_DATALEN(&s->sin);
+    if(s->inputbuf[len - 1] != ISO_nl) {
+      do {
+        PSOCK_READTO(&s->sin, ISO_nl);
+      } while(s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] != ISO_nl);
+      continue;
+    }
+    if(len <= 2) {
+      break;
+    }
+    s->inputbuf[len - 1] = '\0';
+    parse_header(s, s->inputbuf);
+  }
+
+  if(s->content_length > 0) {
+    if(s->method == COAP_GET || s->content_length > REST_MAX_CHUNK_SIZE) {
+      s->status = 413;
+      s->state = STATE_OUTPUT;
+      PSOCK_EXIT(&s->sin);
+    }
+    /* The body is kept in the output buffer until the exchange takes it. */
+    while(s->body_len < s->content_length) {
+      PSOCK_READBUF_LEN(&s->sin, s->content_length - s->body_len);
+      len = MIN(PSOCK_DATALEN(&s->sin), s->content_length - s->body_len);
+      memcpy(s->outbuf + s->body_len, s->inputbuf, len);
+      s->body_len += len;
+    }
+  }
+
+  s->state = STATE_OUTPUT;
+
+  PSOCK_END(&s->sin);
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_request(struct proxy_conn *s)
+{
+  struct exchange *ex;
+
+  ++stats.requests;
+
+  if(s->status != 0 || (s->flags & FLAG_STATS)) {
+    return;
+  }
+
+  if(s->method == COAP_GET) {
+    if((ex = exchange_find(s)) != NULL) {
+      if(ex->state == EXCHANGE_DONE && !(s->flags & FLAG_OBSERVE)) {
+        ++stats.cache_hits;
+      } else {
+        ++stats.coalesced;
+      }
+      exchange_attach(s, ex);
+      return;
+    }
+  } else {
+    exchange_invalidate(s);
+  }
+
+  if((ex = exchange_new(s)) == NULL) {
+    ++stats.rejected;
+    s->status = 503;
+    return;
+  }
+  if(!exchange_send(ex)) {
+    exchange_fail(ex, 503);
+  }
+  exchange_attach(s, ex);
+}
+/*---------------------------------------------------------------------------*/
+static void
+format_head(struct proxy_conn *s, uint16_t status, const char *content_type, int length, uint32_t max_age)
+{
+  s->outlen = snprintf(s->outbuf, sizeof(s->outbuf), "HTTP/1.%c %u %s\r\nServer: Contiki HTTP-CoAP proxy\r\n",
+                       (s->flags & FLAG_HTTP11) ? '1' : '0', status, status_text(status));
+  if(content_type != NULL) {
+    s->outlen += snprintf(s->outbuf + s->outlen, sizeof(s->outbuf) - s->outlen, "Content-Type: %s\r\n", content_type);
+  }
+  if(length < 0) {
+    s->outlen += snprintf(s->outbuf + s->outlen, sizeof(s->outbuf) - s->outlen, "Transfer-Encoding: chunked\r\n");
+  } else {
+    s->outlen += snprintf(s->outbuf + s->outlen, sizeof(s->outbuf) - s->outlen, "Content-Length: %d\r\n", length);
+  }
+  if(max_age > 0) {
+    s->outlen += snprintf(s->outbuf + s->outlen, sizeof(s->outbuf) - s->outlen, "Cache-Control: max-age=%lu\r\n", (unsigned long)max_age);
+  }
+  s->outlen += snprintf(s->outbuf + s->outlen, sizeof(s->outbuf) - s->outlen, "Connection: %s\r\n\r\n",
+                        (s->flags & FLAG_KEEP_ALIVE) ? "keep-alive" : "close");
+}
+/*---------------------------------------------------------------------------*/
+static void
+format_text(struct proxy_conn *s, uint16_t status, const char *text, int length)
+{
+  format_head(s, status, "text/plain", length, 0);
+  memcpy(s->outbuf + s->outlen, text, length);
+  s->outlen += length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+format_response(struct proxy_conn *s, struct exchange *ex)
+{
+  uint32_t max_age = 0;
+
+  if(ex->cacheable && !timer_expired(&ex->timer)) {
+    max_age = timer_remaining(&ex->timer) / CLOCK_SECOND;
+  }
+  format_head(s, ex->status, ex->content_type >= 0 ? content_type_to_http(ex->content_type) : NULL, ex->length, max_age);
+  memcpy(s->outbuf + s->outlen, ex->payload, ex->length);
+  s->outlen += ex->length;
+}
+/*---------------------------------------------------------------------------*/
+static void
+format_chunk(struct proxy_conn *s, struct exchange *ex)
+{
+  s->outlen = sprintf(s->outbuf, "%x\r\n", ex->length);
+  memcpy(s->outbuf + s->outlen, ex->payload, ex->length);
+  s->outlen += ex->length;
+  s->outbuf[s->outlen++] = '\r';
+  s->outbuf[s->outlen++] = '\n';
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(handle_output(struct proxy_conn *s))
+{
+  struct exchange *ex = s->exchange;
+  static char text[192];
+
+  PSOCK_BEGIN(&s->sout);
+
+  if(ex == NULL) {
+    if(s->status == 0) {
+      format_text(s, 200, text, snprintf(text, sizeof(text),
+                  "requests %lu\ncache hits %lu\ncoalesced %lu\ncoap requests %lu\n"
+                  "notifications %lu\ntimeouts %lu\nrejected %lu\n",
+                  stats.requests, stats.cache_hits, stats.coalesced, stats.coap_requests,
+                  stats.notifications, stats.timeouts, stats.rejected));
+    } else {
+      /* The rest of a bad request cannot be parsed. */
+      s->flags &= ~FLAG_KEEP_ALIVE;
+      format_text(s, s->status, text, snprintf(text, sizeof(text), "%u %s\n", s->status, status_text(s->status)));
+    }
+    PSOCK_SEND(&s->sout, (uint8_t *)s->outbuf, s->outlen);
+    PSOCK_EXIT(&s->sout);
+  }
+
+  PSOCK_WAIT_UNTIL(&s->sout, ex->state == EXCHANGE_DONE && ex->version != s->version);
+
+  if(!(s->flags & FLAG_OBSERVE) || !(s->flags & FLAG_HTTP11) || ex->status != 200 || !ex->observing) {
+    format_response(s, ex);
+    exchange_release(s);
+    PSOCK_SEND(&s->sout, (uint8_t *)s->outbuf, s->outlen);
+    PSOCK_EXIT(&s->sout);
+  }
+
+  /* Stream the notifications as chunks of one response. */
+  format_head(s, 200, ex->content_type >= 0 ? content_type_to_http(ex->content_type) : NULL, -1, 0);
+  PSOCK_SEND(&s->sout, (uint8_t *)s->outbuf, s->outlen);
+
+  while(s->exchange->observing || s->exchange->version != s->version) {
+    PSOCK_WAIT_UNTIL(&s->sout, s->exchange->state == EXCHANGE_DONE
+                     && (s->exchange->version != s->version || !s->exchange->observing));
+    if(s->exchange->version != s->version && s->exchange->status == 200 && s->exchange->length > 0) {
+      format_chunk(s, s->exchange);
+      s->version = s->exchange->version;
+      PSOCK_SEND(&s->sout, (uint8_t *)s->outbuf, s->outlen);
+    }
+    s->version = s->exchange->version;
+  }
+
+  exchange_release(s);
+  PSOCK_SEND(&s->sout, (uint8_t *)"0\r\n\r\n", 5);
+
+  PSOCK_END(&s->sout);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_conn(struct proxy_conn *s)
+{
+  PSOCK_INIT(&s->sin, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
+  PSOCK_INIT(&s->sout, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
+  s->exchange = NULL;
+  s->status = 0;
+  s->content_length = 0;
+  s->body_len = 0;
+  s->content_type = -1;
+  s->accept = -1;
+  s->flags = 0;
+  s->state = STATE_WAITING;
+  timer_set(&s->timer, HTTP_COAP_PROXY_IDLE_TIMEOUT * CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static void
+free_conn(struct proxy_conn *s)
+{
+  exchange_release(s);
+  list_remove(conn_list, s);
+  memb_free(&conns, s);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_connection(struct proxy_conn *s)
+{
+  if(s->state == STATE_WAITING) {
+    handle_input(s);
+    if(s->state == STATE_OUTPUT) {
+      start_request(s);
+    }
+  }
+  if(s->state == STATE_OUTPUT && !PT_SCHEDULE(handle_output(s))) {
+    if(s->flags & FLAG_KEEP_ALIVE) {
+      /* The ACK for the response may carry the next request. */
+      reset_conn(s);
+      if(uip_newdata()) {
+        handle_connection(s);
+      }
+    } else {
+      s->state = STATE_CLOSING;
+      uip_close();
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+http_coap_proxy_appcall(void *state)
+{
+  struct proxy_conn *s = (struct proxy_conn *)state;
+
+  if(uip_closed() || uip_aborted() || uip_timedout()) {
+    if(s != NULL) {
+      free_conn(s);
+    }
+  } else if(uip_connected()) {
+    s = (struct proxy_conn *)memb_alloc(&conns);
+    if(s == NULL) {
+      ++stats.rejected;
+      uip_abort();
+      return;
+    }
+    list_add(conn_list, s);
+    s->conn = uip_conn;
+    tcp_markconn(uip_conn, s);
+    reset_conn(s);
+    handle_connection(s);
+  } else if(s != NULL) {
+    if(s->state == STATE_CLOSING) {
+      return;
+    }
+    if(uip_newdata()) {
+      timer_restart(&s->timer);
+    } else if(uip_poll() && s->state == STATE_WAITING && timer_expired(&s->timer)) {
+      s->state = STATE_CLOSING;
+      uip_close();
+      return;
+    }
+    handle_connection(s);
+  } else {
+    uip_abort();
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct http_coap_proxy_stats *
+http_coap_proxy_get_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(http_coap_proxy_process, "HTTP-CoAP proxy");
+
+PROCESS_THREAD(http_coap_proxy_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  memb_init(&conns);
+  list_init(conn_list);
+  memb_init(&exchanges);
+  list_init(exchange_list);
+  current_token = random_rand();
+
+  rest_init_engine();
+  coap_set_response_handler(handle_response);
+
+  tcp_listen(UIP_HTONS(HTTP_COAP_PROXY_PORT));
+  PRINTF("HTTP-CoAP proxy listening on port %u\n", HTTP_COAP_PROXY_PORT);
+
+  etimer_set(&et, CLOCK_SECOND);
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == tcpip_event) {
+      http_coap_proxy_appcall(data);
+    } else if(ev == PROCESS_EVENT_POLL) {
+      send_next_blocks();
+    } else if(ev == PROCESS_EVENT_TIMER && data == &et) {
+      check_timeouts();
+      etimer_reset(&et);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
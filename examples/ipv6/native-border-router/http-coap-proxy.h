@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         An HTTP-CoAP proxy for the nodes behind the border router
+ */
+
+#ifndef __HTTP_COAP_PROXY_H__
+#define __HTTP_COAP_PROXY_H__
+
+#include "contiki-net.h"
+
+/* The TCP port on which the proxy accepts HTTP requests. */
+#ifndef HTTP_COAP_PROXY_CONF_PORT
+#define HTTP_COAP_PROXY_PORT 8080
+#else /* HTTP_COAP_PROXY_CONF_PORT */
+#define HTTP_COAP_PROXY_PORT HTTP_COAP_PROXY_CONF_PORT
+#endif /* HTTP_COAP_PROXY_CONF_PORT */
+
+/* The number of concurrent HTTP connections. */
+#ifndef HTTP_COAP_PROXY_CONF_CONNS
+#define HTTP_COAP_PROXY_CONNS 16
+#else /* HTTP_COAP_PROXY_CONF_CONNS */
+#define HTTP_COAP_PROXY_CONNS HTTP_COAP_PROXY_CONF_CONNS
+#endif /* HTTP_COAP_PROXY_CONF_CONNS */
+
+/* The number of CoAP exchanges, which are outstanding requests or cached responses. */
+#ifndef HTTP_COAP_PROXY_CONF_EXCHANGES
+#define HTTP_COAP_PROXY_EXCHANGES 16
+#else /* HTTP_COAP_PROXY_CONF_EXCHANGES */
+#define HTTP_COAP_PROXY_EXCHANGES HTTP_COAP_PROXY_CONF_EXCHANGES
+#endif /* HTTP_COAP_PROXY_CONF_EXCHANGES */
+
+/* The largest path and query of a proxied URL. */
+#ifndef HTTP_COAP_PROXY_CONF_URL_SIZE
+#define HTTP_COAP_PROXY_URL_SIZE 64
+#else /* HTTP_COAP_PROXY_CONF_URL_SIZE */
+#define HTTP_COAP_PROXY_URL_SIZE HTTP_COAP_PROXY_CONF_URL_SIZE
+#endif /* HTTP_COAP_PROXY_CONF_URL_SIZE */
+
+/* The largest response body; blockwise responses are reassembled up to this size. */
+#ifndef HTTP_COAP_PROXY_CONF_BODY_SIZE
+#define HTTP_COAP_PROXY_BODY_SIZE 512
+#else /* HTTP_COAP_PROXY_CONF_BODY_SIZE */
+#define HTTP_COAP_PROXY_BODY_SIZE HTTP_COAP_PROXY_CONF_BODY_SIZE
+#endif /* HTTP_COAP_PROXY_CONF_BODY_SIZE */
+
+/* Seconds to wait for a separate CoAP response after its empty ACK. */
+#ifndef HTTP_COAP_PROXY_CONF_TIMEOUT
+#define HTTP_COAP_PROXY_TIMEOUT 30
+#else /* HTTP_COAP_PROXY_CONF_TIMEOUT */
+#define HTTP_COAP_PROXY_TIMEOUT HTTP_COAP_PROXY_CONF_TIMEOUT
+#endif /* HTTP_COAP_PROXY_CONF_TIMEOUT */
+
+/* Seconds an idle persistent connection is kept open. */
+#ifndef HTTP_COAP_PROXY_CONF_IDLE_TIMEOUT
+#define HTTP_COAP_PROXY_IDLE_TIMEOUT 10
+#else /* HTTP_COAP_PROXY_CONF_IDLE_TIMEOUT */
+#define HTTP_COAP_PROXY_IDLE_TIMEOUT HTTP_COAP_PROXY_CONF_IDLE_TIMEOUT
+#endif /* HTTP_COAP_PROXY_CONF_IDLE_TIMEOUT */
+
+struct http_coap_proxy_stats {
+  unsigned long requests;      /* HTTP requests */
+  unsigned long cache_hits;    /* answered with a fresh response */
+  unsigned long coalesced;     /* joined an outstanding CoAP request */
+  unsigned long coap_requests; /* CoAP requests sent, including further blocks */
+  unsigned long notifications; /* Observe notifications received */
+  unsigned long timeouts;      /* CoAP requests that were not answered */
+  unsigned long rejected;      /* no free connection or exchange */
+};
+
+PROCESS_NAME(http_coap_proxy_process);
+
+const struct http_coap_proxy_stats *http_coap_proxy_get_stats(void);
+
+#endif /* __HTTP_COAP_PROXY_H__ */
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *         Load test for the HTTP-CoAP proxy. Runs on the host and keeps
+ *         a number of concurrent HTTP connections busy with requests
+ *         for the given paths, e.g.:
+ *
+ *         ./http-proxy-load -c 16 -n 10000 aaaa::212:7401:1:101 8080 \
+ *             '/[aaaa::212:7401:1:102]/sensors/light' \
+ *             '/[aaaa::212:7401:1:102]/sensors/light?n=%d'
+ *
+ *         A %d in a path is replaced by the request number.
+ */
+
+#define _GNU_SOURCE /* strcasestr() */
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define MAX_CONNECTIONS 1024
+#define BUFFER_SIZE     4096
+
+enum { IDLE, CONNECTING, SENDING, READING };
+
+struct connection {
+  int fd;
+  int state;
+  int path;
+  double start;
+  int sent, request_len;
+  int received, header_len, content_length;
+  char request[512];
+  char buffer[BUFFER_SIZE];
+};
+
+static struct connection connections[MAX_CONNECTIONS];
+static struct addrinfo *server;
+static const char *host;
+static char **paths;
+static int path_count;
+static int keep_alive;
+static long requests, started, completed, errors, connects;
+static long status_classes[6];
+static double *latencies;
+
+/*---------------------------------------------------------------------------*/
+static double
+now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+/*---------------------------------------------------------------------------*/
+static void
+close_connection(struct connection *c)
+{
+  if(c->fd >= 0) {
+    close(c->fd);
+  }
+  c->fd = -1;
+  c->state = IDLE;
+}
+/*---------------------------------------------------------------------------*/
+static int
+open_connection(struct connection *c)
+{
+  c->fd = socket(server->ai_family, SOCK_STREAM, 0);
+  if(c->fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  fcntl(c->fd, F_SETFL, O_NONBLOCK);
+  ++connects;
+  if(connect(c->fd, server->ai_addr, server->ai_addrlen) < 0 && errno != EINPROGRESS) {
+    close_connection(c);
+    return -1;
+  }
+  c->state = CONNECTING;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_request(struct connection *c)
+{
+  if(started >= requests) {
+    close_connection(c);
+    return;
+  }
+  if(c->fd < 0 && open_connection(c) < 0) {
+    ++errors;
+    return;
+  }
+  c->path = started % path_count;
+  /* A %d in the path is replaced by the request number, which defeats caching. */
+  c->request_len = snprintf(c->request, sizeof(c->request), "GET ");
+  c->request_len += snprintf(c->request + c->request_len, sizeof(c->request) - c->request_len,
+                             paths[c->path], started++);
+  c->request_len += snprintf(c->request + c->request_len, sizeof(c->request) - c->request_len,
+                             " HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+                             host, keep_alive ? "keep-alive" : "close");
+  c->sent = 0;
+  c->received = 0;
+  c->header_len = 0;
+  c->content_length = -1;
+  c->start = now();
+  if(c->state != CONNECTING) {
+    c->state = SENDING;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+finish_request(struct connection *c, int status)
+{
+  if(status >= 100 && status < 600) {
+    ++status_classes[status / 100];
+  } else {
+    ++errors;
+  }
+  latencies[completed++] = now() - c->start;
+
+  if(!keep_alive || strcasestr(c->buffer, "Connection: close") != NULL) {
+    close_connection(c);
+  } else {
+    c->state = SENDING;
+  }
+  start_request(c);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_read(struct connection *c)
+{
+  char *end, *p;
+  int n;
+
+  n = read(c->fd, c->buffer + c->received, sizeof(c->buffer) - 1 - c->received);
+  if(n <= 0) {
+    if(n < 0 && errno == EAGAIN) {
+      return;
+    }
+    /* Closed before the response was complete */
+    ++errors;
+    close_connection(c);
+    start_request(c);
+    return;
+  }
+  c->received += n;
+  c->buffer[c->received] = '\0';
+
+  if(c->header_len == 0) {
+    if((end = strstr(c->buffer, "\r\n\r\n")) == NULL) {
+      return;
+    }
+    c->header_len = end + 4 - c->buffer;
+    if((p = strcasestr(c->buffer, "Content-Length:")) != NULL && p < end) {
+      c->content_length = atoi(p + 15);
+    }
+  }
+  if(c->content_length >= 0 && c->received >= c->header_len + c->content_length) {
+    finish_request(c, atoi(c->buffer + 9));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+compare_double(const void *a, const void *b)
+{
+  double d = *(const double *)a - *(const double *)b;
+  return d < 0 ? -1 : d > 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  struct pollfd fds[MAX_CONNECTIONS];
+  struct connection *c;
+  struct addrinfo hints;
+  int concurrency = 8;
+  double begin, elapsed;
+  int opt, i, n, error;
+  socklen_t len;
+
+  requests = 1000;
+  keep_alive = 1;
+  while((opt = getopt(argc, argv, "c:n:C")) != -1) {
+    switch(opt) {
+    case 'c':
+      concurrency = atoi(optarg);
+      break;
+    case 'n':
+      requests = atol(optarg);
+      break;
+    case 'C':
+      keep_alive = 0;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-c connections] [-n requests] [-C] host port path...\n"
+              " -C  close the connection after each request\n", argv[0]);
+      return 1;
+    }
+  }
+  if(argc - optind < 3 || concurrency < 1 || concurrency > MAX_CONNECTIONS || requests < 1) {
+    fprintf(stderr, "usage: %s [-c connections] [-n requests] [-C] host port path...\n", argv[0]);
+    return 1;
+  }
+  host = argv[optind];
+  paths = &argv[optind + 2];
+  path_count = argc - optind - 2;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  if((error = getaddrinfo(host, argv[optind + 1], &hints, &server)) != 0) {
+    fprintf(stderr, "%s: %s\n", host, gai_strerror(error));
+    return 1;
+  }
+  latencies = calloc(requests, sizeof(double));
+
+  begin = now();
+  for(i = 0; i < concurrency; ++i) {
+    connections[i].fd = -1;
+    start_request(&connections[i]);
+  }
+
+  while(1) {
+    for(i = 0, n = 0; i < concurrency; ++i) {
+      c = &connections[i];
+      if(c->state != IDLE) {
+        fds[n].fd = c->fd;
+        fds[n].events = c->state == READING ? POLLIN : POLLOUT;
+        ++n;
+      }
+    }
+    if(n == 0) {
+      break;
+    }
+    if(poll(fds, n, 10000) == 0) {
+      fprintf(stderr, "no progress for 10 s\n");
+      break;
+    }
+    for(i = 0, n = 0; i < concurrency; ++i) {
+      c = &connections[i];
+      if(c->state == IDLE) {
+        continue;
+      }
+      if(fds[n++].revents == 0) {
+        continue;
+      }
+      if(c->state == CONNECTING) {
+        len = sizeof(error);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+        if(error != 0) {
+          ++errors;
+          close_connection(c);
+          start_request(c);
+          continue;
+        }
+        c->state = SENDING;
+      }
+      if(c->state == SENDING) {
+        int sent = write(c->fd, c->request + c->sent, c->request_len - c->sent);
+        if(sent > 0 && (c->sent += sent) == c->request_len) {
+          c->state = READING;
+        } else if(sent < 0 && errno != EAGAIN) {
+          ++errors;
+          close_connection(c);
+          start_request(c);
+        }
+      } else if(c->state == READING) {
+        handle_read(c);
+      }
+    }
+  }
+  elapsed = now() - begin;
+
+  qsort(latencies, completed, sizeof(double), compare_double);
+  printf("requests     %ld in %.2f s, %.1f requests/s\n", completed, elapsed, completed / elapsed);
+  printf("connections  %ld\n", connects);
+  printf("status       2xx %ld, 4xx %ld, 5xx %ld, errors %ld\n",
+         status_classes[2], status_classes[4], status_classes[5], errors);
+  if(completed > 0) {
+    printf("latency      median %.1f ms, 99%% %.1f ms, max %.1f ms\n",
+           latencies[completed / 2] * 1000, latencies[completed * 99 / 100] * 1000,
+           latencies[completed - 1] * 1000);
+  }
+  freeaddrinfo(server);
+  return 0;
+}
@@ -49,6 +49,18 @@
 
 #define SERIALIZE_ATTRIBUTES 1
 
+#if WITH_COAP_PROXY
+/* The HTTP-CoAP proxy has a CoAP transaction open for each outstanding request. */
+#undef COAP_MAX_OPEN_TRANSACTIONS
+#define COAP_MAX_OPEN_TRANSACTIONS 16
+
+/* uIP waits for the ACK of each segment, so send HTTP responses in one segment. */
+#undef UIP_CONF_TCP_MSS
+#define UIP_CONF_TCP_MSS 1220
+#undef UIP_CONF_RECEIVE_WINDOW
+#define UIP_CONF_RECEIVE_WINDOW 1220
+#endif /* WITH_COAP_PROXY */
+
 #define CMD_CONF_OUTPUT border_router_cmd_output
 
 #undef NETSTACK_CONF_RDC
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         TCP throughput benchmark. Sends a bulk transfer to another
+ *         node and reports the throughput.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PORT 5001
+
+/* The amount of data to send. */
+#ifndef TCP_THROUGHPUT_BYTES
+#define TCP_THROUGHPUT_BYTES (1024 * 1024UL)
+#endif
+
+/* The delay before connecting, to let the interfaces come up. */
+#ifndef TCP_THROUGHPUT_DELAY
+#define TCP_THROUGHPUT_DELAY (5 * CLOCK_SECOND)
+#endif
+
+static struct sender {
+  struct psock p;
+  uint8_t inputbuf[1];
+  unsigned long sent;
+  clock_time_t start;
+} sender;
+
+static struct receiver {
+  unsigned long received;
+  clock_time_t start;
+} receiver;
+
+static uint8_t data[4096];
+
+PROCESS(tcp_throughput_process, "TCP throughput");
+AUTOSTART_PROCESSES(&tcp_throughput_process);
+/*---------------------------------------------------------------------------*/
+static void
+print_result(const char *what, unsigned long bytes, clock_time_t start)
+{
+  unsigned long ms;
+
+  ms = (clock_time() - start) * 1000 / CLOCK_SECOND;
+  printf("%s %lu bytes in %lu ms, %lu kB/s\n", what, bytes, ms,
+         ms > 0 ? bytes / ms * 1000 / 1024 : 0);
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(send_data(struct sender *s))
+{
+  PSOCK_BEGIN(&s->p);
+
+  while(s->sent < TCP_THROUGHPUT_BYTES) {
+    PSOCK_SEND(&s->p, data, sizeof(data));
+    s->sent += sizeof(data);
+  }
+  PSOCK_CLOSE(&s->p);
+
+  PSOCK_END(&s->p);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_sender(void)
+{
+  if(uip_connected()) {
+    PSOCK_INIT(&sender.p, sender.inputbuf, sizeof(sender.inputbuf));
+    sender.sent = 0;
+    sender.start = clock_time();
+  }
+  if(uip_closed()) {
+    print_result("sent", sender.sent, sender.start);
+    exit(0);
+  }
+  if(uip_aborted() || uip_timedout()) {
+    printf("connection %s after %lu bytes\n",
+           uip_aborted() ? "aborted" : "timed out", sender.sent);
+    exit(1);
+  }
+  send_data(&sender);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_receiver(void)
+{
+  if(uip_connected()) {
+    receiver.received = 0;
+    receiver.start = clock_time();
+  }
+  if(uip_newdata()) {
+    receiver.received += uip_datalen();
+  }
+  if(uip_closed() || uip_aborted() || uip_timedout()) {
+    print_result("received", receiver.received, receiver.start);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tcp_throughput_process, ev, ev_data)
+{
+#ifdef TCP_THROUGHPUT_PEER
+  static struct etimer et;
+  uip_ipaddr_t addr;
+#endif
+
+  PROCESS_BEGIN();
+
+  memset(data, 'x', sizeof(data));
+  tcp_listen(UIP_HTONS(PORT));
+
+#ifdef TCP_THROUGHPUT_PEER
+  etimer_set(&et, TCP_THROUGHPUT_DELAY);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  uiplib_ipaddrconv(TCP_THROUGHPUT_PEER, &addr);
+  printf("sending %lu bytes to %s, send window %d\n",
+         TCP_THROUGHPUT_BYTES, TCP_THROUGHPUT_PEER, UIP_TCP_SEND_WINDOW);
+  if(tcp_connect(&addr, UIP_HTONS(PORT), &sender) == NULL) {
+    printf("no connection\n");
+    exit(1);
+  }
+#endif
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+    if(ev_data == &sender) {
+      handle_sender();
+    } else {
+      handle_receiver();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
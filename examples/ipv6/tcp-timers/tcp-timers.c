@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         TCP timer benchmark. Opens as many TCP connections as uIP has
+ *         room for and counts how often the TCP/IP process wakes up for
+ *         the connections' timers, and how many connections it
+ *         processes, while they are idle, while one of them
+ *         retransmits, and while one of them is in TIME_WAIT.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* How long each phase lasts. */
+#define PHASE_TIME (10 * CLOCK_SECOND)
+
+/* The TCP flags, as in uip6.c. */
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_ACK 0x10
+
+#define TCP_PEER_PORT 80
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_TCP_BUF ((struct uip_tcp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+static uip_ipaddr_t host;
+
+static struct uip_conn *conns[UIP_CONNS];
+static unsigned conn_count;
+
+/* The connection that sends data that is never acknowledged, and the
+   one that is closed, once they are polled. */
+static struct uip_conn *sender, *closer;
+static uint8_t sending, closing;
+
+static unsigned long polls;
+
+PROCESS(tcp_timers, "TCP timer benchmark");
+AUTOSTART_PROCESSES(&tcp_timers);
+/*---------------------------------------------------------------------------*/
+static void
+seqno_add(uint8_t *dst, const uint8_t *seqno, uint16_t n)
+{
+  uint32_t s;
+
+  s = ((uint32_t)seqno[0] << 24) + ((uint32_t)seqno[1] << 16) +
+    ((uint32_t)seqno[2] << 8) + seqno[3] + n;
+  dst[0] = s >> 24;
+  dst[1] = s >> 16;
+  dst[2] = s >> 8;
+  dst[3] = s;
+}
+/*---------------------------------------------------------------------------*/
+/* Feeds the TCP/IP process a segment from the peer of a connection. */
+static void
+conn_input(struct uip_conn *conn, uint8_t flags)
+{
+  uint8_t ackno[4];
+
+  memset(UIP_IP_BUF, 0, UIP_IPTCPH_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[1] = UIP_TCPH_LEN;
+  UIP_IP_BUF->proto = UIP_PROTO_TCP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &conn->ripaddr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &host);
+
+  seqno_add(ackno, conn->snd_nxt, conn->len);
+  UIP_TCP_BUF->srcport = conn->rport;
+  UIP_TCP_BUF->destport = conn->lport;
+  memcpy(UIP_TCP_BUF->seqno, conn->rcv_nxt, 4);
+  memcpy(UIP_TCP_BUF->ackno, ackno, 4);
+  UIP_TCP_BUF->tcpoffset = 5 << 4;
+  UIP_TCP_BUF->flags = flags;
+  UIP_TCP_BUF->wnd[0] = 4;
+  UIP_TCP_BUF->tcpchksum = ~(uip_tcpchksum());
+
+  uip_len = UIP_IPTCPH_LEN;
+  tcpip_input();
+}
+/*---------------------------------------------------------------------------*/
+static void
+appcall(void)
+{
+  if(uip_poll()) {
+    ++polls;
+  }
+  if(uip_conn == sender && sending && (uip_poll() || uip_rexmit())) {
+    uip_send("x", 1);
+  } else if(uip_conn == closer && closing && uip_poll()) {
+    uip_close();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *phase, clock_time_t start)
+{
+  printf("%-10s %8lu %8lu %8lu %8lu %8lu\n", phase,
+         (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND),
+         (unsigned long)uip_stat.tcp.wakeups,
+         (unsigned long)uip_stat.tcp.timers,
+         polls, (unsigned long)uip_stat.tcp.rexmit);
+  uip_stat.tcp.wakeups = 0;
+  uip_stat.tcp.timers = 0;
+  uip_stat.tcp.rexmit = 0;
+  polls = 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tcp_timers, ev, data)
+{
+  static uip_ipaddr_t peer;
+  static struct etimer et;
+  static clock_time_t start;
+  static unsigned errors;
+  struct uip_conn *conn;
+
+  PROCESS_BEGIN();
+
+  uip_ipaddr_copy(&host, &uip_ds6_get_link_local(-1)->ipaddr);
+
+  /* Open the TCP connections and establish them with a SYNACK from
+     each peer. */
+  for(conn_count = 0; conn_count < UIP_CONNS; ++conn_count) {
+    uip_ip6addr(&peer, 0xfd00, 0, 0, 0, 0, 0, 0, conn_count + 1);
+    conn = tcp_connect(&peer, UIP_HTONS(TCP_PEER_PORT), NULL);
+    if(conn == NULL) {
+      break;
+    }
+    conn_input(conn, TCP_SYN | TCP_ACK);
+    if(conn->tcpstateflags != UIP_ESTABLISHED) {
+      ++errors;
+    }
+    conns[conn_count] = conn;
+  }
+  sender = conns[0];
+  closer = conns[1];
+
+  printf("%u TCP connections, %s\n", conn_count,
+         UIP_TCP_EVENT_TIMERS ? "event-driven timers" : "periodic timers");
+  printf("phase       time(ms)  wakeups   timers    polls   rexmit\n");
+
+  /* Let the connections' first polls pass. */
+  etimer_set(&et, CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  report("setup", clock_time() - CLOCK_SECOND);
+
+  start = clock_time();
+  etimer_set(&et, PHASE_TIME);
+  while(!etimer_expired(&et)) {
+    PROCESS_WAIT_EVENT();
+    if(ev == tcpip_event) {
+      appcall();
+    }
+  }
+  report("idle", start);
+
+  /* The sender's data is never acknowledged, so uIP retransmits it. */
+  start = clock_time();
+  sending = 1;
+  tcpip_poll_tcp(sender);
+  etimer_set(&et, PHASE_TIME);
+  while(!etimer_expired(&et)) {
+    PROCESS_WAIT_EVENT();
+    if(ev == tcpip_event) {
+      appcall();
+    }
+  }
+  if(!uip_outstanding(sender)) {
+    ++errors;
+  }
+  report("rexmit", start);
+
+  /* The closer's FIN is acknowledged together with the peer's FIN, so
+     the connection goes to TIME_WAIT and is closed five seconds
+     later. */
+  start = clock_time();
+  closing = 1;
+  tcpip_poll_tcp(closer);
+  etimer_set(&et, CLOCK_SECOND);
+  while(!etimer_expired(&et)) {
+    PROCESS_WAIT_EVENT();
+    if(ev == tcpip_event) {
+      appcall();
+    }
+  }
+  conn_input(closer, TCP_FIN | TCP_ACK);
+  if(closer->tcpstateflags != UIP_TIME_WAIT) {
+    ++errors;
+  }
+  etimer_set(&et, PHASE_TIME - CLOCK_SECOND);
+  while(!etimer_expired(&et)) {
+    PROCESS_WAIT_EVENT();
+    if(ev == tcpip_event) {
+      appcall();
+    }
+  }
+  if(closer->tcpstateflags != UIP_CLOSED) {
+    ++errors;
+  }
+  report("time-wait", start);
+
+  if(errors) {
+    printf("%u connections were not in the expected state\n", errors);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         JSON parse benchmark. Parses a document of sensor readings
+ *         with jsonparse and with jsonstream, both in one piece and
+ *         in chunks as they would arrive from the network.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+
+#include "jsonparse.h"
+#include "jsonstream.h"
+
+/* The number of times to parse the document with each parser. */
+#ifndef BENCHMARK_ROUNDS
+#define BENCHMARK_ROUNDS 20000UL
+#endif
+
+/* The number of readings in the document. */
+#ifndef BENCHMARK_READINGS
+#define BENCHMARK_READINGS 32
+#endif
+
+/* The chunk size for the streaming parser, e.g., a TCP segment. */
+#ifndef BENCHMARK_CHUNK_SIZE
+#define BENCHMARK_CHUNK_SIZE 64
+#endif
+
+static char document[BENCHMARK_READINGS * 64 + 64];
+static int document_len;
+static unsigned long checksum;
+
+/*---------------------------------------------------------------------------*/
+static void
+make_document(void)
+{
+  int i;
+
+  document_len = sprintf(document, "{\"node\": \"aaaa::212:7401:1:101\", "
+                         "\"readings\": [");
+  for(i = 0; i < BENCHMARK_READINGS; i++) {
+    document_len += sprintf(document + document_len,
+                            "%s\n  {\"sensor\": \"temp%d\", \"time\": %d, "
+                            "\"value\": %d}", i > 0 ? "," : "",
+                            i, 1357000000 + i * 60, 2000 + i * 37);
+  }
+  document_len += sprintf(document + document_len, "]}");
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse_jsonparse(void)
+{
+  struct jsonparse_state state;
+  int type;
+
+  jsonparse_setup(&state, document, document_len);
+  while((type = jsonparse_next(&state)) != 0) {
+    if(type == JSON_TYPE_NUMBER) {
+      checksum += jsonparse_get_value_as_long(&state);
+    } else if(type == JSON_TYPE_STRING || type == JSON_TYPE_PAIR_NAME) {
+      checksum += jsonparse_get_len(&state);
+    }
+  }
+  return state.error;
+}
+/*---------------------------------------------------------------------------*/
+static void
+callback(struct jsonstream_state *state, int type, const char *value, int len)
+{
+  if(type == JSON_TYPE_NUMBER) {
+    checksum += jsonstream_get_value_as_long(state);
+  } else if(type == JSON_TYPE_STRING || type == JSON_TYPE_PAIR_NAME) {
+    checksum += len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse_jsonstream(int chunk_size)
+{
+  struct jsonstream_state state;
+  int pos, len;
+
+  jsonstream_init(&state, callback, NULL);
+  for(pos = 0; pos < document_len; pos += len) {
+    len = document_len - pos < chunk_size ? document_len - pos : chunk_size;
+    if(jsonstream_feed(&state, document + pos, len) != JSON_ERROR_OK) {
+      break;
+    }
+  }
+  return jsonstream_finish(&state);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(json_parse_benchmark, "JSON parse benchmark");
+AUTOSTART_PROCESSES(&json_parse_benchmark);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(json_parse_benchmark, ev, data)
+{
+  unsigned long n, sums[3];
+  clock_time_t start, times[3];
+  int errors, i;
+
+  PROCESS_BEGIN();
+
+  make_document();
+  printf("document: %d bytes, %d readings\n", document_len, BENCHMARK_READINGS);
+
+  errors = 0;
+  for(i = 0; i < 3; i++) {
+    checksum = 0;
+    start = clock_time();
+    for(n = 0; n < BENCHMARK_ROUNDS; n++) {
+      if(i == 0) {
+        errors += parse_jsonparse() != JSON_ERROR_OK;
+      } else {
+        errors += parse_jsonstream(i == 1 ? document_len :
+                                   BENCHMARK_CHUNK_SIZE) != JSON_ERROR_OK;
+      }
+    }
+    times[i] = clock_time() - start;
+    sums[i] = checksum;
+  }
+
+  printf("parser                 time(ms)  kB/s\n");
+  printf("jsonparse              %8lu  %lu\n",
+         (unsigned long)(times[0] * 1000 / CLOCK_SECOND),
+         times[0] ? BENCHMARK_ROUNDS * document_len / 1024 * CLOCK_SECOND / times[0] : 0);
+  printf("jsonstream             %8lu  %lu\n",
+         (unsigned long)(times[1] * 1000 / CLOCK_SECOND),
+         times[1] ? BENCHMARK_ROUNDS * document_len / 1024 * CLOCK_SECOND / times[1] : 0);
+  printf("jsonstream, %3d-byte   %8lu  %lu\n", BENCHMARK_CHUNK_SIZE,
+         (unsigned long)(times[2] * 1000 / CLOCK_SECOND),
+         times[2] ? BENCHMARK_ROUNDS * document_len / 1024 * CLOCK_SECOND / times[2] : 0);
+
+  if(errors || sums[0] != sums[1] || sums[0] != sums[2]) {
+    printf("MISMATCH: %d errors, checksums %lu %lu %lu\n",
+           errors, sums[0], sums[1], sums[2]);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         JSON print benchmark. Prints a tree of sensor readings with
+ *         jsontree through putchar and into buffers with
+ *         jsontree_print_buffer(), and reports the bytes per second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+
+#include "jsontree.h"
+
+/* The number of times to print the tree in each mode. */
+#ifndef BENCHMARK_ROUNDS
+#define BENCHMARK_ROUNDS 20000UL
+#endif
+
+/* The buffer size for chunked output, e.g., a CoAP block. */
+#ifndef BENCHMARK_CHUNK_SIZE
+#define BENCHMARK_CHUNK_SIZE 64
+#endif
+
+#define OUTPUT_SIZE 2048
+
+static char output[OUTPUT_SIZE];
+static int output_len;
+static char reference[OUTPUT_SIZE];
+static int reference_len;
+
+/*---------------------------------------------------------------------------*/
+static int
+uptime_output(struct jsontree_context *js_ctx)
+{
+  jsontree_write_int(js_ctx, 1357000000);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct jsontree_callback uptime_callback =
+  JSONTREE_CALLBACK(uptime_output, NULL);
+
+static struct jsontree_string temp_unit = JSONTREE_STRING("Cel");
+static struct jsontree_string hum_unit = JSONTREE_STRING("%RH");
+static struct jsontree_string light_unit = JSONTREE_STRING("lx");
+static struct jsontree_int temp_value = { JSON_TYPE_INT, 2187 };
+static struct jsontree_int hum_value = { JSON_TYPE_INT, 4512 };
+static struct jsontree_int light_value = { JSON_TYPE_INT, 301 };
+static struct jsontree_int min_value = { JSON_TYPE_INT, -4000 };
+static struct jsontree_int max_value = { JSON_TYPE_INT, 12500 };
+
+JSONTREE_OBJECT(temp_tree,
+                JSONTREE_PAIR("name", &temp_unit),
+                JSONTREE_PAIR("value", &temp_value),
+                JSONTREE_PAIR("min", &min_value),
+                JSONTREE_PAIR("max", &max_value));
+JSONTREE_OBJECT(hum_tree,
+                JSONTREE_PAIR("name", &hum_unit),
+                JSONTREE_PAIR("value", &hum_value),
+                JSONTREE_PAIR("min", &min_value),
+                JSONTREE_PAIR("max", &max_value));
+JSONTREE_OBJECT(light_tree,
+                JSONTREE_PAIR("name", &light_unit),
+                JSONTREE_PAIR("value", &light_value),
+                JSONTREE_PAIR("min", &min_value),
+                JSONTREE_PAIR("max", &max_value));
+
+static struct jsontree_value *sensor_values[] = {
+  (struct jsontree_value *)&temp_tree,
+  (struct jsontree_value *)&hum_tree,
+  (struct jsontree_value *)&light_tree,
+  (struct jsontree_value *)&temp_tree,
+  (struct jsontree_value *)&hum_tree,
+  (struct jsontree_value *)&light_tree,
+};
+static struct jsontree_array sensor_array = {
+  JSON_TYPE_ARRAY,
+  sizeof(sensor_values) / sizeof(struct jsontree_value *),
+  sensor_values
+};
+
+static struct jsontree_string node_name =
+  JSONTREE_STRING("aaaa::212:7401:1:101 \"kitchen\"");
+
+JSONTREE_OBJECT(node_tree,
+                JSONTREE_PAIR("node", &node_name),
+                JSONTREE_PAIR("time", &uptime_callback),
+                JSONTREE_PAIR("sensors", &sensor_array));
+
+/*---------------------------------------------------------------------------*/
+static int
+output_putchar(int c)
+{
+  if(output_len < OUTPUT_SIZE) {
+    output[output_len++] = c;
+  }
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_putchar(void)
+{
+  struct jsontree_context js_ctx;
+
+  output_len = 0;
+  jsontree_setup(&js_ctx, (struct jsontree_value *)&node_tree, output_putchar);
+  while(jsontree_print_next(&js_ctx));
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_buffer(int chunk_size)
+{
+  struct jsontree_context js_ctx;
+  int len;
+
+  output_len = 0;
+  jsontree_setup(&js_ctx, (struct jsontree_value *)&node_tree, NULL);
+  do {
+    if(chunk_size > OUTPUT_SIZE - output_len) {
+      chunk_size = OUTPUT_SIZE - output_len;
+    }
+    len = jsontree_print_buffer(&js_ctx, &output[output_len], chunk_size);
+    output_len += len;
+  } while(len == chunk_size && chunk_size > 0);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(json_print_benchmark, "JSON print benchmark");
+AUTOSTART_PROCESSES(&json_print_benchmark);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(json_print_benchmark, ev, data)
+{
+  static const char *names[] = {
+    "putchar", "buffer", "buffer, chunked"
+  };
+  unsigned long n, bytes;
+  clock_time_t start, time;
+  int errors, i;
+
+  PROCESS_BEGIN();
+
+  print_putchar();
+  memcpy(reference, output, output_len);
+  reference_len = output_len;
+  printf("document: %d bytes\n", reference_len);
+  printf("mode              time(ms)  kB/s\n");
+
+  for(i = 0; i < 3; i++) {
+    errors = 0;
+    bytes = 0;
+    start = clock_time();
+    for(n = 0; n < BENCHMARK_ROUNDS; n++) {
+      if(i == 0) {
+        print_putchar();
+      } else {
+        print_buffer(i == 1 ? OUTPUT_SIZE : BENCHMARK_CHUNK_SIZE);
+      }
+      bytes += output_len;
+    }
+    time = clock_time() - start;
+    if(output_len != reference_len ||
+       memcmp(output, reference, reference_len) != 0) {
+      errors++;
+    }
+
+    printf("%-16s  %8lu  %lu%s\n", names[i],
+           (unsigned long)(time * 1000 / CLOCK_SECOND),
+           time > 0 ? bytes / 1024 * CLOCK_SECOND / time : 0,
+           errors ? "  MISMATCH" : "");
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Ring buffer benchmark. Moves a stream of bytes through the
+ *         ring buffer and the big ring buffer, byte by byte, in
+ *         copied blocks, and in place with spans; first from one
+ *         thread, then from a producer thread to a consumer thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "contiki.h"
+
+#include "lib/random.h"
+#include "lib/ringbuf.h"
+#include "lib/bigringbuf.h"
+
+/* The number of bytes to move with each variant. */
+#ifndef BENCHMARK_BYTES
+#define BENCHMARK_BYTES (32UL * 1024 * 1024)
+#endif
+
+/* The size of the big ring buffer. */
+#ifndef BENCHMARK_BUFSIZE
+#define BENCHMARK_BUFSIZE 1024
+#endif
+
+/* The block size for block access. */
+#ifndef BENCHMARK_CHUNK_SIZE
+#define BENCHMARK_CHUNK_SIZE 64
+#endif
+
+#define SOURCE_SIZE 4096
+#define VARIANTS 6
+
+static uint8_t source[SOURCE_SIZE];
+static uint8_t small_data[128];
+static uint8_t big_data[BENCHMARK_BUFSIZE];
+static struct ringbuf small;
+static struct bigringbuf big;
+
+/* A Fletcher-style checksum, which also catches reordered bytes. */
+static unsigned long sum1, sum2;
+
+/*---------------------------------------------------------------------------*/
+static void
+consume(const uint8_t *data, int len)
+{
+  unsigned long s1, s2;
+  int i;
+
+  s1 = sum1;
+  s2 = sum2;
+  for(i = 0; i < len; i++) {
+    s1 += data[i];
+    s2 += s1;
+  }
+  sum1 = s1;
+  sum2 = s2;
+}
+/*---------------------------------------------------------------------------*/
+/* Produces up to len bytes from position pos of the stream. */
+static int
+produce(uint8_t *data, unsigned long pos, int len)
+{
+  int n;
+
+  n = SOURCE_SIZE - pos % SOURCE_SIZE;
+  if(n > len) {
+    n = len;
+  }
+  if(n > BENCHMARK_BYTES - pos) {
+    n = BENCHMARK_BYTES - pos;
+  }
+  memcpy(data, &source[pos % SOURCE_SIZE], n);
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/* The number of bytes to move from position pos through a buffer. */
+static int
+chunk(unsigned long pos, int space)
+{
+  int n;
+
+  n = BENCHMARK_CHUNK_SIZE < space ? BENCHMARK_CHUNK_SIZE : space;
+  if(n > BENCHMARK_BYTES - pos) {
+    n = BENCHMARK_BYTES - pos;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+move_small_bytes(void)
+{
+  unsigned long pos;
+  uint8_t c;
+  int i, n;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos += n) {
+    n = chunk(pos, sizeof(small_data) - 1);
+    for(i = 0; i < n; i++) {
+      ringbuf_put(&small, source[(pos + i) % SOURCE_SIZE]);
+    }
+    for(i = 0; i < n; i++) {
+      c = ringbuf_get(&small);
+      consume(&c, 1);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+move_big_bytes(void)
+{
+  unsigned long pos;
+  uint8_t c;
+  int i, n;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos += n) {
+    n = chunk(pos, sizeof(big_data));
+    for(i = 0; i < n; i++) {
+      bigringbuf_put(&big, source[(pos + i) % SOURCE_SIZE]);
+    }
+    for(i = 0; i < n; i++) {
+      c = bigringbuf_get(&big);
+      consume(&c, 1);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+move_big_blocks(void)
+{
+  uint8_t block[BENCHMARK_CHUNK_SIZE];
+  unsigned long pos;
+  int n;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos += n) {
+    n = produce(block, pos, sizeof(block));
+    n = bigringbuf_write(&big, block, n);
+    n = bigringbuf_read(&big, block, n);
+    consume(block, n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+move_big_spans(void)
+{
+  unsigned long pos;
+  uint8_t *ptr;
+  int n, len;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos += len) {
+    n = bigringbuf_put_span(&big, &ptr);
+    len = produce(ptr, pos, n < BENCHMARK_CHUNK_SIZE ? n : BENCHMARK_CHUNK_SIZE);
+    bigringbuf_put_commit(&big, len);
+    while((n = bigringbuf_get_span(&big, &ptr)) > 0) {
+      consume(ptr, n);
+      bigringbuf_get_commit(&big, n);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+produce_bytes(void *arg)
+{
+  unsigned long pos;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos++) {
+    while(!bigringbuf_put(&big, source[pos % SOURCE_SIZE])) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+consume_bytes(void)
+{
+  unsigned long pos;
+  uint8_t c;
+  int v;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos++) {
+    while((v = bigringbuf_get(&big)) < 0) {
+      sched_yield();
+    }
+    c = v;
+    consume(&c, 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+produce_spans(void *arg)
+{
+  unsigned long pos;
+  uint8_t *ptr;
+  int n;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos += n) {
+    while((n = bigringbuf_put_span(&big, &ptr)) == 0) {
+      sched_yield();
+    }
+    n = produce(ptr, pos, n < BENCHMARK_CHUNK_SIZE ? n : BENCHMARK_CHUNK_SIZE);
+    bigringbuf_put_commit(&big, n);
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+consume_spans(void)
+{
+  unsigned long pos;
+  uint8_t *ptr;
+  int n;
+
+  for(pos = 0; pos < BENCHMARK_BYTES; pos += n) {
+    while((n = bigringbuf_get_span(&big, &ptr)) == 0) {
+      sched_yield();
+    }
+    consume(ptr, n);
+    bigringbuf_get_commit(&big, n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+move_threaded(void *(*producer)(void *), void (*consumer)(void))
+{
+  pthread_t thread;
+
+  if(pthread_create(&thread, NULL, producer, NULL) != 0) {
+    return -1;
+  }
+  consumer();
+  pthread_join(thread, NULL);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(ringbuf_benchmark, "Ring buffer benchmark");
+AUTOSTART_PROCESSES(&ringbuf_benchmark);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ringbuf_benchmark, ev, data)
+{
+  static const char *names[VARIANTS] = {
+    "ringbuf, bytes",
+    "bigringbuf, bytes",
+    "bigringbuf, blocks",
+    "bigringbuf, spans",
+    "bigringbuf, bytes, 2 threads",
+    "bigringbuf, spans, 2 threads",
+  };
+  uint8_t block[BENCHMARK_CHUNK_SIZE];
+  unsigned long pos, expected1, expected2;
+  clock_time_t start, times[VARIANTS];
+  int errors, i, n;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < SOURCE_SIZE; i++) {
+    source[i] = random_rand();
+  }
+
+  /* The checksums of the stream when it is moved correctly. */
+  sum1 = sum2 = 0;
+  for(pos = 0; pos < BENCHMARK_BYTES; pos += n) {
+    n = produce(block, pos, sizeof(block));
+    consume(block, n);
+  }
+  expected1 = sum1;
+  expected2 = sum2;
+
+  printf("%lu bytes, %d-byte big ring buffer, %d-bit indices, "
+         "%d-byte blocks\n", BENCHMARK_BYTES, BENCHMARK_BUFSIZE,
+         (int)sizeof(bigringbuf_index_t) * 8, BENCHMARK_CHUNK_SIZE);
+
+  errors = 0;
+  for(i = 0; i < VARIANTS; i++) {
+    ringbuf_init(&small, small_data, sizeof(small_data));
+    bigringbuf_init(&big, big_data, sizeof(big_data));
+    sum1 = sum2 = 0;
+    start = clock_time();
+    switch(i) {
+    case 0:
+      move_small_bytes();
+      break;
+    case 1:
+      move_big_bytes();
+      break;
+    case 2:
+      move_big_blocks();
+      break;
+    case 3:
+      move_big_spans();
+      break;
+    case 4:
+      move_threaded(produce_bytes, consume_bytes);
+      break;
+    case 5:
+      move_threaded(produce_spans, consume_spans);
+      break;
+    }
+    times[i] = clock_time() - start;
+    if(sum1 != expected1 || sum2 != expected2) {
+      printf("MISMATCH: %s did not reproduce the stream\n", names[i]);
+      errors++;
+    }
+  }
+
+  printf("variant                        time(ms)  MB/s\n");
+  for(i = 0; i < VARIANTS; i++) {
+    printf("%-30s %8lu  %lu\n", names[i],
+           (unsigned long)(times[i] * 1000 / CLOCK_SECOND),
+           times[i] ? BENCHMARK_BYTES / 1024 * CLOCK_SECOND / 1024 / times[i] : 0);
+  }
+
+  exit(errors != 0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2013, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         SLIP benchmark. Passes a stream of SLIP-encoded packets
+ *         through the SLIP driver byte by byte, as from a UART
+ *         interrupt, and in blocks, as from a DMA buffer or a pty,
+ *         and through the standalone decoder; then sends the packets
+ *         with slip_write() and slip_encode().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "net/uip.h"
+
+#include "dev/slip.h"
+
+/* The number of times to pass the stream through each variant. */
+#ifndef BENCHMARK_ROUNDS
+#define BENCHMARK_ROUNDS 20000UL
+#endif
+
+/* The number of packets in the stream. */
+#ifndef BENCHMARK_PACKETS
+#define BENCHMARK_PACKETS 64
+#endif
+
+/* The length of each packet before encoding. */
+#ifndef BENCHMARK_PACKET_LEN
+#define BENCHMARK_PACKET_LEN 100
+#endif
+
+/* The block size for block input, e.g., a DMA buffer. */
+#ifndef BENCHMARK_CHUNK_SIZE
+#define BENCHMARK_CHUNK_SIZE 64
+#endif
+
+#define VARIANTS 5
+
+static uint8_t packets[BENCHMARK_PACKETS][BENCHMARK_PACKET_LEN];
+static uint8_t stream[BENCHMARK_PACKETS *
+                      SLIP_ENCODED_MAXLEN(BENCHMARK_PACKET_LEN)];
+static int stream_len;
+static uint8_t decoded[BENCHMARK_PACKET_LEN];
+static uint8_t encoded[SLIP_ENCODED_MAXLEN(BENCHMARK_PACKET_LEN)];
+
+static unsigned long count, checksum;
+static unsigned long written;
+static uint8_t last;
+
+/*---------------------------------------------------------------------------*/
+static void
+count_packet(const uint8_t *data, int len)
+{
+  count++;
+  checksum += len + data[1] + data[len - 1];
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_benchmark_input(void)
+{
+  count_packet(&uip_buf[UIP_LLH_LEN], uip_len);
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_arch_init(unsigned long ubr)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_arch_writeb(unsigned char c)
+{
+  written++;
+  last = c;
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_arch_write(const uint8_t *buf, int len)
+{
+  written += len;
+  last = buf[len - 1];
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_stream(void)
+{
+  unsigned long r;
+  int i, j;
+
+  /* Random bytes, so about one in 128 needs to be escaped. */
+  r = 1;
+  stream_len = 0;
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    packets[i][0] = 0x60;
+    for(j = 1; j < BENCHMARK_PACKET_LEN; j++) {
+      r = r * 1103515245 + 12345;
+      packets[i][j] = r >> 16;
+    }
+    stream_len += slip_encode(packets[i], BENCHMARK_PACKET_LEN,
+                              &stream[stream_len], sizeof(stream) - stream_len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Let slip_process move the received packet to uIP. */
+static void
+deliver(void)
+{
+  process_post_synch(&slip_process, PROCESS_EVENT_POLL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+input_bytes(void)
+{
+  int i;
+
+  for(i = 0; i < stream_len; i++) {
+    if(slip_input_byte(stream[i])) {
+      deliver();
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+input_blocks(void)
+{
+  int i, len;
+
+  for(i = 0; i < stream_len; i += len) {
+    len = stream_len - i < BENCHMARK_CHUNK_SIZE ?
+      stream_len - i : BENCHMARK_CHUNK_SIZE;
+    if(slip_input(&stream[i], len)) {
+      deliver();
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+decode_blocks(struct slip_decoder *d)
+{
+  const uint8_t *data;
+  int i, len, n;
+
+  for(i = 0; i < stream_len; i += BENCHMARK_CHUNK_SIZE) {
+    data = &stream[i];
+    len = stream_len - i < BENCHMARK_CHUNK_SIZE ?
+      stream_len - i : BENCHMARK_CHUNK_SIZE;
+    while((n = slip_decode(d, &data, &len)) > 0) {
+      count_packet(d->buf, n);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_packets(void)
+{
+  int i;
+
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    slip_write(packets[i], BENCHMARK_PACKET_LEN);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+encode_packets(void)
+{
+  int i;
+
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    written += slip_encode(packets[i], BENCHMARK_PACKET_LEN,
+                           encoded, sizeof(encoded));
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(slip_benchmark, "SLIP benchmark");
+AUTOSTART_PROCESSES(&slip_benchmark);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(slip_benchmark, ev, data)
+{
+  static const char *names[VARIANTS] = {
+    "slip_input_byte",
+    "slip_input",
+    "slip_decode",
+#if SLIP_CONF_ARCH_WRITE
+    "slip_write, blocks",
+#else
+    "slip_write, bytes",
+#endif
+    "slip_encode",
+  };
+  struct slip_decoder decoder;
+  unsigned long n, expected, results[VARIANTS];
+  clock_time_t start, times[VARIANTS];
+  int errors, i;
+
+  PROCESS_BEGIN();
+
+  make_stream();
+  printf("stream: %d packets of %d bytes, %d bytes encoded, %d-byte blocks\n",
+         BENCHMARK_PACKETS, BENCHMARK_PACKET_LEN, stream_len,
+         BENCHMARK_CHUNK_SIZE);
+
+  process_start(&slip_process, NULL);
+  slip_decoder_init(&decoder, decoded, sizeof(decoded));
+
+  /* The checksum of the stream, as computed by count_packet(). */
+  expected = 0;
+  for(i = 0; i < BENCHMARK_PACKETS; i++) {
+    expected += BENCHMARK_PACKET_LEN + packets[i][1] +
+      packets[i][BENCHMARK_PACKET_LEN - 1];
+  }
+
+  errors = 0;
+  for(i = 0; i < VARIANTS; i++) {
+    count = checksum = written = 0;
+    start = clock_time();
+    for(n = 0; n < BENCHMARK_ROUNDS; n++) {
+      switch(i) {
+      case 0:
+        input_bytes();
+        break;
+      case 1:
+        input_blocks();
+        break;
+      case 2:
+        decode_blocks(&decoder);
+        break;
+      case 3:
+        write_packets();
+        break;
+      case 4:
+        encode_packets();
+        break;
+      }
+    }
+    times[i] = clock_time() - start;
+    if(i < 3) {
+      results[i] = count;
+      errors += checksum != expected * BENCHMARK_ROUNDS;
+    } else {
+      results[i] = written / stream_len * BENCHMARK_PACKETS;
+      errors += written != (unsigned long)stream_len * BENCHMARK_ROUNDS;
+    }
+  }
+
+  printf("variant                time(ms)  packets/s\n");
+  for(i = 0; i < VARIANTS; i++) {
+    printf("%-22s %8lu  %lu\n", names[i],
+           (unsigned long)(times[i] * 1000 / CLOCK_SECOND),
+           times[i] ? results[i] * CLOCK_SECOND / times[i] : 0);
+  }
+
+  if(errors) {
+    printf("MISMATCH: %d variants did not reproduce the stream\n", errors);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
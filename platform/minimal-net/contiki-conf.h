@@ -142,8 +142,16 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_TCP_SPLIT            0
 #define UIP_CONF_IP_FORWARD           0
 #define UIP_CONF_LOGGING              0
+#ifndef UIP_CONF_RX_QUEUE
+#define UIP_CONF_RX_QUEUE             8
+#endif /* UIP_CONF_RX_QUEUE */
 #define UIP_CONF_UDP_CHECKSUMS        1
 
+/* Cache the web server's script output, with room for the whole
+   tcp.shtml table. */
+#define WEBSERVER_CONF_CGI_CACHE      2
+#define WEBSERVER_CONF_CGI_CACHE_SIZE 8192
+
 /* Not used but avoids compile errors while sicslowpan.c is being developed */
 #define SICSLOWPAN_CONF_COMPRESSION       SICSLOWPAN_COMPRESSION_HC06
 
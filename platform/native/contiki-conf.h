@@ -63,8 +63,12 @@ typedef  int32_t s32_t;
 typedef unsigned short uip_stats_t;
 
 #define UIP_CONF_UDP             1
+#ifndef UIP_CONF_MAX_CONNECTIONS
 #define UIP_CONF_MAX_CONNECTIONS 40
+#endif /* UIP_CONF_MAX_CONNECTIONS */
+#ifndef UIP_CONF_MAX_LISTENPORTS
 #define UIP_CONF_MAX_LISTENPORTS 40
+#endif /* UIP_CONF_MAX_LISTENPORTS */
 #define UIP_CONF_BUFFER_SIZE     420
 #define UIP_CONF_BYTE_ORDER      UIP_LITTLE_ENDIAN
 #define UIP_CONF_TCP       1
@@ -72,6 +76,11 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_LOGGING         0
 #define UIP_CONF_UDP_CHECKSUMS   1
 
+/* Cache the web server's script output, with room for the whole
+   tcp.shtml table. */
+#define WEBSERVER_CONF_CGI_CACHE      2
+#define WEBSERVER_CONF_CGI_CACHE_SIZE 8192
+
 #ifndef NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE
 #define NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE 8
 #endif /* NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE */
@@ -125,6 +134,9 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_ND6_MAX_NEIGHBORS    4
 #define UIP_CONF_ND6_MAX_DEFROUTERS   2
 #define UIP_CONF_ICMP6           1
+#ifndef UIP_CONF_CONN_HASH_SIZE
+#define UIP_CONF_CONN_HASH_SIZE  32
+#endif /* UIP_CONF_CONN_HASH_SIZE */
 
 /* configure number of neighbors and routes */
 #ifndef UIP_CONF_DS6_NBR_NBU
@@ -152,7 +164,9 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_DHCP_LIGHT
 #define UIP_CONF_RECEIVE_WINDOW  48
 #define UIP_CONF_TCP_MSS         48
+#ifndef UIP_CONF_UDP_CONNS
 #define UIP_CONF_UDP_CONNS       12
+#endif /* UIP_CONF_UDP_CONNS */
 #define UIP_CONF_FWCACHE_SIZE    30
 #define UIP_CONF_BROADCAST       1
 #define UIP_ARCH_IPCHKSUM        1
@@ -34,13 +34,18 @@
 
  /* Below define allows importing saved output into Wireshark as "Raw IP" packet type */
 #define WIRESHARK_IMPORT_FORMAT 1
- 
+
+/* For the pseudo-terminals of the benchmark. */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
 #include <time.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 
 #include <unistd.h>
 #include <errno.h>
@@ -56,26 +61,75 @@
 
 #include <err.h>
 
+#ifdef linux
+#include <sys/epoll.h>
+#endif
+
 int verbose = 1;
-const char *ipaddr;
-const char *netmask;
-int slipfd = 0;
-uint16_t basedelay=0,delaymsec=0;
-uint32_t startsec,startmsec,delaystartsec,delaystartmsec;
+uint16_t basedelay=0;
 int timestamp = 0, flowcontrol=0;
 
+/* The number of serial radios, each on a tun device of its own, that
+   one tunslip6 can serve. */
+#define MAX_TUNNELS 8
+
+/* The largest packet, and the largest SLIP frame that it makes when
+   every byte is escaped. */
+#define PACKET_SIZE 2000
+#define FRAME_SIZE  (2 * PACKET_SIZE + 2)
+
+/* Packets from tun are encoded into the output buffer while there is
+   room for another frame, so that a write sends several of them. */
+#define SLIP_BUFSIZE (8 * FRAME_SIZE)
+
+/* Serial input is read in blocks of this size. */
+#define READ_SIZE 4096
+
+struct tunnel {
+  int slipfd;
+  int tunfd;
+  char tundev[32];
+  const char *siodev;
+  const char *ipaddr;
+
+  /* The frame being received, and whether the last byte read was an
+     escape. */
+  unsigned char inbuf[PACKET_SIZE];
+  int inbufptr;
+  int esc;
+
+  /* The frames that have not been written to the serial device. */
+  unsigned char slip_buf[SLIP_BUFSIZE];
+  int slip_end, slip_begin;
+
+  /* Optional delay between outgoing packets */
+  uint16_t delaymsec;
+  uint32_t delaystartsec, delaystartmsec;
+
+  /* The events that the main loop waits for, those that the kernel
+     has been asked for, and those that it got. */
+  int watching;
+  int polling;
+  int events;
+};
+
+#define EV_SLIP_IN  1
+#define EV_SLIP_OUT 2
+#define EV_TUN_IN   4
+
+struct tunnel tunnels[MAX_TUNNELS];
+int ntunnels;
+
 int ssystem(const char *fmt, ...)
      __attribute__((__format__ (__printf__, 1, 2)));
-void write_to_serial(int outfd, void *inbuf, int len);
+void write_to_serial(struct tunnel *t, void *inbuf, int len);
 
-void slip_send(int fd, unsigned char c);
-void slip_send_char(int fd, unsigned char c);
+void slip_send(struct tunnel *t, unsigned char c);
+void slip_send_char(struct tunnel *t, unsigned char c);
 
 //#define PROGRESS(s) fprintf(stderr, s)
 #define PROGRESS(s) do { } while (0)
 
-char tundev[32] = { "" };
-
 int
 ssystem(const char *fmt, ...) __attribute__((__format__ (__printf__, 1, 2)));
 
@@ -97,6 +151,13 @@ ssystem(const char *fmt, ...)
 #define SLIP_ESC_END 0334
 #define SLIP_ESC_ESC 0335
 
+/* The bytes that SLIP escapes. The encoder and decoder copy the runs
+   of bytes between them in one go. */
+static const unsigned char slip_special[256] = {
+  [SLIP_END] = 1,
+  [SLIP_ESC] = 1,
+};
+
 
 /* get sockaddr, IPv4 or IPv6: */
 void *
@@ -116,7 +177,7 @@ stamptime(void)
   time_t t;
   struct tm *tmp;
   char timec[20];
- 
+
   gettimeofday(&tv, NULL) ;
   msecs=tv.tv_usec/1000;
   secs=tv.tv_sec;
@@ -151,236 +212,284 @@ is_sensible_string(const unsigned char *s, int len)
 }
 
 /*
- * Read from serial, when we have a packet write it to tun. No output
- * buffering, input buffered by stdio.
+ * Handle a frame received from serial: a request from the radio, a
+ * debug message, or a packet to write to tun.
  */
 void
-serial_to_tun(FILE *inslip, int outfd)
+serial_frame(struct tunnel *t)
 {
-  static union {
-    unsigned char inbuf[2000];
-  } uip;
-  static int inbufptr = 0;
-  int ret,i;
-  unsigned char c;
-
-#ifdef linux
-  ret = fread(&c, 1, 1, inslip);
-  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
-  goto after_fread;
-#endif
+  int i;
 
- read_more:
-  if(inbufptr >= sizeof(uip.inbuf)) {
-     if(timestamp) stamptime();
-     fprintf(stderr, "*** dropping large %d byte packet\n",inbufptr);
-	 inbufptr = 0;
-  }
-  ret = fread(&c, 1, 1, inslip);
-#ifdef linux
- after_fread:
-#endif
-  if(ret == -1) {
-    err(1, "serial_to_tun: read");
-  }
-  if(ret == 0) {
-    clearerr(inslip);
-    return;
-  }
-  /*  fprintf(stderr, ".");*/
-  switch(c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      if(uip.inbuf[0] == '!') {
-	if(uip.inbuf[1] == 'M') {
-	  /* Read gateway MAC address and autoconfigure tap0 interface */
-	  char macs[24];
-	  int i, pos;
-	  for(i = 0, pos = 0; i < 16; i++) {
-	    macs[pos++] = uip.inbuf[2 + i];
-	    if((i & 1) == 1 && i < 14) {
-	      macs[pos++] = ':';
-	    }
-	  }
-          if(timestamp) stamptime();
-	  macs[pos] = '\0';
-//	  printf("*** Gateway's MAC address: %s\n", macs);
-	  fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s down", tundev);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s up", tundev);
+  if(t->inbuf[0] == '!') {
+    if(t->inbuf[1] == 'M') {
+      /* Read gateway MAC address and autoconfigure tap0 interface */
+      char macs[24];
+      int i, pos;
+      for(i = 0, pos = 0; i < 16; i++) {
+	macs[pos++] = t->inbuf[2 + i];
+	if((i & 1) == 1 && i < 14) {
+	  macs[pos++] = ':';
 	}
-      } else if(uip.inbuf[0] == '?') {
-	if(uip.inbuf[1] == 'P') {
-          /* Prefix info requested */
-          struct in6_addr addr;
-	  int i;
-	  char *s = strchr(ipaddr, '/');
-	  if(s != NULL) {
-	    *s = '\0';
-	  }
-          inet_pton(AF_INET6, ipaddr, &addr);
-          if(timestamp) stamptime();
-          fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+      }
+      if(timestamp) stamptime();
+      macs[pos] = '\0';
+//	  printf("*** Gateway's MAC address: %s\n", macs);
+      fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s down", t->tundev);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s hw ether %s", t->tundev, &macs[6]);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s up", t->tundev);
+    }
+  } else if(t->inbuf[0] == '?') {
+    if(t->inbuf[1] == 'P') {
+      /* Prefix info requested */
+      struct in6_addr addr;
+      int i;
+      char *s = strchr(t->ipaddr, '/');
+      if(s != NULL) {
+	*s = '\0';
+      }
+      inet_pton(AF_INET6, t->ipaddr, &addr);
+      if(timestamp) stamptime();
+      fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
  //         printf("*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
-		 ipaddr, 
-		 addr.s6_addr[0], addr.s6_addr[1],
-		 addr.s6_addr[2], addr.s6_addr[3],
-		 addr.s6_addr[4], addr.s6_addr[5],
-		 addr.s6_addr[6], addr.s6_addr[7]);
-	  slip_send(slipfd, '!');
-	  slip_send(slipfd, 'P');
-	  for(i = 0; i < 8; i++) {
-	    /* need to call the slip_send_char for stuffing */
-	    slip_send_char(slipfd, addr.s6_addr[i]);
-	  }
-	  slip_send(slipfd, SLIP_END);
-        }
+	      t->ipaddr,
+	      addr.s6_addr[0], addr.s6_addr[1],
+	      addr.s6_addr[2], addr.s6_addr[3],
+	      addr.s6_addr[4], addr.s6_addr[5],
+	      addr.s6_addr[6], addr.s6_addr[7]);
+      slip_send(t, '!');
+      slip_send(t, 'P');
+      for(i = 0; i < 8; i++) {
+	/* need to call the slip_send_char for stuffing */
+	slip_send_char(t, addr.s6_addr[i]);
+      }
+      slip_send(t, SLIP_END);
+    }
 #define DEBUG_LINE_MARKER '\r'
-      } else if(uip.inbuf[0] == DEBUG_LINE_MARKER) {    
-	fwrite(uip.inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(uip.inbuf, inbufptr)) {
-        if(verbose==1) {   /* strings already echoed below for verbose>1 */
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(verbose>2) {
-          if (timestamp) stamptime();
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if (verbose>4) {
+  } else if(t->inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(t->inbuf + 1, t->inbufptr - 1, 1, stdout);
+  } else if(is_sensible_string(t->inbuf, t->inbufptr)) {
+    if(verbose==1) {   /* strings already echoed below for verbose>1 */
+      if (timestamp) stamptime();
+      fwrite(t->inbuf, t->inbufptr, 1, stdout);
+    }
+  } else {
+    if(verbose>2) {
+      if (timestamp) stamptime();
+      printf("Packet from SLIP of length %d - write TUN\n", t->inbufptr);
+      if (verbose>4) {
 #if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	        for(i = 0; i < inbufptr; i++) printf(" %02x",uip.inbuf[i]);
+	printf("0000");
+	for(i = 0; i < t->inbufptr; i++) printf(" %02x",t->inbuf[i]);
 #else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", uip.inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
-        }
-	if(write(outfd, uip.inbuf, inbufptr) != inbufptr) {
-	  err(1, "serial_to_tun: write");
+	printf("         ");
+	for(i = 0; i < t->inbufptr; i++) {
+	  printf("%02x", t->inbuf[i]);
+	  if((i & 3) == 3) printf(" ");
+	  if((i & 15) == 15) printf("\n         ");
 	}
+#endif
+	printf("\n");
       }
-      inbufptr = 0;
     }
-    break;
+    if(write(t->tunfd, t->inbuf, t->inbufptr) != t->inbufptr) {
+      err(1, "serial_to_tun: write");
+    }
+  }
+}
 
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, inslip) != 1) {
-      clearerr(inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, inslip);
-      return;
+/*
+ * Add decoded bytes to the frame being received.
+ */
+void
+serial_input(struct tunnel *t, const unsigned char *p, int len)
+{
+  int n;
+
+  while(len > 0) {
+    if(t->inbufptr >= sizeof(t->inbuf)) {
+      if(timestamp) stamptime();
+      fprintf(stderr, "*** dropping large %d byte packet\n", t->inbufptr);
+      t->inbufptr = 0;
     }
+    n = sizeof(t->inbuf) - t->inbufptr;
+    if(n > len) {
+      n = len;
+    }
+    memcpy(t->inbuf + t->inbufptr, p, n);
+    t->inbufptr += n;
+    p += n;
+    len -= n;
+  }
+}
 
-    switch(c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
+/*
+ * Echo the input as it is received, for the higher verbosity levels.
+ */
+void
+serial_echo(struct tunnel *t, unsigned char c)
+{
+  /* Echo lines as they are received for verbose=2,3,5+ */
+  /* Echo all printable characters for verbose==4 */
+  if((verbose==2) || (verbose==3) || (verbose>4)) {
+    if(c=='\n') {
+      if(is_sensible_string(t->inbuf, t->inbufptr)) {
+	if (timestamp) stamptime();
+	fwrite(t->inbuf, t->inbufptr, 1, stdout);
+	t->inbufptr=0;
+      }
     }
-    /* FALLTHROUGH */
-  default:
-    uip.inbuf[inbufptr++] = c;
+  } else if(verbose==4) {
+    if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
+      fwrite(&c, 1, 1, stdout);
+      if(c=='\n') if(timestamp) stamptime();
+    }
+  }
+}
 
-    /* Echo lines as they are received for verbose=2,3,5+ */
-    /* Echo all printable characters for verbose==4 */
-    if((verbose==2) || (verbose==3) || (verbose>4)) {
-      if(c=='\n') {
-        if(is_sensible_string(uip.inbuf, inbufptr)) {
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-          inbufptr=0;
-        }
+/*
+ * Read from serial, when we have a packet write it to tun. The input
+ * is read a block at a time, and the runs of bytes between the SLIP
+ * END and ESC characters are copied as they are.
+ */
+void
+serial_to_tun(struct tunnel *t)
+{
+  static unsigned char buf[READ_SIZE];
+  unsigned char *p, *q, *end;
+  unsigned char c;
+  int ret;
+
+  ret = read(t->slipfd, buf, sizeof(buf));
+  if(ret == -1 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
+
+  p = buf;
+  end = buf + ret;
+  while(p < end) {
+    if(t->esc) {
+      t->esc = 0;
+      c = *p++;
+      switch(c) {
+      case SLIP_ESC_END:
+	c = SLIP_END;
+	break;
+      case SLIP_ESC_ESC:
+	c = SLIP_ESC;
+	break;
       }
-    } else if(verbose==4) {
-      if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
-	fwrite(&c, 1, 1, stdout);
-        if(c=='\n') if(timestamp) stamptime();
+      serial_input(t, &c, 1);
+      if(verbose > 1) {
+	serial_echo(t, c);
       }
+      continue;
     }
-    
-    break;
-  }
 
-  goto read_more;
-}
+    /* The echo looks at the bytes one at a time. */
+    q = p;
+    while(q < end && !slip_special[*q]) {
+      ++q;
+      if(verbose > 1) {
+	break;
+      }
+    }
+    if(q > p) {
+      serial_input(t, p, q - p);
+      if(verbose > 1) {
+	serial_echo(t, *p);
+      }
+      p = q;
+      continue;
+    }
 
-unsigned char slip_buf[2000];
-int slip_end, slip_begin;
+    if(*p++ == SLIP_END) {
+      if(t->inbufptr > 0) {
+	serial_frame(t);
+	t->inbufptr = 0;
+      }
+    } else {
+      t->esc = 1;
+    }
+  }
+}
 
 void
-slip_send_char(int fd, unsigned char c)
+slip_send_char(struct tunnel *t, unsigned char c)
 {
   switch(c) {
   case SLIP_END:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_END);
+    slip_send(t, SLIP_ESC);
+    slip_send(t, SLIP_ESC_END);
     break;
   case SLIP_ESC:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_ESC);
+    slip_send(t, SLIP_ESC);
+    slip_send(t, SLIP_ESC_ESC);
     break;
   default:
-    slip_send(fd, c);
+    slip_send(t, c);
     break;
   }
 }
 
 void
-slip_send(int fd, unsigned char c)
+slip_send(struct tunnel *t, unsigned char c)
 {
-  if(slip_end >= sizeof(slip_buf)) {
+  if(t->slip_end >= sizeof(t->slip_buf)) {
     err(1, "slip_send overflow");
   }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  t->slip_buf[t->slip_end] = c;
+  t->slip_end++;
 }
 
 int
-slip_empty()
+slip_empty(struct tunnel *t)
 {
-  return slip_end == 0;
+  return t->slip_end == 0;
+}
+
+/*
+ * Whether another packet from tun fits in the output buffer. A little
+ * room is left for the replies to the radio's requests.
+ */
+int
+slip_room(struct tunnel *t)
+{
+  return sizeof(t->slip_buf) - t->slip_end + t->slip_begin >= FRAME_SIZE + 32;
 }
 
 void
-slip_flushbuf(int fd)
+slip_flushbuf(struct tunnel *t)
 {
   int n;
-  
-  if(slip_empty()) {
+
+  if(slip_empty(t)) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, (slip_end - slip_begin));
+  n = write(t->slipfd, t->slip_buf + t->slip_begin, (t->slip_end - t->slip_begin));
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueueis full! */
   } else {
-    slip_begin += n;
-    if(slip_begin == slip_end) {
-      slip_begin = slip_end = 0;
+    t->slip_begin += n;
+    if(t->slip_begin == t->slip_end) {
+      t->slip_begin = t->slip_end = 0;
     }
   }
 }
 
 void
-write_to_serial(int outfd, void *inbuf, int len)
+write_to_serial(struct tunnel *t, void *inbuf, int len)
 {
   u_int8_t *p = inbuf;
+  u_int8_t *q, *end, *out;
   int i;
 
   if(verbose>2) {
@@ -402,45 +511,64 @@ write_to_serial(int outfd, void *inbuf, int len)
     }
   }
 
+  /* Make room at the end of the buffer. */
+  if(t->slip_begin > 0) {
+    memmove(t->slip_buf, t->slip_buf + t->slip_begin,
+	    t->slip_end - t->slip_begin);
+    t->slip_end -= t->slip_begin;
+    t->slip_begin = 0;
+  }
+  if(t->slip_end + 2 * len + 1 > sizeof(t->slip_buf)) {
+    err(1, "slip_send overflow");
+  }
+
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
-
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
+  /* slip_send(t, SLIP_END); */
+
+  out = t->slip_buf + t->slip_end;
+  end = p + len;
+  while(p < end) {
+    for(q = p; q < end && !slip_special[*q]; q++);
+    memcpy(out, p, q - p);
+    out += q - p;
+    p = q;
+    if(p < end) {
+      *out++ = SLIP_ESC;
+      *out++ = *p++ == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
     }
   }
-  slip_send(outfd, SLIP_END);
+  *out++ = SLIP_END;
+  t->slip_end = out - t->slip_buf;
   PROGRESS("t");
 }
 
 
 /*
- * Read from tun, write to slip.
+ * Read from tun, write to slip. Returns the size of the packet, or
+ * zero if there is none.
  */
 int
-tun_to_serial(int infd, int outfd)
+tun_to_serial(struct tunnel *t)
 {
   struct {
-    unsigned char inbuf[2000];
+    unsigned char inbuf[PACKET_SIZE];
   } uip;
   int size;
 
-  if((size = read(infd, uip.inbuf, 2000)) == -1) err(1, "tun_to_serial: read");
+  if((size = read(t->tunfd, uip.inbuf, PACKET_SIZE)) == -1) {
+    if(errno == EAGAIN || errno == EINTR) {
+      return 0;
+    }
+    err(1, "tun_to_serial: read");
+  }
+  if(size == 0) {
+    /* Only the benchmark's stand-in for tun ends. */
+    exit(0);
+  }
 
-  write_to_serial(outfd, uip.inbuf, size);
+  write_to_serial(t, uip.inbuf, size);
   return size;
 }
 
@@ -544,11 +672,11 @@ tun_alloc(char *dev, int tap)
 #endif
 
 void
-cleanup(void)
+cleanup_tunnel(struct tunnel *t)
 {
 #ifndef __APPLE__
   if (timestamp) stamptime();
-  ssystem("ifconfig %s down", tundev);
+  ssystem("ifconfig %s down", t->tundev);
 #ifndef linux
   ssystem("sysctl -w net.ipv6.conf.all.forwarding=1");
 #endif
@@ -557,15 +685,15 @@ cleanup(void)
   ssystem("netstat -nr"
 	  " | awk '{ if ($2 == \"%s\") print \"route delete -net \"$1; }'"
 	  " | sh",
-	  tundev);
+	  t->tundev);
 #else
   {
-    char *  itfaddr = strdup(ipaddr);
+    char *  itfaddr = strdup(t->ipaddr);
     char *  prefix = index(itfaddr, '/');
     if (timestamp) stamptime();
-    ssystem("ifconfig %s inet6 %s remove", tundev, ipaddr);
+    ssystem("ifconfig %s inet6 %s remove", t->tundev, t->ipaddr);
     if (timestamp) stamptime();
-    ssystem("ifconfig %s down", tundev);
+    ssystem("ifconfig %s down", t->tundev);
     if ( prefix != NULL ) *prefix = '\0';
     ssystem("route delete -inet6 %s", itfaddr);
     free(itfaddr);
@@ -573,6 +701,16 @@ cleanup(void)
 #endif
 }
 
+void
+cleanup(void)
+{
+  int i;
+
+  for(i = 0; i < ntunnels; i++) {
+    cleanup_tunnel(&tunnels[i]);
+  }
+}
+
 void
 sigcleanup(int signo)
 {
@@ -636,7 +774,7 @@ ifconf(const char *tundev, const char *ipaddr)
       } else {
 	cc=0;
 	digit = c-'0';
-	if (digit > 9) 
+	if (digit > 9)
 	  digit = 10 + (c & 0xdf) - 'A';
 	a[ai] = (a[ai] << 4) + digit;
       }
@@ -685,26 +823,320 @@ ifconf(const char *tundev, const char *ipaddr)
   ssystem("ifconfig %s\n", tundev);
 }
 
+/*
+ * Wait for the events that the tunnels are watching. Sets t->events,
+ * and returns the number of tunnels that got any. A tunnel with an
+ * outgoing delay wakes the loop up when the delay is over.
+ */
+#ifdef linux
+static int epfd = -1;
+
+static void
+watch_fd(int fd, int events, uint32_t data)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.u32 = data;
+  if(epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+    err(1, "epoll_ctl");
+  }
+}
+
+int
+wait_events(int timeout)
+{
+  struct epoll_event evs[2 * MAX_TUNNELS];
+  struct tunnel *t;
+  uint32_t data;
+  int i, n;
+
+  if(epfd == -1) {
+    if((epfd = epoll_create(2 * MAX_TUNNELS)) == -1) {
+      err(1, "epoll_create");
+    }
+    /* The data is the index of the tunnel, and 1 for its tun device. */
+    for(t = tunnels; t < &tunnels[ntunnels]; t++) {
+      memset(&evs[0], 0, sizeof(evs[0]));
+      evs[0].data.u32 = (t - tunnels) << 1;
+      if(epoll_ctl(epfd, EPOLL_CTL_ADD, t->slipfd, &evs[0]) == -1) {
+	err(1, "epoll_ctl");
+      }
+      evs[0].data.u32 |= 1;
+      if(epoll_ctl(epfd, EPOLL_CTL_ADD, t->tunfd, &evs[0]) == -1) {
+	err(1, "epoll_ctl");
+      }
+      t->polling = 0;
+    }
+  }
+
+  /* Only the changes are passed to the kernel. */
+  for(t = tunnels; t < &tunnels[ntunnels]; t++) {
+    data = (t - tunnels) << 1;
+    if((t->watching ^ t->polling) & (EV_SLIP_IN | EV_SLIP_OUT)) {
+      watch_fd(t->slipfd,
+	       ((t->watching & EV_SLIP_IN) ? EPOLLIN : 0) |
+	       ((t->watching & EV_SLIP_OUT) ? EPOLLOUT : 0), data);
+    }
+    if((t->watching ^ t->polling) & EV_TUN_IN) {
+      watch_fd(t->tunfd, (t->watching & EV_TUN_IN) ? EPOLLIN : 0, data | 1);
+    }
+    t->polling = t->watching;
+    t->events = 0;
+  }
+
+  n = epoll_wait(epfd, evs, 2 * MAX_TUNNELS, timeout);
+  if(n == -1 && errno != EINTR) {
+    err(1, "epoll_wait");
+  }
+  for(i = 0; i < n; i++) {
+    t = &tunnels[evs[i].data.u32 >> 1];
+    if(evs[i].data.u32 & 1) {
+      t->events |= EV_TUN_IN;
+    } else {
+      /* Errors and hangups are reported by the read. */
+      if(evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+	t->events |= EV_SLIP_IN;
+      }
+      if(evs[i].events & EPOLLOUT) {
+	t->events |= EV_SLIP_OUT;
+      }
+    }
+  }
+  return n > 0 ? n : 0;
+}
+#else /* linux */
+int
+wait_events(int timeout)
+{
+  fd_set rset, wset;
+  struct timeval tv;
+  struct tunnel *t;
+  int maxfd, ret;
+
+  maxfd = 0;
+  FD_ZERO(&rset);
+  FD_ZERO(&wset);
+  for(t = tunnels; t < &tunnels[ntunnels]; t++) {
+    if(t->watching & EV_SLIP_IN) {
+      FD_SET(t->slipfd, &rset);
+    }
+    if(t->watching & EV_SLIP_OUT) {
+      FD_SET(t->slipfd, &wset);
+    }
+    if(t->slipfd > maxfd) maxfd = t->slipfd;
+    if(t->watching & EV_TUN_IN) {
+      FD_SET(t->tunfd, &rset);
+      if(t->tunfd > maxfd) maxfd = t->tunfd;
+    }
+    t->events = 0;
+  }
+
+  tv.tv_sec = timeout / 1000;
+  tv.tv_usec = (timeout % 1000) * 1000;
+  ret = select(maxfd + 1, &rset, &wset, NULL, timeout < 0 ? NULL : &tv);
+  if(ret == -1 && errno != EINTR) {
+    err(1, "select");
+  } else if(ret > 0) {
+    for(t = tunnels; t < &tunnels[ntunnels]; t++) {
+      if(FD_ISSET(t->slipfd, &rset)) t->events |= EV_SLIP_IN;
+      if(FD_ISSET(t->slipfd, &wset)) t->events |= EV_SLIP_OUT;
+      if((t->watching & EV_TUN_IN) && FD_ISSET(t->tunfd, &rset)) {
+	t->events |= EV_TUN_IN;
+      }
+    }
+  }
+  return ret > 0 ? ret : 0;
+}
+#endif /* linux */
+
+/*
+ * The benchmark (-b) replaces each serial radio with a pseudo-terminal
+ * whose other end a child process echoes back, like a radio looping
+ * the frames back, and each tun device with a socket pair. A driver
+ * process sends packets into the tunnels, checks those that come back,
+ * and reports the throughput.
+ */
+#define BENCHMARK_PACKETS 20000
+#define BENCHMARK_WINDOW  8 /* Packets in flight on each tunnel. */
+
+/* Packets of 64 to 1280 bytes, with bytes that SLIP escapes. */
+int
+benchmark_packet(unsigned char *buf, int tunnel, unsigned long seq)
+{
+  uint32_t x;
+  int i, len;
+
+  len = 64 * (1 + seq % 20);
+  buf[0] = 0x60;
+  buf[1] = tunnel;
+  memcpy(&buf[2], &seq, sizeof(uint32_t));
+  x = seq * 2654435761u + tunnel;
+  for(i = 6; i < len; i++) {
+    x = x * 1103515245 + 12345;
+    buf[i] = x >> 16;
+  }
+  return len;
+}
+
+void
+benchmark_radio(int fd)
+{
+  unsigned char buf[READ_SIZE];
+  int n, m, k;
+
+  while((n = read(fd, buf, sizeof(buf))) > 0) {
+    for(m = 0; m < n; m += k) {
+      if((k = write(fd, buf + m, n - m)) <= 0) {
+	_exit(1);
+      }
+    }
+  }
+  _exit(0);
+}
+
+void
+benchmark_driver(int *fds, unsigned long packets)
+{
+  unsigned long sent[MAX_TUNNELS], received[MAX_TUNNELS];
+  unsigned long bytes, errors, total, ms;
+  unsigned char buf[PACKET_SIZE], expected[PACKET_SIZE];
+  struct timeval start, end;
+  fd_set rset;
+  int i, n, len, maxfd;
+
+  memset(sent, 0, sizeof(sent));
+  memset(received, 0, sizeof(received));
+  bytes = errors = total = 0;
+  gettimeofday(&start, NULL);
+
+  while(total < packets * ntunnels) {
+    maxfd = 0;
+    FD_ZERO(&rset);
+    for(i = 0; i < ntunnels; i++) {
+      while(sent[i] < packets && sent[i] - received[i] < BENCHMARK_WINDOW) {
+	len = benchmark_packet(buf, i, sent[i]);
+	if(write(fds[i], buf, len) != len) {
+	  err(1, "benchmark: write");
+	}
+	sent[i]++;
+      }
+      FD_SET(fds[i], &rset);
+      if(fds[i] > maxfd) maxfd = fds[i];
+    }
+    if(select(maxfd + 1, &rset, NULL, NULL, NULL) == -1) {
+      err(1, "benchmark: select");
+    }
+    for(i = 0; i < ntunnels; i++) {
+      if(!FD_ISSET(fds[i], &rset)) {
+	continue;
+      }
+      if((n = read(fds[i], buf, sizeof(buf))) <= 0) {
+	err(1, "benchmark: read");
+      }
+      len = benchmark_packet(expected, i, received[i]);
+      if(n != len || memcmp(buf, expected, len) != 0) {
+	errors++;
+      }
+      received[i]++;
+      bytes += n;
+      total++;
+    }
+  }
+
+  gettimeofday(&end, NULL);
+  ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+  if(ms == 0) {
+    ms = 1;
+  }
+  printf("%d tunnels, %lu packets, %lu bytes in %lu ms: %lu packets/s, %lu kB/s%s\n",
+	 ntunnels, total, bytes, ms, total * 1000 / ms, bytes / ms,
+	 errors ? "" : ", no errors");
+  if(errors) {
+    printf("%lu packets came back wrong\n", errors);
+  }
+  _exit(errors ? 1 : 0);
+}
+
+void
+benchmark_start(int n, unsigned long packets)
+{
+  int radios[MAX_TUNNELS], drivers[MAX_TUNNELS];
+  struct termios tty;
+  int i, j, sv[2];
+
+  for(i = 0; i < n; i++) {
+    struct tunnel *t = &tunnels[i];
+
+    if((t->slipfd = posix_openpt(O_RDWR | O_NOCTTY)) == -1 ||
+       grantpt(t->slipfd) == -1 || unlockpt(t->slipfd) == -1) {
+      err(1, "benchmark: posix_openpt");
+    }
+    if((radios[i] = open(ptsname(t->slipfd), O_RDWR | O_NOCTTY)) == -1) {
+      err(1, "benchmark: open %s", ptsname(t->slipfd));
+    }
+    if(tcgetattr(radios[i], &tty) == -1) err(1, "tcgetattr");
+    cfmakeraw(&tty);
+    if(tcsetattr(radios[i], TCSANOW, &tty) == -1) err(1, "tcsetattr");
+    fcntl(t->slipfd, F_SETFL, O_NONBLOCK);
+
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == -1) {
+      err(1, "benchmark: socketpair");
+    }
+    t->tunfd = sv[0];
+    drivers[i] = sv[1];
+    snprintf(t->tundev, sizeof(t->tundev), "bench%d", i);
+  }
+  ntunnels = n;
+
+  /* The children keep only their own ends. */
+  for(i = 0; i < n; i++) {
+    if(fork() == 0) {
+      for(j = 0; j < n; j++) {
+	close(tunnels[j].slipfd);
+	close(tunnels[j].tunfd);
+	close(drivers[j]);
+	if(j != i) close(radios[j]);
+      }
+      benchmark_radio(radios[i]);
+    }
+  }
+  if(fork() == 0) {
+    for(j = 0; j < n; j++) {
+      close(tunnels[j].slipfd);
+      close(tunnels[j].tunfd);
+      close(radios[j]);
+    }
+    benchmark_driver(drivers, packets);
+  }
+  for(i = 0; i < n; i++) {
+    close(radios[i]);
+    close(drivers[i]);
+  }
+}
+
 int
 main(int argc, char **argv)
 {
   int c;
-  int tunfd, maxfd;
-  int ret;
-  fd_set rset, wset;
-  FILE *inslip;
-  const char *siodev = NULL;
+  int i, n;
+  int timeout;
+  struct tunnel *t;
+  const char *siodevs[MAX_TUNNELS];
+  const char *tundevs[MAX_TUNNELS];
+  int nsiodevs = 0, ntundevs = 0;
   const char *host = NULL;
   const char *port = NULL;
   const char *prog;
   int baudrate = -2;
   int tap = 0;
-  slipfd = 0;
+  unsigned long benchmark = 0;
 
   prog = argv[0];
   setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
 
-  while((c = getopt(argc, argv, "B:HLhs:t:v::d::a:p:T")) != -1) {
+  while((c = getopt(argc, argv, "B:HLhs:t:v::d::a:p:Tb::")) != -1) {
     switch(c) {
     case 'B':
       baudrate = atoi(optarg);
@@ -719,18 +1151,24 @@ main(int argc, char **argv)
       break;
 
     case 's':
+      if(nsiodevs == MAX_TUNNELS) {
+	errx(1, "at most %d serial devices", MAX_TUNNELS);
+      }
       if(strncmp("/dev/", optarg, 5) == 0) {
-	siodev = optarg + 5;
+	siodevs[nsiodevs++] = optarg + 5;
       } else {
-	siodev = optarg;
+	siodevs[nsiodevs++] = optarg;
       }
       break;
 
     case 't':
+      if(ntundevs == MAX_TUNNELS) {
+	errx(1, "at most %d interfaces", MAX_TUNNELS);
+      }
       if(strncmp("/dev/", optarg, 5) == 0) {
-	strncpy(tundev, optarg + 5, sizeof(tundev));
+	tundevs[ntundevs++] = optarg + 5;
       } else {
-	strncpy(tundev, optarg, sizeof(tundev));
+	tundevs[ntundevs++] = optarg;
       }
       break;
 
@@ -755,12 +1193,18 @@ main(int argc, char **argv)
     case 'T':
       tap = 1;
       break;
+
+    case 'b':
+      benchmark = BENCHMARK_PACKETS;
+      if (optarg) benchmark = atol(optarg);
+      break;
  
     case '?':
     case 'h':
     default:
-fprintf(stderr,"usage:  %s [options] ipaddress\n", prog);
+fprintf(stderr,"usage:  %s [options] ipaddress...\n", prog);
 fprintf(stderr,"example: tunslip6 -L -v2 -s ttyUSB1 aaaa::1/64\n");
+fprintf(stderr,"example: tunslip6 -s ttyUSB0 -s ttyUSB1 aaaa::1/64 bbbb::1/64\n");
 fprintf(stderr,"Options are:\n");
 #ifndef __APPLE__
 fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400,460800,921600\n");
@@ -770,8 +1214,10 @@ fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400\n
 fprintf(stderr," -H             Hardware CTS/RTS flow control (default disabled)\n");
 fprintf(stderr," -L             Log output format (adds time stamps)\n");
 fprintf(stderr," -s siodev      Serial device (default /dev/ttyUSB0)\n");
+fprintf(stderr,"                Repeat for more radios, each with its own interface\n");
+fprintf(stderr,"                and ipaddress, in the same order.\n");
 fprintf(stderr," -T             Make tap interface (default is tun interface)\n");
-fprintf(stderr," -t tundev      Name of interface (default tap0 or tun0)\n");
+fprintf(stderr," -t tundev      Name of interface (default tap0 or tun0, tap1 or tun1...)\n");
 fprintf(stderr," -v[level]      Verbosity level\n");
 fprintf(stderr,"    -v0         No messages\n");
 fprintf(stderr,"    -v1         Encapsulated SLIP debug messages (default)\n");
@@ -785,6 +1231,9 @@ fprintf(stderr,"                Actual delay is basedelay*(#6LowPAN fragments) m
 fprintf(stderr,"                -d is equivalent to -d10.\n");
 fprintf(stderr," -a serveraddr  \n");
 fprintf(stderr," -p serverport  \n");
+fprintf(stderr," -b[packets]    Benchmark: loop SLIP back over pseudo-terminals, one for\n");
+fprintf(stderr,"                each ipaddress, and report the throughput. Needs no\n");
+fprintf(stderr,"                radio or root. -b is equivalent to -b%d.\n", BENCHMARK_PACKETS);
 exit(1);
       break;
     }
@@ -792,10 +1241,20 @@ exit(1);
   argc -= (optind - 1);
   argv += (optind - 1);
 
-  if(argc != 2 && argc != 3) {
-    err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress", prog);
+  n = nsiodevs > 0 ? nsiodevs : 1;
+  if(benchmark) {
+    n = argc - 1;
+  }
+  if(argc - 1 < n || argc - 1 > MAX_TUNNELS + 1 || n < 1 || n > MAX_TUNNELS) {
+    err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev]... [-t tundev]... [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] [-b packets] ipaddress...", prog);
+  }
+  if(host != NULL && n > 1) {
+    errx(1, "-a serves one tunnel");
+  }
+  for(i = 0; i < n; i++) {
+    tunnels[i].ipaddr = argv[1 + i];
+    tunnels[i].siodev = i < nsiodevs ? siodevs[i] : NULL;
   }
-  ipaddr = argv[1];
 
   switch(baudrate) {
   case -2:
@@ -831,19 +1290,23 @@ exit(1);
     break;
   }
 
-  if(*tundev == '\0') {
-    /* Use default. */
-    if(tap) {
-      strcpy(tundev, "tap0");
+  for(i = 0; i < n; i++) {
+    if(i < ntundevs) {
+      strncpy(tunnels[i].tundev, tundevs[i], sizeof(tunnels[i].tundev) - 1);
     } else {
-      strcpy(tundev, "tun0");
+      /* Use default. */
+      sprintf(tunnels[i].tundev, "%s%d", tap ? "tap" : "tun", i);
     }
   }
-  if(host != NULL) {
+
+  if(benchmark) {
+    benchmark_start(n, benchmark);
+  } else if(host != NULL) {
     struct addrinfo hints, *servinfo, *p;
     int rv;
     char s[INET6_ADDRSTRLEN];
 
+    t = &tunnels[0];
     if(port == NULL) {
       port = "60001";
     }
@@ -858,14 +1321,14 @@ exit(1);
 
     /* loop through all the results and connect to the first we can */
     for(p = servinfo; p != NULL; p = p->ai_next) {
-      if((slipfd = socket(p->ai_family, p->ai_socktype,
+      if((t->slipfd = socket(p->ai_family, p->ai_socktype,
                           p->ai_protocol)) == -1) {
         perror("client: socket");
         continue;
       }
 
-      if(connect(slipfd, p->ai_addr, p->ai_addrlen) == -1) {
-        close(slipfd);
+      if(connect(t->slipfd, p->ai_addr, p->ai_addrlen) == -1) {
+        close(t->slipfd);
         perror("client: connect");
         continue;
       }
@@ -876,7 +1339,7 @@ exit(1);
       err(1, "can't connect to ``%s:%s''", host, port);
     }
 
-    fcntl(slipfd, F_SETFL, O_NONBLOCK);
+    fcntl(t->slipfd, F_SETFL, O_NONBLOCK);
 
     inet_ntop(p->ai_family, get_in_addr((struct sockaddr *)p->ai_addr),
               s, sizeof(s));
@@ -886,115 +1349,129 @@ exit(1);
     freeaddrinfo(servinfo);
 
   } else {
-    if(siodev != NULL) {
-      slipfd = devopen(siodev, O_RDWR | O_NONBLOCK);
-      if(slipfd == -1) {
-	err(1, "can't open siodev ``/dev/%s''", siodev);
-      }
-    } else {
-      static const char *siodevs[] = {
-        "ttyUSB0", "cuaU0", "ucom0" /* linux, fbsd6, fbsd5 */
-      };
-      int i;
-      for(i = 0; i < 3; i++) {
-        siodev = siodevs[i];
-        slipfd = devopen(siodev, O_RDWR | O_NONBLOCK);
-        if(slipfd != -1) {
-          break;
-        }
-      }
-      if(slipfd == -1) {
-        err(1, "can't open siodev");
+    for(t = tunnels; t < &tunnels[n]; t++) {
+      if(t->siodev != NULL) {
+	t->slipfd = devopen(t->siodev, O_RDWR | O_NONBLOCK);
+	if(t->slipfd == -1) {
+	  err(1, "can't open siodev ``/dev/%s''", t->siodev);
+	}
+      } else {
+	static const char *siodevs[] = {
+	  "ttyUSB0", "cuaU0", "ucom0" /* linux, fbsd6, fbsd5 */
+	};
+	int i;
+	for(i = 0; i < 3; i++) {
+	  t->siodev = siodevs[i];
+	  t->slipfd = devopen(t->siodev, O_RDWR | O_NONBLOCK);
+	  if(t->slipfd != -1) {
+	    break;
+	  }
+	}
+	if(t->slipfd == -1) {
+	  err(1, "can't open siodev");
+	}
       }
+      if (timestamp) stamptime();
+      fprintf(stderr, "********SLIP started on ``/dev/%s''\n", t->siodev);
+      stty_telos(t->slipfd);
     }
-    if (timestamp) stamptime();
-    fprintf(stderr, "********SLIP started on ``/dev/%s''\n", siodev);
-    stty_telos(slipfd);
   }
-  slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) err(1, "main: fdopen");
 
-  tunfd = tun_alloc(tundev, tap);
-  if(tunfd == -1) err(1, "main: open");
-  if (timestamp) stamptime();
-  fprintf(stderr, "opened %s device ``/dev/%s''\n",
-          tap ? "tap" : "tun", tundev);
+  if(!benchmark) {
+    atexit(cleanup);
+    for(t = tunnels; t < &tunnels[n]; t++) {
+      t->tunfd = tun_alloc(t->tundev, tap);
+      if(t->tunfd == -1) err(1, "main: open");
+      ntunnels++;
+      if (timestamp) stamptime();
+      fprintf(stderr, "opened %s device ``/dev/%s''\n",
+	      tap ? "tap" : "tun", t->tundev);
+    }
+  }
+
+  for(t = tunnels; t < &tunnels[n]; t++) {
+    slip_send(t, SLIP_END);
+    /* All the packets that are waiting are read at once. */
+    fcntl(t->tunfd, F_SETFL, O_NONBLOCK);
+  }
 
-  atexit(cleanup);
   signal(SIGHUP, sigcleanup);
   signal(SIGTERM, sigcleanup);
   signal(SIGINT, sigcleanup);
   signal(SIGALRM, sigalarm);
-  ifconf(tundev, ipaddr);
+  if(!benchmark) {
+    for(t = tunnels; t < &tunnels[n]; t++) {
+      ifconf(t->tundev, t->ipaddr);
+    }
+  }
 
   while(1) {
-    maxfd = 0;
-    FD_ZERO(&rset);
-    FD_ZERO(&wset);
+    timeout = -1;
+    for(t = tunnels; t < &tunnels[ntunnels]; t++) {
+      /* Optional delay between outgoing packets */
+      /* Base delay times number of 6lowpan fragments to be sent */
+      if(t->delaymsec) {
+	struct timeval tv;
+	int dmsec;
+	gettimeofday(&tv, NULL) ;
+	dmsec=(tv.tv_sec-t->delaystartsec)*1000+tv.tv_usec/1000-t->delaystartmsec;
+	if(dmsec<0) t->delaymsec=0;
+	if(dmsec>t->delaymsec) t->delaymsec=0;
+	if(t->delaymsec && (timeout == -1 || t->delaymsec - dmsec + 1 < timeout)) {
+	  timeout = t->delaymsec - dmsec + 1;
+	}
+      }
 
 /* do not send IPA all the time... - add get MAC later... */
 /*     if(got_sigalarm) { */
 /*       /\* Send "?IPA". *\/ */
-/*       slip_send(slipfd, '?'); */
-/*       slip_send(slipfd, 'I'); */
-/*       slip_send(slipfd, 'P'); */
-/*       slip_send(slipfd, 'A'); */
-/*       slip_send(slipfd, SLIP_END); */
+/*       slip_send(t, '?'); */
+/*       slip_send(t, 'I'); */
+/*       slip_send(t, 'P'); */
+/*       slip_send(t, 'A'); */
+/*       slip_send(t, SLIP_END); */
 /*       got_sigalarm = 0; */
 /*     } */
 
-    if(!slip_empty()) {		/* Anything to flush? */
-      FD_SET(slipfd, &wset);
+      t->watching = EV_SLIP_IN;	/* Read from slip ASAP! */
+      if(!slip_empty(t)) {	/* Anything to flush? */
+	t->watching |= EV_SLIP_OUT;
+      }
+      /* With a delay, only one packet at a time is queued for slip
+	 output. Otherwise as many as fit. */
+      if(t->delaymsec == 0 && (basedelay ? slip_empty(t) : slip_room(t))) {
+	t->watching |= EV_TUN_IN;
+      }
     }
 
-    FD_SET(slipfd, &rset);	/* Read from slip ASAP! */
-    if(slipfd > maxfd) maxfd = slipfd;
-    
-    /* We only have one packet at a time queued for slip output. */
-    if(slip_empty()) {
-      FD_SET(tunfd, &rset);
-      if(tunfd > maxfd) maxfd = tunfd;
+    if(wait_events(timeout) == 0) {
+      continue;
     }
 
-    ret = select(maxfd + 1, &rset, &wset, NULL, NULL);
-    if(ret == -1 && errno != EINTR) {
-      err(1, "select");
-    } else if(ret > 0) {
-      if(FD_ISSET(slipfd, &rset)) {
-        serial_to_tun(inslip, tunfd);
+    for(t = tunnels; t < &tunnels[ntunnels]; t++) {
+      if(t->events & EV_SLIP_IN) {
+	serial_to_tun(t);
       }
-      
-      if(FD_ISSET(slipfd, &wset)) {
-	slip_flushbuf(slipfd);
+
+      if(t->events & EV_SLIP_OUT) {
+	slip_flushbuf(t);
 	sigalarm_reset();
       }
- 
-      /* Optional delay between outgoing packets */
-      /* Base delay times number of 6lowpan fragments to be sent */
-      if(delaymsec) {
-       struct timeval tv;
-       int dmsec;
-       gettimeofday(&tv, NULL) ;
-       dmsec=(tv.tv_sec-delaystartsec)*1000+tv.tv_usec/1000-delaystartmsec;
-       if(dmsec<0) delaymsec=0;
-       if(dmsec>delaymsec) delaymsec=0;
-      }
-      if(delaymsec==0) {
-        int size;
-        if(slip_empty() && FD_ISSET(tunfd, &rset)) {
-          size=tun_to_serial(tunfd, slipfd);
-          slip_flushbuf(slipfd);
-          sigalarm_reset();
-          if(basedelay) {
-            struct timeval tv;
-            gettimeofday(&tv, NULL) ;
+
+      if(t->events & EV_TUN_IN) {
+	while(slip_room(t) && tun_to_serial(t) > 0) {
+	  if(basedelay) {
+	    struct timeval tv;
+	    gettimeofday(&tv, NULL) ;
  //         delaymsec=basedelay*(1+(size/120));//multiply by # of 6lowpan packets?
-            delaymsec=basedelay;
-            delaystartsec =tv.tv_sec;
-            delaystartmsec=tv.tv_usec/1000;
-          }
-        }
+	    t->delaymsec=basedelay;
+	    t->delaystartsec =tv.tv_sec;
+	    t->delaystartmsec=tv.tv_usec/1000;
+	    break;
+	  }
+	}
+	slip_flushbuf(t);
+	sigalarm_reset();
       }
     }
   }